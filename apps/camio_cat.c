@@ -19,6 +19,8 @@ static camio_list_t(istream) istreams = {};
 static camio_list_t(ostream) ostreams = {};
 static camio_perf_t* perf_mon = NULL;
 
+#define CAT_READY_MAX 64 //Most streams to take from the selector per wakeup
+
 void term(int signum){
     camio_perf_finish(perf_mon);
     int i;
@@ -81,47 +83,53 @@ int main(int argc, char** argv){
     size_t len = 0;
     size_t which = ~0;
     uint8_t* free_buff = NULL;
+    size_t ready[CAT_READY_MAX];
+    size_t count = 0;
+    size_t r = 0;
 
     while(selector->count(selector)){
 
-        //Wait for some input
-        which = selector->select(selector);
-
-        //Read the input from the right stream
-        camio_istream_t* in = istreams.items[which];
-        len = in->start_read(in, &in_buff );
-        if(unlikely(!len)){
-            selector->remove(selector,which);
-            continue;
-        }
-
-        //Write it out
-        for(i=0; i < ostreams.count; i++){
-            camio_ostream_t* out = ostreams.items[i];
-
-            //Assign writes may imply a memory copy
-            if(likely(out->can_assign_write(out))){
-                //Try to write, if it fails, keep trying
-                while( out->assign_write(out,in_buff,len) < 0 ) { usleep(100* 1000); }
-                in_buff = NULL;
-            }
-            //Non assigned writes require memory copy
-            else{
-                 //Try to write, if it fails, keep trying
-                 while(! (out_buff = out->start_write(out,len)) ) { usleep(100 * 1000);}
-                 if(unlikely(!out_buff)){
-                     printf("Could not get an output buffer for output %i\n", i);
-                     continue;
-                 }
-                 memcpy(out_buff,in_buff,len);
-                 out_buff = NULL;
+        //Wait for some input, then drain everything that is ready before waiting again
+        count = selector->select_many(selector, ready, CAT_READY_MAX);
+        for(r = 0; r < count; r++){
+            which = ready[r];
+
+            //Read the input from the right stream
+            camio_istream_t* in = istreams.items[which];
+            len = in->start_read(in, &in_buff );
+            if(unlikely(!len)){
+                selector->remove(selector,which);
+                continue;
             }
 
-            free_buff = out->end_write(out, len);
-            if(unlikely(in->end_read(in, free_buff))){
-                printf("Overrun detected for output %i\n", i);
-            }
+            //Write it out
+            for(i=0; i < ostreams.count; i++){
+                camio_ostream_t* out = ostreams.items[i];
+
+                //Assign writes may imply a memory copy
+                if(likely(out->can_assign_write(out))){
+                    //Try to write, if it fails, keep trying
+                    while( out->assign_write(out,in_buff,len) < 0 ) { usleep(100* 1000); }
+                    in_buff = NULL;
+                }
+                //Non assigned writes require memory copy
+                else{
+                     //Try to write, if it fails, keep trying
+                     while(! (out_buff = out->start_write(out,len)) ) { usleep(100 * 1000);}
+                     if(unlikely(!out_buff)){
+                         printf("Could not get an output buffer for output %i\n", i);
+                         continue;
+                     }
+                     memcpy(out_buff,in_buff,len);
+                     out_buff = NULL;
+                }
+
+                free_buff = out->end_write(out, len);
+                if(unlikely(in->end_read(in, free_buff))){
+                    printf("Overrun detected for output %i\n", i);
+                }
 
+            }
         }
     }
 
@@ -0,0 +1,76 @@
+/*
+ * Copyright  (C) Matthew P. Grosvenor, 2012, All Rights Reserved
+ *
+ * Measures how long it takes to read each of the camio clocks
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "camio.h"
+
+static struct camio_clock_bench_options_t{
+    uint64_t count;
+    char* clocks;
+} options ;
+
+
+static uint64_t now_ns(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000 * 1000 * 1000ULL + ts.tv_nsec;
+}
+
+
+static void bench(char* description){
+    camio_clock_t* clock = camio_clock_new(description, NULL);
+
+    //Warm up, and make sure the calls can't be thrown away
+    int64_t sum = 0;
+    uint64_t i  = 0;
+    for(; i < options.count / 10; i++){
+        sum += clock->get(clock)->counter;
+    }
+
+    const uint64_t start = now_ns();
+    for(i = 0; i < options.count; i++){
+        sum += clock->get(clock)->counter;
+    }
+    const uint64_t end = now_ns();
+
+    const camio_time_t* time = clock->get(clock);
+    struct timespec ts;
+    camio_time_to_timespec(time, &ts);
+
+    printf("%-16s %8.2lfns/get  now=%lu.%09lus  (check=%li)\n", description,
+            (double)(end - start) / options.count, ts.tv_sec, ts.tv_nsec, sum & 0xF);
+
+    free(clock->priv);
+}
+
+
+int main(int argc, char** argv){
+
+    camio_options_short_description("camio_clock_bench");
+    camio_options_add(CAMIO_OPTION_OPTIONAL, 'n', "count",  "Number of get() calls to time on each clock [10000000]", CAMIO_UINT64, &options.count, 10000000ULL);
+    camio_options_add(CAMIO_OPTION_OPTIONAL, 'c', "clocks", "Comma separated list of clocks to time [tsc,monotonic,monotonic_raw,realtime]", CAMIO_STRING, &options.clocks, "tsc,monotonic,monotonic_raw,realtime");
+    camio_options_long_description("Times the get() call on each of the free running clocks.");
+    camio_options_parse(argc, argv);
+
+    if(!options.count){
+        eprintf_exit("Need at least one get() call to time\n");
+    }
+
+    char* clocks = strdup(options.clocks);
+    char* save   = NULL;
+    char* description = strtok_r(clocks, ",", &save);
+    for(; description; description = strtok_r(NULL, ",", &save)){
+        bench(description);
+    }
+
+    free(clocks);
+    return 0;
+}
@@ -27,6 +27,8 @@ static camio_perf_t* perf_mon = NULL;
 
 enum { CONLISTEN = 0, IOSTREAM, INSTREAM, OUTSTREAM };
 
+#define HTTPD_READY_MAX 64 //Most streams to take from the selector per wakeup
+
 
 void term(int signum){
     camio_perf_finish(perf_mon);
@@ -126,6 +128,9 @@ int main(int argc, char** argv){
     uint8_t* buff = NULL;
     size_t len = 0;
     size_t which = ~0;
+    size_t ready[HTTPD_READY_MAX];
+    size_t count = 0;
+    size_t r = 0;
 
     int i = 0;
     for(;i < STATIC_CONTENT_SIZE; i++){
@@ -136,33 +141,36 @@ int main(int argc, char** argv){
 
     while(selector->count(selector)){
 
-        //Wait for some input
-        which = selector->select(selector);
-        if(which == CONLISTEN){
-                len = con_listener->start_read(con_listener,&buff);
-
-                camio_iostream_tcp_params_t params = { .listen = 0, .fd = *(int*)buff };
-                iostream = camio_iostream_delimiter_new( camio_iostream_new("tcp",NULL,&params, perf_mon) , http_delimiter, NULL) ;
+        //Wait for some input, then deal with everything that is ready before waiting again
+        count = selector->select_many(selector, ready, HTTPD_READY_MAX);
+        for(r = 0; r < count; r++){
+            which = ready[r];
+            if(which == CONLISTEN){
+                    len = con_listener->start_read(con_listener,&buff);
 
-                //We use the integer value of the iostream pointer as its identifier in the selector
-                selector->insert(selector,&iostream->selector,(size_t)iostream);
-                //printf("[0x%016lx] new stream\n", (size_t)iostream);
-                con_listener->end_read(con_listener, NULL);
-        }
-        else{
-            iostream = (camio_iostream_t*)which;
-            len = iostream->start_read(iostream,&buff);
-            //printf("[0x%016lx] stream has %lu bytes data\n", (size_t)iostream, len);
+                    camio_iostream_tcp_params_t params = { .listen = 0, .fd = *(int*)buff };
+                    iostream = camio_iostream_delimiter_new( camio_iostream_new("tcp",NULL,&params, perf_mon) , http_delimiter, NULL) ;
 
-            if(len == 0){
+                    //We use the integer value of the iostream pointer as its identifier in the selector
+                    selector->insert(selector,&iostream->selector,(size_t)iostream);
+                    //printf("[0x%016lx] new stream\n", (size_t)iostream);
+                    con_listener->end_read(con_listener, NULL);
+            }
+            else{
+                iostream = (camio_iostream_t*)which;
+                len = iostream->start_read(iostream,&buff);
+                //printf("[0x%016lx] stream has %lu bytes data\n", (size_t)iostream, len);
+
+                if(len == 0){
+                    iostream->end_read(iostream, NULL);
+                    selector->remove(selector, which);
+                    iostream->delete(iostream);
+                    //printf("[0x%016lx] stream deleted\n", (size_t)iostream);
+                    continue;
+                }
+                http_decode(buff,len);
                 iostream->end_read(iostream, NULL);
-                selector->remove(selector, which);
-                iostream->delete(iostream);
-                //printf("[0x%016lx] stream deleted\n", (size_t)iostream);
-                continue;
             }
-            http_decode(buff,len);
-            iostream->end_read(iostream, NULL);
         }
 
     }
@@ -0,0 +1,336 @@
+/*
+ * Copyright  (C) Matthew P. Grosvenor, 2012, All Rights Reserved
+ *
+ * Reports on a camio perf dump. Start and stop events are paired up into latency histograms, and each event is
+ * counted to give a throughput for every stream type.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "camio.h"
+#include "perf/camio_perf_trace.h"
+#include "perf/camio_perf_chrome.h"
+
+//Histograms are log linear, like HDR histograms. Every power of two range is split into 2^SUB_BITS linear buckets,
+//so that any value is recorded to within 1 part in 2^SUB_BITS, whatever its size.
+#define CAMIO_PERF_HIST_SUB_BITS (10)
+#define CAMIO_PERF_HIST_SUB (1ULL << CAMIO_PERF_HIST_SUB_BITS)
+#define CAMIO_PERF_HIST_BUCKETS ((64 - CAMIO_PERF_HIST_SUB_BITS + 1) * CAMIO_PERF_HIST_SUB)
+
+static struct camio_perf_options_t{
+    char* input;
+    uint64_t tsc_hz;
+    char* from;
+    char* to;
+    char* chrome;
+    int quiet;
+} options ;
+
+
+typedef struct {
+    uint64_t count;
+    uint64_t min;
+    uint64_t max;
+    double sum;
+    uint64_t* buckets;
+    uint64_t counted;                               //Pairs with counter deltas, summed below
+    uint32_t counter_kind;
+    double counter_sums[CAMIO_PERF_COUNTERS];
+} hist_t;
+
+static const double percentiles[] = { 50, 90, 99, 99.9, 99.99, 99.999 };
+#define PERCENTILES (sizeof(percentiles) / sizeof(percentiles[0]))
+
+
+static inline uint64_t hist_index(uint64_t value){
+    if(value < 2 * CAMIO_PERF_HIST_SUB){
+        return value;
+    }
+    const uint64_t shift = 63 - __builtin_clzll(value) - CAMIO_PERF_HIST_SUB_BITS;
+    return (shift + 1) * CAMIO_PERF_HIST_SUB + ((value >> shift) - CAMIO_PERF_HIST_SUB);
+}
+
+
+//The middle of the range of values that land in a bucket
+static inline uint64_t hist_value(uint64_t index){
+    if(index < 2 * CAMIO_PERF_HIST_SUB){
+        return index;
+    }
+    const uint64_t shift = index / CAMIO_PERF_HIST_SUB - 1;
+    const uint64_t base  = (index % CAMIO_PERF_HIST_SUB + CAMIO_PERF_HIST_SUB) << shift;
+    return base + ((1ULL << shift) >> 1);
+}
+
+
+static void hist_add(hist_t* hist, uint64_t value){
+    if(!hist->buckets){
+        hist->buckets = calloc(CAMIO_PERF_HIST_BUCKETS, sizeof(uint64_t));
+        if(!hist->buckets){
+            eprintf_exit("Could not allocate memory for histogram\n");
+        }
+        hist->min = ~0ULL;
+    }
+
+    hist->buckets[hist_index(value)]++;
+    hist->count++;
+    hist->sum += value;
+    hist->min = MIN(hist->min, value);
+    hist->max = MAX(hist->max, value);
+}
+
+
+static void hist_print(const char* name, const hist_t* hist){
+    printf("%-48s %10lu %10.0lf %10lu", name, hist->count, hist->sum / hist->count, hist->min);
+
+    uint64_t seen  = 0;
+    uint64_t index = 0;
+    size_t p = 0;
+    for(; p < PERCENTILES; p++){
+        const uint64_t want = (uint64_t)(percentiles[p] / 100.0 * hist->count + 0.5);
+        while(seen < MAX(want, 1) && index < CAMIO_PERF_HIST_BUCKETS){
+            seen += hist->buckets[index++];
+        }
+        printf(" %10lu", MIN(hist_value(index - 1), hist->max));
+    }
+
+    printf(" %10lu\n", hist->max);
+}
+
+
+//Latencies, by start event and condition, and by stop condition
+typedef struct {
+    const camio_perf_trace_t* trace;
+    uint64_t events;
+    uint64_t conds;
+    hist_t* hists;
+} pairs_t;
+
+
+static void on_pair(void* arg, const camio_perf_trace_buff_t* buff, const camio_perf_event_t* start,
+        const camio_perf_event_t* stop){
+    pairs_t* pairs = arg;
+    const uint64_t event_id = start->event_id;
+    if(event_id >= pairs->events || start->cond_id >= pairs->conds || stop->cond_id >= pairs->conds){
+        return;
+    }
+
+    const uint64_t ticks = stop->ts > start->ts ? stop->ts - start->ts : 0;
+    hist_t* hist = &pairs->hists[(event_id * pairs->conds + start->cond_id) * pairs->conds + stop->cond_id];
+    hist_add(hist, camio_perf_trace_ticks_to_ns(pairs->trace, ticks));
+
+    camio_perf_counts_t deltas;
+    if(camio_perf_trace_deltas(buff, start, stop, &deltas)){
+        int c = 0;
+        for(c = 0; c < CAMIO_PERF_COUNTERS; c++){
+            hist->counter_sums[c] += deltas.values[c];
+        }
+        hist->counter_kind = buff->counter_kind;
+        hist->counted++;
+    }
+}
+
+
+//Mean counter deltas for each kind of pair that has them, with instructions per cycle when there are hardware counters
+static void report_counters(const camio_perf_trace_t* trace, const pairs_t* pairs, char (*names)[3 * CAMIO_PERF_FILE_NAME_LEN + 3]){
+    uint64_t kind = CAMIO_PERF_COUNTERS_NONE + 1;
+    for(; kind < CAMIO_PERF_COUNTERS_KINDS; kind++){
+        int header = 0;
+        uint64_t h = 0;
+        for(h = 0; h < pairs->events * pairs->conds * pairs->conds; h++){
+            const hist_t* hist = &pairs->hists[h];
+            if(!hist->counted || hist->counter_kind != kind){
+                continue;
+            }
+
+            if(!header){
+                header = 1;
+                printf("\nCounters, mean per pair\n%-48s %10s", "event/start_cond/stop_cond", "pairs");
+                int c = 0;
+                for(c = 0; c < CAMIO_PERF_COUNTERS; c++){
+                    printf(" %14s", camio_perf_trace_counter_name(trace, kind, c));
+                }
+                printf(kind == CAMIO_PERF_COUNTERS_HW ? " %8s\n" : "\n", "ipc");
+            }
+
+            printf("%-48s %10lu", names[h], hist->counted);
+            int c = 0;
+            for(c = 0; c < CAMIO_PERF_COUNTERS; c++){
+                printf(" %14.2lf", hist->counter_sums[c] / hist->counted);
+            }
+            if(kind == CAMIO_PERF_COUNTERS_HW){
+                printf(" %8.2lf", hist->counter_sums[0] ? hist->counter_sums[1] / hist->counter_sums[0] : 0.0);
+            }
+            printf("\n");
+        }
+    }
+}
+
+
+static void report_latency(const camio_perf_trace_t* trace, int64_t from, int64_t to){
+    pairs_t pairs;
+    pairs.trace  = trace;
+    pairs.events = trace->event_names_len;
+    pairs.conds  = trace->cond_names_len;
+    pairs.hists  = calloc(pairs.events * pairs.conds * pairs.conds + 1, sizeof(hist_t));
+    if(!pairs.hists){
+        eprintf_exit("Could not allocate memory for histograms\n");
+    }
+
+    camio_perf_trace_pair_stats_t stats;
+    camio_perf_trace_pairs(trace, from, to, on_pair, NULL, &pairs, &stats);
+
+    printf("Latency (ns), %lu pairs, %lu unmatched starts, %lu unmatched stops\n",
+            stats.pairs, stats.unmatched_starts, stats.unmatched_stops);
+    printf("%-48s %10s %10s %10s", "event/start_cond/stop_cond", "count", "mean", "min");
+    size_t p = 0;
+    for(; p < PERCENTILES; p++){
+        char heading[16];
+        snprintf(heading, sizeof(heading), "p%g", percentiles[p]);
+        printf(" %10s", heading);
+    }
+    printf(" %10s\n", "max");
+
+    char (*names)[3 * CAMIO_PERF_FILE_NAME_LEN + 3] = calloc(pairs.events * pairs.conds * pairs.conds + 1, sizeof(*names));
+    if(!names){
+        eprintf_exit("Could not allocate memory for histogram names\n");
+    }
+
+    uint64_t e = 0, a = 0, o = 0;
+    for(e = 0; e < pairs.events; e++){
+        for(a = 0; a < pairs.conds; a++){
+            for(o = 0; o < pairs.conds; o++){
+                hist_t* hist = &pairs.hists[(e * pairs.conds + a) * pairs.conds + o];
+                if(!hist->count){
+                    continue;
+                }
+
+                char* name = names[(e * pairs.conds + a) * pairs.conds + o];
+                const size_t size = sizeof(*names);
+                int len = snprintf(name, size, "%s", from >= 0 && to >= 0 ?
+                        camio_perf_trace_event_name(trace, from) : camio_perf_trace_event_name(trace, e));
+                if(from >= 0 && to >= 0){
+                    len += snprintf(name + len, size - len, "->%s", camio_perf_trace_event_name(trace, to));
+                }
+                len += snprintf(name + len, size - len, "/%s", camio_perf_trace_cond_name(trace, a));
+                snprintf(name + len, size - len, "/%s", camio_perf_trace_cond_name(trace, o));
+
+                hist_print(name, hist);
+                free(hist->buckets);
+            }
+        }
+    }
+
+    report_counters(trace, &pairs, names);
+    free(names);
+    free(pairs.hists);
+}
+
+
+//Events per second for each event, over the time between the first and last time it was seen in any thread
+static void report_throughput(const camio_perf_trace_t* trace){
+    const uint64_t events = trace->event_names_len;
+    uint64_t* starts = calloc(events, sizeof(uint64_t));
+    uint64_t* stops  = calloc(events, sizeof(uint64_t));
+    uint64_t* first  = calloc(events, sizeof(uint64_t));
+    uint64_t* last   = calloc(events, sizeof(uint64_t));
+    if(!starts || !stops || !first || !last){
+        eprintf_exit("Could not allocate memory for event counts\n");
+    }
+
+    uint64_t logged = 0;
+    uint64_t kept   = 0;
+    uint64_t b = 0, i = 0;
+    for(b = 0; b < trace->buffs_len; b++){
+        const camio_perf_trace_buff_t* buff = &trace->buffs[b];
+        logged += buff->event_count;
+        kept   += buff->events_len;
+
+        for(i = 0; i < buff->events_len; i++){
+            const camio_perf_event_t* event = &buff->events[i];
+            const uint64_t event_id = event->event_id & ~CAMIO_PERF_EVENT_STOP;
+            if(event_id >= events){
+                continue;
+            }
+
+            if(event->event_id & CAMIO_PERF_EVENT_STOP){
+                stops[event_id]++;
+            }
+            else{
+                starts[event_id]++;
+            }
+            first[event_id] = first[event_id] ? MIN(first[event_id], event->ts) : event->ts;
+            last[event_id]  = MAX(last[event_id], event->ts);
+        }
+    }
+
+    printf("\nThroughput, %lu threads, %lu of %lu events kept, TSC at %.3lfGHz\n",
+            trace->buffs_len, kept, logged, trace->tsc_hz / 1e9);
+    printf("%-48s %10s %10s %12s %14s\n", "event", "starts", "stops", "span (ms)", "ops/s");
+
+    for(i = 0; i < events; i++){
+        if(!starts[i] && !stops[i]){
+            continue;
+        }
+
+        //Streams log either side of an operation, or only one side of it, so an operation is whichever is larger
+        const uint64_t ops     = MAX(starts[i], stops[i]);
+        const uint64_t span_ns = camio_perf_trace_ticks_to_ns(trace, last[i] - first[i]);
+        printf("%-48s %10lu %10lu %12.3lf", camio_perf_trace_event_name(trace, i), starts[i], stops[i], span_ns / 1e6);
+        if(span_ns){
+            printf(" %14.0lf\n", ops * 1e9 / span_ns);
+        }
+        else{
+            printf(" %14s\n", "-");
+        }
+    }
+
+    free(starts);
+    free(stops);
+    free(first);
+    free(last);
+}
+
+
+int main(int argc, char** argv){
+
+    camio_options_short_description("camio_perf");
+    camio_options_add(CAMIO_OPTION_REQUIRED, 'i', "input",  "Perf dump to report on, text or binary", CAMIO_STRING, &options.input, "");
+    camio_options_add(CAMIO_OPTION_OPTIONAL, 't', "tsc-hz", "TSC rate that the dump was taken at. Measured on this machine for text dumps if 0 [0]", CAMIO_UINT64, &options.tsc_hz, 0ULL);
+    camio_options_add(CAMIO_OPTION_OPTIONAL, 'f', "from",   "Pair starts of this event with stops of --to, eg istream_udp", CAMIO_STRING, &options.from, "");
+    camio_options_add(CAMIO_OPTION_OPTIONAL, 'o', "to",     "Pair stops of this event with starts of --from, eg ostream_udp", CAMIO_STRING, &options.to, "");
+    camio_options_add(CAMIO_OPTION_OPTIONAL, 'c', "chrome", "Also write a Chrome/Perfetto JSON timeline to this output, eg blob:/tmp/camio.json", CAMIO_STRING, &options.chrome, "");
+    camio_options_add(CAMIO_OPTION_FLAG,     'q', "quiet",  "Don't print the latency and throughput reports", CAMIO_BOOL, &options.quiet, 0);
+    camio_options_long_description("Pairs up start and stop events in a camio perf dump, and prints latency percentiles and throughput for each stream type.");
+    camio_options_parse(argc, argv);
+
+    if(!*options.from != !*options.to){
+        eprintf_exit("--from and --to must be given together\n");
+    }
+
+    camio_perf_trace_t* trace = camio_perf_trace_load(options.input, options.tsc_hz);
+
+    int64_t from = -1;
+    int64_t to   = -1;
+    if(*options.from){
+        from = camio_perf_trace_find_event(trace, options.from);
+        to   = camio_perf_trace_find_event(trace, options.to);
+        if(from < 0 || to < 0){
+            eprintf_exit("Unknown event \"%s\"\n", from < 0 ? options.from : options.to);
+        }
+    }
+
+    if(!options.quiet){
+        report_latency(trace, from, to);
+        report_throughput(trace);
+    }
+
+    if(*options.chrome){
+        camio_perf_chrome_export(trace, from, to, options.chrome);
+    }
+
+    camio_perf_trace_free(trace);
+    return 0;
+}
@@ -1,12 +1,15 @@
 
 #include <stdio.h>
+#include <errno.h>
 #include <stdlib.h>
 #include <memory.h>
 #include <signal.h>
 #include <sys/time.h>
+#include <sys/wait.h>
 
 #include "camio.h"
 #include "utils/camio_ring.h"
+#include "utils/camio_tsc.h"
 
 static struct camio_cat_options_t{
     char* stream;
@@ -15,6 +18,11 @@ static struct camio_cat_options_t{
     char* perf_out;
     int begin;
     int64_t amount;
+    uint64_t batch;
+    int regress;
+    double max_ns;
+    uint64_t count;
+    uint64_t gap_ns;
 } options ;
 
 static camio_istream_t*     in = NULL;
@@ -46,25 +54,48 @@ static void do_listener(uint64_t amt){
 
     printf("Running do_listener...\n");
     gettimeofday(&start, NULL);
+    camio_batch_item_t batch[options.batch ? options.batch : 1];
+    uint64_t report_count = 1000 * 1000 * 10;
+    uint64_t last_count = 0;
     while(1){
         if(likely(in->ready(in))){
-            len = in->start_read(in,&buff);
+            if(options.batch){
+                const int count = in->start_read_batch(in, batch, options.batch);
+                uint64_t batch_data = 0;
+                int i = 0;
+                for(i = 0; i < count; i++){
+                    batch_data += batch[i].len;
+                }
 
-            if(in->end_read(in,NULL)){
-                error_count++;
+                if(in->end_read_batch(in)){
+                    error_count += count;
+                }
+                else{
+                    read_count += count;
+                    total_data += batch_data;
+                }
             }
             else{
-                read_count++;
-                total_data += len;
+                len = in->start_read(in,&buff);
+
+                if(in->end_read(in,NULL)){
+                    error_count++;
+                }
+                else{
+                    read_count++;
+                    total_data += len;
+                }
             }
 
-            if(unlikely( read_count && !(read_count % (1000 * 1000 * 10)) )){
+            if(unlikely( read_count >= report_count )){
                 gettimeofday(&end,NULL);
                 const uint64_t nanos_start  = start.tv_sec * 1000 * 1000 + start.tv_usec;
                 const uint64_t nanos_end    = end.tv_sec * 1000 * 1000 + end.tv_usec;
-                printf("%c,%lf, %lu, %lu\n", 'l', (nanos_end - nanos_start) / (1000 * 1000 * 10.0) ,total_data / (nanos_end - nanos_start), read_count);
+                printf("%c,%lf, %lu, %lu\n", 'l', (nanos_end - nanos_start) / (double)(read_count - last_count) ,total_data / (nanos_end - nanos_start), read_count);
                 total_data = 0;
                 error_count = 0;
+                last_count = read_count;
+                report_count += 1000 * 1000 * 10;
                 gettimeofday(&start,NULL);
             }
         }
@@ -80,7 +111,7 @@ static void do_sender(int amt){
     uint64_t total_data = 0;
 
     //Make some test data
-    const uint64_t test_data_size = MIN(amt / sizeof(uint64_t),CAMIO_RING_SLOT_AVAIL / sizeof(uint64_t));
+    const uint64_t test_data_size = MIN(amt / sizeof(uint64_t),(CAMIO_RING_SLOT_SIZE_DEFAULT - 2 * sizeof(uint64_t)) / sizeof(uint64_t));
     printf("Sending %lu 64bits words at a time\n", test_data_size);
     uint64_t test_data[test_data_size];
     const uint64_t test_pattern = 0xCAFEFEEDDEADBEEFULL;
@@ -90,6 +121,26 @@ static void do_sender(int amt){
         test_data[i] = test_pattern + i;
     }
     uint64_t seq = 0;
+    camio_batch_item_t batch[options.batch ? options.batch : 1];
+    for(i = 0; i < options.batch; i++){
+        batch[i].buffer = (uint8_t*)test_data;
+        batch[i].len    = test_data_size;
+    }
+    uint64_t report_count = 1000 * 1000 * 10;
+    uint64_t last_count = 0;
+
+    //In regression mode, every message starts with the time it was written, so the reader can tell how long it took
+    if(options.regress && test_data_size < sizeof(uint64_t)){
+        eprintf_exit("Messages are too small to carry a timestamp, use a larger --amount\n");
+    }
+
+    camio_tsc_t tsc;
+    uint64_t gap_ticks = 0;
+    uint64_t next_ts   = 0;
+    if(options.gap_ns){
+        camio_tsc_calibrate(&tsc, CLOCK_MONOTONIC);
+        gap_ticks = camio_tsc_from_ns(&tsc, tsc.ns_base + options.gap_ns) - tsc.tsc_base;
+    }
 
     //Wait until the ring is connected
     while(! out->start_write(out,test_data_size)){
@@ -102,22 +153,58 @@ static void do_sender(int amt){
     printf("Running do_sender...\n");
     gettimeofday(&start, NULL);
     while(1){
-        if(unlikely( write_count && !(write_count % (1000* 1000 * 10)) )){
+        if(unlikely( write_count >= report_count )){
             gettimeofday(&end,NULL);
             const uint64_t nanos_start  = start.tv_sec * 1000 * 1000 + start.tv_usec;
             const uint64_t nanos_end    = end.tv_sec * 1000 * 1000 + end.tv_usec;
-            printf("%c,%lf,%lu,%lu\n", 's', (nanos_end - nanos_start) / (1000 * 1000 * 10.0), total_data / (nanos_end - nanos_start),write_count);
+            printf("%c,%lf,%lu,%lu\n", 's', (nanos_end - nanos_start) / (double)(write_count - last_count), total_data / (nanos_end - nanos_start),write_count);
             total_data = 0;
+            last_count = write_count;
+            report_count += 1000 * 1000 * 10;
             gettimeofday(&start,NULL);
         }
 
+        if(gap_ticks){
+            while(camio_perf_ts() < next_ts){
+                //spin until the next message is due
+            }
+            next_ts = camio_perf_ts() + gap_ticks;
+        }
+
+        if(options.batch){
+            int count = options.batch;
+            if(options.begin){
+                count = out->start_write_batch(out, batch, options.batch);
+                //Do some work here?
+                if(options.regress){
+                    const uint64_t ts = camio_perf_ts();
+                    for(i = 0; i < (uint64_t)count; i++){
+                        memcpy(batch[i].buffer, &ts, sizeof(ts));
+                    }
+                }
+            }
+            else if(options.regress){
+                test_data[0] = camio_perf_ts();
+            }
+            count = out->commit_batch(out, batch, count);
+            write_count += count;
+            total_data  += count * test_data_size;
+            continue;
+        }
+
         if(options.begin){
             buff = out->start_write(out,test_data_size);
             //Do some work here?
-            (void)buff;
+            if(options.regress){
+                const uint64_t ts = camio_perf_ts();
+                memcpy(buff, &ts, sizeof(ts));
+            }
             out->end_write(out,test_data_size);
         }
         else{
+            if(options.regress){
+                test_data[0] = camio_perf_ts();
+            }
             out->assign_write(out,(uint8_t*)test_data,test_data_size );
             out->end_write(out,test_data_size);
             seq++;
@@ -130,21 +217,143 @@ static void do_sender(int amt){
 
 }
 
+static int compare_u64(const void* a, const void* b){
+    const uint64_t x = *(const uint64_t*)a;
+    const uint64_t y = *(const uint64_t*)b;
+    return x < y ? -1 : x > y;
+}
+
+
+//Keep the time from a message being written to it being read, from the timestamp the sender put at the front of it
+static void record_latency(uint64_t* latencies, uint64_t* latency_count, uint64_t* error_count, const uint8_t* buff,
+        uint64_t len, uint64_t now){
+    uint64_t written = 0;
+    if(len < sizeof(written)){
+        (*error_count)++;
+        return;
+    }
+    memcpy(&written, buff, sizeof(written));
+
+    //Anything from the future was not written by the timed part of the sender
+    if(written > now){
+        (*error_count)++;
+        return;
+    }
+    latencies[(*latency_count)++] = now - written;
+}
+
+
+//Run a sender in a child process and time options.count messages through the stream, from being written to being read.
+//Returns non-zero if the 99th percentile is more than options.max_ns, so that it can be used to catch performance
+//regressions.
+static int do_regress(){
+    const pid_t sender = fork();
+    if(sender < 0){
+        eprintf_exit("Could not fork sender. Error=%s\n", strerror(errno));
+    }
+    if(sender == 0){
+        do_sender(options.amount);
+        exit(0);
+    }
+
+    camio_tsc_t tsc;
+    camio_tsc_calibrate(&tsc, CLOCK_MONOTONIC);
+
+    in = camio_istream_new(options.stream, NULL, NULL, NULL);
+    uint8_t* buff;
+    uint64_t len;
+    uint64_t read_count = 0;
+    uint64_t error_count = 0;
+    uint64_t latency_count = 0;
+    camio_batch_item_t batch[options.batch ? options.batch : 1];
+    uint64_t* latencies = malloc(options.count * sizeof(uint64_t));
+    if(!latencies){
+        eprintf_exit("Could not allocate memory for %lu latencies\n", options.count);
+    }
+
+    //wait until the first data is ready before starting timing
+    in->start_read(in,&buff);
+    in->end_read(in, NULL);
+
+    while(read_count < options.count){
+        if(options.batch){
+            const int count = in->start_read_batch(in, batch, MIN(options.batch, options.count - read_count));
+            const uint64_t now = camio_perf_ts();
+            int i = 0;
+            for(i = 0; i < count; i++){
+                record_latency(latencies, &latency_count, &error_count, batch[i].buffer, batch[i].len, now);
+            }
+            if(in->end_read_batch(in)){
+                error_count += count;
+            }
+            read_count += count;
+        }
+        else{
+            len = in->start_read(in,&buff);
+            record_latency(latencies, &latency_count, &error_count, buff, len, camio_perf_ts());
+            if(in->end_read(in,NULL)){
+                error_count++;
+            }
+            read_count++;
+        }
+    }
+
+    kill(sender, SIGTERM);
+    waitpid(sender, NULL, 0);
+
+    if(!latency_count){
+        printf("FAIL: %lu messages (%lu errors), none of them timed\n", read_count, error_count);
+        free(latencies);
+        return 1;
+    }
+
+    qsort(latencies, latency_count, sizeof(uint64_t), compare_u64);
+    uint64_t total = 0;
+    uint64_t i = 0;
+    for(i = 0; i < latency_count; i++){
+        total += latencies[i];
+    }
+    const double to_ns = (double)tsc.ns_per_tsc / (1ULL << 32);
+    const double mean_ns = total * to_ns / latency_count;
+    const double p50_ns  = latencies[latency_count / 2] * to_ns;
+    const double p99_ns  = latencies[latency_count * 99 / 100] * to_ns;
+    const double max_ns  = latencies[latency_count - 1] * to_ns;
+    const int failed     = p99_ns > options.max_ns;
+    printf("%s: %lu messages (%lu errors), write to read latency mean=%.1lfns p50=%.1lfns p99=%.1lfns max=%.1lfns, p99 limit is %.1lfns\n",
+            failed ? "FAIL" : "PASS", read_count, error_count, mean_ns, p50_ns, p99_ns, max_ns, options.max_ns);
+
+    free(latencies);
+    return failed;
+}
+
+
 int main(int argc, char** argv){
     signal(SIGTERM, term);
     signal(SIGINT, term);
 
     camio_options_short_description("camio_tp_bench");
-    camio_options_add(CAMIO_OPTION_OPTIONAL,  'a', "amount",   "Amount of data per write [1024]",  CAMIO_UINT64, &options.amount, 1024);
+    camio_options_add(CAMIO_OPTION_OPTIONAL,  'a', "amount",   "Amount of data per write [1024]",  CAMIO_UINT64, &options.amount, 1024LL);
     camio_options_add(CAMIO_OPTION_OPTIONAL,  'd', "stream",   "An istream or ostream description such. [ring:/tmp/bench.ring]",  CAMIO_STRING, &options.stream, "ring:/tmp/tp_bench.ring");
     camio_options_add(CAMIO_OPTION_FLAG,      'l', "listen",   "If the program is listen mode, the tx and rx pipes loop-back on each other", CAMIO_BOOL, &options.listen, 0);
     camio_options_add(CAMIO_OPTION_FLAG,      'b', "begin-write",   "Use begin_write instead of assign write", CAMIO_BOOL, &options.begin, 0);
+    camio_options_add(CAMIO_OPTION_OPTIONAL,  'B', "batch",    "Read/write up to this many messages at a time with the batch interface, 0 does one at a time [0]", CAMIO_UINT64, &options.batch, 0ULL);
+    camio_options_add(CAMIO_OPTION_FLAG,      'R', "regress",  "Run a sender and a listener and fail if the 99th percentile write to read latency is over --max-ns", CAMIO_BOOL, &options.regress, 0);
+    camio_options_add(CAMIO_OPTION_OPTIONAL,  'M', "max-ns",   "Maximum 99th percentile latency in nanoseconds for --regress [10000]", CAMIO_DOUBLE, &options.max_ns, 10000.0);
+    camio_options_add(CAMIO_OPTION_OPTIONAL,  'n', "count",    "Number of messages to time for --regress [1000000]", CAMIO_UINT64, &options.count, 1000000ULL);
+    camio_options_add(CAMIO_OPTION_OPTIONAL,  'g', "gap-ns",   "Time between sending messages in nanoseconds, so that the ring doesn't fill and queueing isn't timed [0]", CAMIO_UINT64, &options.gap_ns, 0ULL);
     camio_options_add(CAMIO_OPTION_OPTIONAL,  's', "selector", "Selector description eg selection", CAMIO_STRING, &options.selector, "spin" );
     camio_options_add(CAMIO_OPTION_OPTIONAL,  'p', "perf-mon", "Performance monitoring output path", CAMIO_STRING, &options.perf_out, "log:/tmp/camio_chat.perf" );
     camio_options_long_description("Tests I/O streams as either a client or server.");
     camio_options_parse(argc, argv);
 
 
+    if(options.regress){
+        printf("Starting TP Bench in regression mode...\n");
+        const int result = do_regress();
+        if(in){ in->delete(in); in = NULL; }
+        return result;
+    }
+
     if(options.listen){
         printf("Starting TP Bench in listener mode...\n");
         do_listener(options.amount);
@@ -12,6 +12,8 @@
 
 //#include "camio_clock_gtod.h"
 #include "camio_clock_tistream.h"
+#include "camio_clock_posix.h"
+#include "camio_clock_tsc.h"
 
 
 camio_clock_t* camio_clock_new( char* description, void* parameters){
@@ -25,6 +27,23 @@ camio_clock_t* camio_clock_new( char* description, void* parameters){
     else if(strcmp(description,"tistream") == 0){
         result = camio_clock_tistream_new( parameters );
     }
+    //Invariant TSC, calibrated against CLOCK_MONOTONIC_RAW. Cheapest to read, in ns since boot
+    else if(strcmp(description,"tsc") == 0){
+        result = camio_clock_tsc_new( parameters );
+    }
+    //Free running clock_gettime() clocks. Served from the vDSO, so no system call
+    else if(strcmp(description,"monotonic") == 0){
+        camio_clock_posix_params_t params = { .clock_id = CLOCK_MONOTONIC };
+        result = camio_clock_posix_new( &params );
+    }
+    else if(strcmp(description,"monotonic_raw") == 0){
+        camio_clock_posix_params_t params = { .clock_id = CLOCK_MONOTONIC_RAW };
+        result = camio_clock_posix_new( &params );
+    }
+    else if(strcmp(description,"realtime") == 0){
+        camio_clock_posix_params_t params = { .clock_id = CLOCK_REALTIME };
+        result = camio_clock_posix_new( &params );
+    }
     else{
         eprintf_exit("Could not create clock from description \"%s\" \n", description);
     }
@@ -0,0 +1,81 @@
+/*
+ * Copyright  (C) Matthew P. Grosvenor, 2012, All Rights Reserved
+ *
+ */
+
+#include <errno.h>
+
+#include "camio_clock_posix.h"
+#include "../errors/camio_errors.h"
+#include "../utils/camio_util.h"
+
+//A free running clock that reads clock_gettime() on every get(). For the monotonic and realtime clocks this is served
+//from the vDSO, so there's no system call.
+
+//Initialize the new clock
+int camio_clock_posix_init(camio_clock_t* this){
+    camio_clock_posix_t* priv = this->priv;
+
+    struct timespec ts;
+    if(clock_gettime(priv->clock_id, &ts) < 0){
+        eprintf_exit("Could not read clock %i. Error=%s\n", priv->clock_id, strerror(errno));
+    }
+    camio_timespec_to_time(&ts, &priv->time);
+    return 0;
+}
+
+//Is this clock from a free running source, or is is it driven by something
+int camio_clock_posix_is_driven(camio_clock_t* this){
+    return 0; //Free running
+}
+
+//Get the current clock time structure
+camio_time_t* camio_clock_posix_get(camio_clock_t* this){
+    camio_clock_posix_t* priv = this->priv;
+
+    struct timespec ts;
+    clock_gettime(priv->clock_id, &ts);
+    camio_timespec_to_time(&ts, &priv->time);
+    return &priv->time;
+}
+
+//Free running clocks can't be set
+int camio_clock_posix_set(camio_clock_t* this, camio_time_t* current){
+    return -1;
+}
+
+
+/* ****************************************************
+ * Construction
+ */
+
+camio_clock_t* camio_clock_posix_construct(camio_clock_posix_t* priv, camio_clock_posix_params_t* params){
+    if(!priv){
+        eprintf_exit("Clock supplied is null\n");
+    }
+    //Initialize the local variables
+    priv->time.counter      = 0;
+    priv->clock_id          = params ? params->clock_id : CLOCK_MONOTONIC;
+
+    //Populate the function members
+    priv->clock.priv            = priv; //Lets us access private members
+    priv->clock.init            = camio_clock_posix_init;
+    priv->clock.is_driven       = camio_clock_posix_is_driven;
+    priv->clock.get             = camio_clock_posix_get;
+    priv->clock.set             = camio_clock_posix_set;
+
+    //Call ini, because its the obvious thing to do now...
+    priv->clock.init(&priv->clock);
+
+    //Return the generic clock interface for the outside world to use
+    return &priv->clock;
+
+}
+
+camio_clock_t* camio_clock_posix_new( camio_clock_posix_params_t* params){
+    camio_clock_posix_t* priv = malloc(sizeof(camio_clock_posix_t));
+    if(!priv){
+        eprintf_exit("No memory available for posix clock creation\n");
+    }
+    return camio_clock_posix_construct(priv, params);
+}
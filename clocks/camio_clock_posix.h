@@ -0,0 +1,38 @@
+/*
+ * Copyright  (C) Matthew P. Grosvenor, 2012, All Rights Reserved
+ *
+ * Camio clock backed by clock_gettime()
+ *
+ */
+
+#ifndef CAMIO_CLOCK_POSIX_H_
+#define CAMIO_CLOCK_POSIX_H_
+
+#include "camio_clock.h"
+
+
+/********************************************************************
+ *                  PRIVATE DEFS
+ ********************************************************************/
+
+
+typedef struct {
+    clockid_t clock_id;                 //eg CLOCK_MONOTONIC, CLOCK_REALTIME
+} camio_clock_posix_params_t;
+
+typedef struct {
+    camio_time_t time;
+    camio_clock_t clock;
+    clockid_t clock_id;
+} camio_clock_posix_t;
+
+
+
+/********************************************************************
+ *                  PUBLIC DEFS
+ ********************************************************************/
+
+camio_clock_t* camio_clock_posix_new( camio_clock_posix_params_t* params);
+
+
+#endif /* CAMIO_CLOCK_POSIX_H_ */
@@ -0,0 +1,81 @@
+/*
+ * Copyright  (C) Matthew P. Grosvenor, 2012, All Rights Reserved
+ *
+ */
+
+#include "camio_clock_tsc.h"
+#include "../errors/camio_errors.h"
+#include "../utils/camio_util.h"
+
+//A free running clock that reads the TSC, and scales it to ns with a multiply and a shift. The rate is calibrated
+//against CLOCK_MONOTONIC_RAW (by default), which isn't slewed by NTP, and re-measured about once a second.
+
+//Initialize the new clock
+int camio_clock_tsc_init(camio_clock_t* this){
+    camio_clock_tsc_t* priv = this->priv;
+    priv->time.counter = camio_tsc_to_ns(&priv->tsc, camio_tsc_read());
+    return 0;
+}
+
+//Is this clock from a free running source, or is is it driven by something
+int camio_clock_tsc_is_driven(camio_clock_t* this){
+    return 0; //Free running
+}
+
+//Get the current clock time structure
+camio_time_t* camio_clock_tsc_get(camio_clock_t* this){
+    camio_clock_tsc_t* priv = this->priv;
+
+    const uint64_t ticks = camio_tsc_read();
+    if(unlikely(ticks >= priv->tsc.tsc_refine)){
+        camio_tsc_refine(&priv->tsc);
+    }
+
+    //Re-basing can step the conversion back a little, but the clock must never go backwards
+    const int64_t now = camio_tsc_to_ns(&priv->tsc, ticks);
+    if(likely(now > priv->time.counter)){
+        priv->time.counter = now;
+    }
+    return &priv->time;
+}
+
+//Free running clocks can't be set
+int camio_clock_tsc_set(camio_clock_t* this, camio_time_t* current){
+    return -1;
+}
+
+
+/* ****************************************************
+ * Construction
+ */
+
+camio_clock_t* camio_clock_tsc_construct(camio_clock_tsc_t* priv, camio_clock_tsc_params_t* params){
+    if(!priv){
+        eprintf_exit("Clock supplied is null\n");
+    }
+    //Initialize the local variables
+    priv->time.counter      = 0;
+    camio_tsc_calibrate(&priv->tsc, params ? params->clock_id : CLOCK_MONOTONIC_RAW);
+
+    //Populate the function members
+    priv->clock.priv            = priv; //Lets us access private members
+    priv->clock.init            = camio_clock_tsc_init;
+    priv->clock.is_driven       = camio_clock_tsc_is_driven;
+    priv->clock.get             = camio_clock_tsc_get;
+    priv->clock.set             = camio_clock_tsc_set;
+
+    //Call ini, because its the obvious thing to do now...
+    priv->clock.init(&priv->clock);
+
+    //Return the generic clock interface for the outside world to use
+    return &priv->clock;
+
+}
+
+camio_clock_t* camio_clock_tsc_new( camio_clock_tsc_params_t* params){
+    camio_clock_tsc_t* priv = malloc(sizeof(camio_clock_tsc_t));
+    if(!priv){
+        eprintf_exit("No memory available for tsc clock creation\n");
+    }
+    return camio_clock_tsc_construct(priv, params);
+}
@@ -0,0 +1,39 @@
+/*
+ * Copyright  (C) Matthew P. Grosvenor, 2012, All Rights Reserved
+ *
+ * Camio clock driven by the CPU timestamp counter
+ *
+ */
+
+#ifndef CAMIO_CLOCK_TSC_H_
+#define CAMIO_CLOCK_TSC_H_
+
+#include "camio_clock.h"
+#include "../utils/camio_tsc.h"
+
+
+/********************************************************************
+ *                  PRIVATE DEFS
+ ********************************************************************/
+
+
+typedef struct {
+    clockid_t clock_id;                 //Clock to calibrate against, and whose epoch the times are from
+} camio_clock_tsc_params_t;
+
+typedef struct {
+    camio_time_t time;
+    camio_clock_t clock;
+    camio_tsc_t tsc;
+} camio_clock_tsc_t;
+
+
+
+/********************************************************************
+ *                  PUBLIC DEFS
+ ********************************************************************/
+
+camio_clock_t* camio_clock_tsc_new( camio_clock_tsc_params_t* params);
+
+
+#endif /* CAMIO_CLOCK_TSC_H_ */
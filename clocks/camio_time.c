@@ -0,0 +1,27 @@
+/*
+ * Copyright  (C) Matthew P. Grosvenor, 2012, All Rights Reserved
+ *
+ * Camio time implementation
+ *
+ */
+
+#include "camio_time.h"
+
+#define CAMIO_TIME_NS_PER_SEC (1000 * 1000 * 1000LL)
+
+
+void camio_time_to_timespec(const camio_time_t* time, struct timespec* ts_out){
+    ts_out->tv_sec  = time->counter / CAMIO_TIME_NS_PER_SEC;
+    ts_out->tv_nsec = time->counter % CAMIO_TIME_NS_PER_SEC;
+
+    //Keep tv_nsec positive for times before the epoch, as timespecs expect
+    if(ts_out->tv_nsec < 0){
+        ts_out->tv_sec  -= 1;
+        ts_out->tv_nsec += CAMIO_TIME_NS_PER_SEC;
+    }
+}
+
+
+void camio_timespec_to_time(const struct timespec* ts, camio_time_t* time_out){
+    time_out->counter = (int64_t)ts->tv_sec * CAMIO_TIME_NS_PER_SEC + ts->tv_nsec;
+}
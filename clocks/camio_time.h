@@ -8,15 +8,17 @@
 #ifndef CAMIO_TIME_H_
 #define CAMIO_TIME_H_
 
+#include <stdint.h>
+#include <time.h>
 
 typedef struct {
-    int64_t counter;
+    int64_t counter;                    //Nanoseconds since the epoch of the clock that produced it
 } camio_time_t;
 
 
 
-void camio_time_to_timespec();
-void camio_timespec_to_time();
+void camio_time_to_timespec(const camio_time_t* time, struct timespec* ts_out);
+void camio_timespec_to_time(const struct timespec* ts, camio_time_t* time_out);
 
 
 #endif /* CAMIO_TIME_H_ */
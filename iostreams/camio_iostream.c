@@ -14,6 +14,7 @@
 #include "../iostreams/camio_iostream_tcps.h"
 
 #include "../errors/camio_errors.h"
+#include "../utils/camio_util.h"
 
 
 camio_iostream_t* camio_iostream_new(const char* description, camio_clock_t* clock, void* parameters, camio_perf_t* perf_mon){
@@ -48,3 +49,31 @@ camio_iostream_t* camio_iostream_new(const char* description, camio_clock_t* clo
 }
 
 
+
+//Streams that reuse a single buffer for every write can only hand out one buffer at a time.
+int camio_iostream_generic_start_write_batch(camio_iostream_t* this, camio_batch_item_t* items, size_t count){
+    if(unlikely(!count)){
+        return 0;
+    }
+
+    items[0].buffer = this->start_write(this, items[0].len);
+    return items[0].buffer ? 1 : 0;
+}
+
+
+int camio_iostream_generic_commit_batch(camio_iostream_t* this, camio_batch_item_t* items, size_t count){
+    size_t i = 0;
+    for(; i < count; i++){
+        uint8_t* buffer = this->start_write(this, items[i].len);
+        if(unlikely(!buffer)){
+            break;
+        }
+
+        if(buffer != items[i].buffer){
+            memcpy(buffer, items[i].buffer, items[i].len);
+        }
+        this->end_write(this, items[i].len);
+    }
+
+    return i;
+}
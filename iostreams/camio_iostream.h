@@ -14,6 +14,7 @@
 #include "../clocks/camio_clock.h"
 #include "../selectors/camio_selector.h"
 #include "../perf/camio_perf.h"
+#include "../utils/camio_batch.h"
 
 struct camio_iostream;
 typedef struct camio_iostream camio_iostream_t;
@@ -34,12 +35,20 @@ struct camio_iostream{
      uint8_t* (*end_write)(camio_iostream_t* this, size_t len);                                 //Commit the data to the buffer previously allocated, if the write was "assigned" and write want's to keep the buffer, optionally return a fresh one
      int (*can_assign_write)(camio_iostream_t*);                                                //Is this stream capable of taking over another stream buffer
      int (*assign_write)(camio_iostream_t* this, uint8_t* buffer, size_t len);                  //Assign the write buffer to the stream
+     int (*start_write_batch)(camio_iostream_t* this, camio_batch_item_t* items, size_t count); //Sets items[i].buffer to a space of size items[i].len for up to count items, returns the number of items filled (at least 1)
+     int (*commit_batch)(camio_iostream_t* this, camio_batch_item_t* items, size_t count);      //Commit count items in one go. Buffers not from start_write_batch are copied/sent from directly. Returns the number committed
      void(*wsync)(camio_iostream_t* this);                                                      //Some streams require explicit syncronisation, and the timing of that is performance critical. This interface exists for these streams
 
      camio_clock_t* clock;
+     camio_meta_t meta;                                                                         //What is known about the data returned by the last start_read
+     camio_meta_t tx_meta;                                                                      //The latest transmit timestamp the kernel has handed back, if asked for
      void* priv;
 };
 
 camio_iostream_t* camio_iostream_new(const char* description, camio_clock_t* clock, void* parameters, camio_perf_t* perf_mon);
 
+//Generic batch implementation for streams that can only have one write outstanding. Commits are done one item at a time.
+int camio_iostream_generic_start_write_batch(camio_iostream_t* this, camio_batch_item_t* items, size_t count);
+int camio_iostream_generic_commit_batch(camio_iostream_t* this, camio_batch_item_t* items, size_t count);
+
 #endif /* CAMIO_IOSTREAM_H_ */
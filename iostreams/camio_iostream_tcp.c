@@ -9,6 +9,7 @@
 #include <stdio.h>
 #include <unistd.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <netinet/in.h>
 #include <sys/ioctl.h>
 #include <net/if.h>
@@ -41,7 +42,17 @@ int camio_iostream_tcp_open(camio_iostream_t* this, const camio_descr_t* descr,
     int tcp_sock_fd = -1;
 
     if(unlikely(camio_descr_has_opts(descr->opt_head))){
-        eprintf_exit( "Option(s) supplied, but none expected\n");
+        struct camio_opt_t* opt;
+        for(opt = descr->opt_head; opt; opt = opt->next){
+            if(strcmp(opt->name,"tstamp") == 0){
+                char* value = NULL;
+                camio_descr_get_opt_string(opt, &value);
+                priv->tstamp = camio_tstamp_parse(value);
+            }
+            else{
+                eprintf_exit( "Unknown option supplied \"%s\". Valid options for this stream are: \"tstamp=sw|hw\"\n", opt->name);
+            }
+        }
     }
 
 
@@ -155,6 +166,9 @@ int camio_iostream_tcp_open(camio_iostream_t* this, const camio_descr_t* descr,
     }
 
 
+    //Stamp the connection, not the listener. We don't know which NIC it's on, so hardware stamping has to be on already.
+    camio_tstamp_enable(this->selector.fd, priv->tstamp, 1, NULL);
+
     int RCVBUFF_SIZE = 512 * 1024 * 1024;
     if (setsockopt(tcp_sock_fd, SOL_SOCKET, SO_RCVBUF, &RCVBUFF_SIZE, sizeof(RCVBUFF_SIZE)) < 0) {
         eprintf_exit("%s\n",strerror(errno));
@@ -207,6 +221,30 @@ static void set_fd_blocking(int fd, int blocking){
     }
 }
 
+//Read with the kernel's timestamp for the data, and move the clock on to it. A read can span many segments, the stamp
+//is for the last of them.
+static int read_stamped(camio_iostream_tcp_t* priv){
+    struct iovec iov = { .iov_base = priv->rbuffer, .iov_len = priv->rbuffer_size };
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov         = &iov;
+    msg.msg_iovlen      = 1;
+    msg.msg_control     = priv->control;
+    msg.msg_controllen  = sizeof(priv->control);
+
+    const int bytes = recvmsg(priv->iostream.selector.fd, &msg, 0);
+    if(bytes > 0){
+        priv->iostream.meta.flags = camio_tstamp_rx(&msg, &priv->iostream.meta.ts_ns);
+        if(priv->iostream.clock && (priv->iostream.meta.flags & CAMIO_META_TS)){
+            camio_time_t time = { .counter = priv->iostream.meta.ts_ns };
+            priv->iostream.clock->set(priv->iostream.clock, &time);
+        }
+    }
+
+    return bytes;
+}
+
+
 static int prepare_next(camio_iostream_tcp_t* priv, int blocking){
     if(priv->bytes_read){
         camio_perf_event_start(priv->perf_mon, CAMIO_PERF_EVENT_IOSTREAM_TCP, CAMIO_PERF_COND_EXISTING_DATA);
@@ -215,7 +253,13 @@ static int prepare_next(camio_iostream_tcp_t* priv, int blocking){
 
     set_fd_blocking(priv->iostream.selector.fd, blocking);
 
-    int bytes = read(priv->iostream.selector.fd,priv->rbuffer,priv->rbuffer_size);
+    int bytes = 0;
+    if(likely(!priv->tstamp)){
+        bytes = read(priv->iostream.selector.fd,priv->rbuffer,priv->rbuffer_size);
+    }
+    else{
+        bytes = read_stamped(priv);
+    }
     camio_perf_event_start(priv->perf_mon, CAMIO_PERF_EVENT_IOSTREAM_TCP, CAMIO_PERF_COND_NEW_DATA);
     if( bytes < 0){
         if(errno == EAGAIN || errno == EWOULDBLOCK){
@@ -309,6 +353,18 @@ int camio_iostream_tcp_wready(camio_iostream_t* this){
 }
 
 
+//The kernel loops transmit stamps back on the error queue. Picking them up after each write keeps the queue short, and
+//stops the socket from looking like it has an error to anyone selecting on it. seq is the byte count, less one, at
+//the end of the write that was stamped.
+static void collect_tx_stamps(camio_iostream_tcp_t* priv){
+    camio_meta_t* tx_meta = &priv->iostream.tx_meta;
+    const uint16_t flags  = camio_tstamp_tx(priv->iostream.selector.fd, &tx_meta->ts_ns, &tx_meta->seq);
+    if(flags){
+        tx_meta->flags = flags;
+    }
+}
+
+
 //Commit the data to the buffer previously allocated
 //Len must be equal to or less than len called with start_write
 uint8_t* camio_iostream_tcp_end_write(camio_iostream_t* this, size_t len){
@@ -343,6 +399,9 @@ uint8_t* camio_iostream_tcp_end_write(camio_iostream_t* this, size_t len){
 
         priv->assigned_buffer    = NULL;
         priv->assigned_buffer_sz = 0;
+        if(priv->tstamp){
+            collect_tx_stamps(priv);
+        }
         return NULL;
     }
 
@@ -357,6 +416,84 @@ uint8_t* camio_iostream_tcp_end_write(camio_iostream_t* this, size_t len){
     return NULL;
 }
 
+//Carve the output buffer up so that every item in the batch gets its own space
+static int camio_iostream_tcp_start_write_batch(camio_iostream_t* this, camio_batch_item_t* items, size_t count){
+    camio_iostream_tcp_t* priv = this->priv;
+    size_t total = 0;
+    size_t i = 0;
+
+    for(i = 0; i < count; i++){
+        total += items[i].len;
+    }
+
+    //Grow the buffer if it's not big enough
+    if(total > priv->wbuffer_size){
+        priv->wbuffer = realloc(priv->wbuffer, total);
+        if(!priv->wbuffer){
+            eprintf_exit( "Could not grow message buffer\n");
+        }
+        priv->wbuffer_size = total;
+    }
+
+    uint8_t* head = priv->wbuffer;
+    for(i = 0; i < count; i++){
+        items[i].buffer = head;
+        head += items[i].len;
+    }
+
+    return count;
+}
+
+
+//Gather the whole batch into as few writev calls as possible. TCP is a byte stream, so a short write can leave us
+//part way through any buffer, pick up from wherever the kernel left off.
+static int camio_iostream_tcp_commit_batch(camio_iostream_t* this, camio_batch_item_t* items, size_t count){
+    camio_iostream_tcp_t* priv = this->priv;
+    size_t done = 0;
+    size_t i = 0;
+
+    camio_perf_event_stop(priv->perf_mon, CAMIO_PERF_EVENT_IOSTREAM_TCP, CAMIO_PERF_COND_WRITE);
+    while(done < count){
+        const size_t todo = MIN(count - done, CAMIO_IOSTREAM_TCP_BATCH_MAX);
+        for(i = 0; i < todo; i++){
+            priv->iovecs[i].iov_base = items[done + i].buffer;
+            priv->iovecs[i].iov_len  = items[done + i].len;
+        }
+
+        struct iovec* iov = priv->iovecs;
+        size_t iov_count = todo;
+        while(iov_count){
+            ssize_t written = writev(this->selector.fd, iov, iov_count);
+            if(unlikely(written < 0)){
+                if(errno == EAGAIN){
+                    continue;
+                }
+                eprintf_exit( "Could not send on tcp socket. Error = %s\n", strerror(errno));
+            }
+
+            while(iov_count && (size_t)written >= iov->iov_len){
+                written -= iov->iov_len;
+                iov++;
+                iov_count--;
+            }
+
+            if(iov_count){
+                iov->iov_base = (uint8_t*)iov->iov_base + written;
+                iov->iov_len -= written;
+            }
+        }
+
+        done += todo;
+    }
+
+    if(priv->tstamp){
+        collect_tx_stamps(priv);
+    }
+
+    return done;
+}
+
+
 //Is this stream capable of taking over another stream buffer
 int camio_iostream_tcp_can_assign_write(camio_iostream_t* this){
     return 1;
@@ -394,6 +531,7 @@ camio_iostream_t* camio_iostream_tcp_construct(camio_iostream_tcp_t* priv, const
     priv->bytes_read        = 0;
     priv->type              = CAMIO_IOSTREAM_TCP_TYPE_CLIENT;
     priv->params            = params;
+    priv->tstamp            = CAMIO_TSTAMP_NONE;
 
 
     //Populate the function members
@@ -410,9 +548,13 @@ camio_iostream_t* camio_iostream_tcp_construct(camio_iostream_tcp_t* priv, const
     priv->iostream.end_write        = camio_iostream_tcp_end_write;
     priv->iostream.can_assign_write = camio_iostream_tcp_can_assign_write;
     priv->iostream.assign_write     = camio_iostream_tcp_assign_write;
+    priv->iostream.start_write_batch= camio_iostream_tcp_start_write_batch;
+    priv->iostream.commit_batch     = camio_iostream_tcp_commit_batch;
     priv->iostream.wready           = camio_iostream_tcp_wready;
 
     priv->iostream.clock            = clock;
+    priv->iostream.meta             = (camio_meta_t){ .flags = 0 };
+    priv->iostream.tx_meta          = (camio_meta_t){ .flags = 0 };
     priv->iostream.selector.fd      = -1;
 
 
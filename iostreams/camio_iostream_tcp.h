@@ -9,13 +9,17 @@
 #define CAMIO_IOSTREAM_TCP_H_
 
 #include <netinet/in.h>
+#include <sys/uio.h>
 
 #include "camio_iostream.h"
+#include "../utils/camio_tstamp.h"
 
 /********************************************************************
  *                  PRIVATE DEFS
  ********************************************************************/
 
+#define CAMIO_IOSTREAM_TCP_BATCH_MAX 64    //Most buffers gathered by a single call to writev
+
 typedef struct {
     int listen;
     int fd;
@@ -34,9 +38,12 @@ typedef struct {
     size_t wbuffer_size;                     //Size of output buffer
     uint8_t* assigned_buffer;                  //Assigned write buffer
     size_t assigned_buffer_sz;              //Assigned write buffer size
+    struct iovec iovecs[CAMIO_IOSTREAM_TCP_BATCH_MAX]; //Gather list for batched writes
     enum camio_iostream_tcp_type type;
     struct sockaddr_in addr;            //Source address/port
     int listener_fd;                     //FD of the tcp listener
+    int tstamp;                          //Kernel timestamps, one of CAMIO_TSTAMP_*
+    uint8_t control[CAMIO_TSTAMP_CONTROL_SIZE]; //Space for receive timestamps
     camio_iostream_tcp_params_t* params;  //Parameters passed in from the outside
     camio_perf_t* perf_mon;
 } camio_iostream_tcp_t;
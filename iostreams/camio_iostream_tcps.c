@@ -295,9 +295,13 @@ camio_iostream_t* camio_iostream_tcps_construct(camio_iostream_tcps_t* priv, con
     priv->iostream.end_write        = camio_iostream_tcps_end_write;
     priv->iostream.can_assign_write = camio_iostream_tcps_can_assign_write;
     priv->iostream.assign_write     = camio_iostream_tcps_assign_write;
+    priv->iostream.start_write_batch= camio_iostream_generic_start_write_batch;
+    priv->iostream.commit_batch     = camio_iostream_generic_commit_batch;
     priv->iostream.wready           = camio_iostream_tcps_wready;
 
     priv->iostream.clock            = clock;
+    priv->iostream.meta             = (camio_meta_t){ .flags = 0 };
+    priv->iostream.tx_meta          = (camio_meta_t){ .flags = 0 };
     priv->iostream.selector.fd      = -1;
 
 
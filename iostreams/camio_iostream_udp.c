@@ -1,3 +1,4 @@
+//#CFLAGS=-D_GNU_SOURCE
 /*
  * Copyright  (C) Matthew P. Grosvenor, 2012, All Rights Reserved
  *
@@ -9,6 +10,7 @@
 #include <stdio.h>
 #include <unistd.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <netinet/in.h>
 #include <sys/ioctl.h>
 #include <net/if.h>
@@ -42,7 +44,17 @@ static int camio_iostream_udp_open(camio_iostream_t* this, const camio_descr_t*
     int udp_sock_fd;
 
     if(unlikely(camio_descr_has_opts(descr->opt_head))){
-        eprintf_exit( "Option(s) supplied, but none expected\n");
+        struct camio_opt_t* opt;
+        for(opt = descr->opt_head; opt; opt = opt->next){
+            if(strcmp(opt->name,"tstamp") == 0){
+                char* value = NULL;
+                camio_descr_get_opt_string(opt, &value);
+                priv->tstamp = camio_tstamp_parse(value);
+            }
+            else{
+                eprintf_exit( "Unknown option supplied \"%s\". Valid options for this stream are: \"tstamp=sw|hw\"\n", opt->name);
+            }
+        }
     }
 
     if(priv->params){
@@ -101,6 +113,21 @@ static int camio_iostream_udp_open(camio_iostream_t* this, const camio_descr_t*
     out_addr.sin_port        = htons(atoi(udp_port));
     priv->addr = out_addr;
 
+    //Message headers for batched writes, the iovecs are filled in on each commit
+    priv->msgs   = calloc(CAMIO_IOSTREAM_UDP_BATCH_MAX, sizeof(struct mmsghdr));
+    priv->iovecs = calloc(CAMIO_IOSTREAM_UDP_BATCH_MAX, sizeof(struct iovec));
+    if(!priv->msgs || !priv->iovecs){
+        eprintf_exit( "Failed to allocate batch descriptors\n");
+    }
+
+    size_t j = 0;
+    for(j = 0; j < CAMIO_IOSTREAM_UDP_BATCH_MAX; j++){
+        priv->msgs[j].msg_hdr.msg_iov     = &priv->iovecs[j];
+        priv->msgs[j].msg_hdr.msg_iovlen  = 1;
+        priv->msgs[j].msg_hdr.msg_name    = &priv->addr;
+        priv->msgs[j].msg_hdr.msg_namelen = sizeof(priv->addr);
+    }
+
     memset(&in_addr,0,sizeof(in_addr));
     in_addr.sin_family      = AF_INET;
     in_addr.sin_addr.s_addr = INADDR_ANY;
@@ -120,6 +147,9 @@ static int camio_iostream_udp_open(camio_iostream_t* this, const camio_descr_t*
         eprintf_exit("%s\n",strerror(errno));
     }
 
+    //We don't know which NIC the datagrams go through, so hardware stamping has to be switched on there already
+    camio_tstamp_enable(udp_sock_fd, priv->tstamp, 1, NULL);
+
     priv->iostream.selector.fd = udp_sock_fd;
     priv->is_closed = 0;
     return 0;
@@ -133,6 +163,8 @@ static void camio_iostream_udp_close(camio_iostream_t* this){
     close(this->selector.fd);
     free(priv->rbuffer);
     free(priv->wbuffer);
+    free(priv->msgs);
+    free(priv->iovecs);
 }
 
 static void set_fd_blocking(int fd, int blocking){
@@ -154,6 +186,33 @@ static void set_fd_blocking(int fd, int blocking){
     }
 }
 
+//Read with the kernel's timestamp for the datagram, and move the clock on to it
+static int read_stamped(camio_iostream_udp_t* priv){
+    struct iovec iov = { .iov_base = priv->rbuffer, .iov_len = priv->rbuffer_size };
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_name        = &priv->addr;
+    msg.msg_namelen     = sizeof(priv->addr);
+    msg.msg_iov         = &iov;
+    msg.msg_iovlen      = 1;
+    msg.msg_control     = priv->control;
+    msg.msg_controllen  = sizeof(priv->control);
+
+    const int bytes = recvmsg(priv->iostream.selector.fd, &msg, 0);
+    if(bytes >= 0){
+        priv->iostream.meta.src_addr = priv->addr.sin_addr.s_addr;
+        priv->iostream.meta.src_port = priv->addr.sin_port;
+        priv->iostream.meta.flags    = CAMIO_META_SRC | camio_tstamp_rx(&msg, &priv->iostream.meta.ts_ns);
+        if(priv->iostream.clock && (priv->iostream.meta.flags & CAMIO_META_TS)){
+            camio_time_t time = { .counter = priv->iostream.meta.ts_ns };
+            priv->iostream.clock->set(priv->iostream.clock, &time);
+        }
+    }
+
+    return bytes;
+}
+
+
 static int prepare_next(camio_iostream_udp_t* priv, int blocking){
     if(priv->bytes_read){
         camio_perf_event_start(priv->perf_mon, CAMIO_PERF_EVENT_IOSTREAM_UDP, CAMIO_PERF_COND_EXISTING_DATA);
@@ -162,8 +221,14 @@ static int prepare_next(camio_iostream_udp_t* priv, int blocking){
 
     set_fd_blocking(priv->iostream.selector.fd, blocking);
 
-    size_t sock_addr_len = sizeof(priv->addr);
-    int bytes = recvfrom(priv->iostream.selector.fd,priv->rbuffer,priv->rbuffer_size, 0, (struct sockaddr*)&priv->addr, (socklen_t*)&sock_addr_len );
+    int bytes = 0;
+    if(likely(!priv->tstamp)){
+        size_t sock_addr_len = sizeof(priv->addr);
+        bytes = recvfrom(priv->iostream.selector.fd,priv->rbuffer,priv->rbuffer_size, 0, (struct sockaddr*)&priv->addr, (socklen_t*)&sock_addr_len );
+    }
+    else{
+        bytes = read_stamped(priv);
+    }
     camio_perf_event_start(priv->perf_mon, CAMIO_PERF_EVENT_IOSTREAM_UDP, CAMIO_PERF_COND_NEW_DATA);
     if( bytes < 0){
         if(errno == EAGAIN || errno == EWOULDBLOCK){
@@ -252,6 +317,17 @@ static int camio_iostream_udp_wready(camio_iostream_t* this){
 }
 
 
+//The kernel loops transmit stamps back on the error queue. Picking them up after each send keeps the queue short, and
+//stops the socket from looking like it has an error to anyone selecting on it. seq counts datagrams sent.
+static void collect_tx_stamps(camio_iostream_udp_t* priv){
+    camio_meta_t* tx_meta = &priv->iostream.tx_meta;
+    const uint16_t flags  = camio_tstamp_tx(priv->iostream.selector.fd, &tx_meta->ts_ns, &tx_meta->seq);
+    if(flags){
+        tx_meta->flags = flags;
+    }
+}
+
+
 //Commit the data to the buffer previously allocated
 //Len must be equal to or less than len called with start_write
 static uint8_t* camio_iostream_udp_end_write(camio_iostream_t* this, size_t len){
@@ -267,6 +343,9 @@ static uint8_t* camio_iostream_udp_end_write(camio_iostream_t* this, size_t len)
 
         priv->assigned_buffer    = NULL;
         priv->assigned_buffer_sz = 0;
+        if(priv->tstamp){
+            collect_tx_stamps(priv);
+        }
         return NULL;
     }
 
@@ -275,9 +354,74 @@ static uint8_t* camio_iostream_udp_end_write(camio_iostream_t* this, size_t len)
     if(result < 0){
         eprintf_exit( "Could not send on udp socket. Error = %s\n", strerror(errno));
     }
+    if(priv->tstamp){
+        collect_tx_stamps(priv);
+    }
     return NULL;
 }
 
+//Carve the output buffer up so that every item in the batch gets its own space
+static int camio_iostream_udp_start_write_batch(camio_iostream_t* this, camio_batch_item_t* items, size_t count){
+    camio_iostream_udp_t* priv = this->priv;
+    size_t total = 0;
+    size_t i = 0;
+
+    for(i = 0; i < count; i++){
+        total += items[i].len;
+    }
+
+    //Grow the buffer if it's not big enough
+    if(total > priv->wbuffer_size){
+        priv->wbuffer = realloc(priv->wbuffer, total);
+        if(!priv->wbuffer){
+            eprintf_exit( "Could not grow message buffer\n");
+        }
+        priv->wbuffer_size = total;
+    }
+
+    uint8_t* head = priv->wbuffer;
+    for(i = 0; i < count; i++){
+        items[i].buffer = head;
+        head += items[i].len;
+    }
+
+    return count;
+}
+
+
+//Send the whole batch with as few system calls as possible
+static int camio_iostream_udp_commit_batch(camio_iostream_t* this, camio_batch_item_t* items, size_t count){
+    camio_iostream_udp_t* priv = this->priv;
+    size_t sent = 0;
+    size_t i = 0;
+
+    camio_perf_event_stop(priv->perf_mon, CAMIO_PERF_EVENT_IOSTREAM_UDP, CAMIO_PERF_COND_WRITE);
+    while(sent < count){
+        const size_t todo = MIN(count - sent, CAMIO_IOSTREAM_UDP_BATCH_MAX);
+        for(i = 0; i < todo; i++){
+            priv->iovecs[i].iov_base = items[sent + i].buffer;
+            priv->iovecs[i].iov_len  = items[sent + i].len;
+        }
+
+        const int result = sendmmsg(this->selector.fd, priv->msgs, todo, 0);
+        if(unlikely(result < 0)){
+            if(errno == EAGAIN){
+                continue;
+            }
+            eprintf_exit( "Could not send on udp socket. Error = %s\n", strerror(errno));
+        }
+
+        sent += result;
+    }
+
+    if(priv->tstamp){
+        collect_tx_stamps(priv);
+    }
+
+    return sent;
+}
+
+
 //Is this stream capable of taking over another stream buffer
 static int camio_iostream_udp_can_assign_write(camio_iostream_t* this){
     return 1;
@@ -315,7 +459,10 @@ static camio_iostream_t* camio_iostream_udp_construct(camio_iostream_udp_t* priv
     priv->wbuffer_size      = 0;
     priv->bytes_read        = 0;
     priv->type              = CAMIO_IOSTREAM_UDP_TYPE_CLIENT;
+    priv->msgs              = NULL;
+    priv->iovecs            = NULL;
     priv->params            = params;
+    priv->tstamp            = CAMIO_TSTAMP_NONE;
 
 
     //Populate the function members
@@ -332,9 +479,13 @@ static camio_iostream_t* camio_iostream_udp_construct(camio_iostream_udp_t* priv
     priv->iostream.end_write        = camio_iostream_udp_end_write;
     priv->iostream.can_assign_write = camio_iostream_udp_can_assign_write;
     priv->iostream.assign_write     = camio_iostream_udp_assign_write;
+    priv->iostream.start_write_batch= camio_iostream_udp_start_write_batch;
+    priv->iostream.commit_batch     = camio_iostream_udp_commit_batch;
     priv->iostream.wready           = camio_iostream_udp_wready;
 
     priv->iostream.clock            = clock;
+    priv->iostream.meta             = (camio_meta_t){ .flags = 0 };
+    priv->iostream.tx_meta          = (camio_meta_t){ .flags = 0 };
     priv->iostream.selector.fd      = -1;
 
 
@@ -11,11 +11,14 @@
 #include <netinet/in.h>
 
 #include "camio_iostream.h"
+#include "../utils/camio_tstamp.h"
 
 /********************************************************************
  *                  PRIVATE DEFS
  ********************************************************************/
 
+#define CAMIO_IOSTREAM_UDP_BATCH_MAX 64    //Most datagrams sent by a single call to sendmmsg
+
 typedef struct {
     int listen;
 } camio_iostream_udp_params_t;
@@ -35,6 +38,10 @@ typedef struct {
     size_t assigned_buffer_sz;              //Assigned write buffer size
     enum camio_iostream_udp_type type;
     struct sockaddr_in addr;            //Source address/port
+    struct mmsghdr* msgs;               //Message headers for batched writes
+    struct iovec* iovecs;               //One entry per message in a batched write
+    int tstamp;                         //Kernel timestamps, one of CAMIO_TSTAMP_*
+    uint8_t control[CAMIO_TSTAMP_CONTROL_SIZE]; //Space for receive timestamps
     camio_iostream_udp_params_t* params;  //Parameters passed in from the outside
     camio_perf_t* perf_mon;
 } camio_iostream_udp_t;
@@ -82,6 +82,18 @@ int camio_iostream_wrapper_assign_write(camio_iostream_t* this, uint8_t* buffer,
     return priv->base_ostream->assign_write(priv->base_ostream, buffer, len);
 }
 
+//Reserve space for a batch of writes on the base stream
+int camio_iostream_wrapper_start_write_batch(camio_iostream_t* this, camio_batch_item_t* items, size_t count){
+    camio_iostream_wrapper_t* priv = this->priv;
+    return priv->base_ostream->start_write_batch(priv->base_ostream, items, count);
+}
+
+//Commit a batch of writes to the base stream
+int camio_iostream_wrapper_commit_batch(camio_iostream_t* this, camio_batch_item_t* items, size_t count){
+    camio_iostream_wrapper_t* priv = this->priv;
+    return priv->base_ostream->commit_batch(priv->base_ostream, items, count);
+}
+
 
 
 int camio_iostream_wrapper_open(camio_iostream_t* this, const camio_descr_t* descr, camio_perf_t* perf_mon ){
@@ -156,6 +168,8 @@ camio_iostream_t* camio_iostream_wrapper_construct(
     priv->iostream.end_write        = camio_iostream_wrapper_end_write;
     priv->iostream.can_assign_write = camio_iostream_wrapper_can_assign_write;
     priv->iostream.assign_write     = camio_iostream_wrapper_assign_write;
+    priv->iostream.start_write_batch= camio_iostream_wrapper_start_write_batch;
+    priv->iostream.commit_batch     = camio_iostream_wrapper_commit_batch;
     priv->iostream.wready           = camio_iostream_wrapper_wready;
 
     priv->iostream.selector.fd      = -1;
@@ -245,6 +259,8 @@ camio_iostream_t* camio_iostream_wrapper_construct_e(
     priv->iostream.end_write        = camio_iostream_wrapper_end_write;
     priv->iostream.can_assign_write = camio_iostream_wrapper_can_assign_write;
     priv->iostream.assign_write     = camio_iostream_wrapper_assign_write;
+    priv->iostream.start_write_batch= camio_iostream_wrapper_start_write_batch;
+    priv->iostream.commit_batch     = camio_iostream_wrapper_commit_batch;
     priv->iostream.wready           = camio_iostream_wrapper_wready;
 
     priv->iostream.selector.fd      = -1;
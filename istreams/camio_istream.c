@@ -9,6 +9,7 @@
 
 #include "camio_istream.h"
 #include "../errors/camio_errors.h"
+#include "../utils/camio_util.h"
 
 #include "camio_istream_log.h"
 #include "camio_istream_raw.h"
@@ -22,6 +23,8 @@
 #include "camio_istream_netmap_eth.h"
 #include "camio_istream_fio.h"
 #include "camio_istream_bring.h"
+#include "camio_istream_mring.h"
+#include "camio_istream_bcast.h"
 
 //#ifdef HAVE_DAG_
 #include "camio_istream_dag.h"
@@ -68,6 +71,12 @@ camio_istream_t* camio_istream_new(const char* description, camio_clock_t* clock
     else if(strcmp(descr.protocol,"bring") == 0 ){
         result = camio_istream_bring_new(&descr,clock,parameters, perf_mon);
     }
+    else if(strcmp(descr.protocol,"mpmc-ring") == 0 ){
+        result = camio_istream_mring_new(&descr,clock,parameters, perf_mon);
+    }
+    else if(strcmp(descr.protocol,"bcast") == 0 ){
+        result = camio_istream_bcast_new(&descr,clock,parameters, perf_mon);
+    }
 
 
 //    else if(strcmp(descr.protocol,"pcap") == 0 ){
@@ -95,3 +104,26 @@ camio_istream_t* camio_istream_new(const char* description, camio_clock_t* clock
 }
 
 
+//Streams that reuse a single buffer for every read cannot have more than one read outstanding,
+//so the best we can do generically is a batch of one.
+int camio_istream_generic_start_read_batch(camio_istream_t* this, camio_batch_item_t* items, size_t max_items){
+    if(unlikely(!max_items)){
+        return 0;
+    }
+
+    uint8_t* buffer = NULL;
+    const int len = this->start_read(this, &buffer);
+    if(unlikely(len <= 0)){
+        return 0; //Nothing more to read, the stream is closed
+    }
+
+    items[0].buffer = buffer;
+    items[0].len    = len;
+    items[0].meta   = this->meta;
+    return 1;
+}
+
+
+int camio_istream_generic_end_read_batch(camio_istream_t* this){
+    return this->end_read(this, NULL);
+}
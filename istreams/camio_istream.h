@@ -16,6 +16,7 @@
 #include "../clocks/camio_clock.h"
 #include "../selectors/camio_selector.h"
 #include "../perf/camio_perf.h"
+#include "../utils/camio_batch.h"
 
 struct camio_istream;
 typedef struct camio_istream camio_istream_t;
@@ -27,11 +28,18 @@ struct camio_istream{
      int (*start_read)(camio_istream_t* this, uint8_t** out_bytes);  //Returns the number of bytes available to read, this can be 0. If bytes available is non-zero, out_bytes has a pointer to the start of the bytes to read
      int (*end_read)(camio_istream_t* this, uint8_t* free_buff);     //Returns 0 if the contents of out_bytes have NOT changed since the call to start_read. For buffers this may fail, if this is the case, data read in start_read maybe corrupt.
      void(*delete)(camio_istream_t* this);                        //Closes the stream and deletes the memory used
+     int (*start_read_batch)(camio_istream_t* this, camio_batch_item_t* items, size_t max_items); //Fills up to max_items with data available to read, returns the number filled. Blocks until at least one is available, returns 0 if the stream is closed.
+     int (*end_read_batch)(camio_istream_t* this);                //Releases every item returned by the last start_read_batch. Returns 0 if the contents have NOT changed since the call to start_read_batch.
      camio_clock_t* clock;
      camio_selectable_t selector;
+     camio_meta_t meta;                                           //What is known about the message returned by the last start_read. Batch reads return theirs in each item
      void* priv;
 };
 
 camio_istream_t* camio_istream_new(const char* description, camio_clock_t* clock, void* parameters, camio_perf_t* perf_mon);
 
+//Generic batch implementation for streams that cannot hold more than one read outstanding. Returns batches of (at most) one.
+int camio_istream_generic_start_read_batch(camio_istream_t* this, camio_batch_item_t* items, size_t max_items);
+int camio_istream_generic_end_read_batch(camio_istream_t* this);
+
 #endif /* CAMIO_ISTREAM_H_ */
@@ -0,0 +1,316 @@
+/*
+ * Copyright  (C) Matthew P. Grosvenor, 2012, All Rights Reserved
+ *
+ * Camio broadcast (single writer, many reader) ring input stream
+ *
+ */
+#include <errno.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <memory.h>
+
+#include "camio_istream_bcast.h"
+#include "../errors/camio_errors.h"
+#include "../utils/camio_util.h"
+#include "../stream_description/camio_opt_parser.h"
+#include "../utils/camio_bcast.h"
+
+
+static int camio_istream_bcast_open(camio_istream_t* this, const camio_descr_t* descr, camio_perf_t* perf_mon ){
+    camio_istream_bcast_t* priv = this->priv;
+    int bcast_fd = -1;
+    volatile uint8_t* bcast = NULL;
+
+    if(unlikely(perf_mon == NULL)){
+        eprintf_exit("No performance monitor supplied\n");
+    }
+    priv->perf_mon = perf_mon;
+
+    //The geometry is set by the ostream. Params and options are accepted so that both ends can share a description,
+    //but they are only used as a sanity check.
+    uint64_t slot_size  = 0;
+    uint64_t slot_count = 0;
+    if(priv->params){
+        slot_size  = priv->params->slot_size;
+        slot_count = priv->params->slot_count;
+    }
+
+    if(unlikely(camio_descr_has_opts(descr->opt_head))){
+        struct camio_opt_t* opt;
+        for(opt = descr->opt_head; opt; opt = opt->next){
+            if(strcmp(opt->name,"slots") == 0){
+                camio_descr_get_opt_uint(opt, &slot_count);
+            }
+            else if(strcmp(opt->name,"slot_size") == 0){
+                camio_descr_get_opt_uint(opt, &slot_size);
+            }
+            else{
+                eprintf_exit( "Unknown option supplied \"%s\". Valid options for this stream are: \"slots=<uint64>\", \"slot_size=<uint64>\"\n", opt->name);
+            }
+        }
+    }
+
+    if(unlikely(!descr->query)){
+        eprintf_exit( "No filename supplied\n");
+    }
+
+    //Wait until there is a bcast file to open, and it is big enough to hold the header.
+    struct stat bcast_stat;
+    while( (bcast_fd = open(descr->query, O_RDWR)) < 0 ){ usleep(1000); }
+    while( fstat(bcast_fd, &bcast_stat) == 0 && bcast_stat.st_size < CAMIO_BCAST_HEADER_SIZE ){ usleep(1000); }
+
+    //Map just the header to begin with, the geometry tells us how much more there is
+    volatile camio_bcast_header_t* header = mmap( NULL, CAMIO_BCAST_HEADER_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, bcast_fd, 0);
+    if(unlikely(header == MAP_FAILED)){
+        eprintf_exit( "Could not memory map bcast file \"%s\". Error=%s\n", descr->query, strerror(errno));
+    }
+
+    //Wait for the ostream to do any init work it must do
+    while(!header->ostream_created){
+        asm("PAUSE");
+    }
+
+    if(unlikely(header->magic != CAMIO_BCAST_MAGIC || header->version != CAMIO_BCAST_VERSION)){
+        eprintf_exit( "File \"%s\" is not a version %lu bcast ring\n", descr->query, (uint64_t)CAMIO_BCAST_VERSION);
+    }
+
+    priv->slot_size  = header->slot_size;
+    priv->slot_count = header->slot_count;
+    munmap((void*)header, CAMIO_BCAST_HEADER_SIZE);
+
+    if( (slot_size && slot_size != priv->slot_size) || (slot_count && slot_count != priv->slot_count) ){
+        wprintf("Bcast geometry requested (%lu x %lu) does not match the writer's (%lu x %lu). Using the writer's.\n",
+                slot_count, slot_size, priv->slot_count, priv->slot_size);
+    }
+
+    bcast = mmap( NULL, CAMIO_BCAST_MEM_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, bcast_fd, 0);
+    if(unlikely(bcast == MAP_FAILED)){
+        eprintf_exit( "Could not memory map bcast file \"%s\". Error=%s\n", descr->query, strerror(errno));
+    }
+
+    //Unlike the ring, the file is left in place for other readers to find. The ostream removes it when it closes.
+    priv->bcast_size = CAMIO_BCAST_MEM_SIZE;
+    this->selector.fd = bcast_fd;
+    priv->bcast = bcast + CAMIO_BCAST_HEADER_SIZE;
+    priv->is_closed = 0;
+
+    //Start with the next message to be published and tell the ostream we're here
+    priv->pos = bcast_header->head;
+    __sync_fetch_and_add(&bcast_istream_count, 1);
+
+    return 0;
+}
+
+
+static void camio_istream_bcast_close(camio_istream_t* this){
+    camio_istream_bcast_t* priv = this->priv;
+    munmap((void*)bcast_header, priv->bcast_size);
+    close(this->selector.fd);
+    priv->is_closed = 1;
+}
+
+
+
+
+static int prepare_next(camio_istream_bcast_t* priv){
+
+    //Simple case, there's already data waiting
+    if(unlikely(priv->read_size)){
+        camio_perf_event_start(priv->perf_mon,CAMIO_PERF_EVENT_ISTREAM_BCAST,CAMIO_PERF_COND_EXISTING_DATA);
+        return priv->read_size;
+    }
+
+    //Is there new data?
+    const uint64_t seq = bcast_slot(priv->pos)->seq;
+    if( likely(seq == priv->pos + 1)){
+        priv->read_size = bcast_slot(priv->pos)->len;
+        priv->istream.meta.seq   = priv->pos;
+        priv->istream.meta.flags = CAMIO_META_SEQ;
+        camio_perf_event_start(priv->perf_mon,CAMIO_PERF_EVENT_ISTREAM_BCAST,CAMIO_PERF_COND_NEW_DATA);
+        return priv->read_size;
+    }
+
+    //The writer has lapped us. Pick up from the message in this slot, the ones that follow it are newer still.
+    if( unlikely(seq > priv->pos + 1)){
+        wprintf( "Bcast overflow. Catching up now. Dropping payloads from %lu to %lu\n", priv->pos + 1, seq - 1);
+        priv->pos = seq - 1;
+        priv->read_size = bcast_slot(priv->pos)->len;
+        priv->istream.meta.seq   = priv->pos;
+        priv->istream.meta.flags = CAMIO_META_SEQ | CAMIO_META_OVERRUN;
+        camio_perf_event_start(priv->perf_mon,CAMIO_PERF_EVENT_ISTREAM_BCAST,CAMIO_PERF_COND_READ_ERROR);
+        return priv->read_size;
+    }
+
+    return 0;
+}
+
+static int camio_istream_bcast_ready(camio_istream_t* this){
+    camio_istream_bcast_t* priv = this->priv;
+    if(priv->read_size || priv->is_closed){
+        return 1;
+    }
+
+    return prepare_next(priv);
+}
+
+static int camio_istream_bcast_start_read(camio_istream_t* this, uint8_t** out){
+    camio_istream_bcast_t* priv = this->priv;
+    *out = NULL;
+
+    if(unlikely(priv->is_closed)){
+        return 0;
+    }
+
+    //Called read without calling ready, they must want to block/spin waiting for data
+    if(unlikely(!priv->read_size)){
+        while(!prepare_next(priv)){
+            asm("pause"); //Tell the CPU we're spinning
+        }
+    }
+
+    *out = bcast_slot_data(priv->pos);
+    size_t result = priv->read_size;
+    return result;
+}
+
+
+static int camio_istream_bcast_end_read(camio_istream_t* this, uint8_t* free_buff){
+    camio_istream_bcast_t* priv = this->priv;
+
+    asm volatile("" ::: "memory"); //Make sure the compiler does not sink slot reads below the check
+    if( unlikely(bcast_slot(priv->pos)->seq != priv->pos + 1)){
+        //The writer got to the slot while we were reading it, prepare_next will catch us up
+        priv->read_size = 0;
+        return -1;
+    }
+
+    priv->read_size = 0;
+    priv->pos++;
+
+    return 0;
+}
+
+
+//Slots are filled in order, so the slot i places after the current one is ready if its sequence number is exactly i
+//more than the one we expect now.
+static int camio_istream_bcast_start_read_batch(camio_istream_t* this, camio_batch_item_t* items, size_t max_items){
+    camio_istream_bcast_t* priv = this->priv;
+
+    if(unlikely(priv->is_closed || !max_items)){
+        return 0;
+    }
+
+    //Called read without calling ready, they must want to block/spin waiting for data
+    if(unlikely(!priv->read_size)){
+        while(!prepare_next(priv)){
+            asm("pause"); //Tell the CPU we're spinning
+        }
+    }
+
+    //prepare_next has already caught up with any overflow, so the current slot is good
+    items[0].buffer = bcast_slot_data(priv->pos);
+    items[0].len    = priv->read_size;
+    items[0].meta   = priv->istream.meta;
+
+    size_t count = 1;
+    for(; count < max_items && count < priv->slot_count; count++){
+        if(bcast_slot(priv->pos + count)->seq != priv->pos + count + 1){
+            break;
+        }
+
+        items[count].buffer = bcast_slot_data(priv->pos + count);
+        items[count].len    = bcast_slot(priv->pos + count)->len;
+        items[count].meta   = (camio_meta_t){ .seq = priv->pos + count, .flags = CAMIO_META_SEQ };
+    }
+
+    priv->batch_count = count;
+    return count;
+}
+
+
+//The writer overwrites slots in order, so if it has lapped us anywhere in the batch, it will have
+//already marked the first slot of the batch.
+static int camio_istream_bcast_end_read_batch(camio_istream_t* this){
+    camio_istream_bcast_t* priv = this->priv;
+
+    asm volatile("" ::: "memory"); //Make sure the compiler does not sink slot reads below the check
+    if( unlikely(bcast_slot(priv->pos)->seq != priv->pos + 1)){
+        priv->read_size    = 0;
+        priv->batch_count  = 0;
+        return -1;
+    }
+
+    priv->read_size     = 0;
+    priv->pos          += priv->batch_count;
+    priv->batch_count   = 0;
+
+    return 0;
+}
+
+
+static int camio_istream_bcast_selector_ready(camio_selectable_t* stream){
+    camio_istream_t* this = container_of(stream, camio_istream_t,selector);
+    return this->ready(this);
+}
+
+
+static void camio_istream_bcast_delete(camio_istream_t* this){
+    this->close(this);
+    camio_istream_bcast_t* priv = this->priv;
+    free(priv);
+}
+
+/* ****************************************************
+ * Construction
+ */
+
+static camio_istream_t* camio_istream_bcast_construct(camio_istream_bcast_t* priv, const camio_descr_t* descr, camio_clock_t* clock, camio_istream_bcast_params_t* params, camio_perf_t* perf_mon ){
+    if(!priv){
+        eprintf_exit("bcast stream supplied is null\n");
+    }
+
+    //Initialize the local variables
+    priv->is_closed         = 1;
+    priv->bcast             = NULL;
+    priv->bcast_size        = 0;
+    priv->read_size         = 0;
+    priv->pos               = 0;
+    priv->batch_count       = 0;
+    priv->slot_size         = 0;
+    priv->slot_count        = 0;
+    priv->params            = params;
+
+    //Populate the function members
+    priv->istream.priv           = priv; //Lets us access private members
+    priv->istream.open           = camio_istream_bcast_open;
+    priv->istream.close          = camio_istream_bcast_close;
+    priv->istream.start_read     = camio_istream_bcast_start_read;
+    priv->istream.end_read       = camio_istream_bcast_end_read;
+    priv->istream.ready          = camio_istream_bcast_ready;
+    priv->istream.delete         = camio_istream_bcast_delete;
+    priv->istream.start_read_batch = camio_istream_bcast_start_read_batch;
+    priv->istream.end_read_batch = camio_istream_bcast_end_read_batch;
+    priv->istream.clock          = clock;
+    priv->istream.meta           = (camio_meta_t){ .flags = 0 };
+    priv->istream.selector.fd    = -1;
+    priv->istream.selector.ready = camio_istream_bcast_selector_ready;
+
+    //Call open, because its the obvious thing to do now...
+    priv->istream.open(&priv->istream, descr, perf_mon);
+
+    //Return the generic istream interface for the outside world to use
+    return &priv->istream;
+
+}
+
+camio_istream_t* camio_istream_bcast_new( const camio_descr_t* descr, camio_clock_t* clock, camio_istream_bcast_params_t* params, camio_perf_t* perf_mon ){
+    camio_istream_bcast_t* priv = malloc(sizeof(camio_istream_bcast_t));
+    if(!priv){
+        eprintf_exit("No memory available for bcast istream creation\n");
+    }
+    return camio_istream_bcast_construct(priv, descr, clock, params, perf_mon );
+}
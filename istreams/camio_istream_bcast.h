@@ -0,0 +1,48 @@
+/*
+ * camio_istream_bcast.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: mgrosvenor
+ */
+
+#ifndef CAMIO_ISTREAM_BCAST_H_
+#define CAMIO_ISTREAM_BCAST_H_
+
+#include "camio_istream.h"
+
+/********************************************************************
+ *                  PRIVATE DEFS
+ ********************************************************************/
+
+
+typedef struct {
+    uint64_t slot_size;
+    uint64_t slot_count;
+} camio_istream_bcast_params_t;
+
+typedef struct {
+    camio_istream_t istream;
+    int is_closed;                       //Has close be called?
+    volatile uint8_t* bcast;             //Pointer to the first slot of the ring
+    size_t bcast_size;                   //Size of the ring buffer
+    size_t read_size;                    //Size of the current read waiting (if any)
+    uint64_t pos;                        //Position of the next message to read, it lives in slot pos % slot_count
+    uint64_t slot_size;                  //Size of each slot in the ring
+    uint64_t slot_count;                 //Number of slots in the ring
+    size_t batch_count;                  //Number of slots handed out by the last start_read_batch
+    camio_istream_bcast_params_t* params;  //Parameters passed in from the outside
+    camio_perf_t* perf_mon;
+
+} camio_istream_bcast_t;
+
+
+
+
+/********************************************************************
+ *                  PUBLIC DEFS
+ ********************************************************************/
+
+camio_istream_t* camio_istream_bcast_new( const camio_descr_t* opts, camio_clock_t* clock, camio_istream_bcast_params_t* params, camio_perf_t* perf_mon );
+
+
+#endif /* CAMIO_ISTREAM_BCAST_H_ */
@@ -153,7 +153,10 @@ camio_istream_t* camio_istream_blob_construct(camio_istream_blob_t* priv, const
     priv->istream.end_read       = camio_istream_blob_end_read;
     priv->istream.ready          = camio_istream_blob_ready;
     priv->istream.delete         = camio_istream_blob_delete;
+    priv->istream.start_read_batch = camio_istream_generic_start_read_batch;
+    priv->istream.end_read_batch = camio_istream_generic_end_read_batch;
     priv->istream.clock          = clock;
+    priv->istream.meta           = (camio_meta_t){ .flags = CAMIO_META_SEQ }; //There's only ever message 0
     priv->istream.selector.fd    = -1;
     priv->istream.selector.ready = camio_istream_blob_selector_ready;
 
@@ -10,6 +10,7 @@
 #include <string.h>
 #include <fcntl.h>
 #include <sys/mman.h>
+#include <sys/stat.h>
 #include <memory.h>
 
 #include "camio_istream_bring.h"
@@ -22,6 +23,32 @@
 
 
 
+//Hand consumed slots back to the ostream. This is the only store the istream makes to shared memory, so it is
+//batched up to keep the tail cache line where it is for as long as possible.
+static inline void publish_tail(camio_istream_bring_t* priv){
+    if(priv->tail != priv->tail_published){
+        bring_header->tail   = priv->tail;
+        priv->tail_published = priv->tail;
+    }
+}
+
+
+//Returns the number of slots ready to read. Only reads the ostream's head (and so only pulls its cache line over)
+//when we've used up everything we knew about.
+static inline uint64_t slots_ready(camio_istream_bring_t* priv){
+    if(likely(priv->head_cache != priv->tail)){
+        return priv->head_cache - priv->tail;
+    }
+
+    priv->head_cache = bring_header->head;
+    if(priv->head_cache == priv->tail){
+        publish_tail(priv); //We've run dry, give everything back so the ostream is never left waiting on us
+    }
+
+    return priv->head_cache - priv->tail;
+}
+
+
 static int prepare_next(camio_istream_bring_t* priv){
 
     //Simple case, there's already data waiting
@@ -31,28 +58,72 @@ static int prepare_next(camio_istream_bring_t* priv){
     }
 
     //Is there new data?
-    register uint64_t curr_sync_count = *((volatile uint64_t*)(priv->curr + priv->slot_size - sizeof(uint64_t)));
-    if( likely(curr_sync_count == priv->sync_counter)){
-        const uint64_t data_len  = *((volatile uint64_t*)(priv->curr + priv->slot_size - 2* sizeof(uint64_t)));
-        priv->read_size = data_len;
+    if(likely(slots_ready(priv))){
+        volatile camio_bring_slot_t* slot = bring_slot(priv->tail);
+        if(unlikely(slot->seq != priv->tail + 1)){
+            eprintf_exit( "Ring corruption. This should not happen with a blocking ring, expected %lu found %lu\n", priv->tail + 1, slot->seq);
+        }
+
+        priv->read_size = slot->len;
+        priv->istream.meta.seq = priv->tail;
         camio_perf_event_start(priv->perf_mon,CAMIO_PERF_EVENT_ISTREAM_BRING,CAMIO_PERF_COND_NEW_DATA);
-        return data_len;
+        return priv->read_size;
+    }
+
+    return 0;
+}
+
+
+//Spin for a while, then (unless we have been told to spin forever) sleep until the ostream wakes us. prepare_next has
+//already handed all of our slots back by the time it finds the bring empty, so the ostream is never left waiting on us.
+static void wait_for_data(camio_istream_bring_t* priv){
+    uint64_t spins = 0;
+    while(!prepare_next(priv)){
+        if(likely(priv->wait_mode == CAMIO_WAIT_SPIN || spins < priv->spin_count)){
+            spins++;
+            asm("pause"); //Tell the CPU we're spinning
+            continue;
+        }
+
+        const uint32_t futex_val = camio_wait_prepare(bring_wait);
+        if(!prepare_next(priv)){
+            camio_wait_sleep(bring_wait, futex_val);
+        }
+        camio_wait_finish(bring_wait);
     }
+}
 
-    if( likely(curr_sync_count > priv->sync_counter)){
-        eprintf_exit( "Ring overflow. This should not happen with a blocking ring %lu to %lu\n", priv->sync_counter, curr_sync_count -1);
+
+//Ask the ostream for a byte on the wake fifo as soon as there is data. Only done when the bring is found empty, so a
+//busy stream never makes a syscall here.
+static void arm_wake_fd(camio_istream_bring_t* priv){
+    if(bring_wait->armed){
+        return; //Nothing has been written since we last armed it
     }
 
-    return 0;
+    camio_wait_fd_drain(priv->istream.selector.fd);
+    bring_wait->armed = 1;
+    __sync_synchronize();
+
+    //Data may have arrived before the ostream could see the flag. Whoever clears it rings the fifo.
+    if(prepare_next(priv) && __sync_bool_compare_and_swap(&bring_wait->armed, 1, 0)){
+        camio_wait_fd_ring(priv->istream.selector.fd);
+    }
 }
 
+
 static int camio_istream_bring_ready(camio_istream_t* this){
     camio_istream_bring_t* priv = this->priv;
     if(priv->read_size || priv->is_closed){
         return 1;
     }
 
-    return prepare_next(priv);
+    const int result = prepare_next(priv);
+    if(!result && priv->wait_mode == CAMIO_WAIT_FD){
+        arm_wake_fd(priv);
+    }
+
+    return result;
 }
 
 static int camio_istream_bring_start_read(camio_istream_t* this, uint8_t** out){
@@ -65,12 +136,10 @@ static int camio_istream_bring_start_read(camio_istream_t* this, uint8_t** out){
 
     //Called read without calling ready, they must want to block/spin waiting for data
     if(unlikely(!priv->read_size)){
-        while(!prepare_next(priv)){
-            asm("pause"); //Tell the CPU we're spinning
-        }
+        wait_for_data(priv);
     }
 
-    *out = (uint8_t*)priv->curr;
+    *out = bring_slot_data(priv->tail);
     size_t result = priv->read_size;
     return result;
 }
@@ -79,15 +148,53 @@ static int camio_istream_bring_start_read(camio_istream_t* this, uint8_t** out){
 static int camio_istream_bring_end_read(camio_istream_t* this, uint8_t* free_buff){
     camio_istream_bring_t* priv = this->priv;
 
-    //Free this slot
-    *((volatile uint64_t*)(priv->curr + priv->slot_size - sizeof(uint64_t))) = 0x00ULL;
-
+    //Free this slot, the ostream will only find out about it once we've freed a batch
     priv->read_size = 0;
-    priv->sync_counter++;
-    priv->index = (priv->index + 1) % (priv->slot_count);
-    priv->curr  = priv->bring + (priv->index * priv->slot_size);
+    priv->tail++;
+    if(unlikely(priv->tail - priv->tail_published >= CAMIO_BRING_FREE_BATCH)){
+        publish_tail(priv);
+    }
+
+    return 0;
+}
 
 
+//Everything between tail and head is ready to read, in order
+static int camio_istream_bring_start_read_batch(camio_istream_t* this, camio_batch_item_t* items, size_t max_items){
+    camio_istream_bring_t* priv = this->priv;
+
+    if(unlikely(priv->is_closed || !max_items)){
+        return 0;
+    }
+
+    //Called read without calling ready, they must want to block/spin waiting for data
+    if(unlikely(!priv->read_size)){
+        wait_for_data(priv);
+    }
+
+    const size_t count = MIN(max_items, slots_ready(priv));
+    size_t i = 0;
+    for(; i < count; i++){
+        items[i].buffer = bring_slot_data(priv->tail + i);
+        items[i].len    = bring_slot(priv->tail + i)->len;
+        items[i].meta   = (camio_meta_t){ .seq = priv->tail + i, .flags = CAMIO_META_SEQ };
+    }
+
+    priv->batch_count = count;
+    return count;
+}
+
+
+static int camio_istream_bring_end_read_batch(camio_istream_t* this){
+    camio_istream_bring_t* priv = this->priv;
+
+    priv->read_size    = 0;
+    priv->tail        += priv->batch_count;
+    priv->batch_count  = 0;
+    if(unlikely(priv->tail - priv->tail_published >= CAMIO_BRING_FREE_BATCH)){
+        publish_tail(priv);
+    }
+
     return 0;
 }
 
@@ -108,28 +215,81 @@ static int camio_istream_bring_open(camio_istream_t* this, const camio_descr_t*
     }
     priv->perf_mon = perf_mon;
 
+    //The geometry is set by the ostream. Params and options are accepted so that both ends can share a description,
+    //but they are only used as a sanity check.
+    uint64_t slot_size  = 0;
+    uint64_t slot_count = 0;
+    if(priv->params){
+        slot_size  = priv->params->slot_size;
+        slot_count = priv->params->slot_count;
+    }
+
     if(unlikely(camio_descr_has_opts(descr->opt_head))){
-        eprintf_exit( "Option(s) supplied, but none expected\n");
+        struct camio_opt_t* opt;
+        for(opt = descr->opt_head; opt; opt = opt->next){
+            if(strcmp(opt->name,"slots") == 0){
+                camio_descr_get_opt_uint(opt, &slot_count);
+            }
+            else if(strcmp(opt->name,"slot_size") == 0){
+                camio_descr_get_opt_uint(opt, &slot_size);
+            }
+            else if(strcmp(opt->name,"wait") == 0){
+                char* mode = NULL;
+                camio_descr_get_opt_string(opt, &mode);
+                priv->wait_mode = camio_wait_mode(mode);
+            }
+            else if(strcmp(opt->name,"spin") == 0){
+                camio_descr_get_opt_uint(opt, &priv->spin_count);
+            }
+            else if(strcmp(opt->name,"doorbell") == 0){
+                char* doorbell_name = NULL;
+                camio_descr_get_opt_string(opt, &doorbell_name);
+                priv->doorbell_name = strdup(doorbell_name); //The descr is likely to go away
+            }
+            else{
+                eprintf_exit( "Unknown option supplied \"%s\". Valid options for this stream are: \"slots=<uint64>\", \"slot_size=<uint64>\", \"wait=spin|futex|fd\", \"spin=<uint64>\", \"doorbell=<file>\"\n", opt->name);
+            }
+        }
     }
 
     if(unlikely(!descr->query)){
         eprintf_exit( "No filename supplied\n");
     }
 
+    //Make a local copy of the filename, the wake fifo is named after it
+    size_t filename_len = strlen(descr->query);
+    priv->filename = malloc(filename_len + 1);
+    memcpy(priv->filename,descr->query, filename_len);
+    priv->filename[filename_len] = '\0'; //Make sure it's null terminated
 
-    if(priv->params){
-        priv->slot_size  = priv->params->slot_size;
-        priv->slot_count = priv->params->slot_count;
+    //Wait until there is a bring file to open, and it is big enough to hold the header.
+    struct stat bring_stat;
+    while( (bring_fd = open(descr->query, O_RDWR)) < 0 ){ usleep(1000); }
+    while( fstat(bring_fd, &bring_stat) == 0 && bring_stat.st_size < CAMIO_BRING_HEADER_SIZE ){ usleep(1000); }
+
+    //Map just the header to begin with, the geometry tells us how much more there is
+    volatile camio_bring_header_t* header = mmap( NULL, CAMIO_BRING_HEADER_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, bring_fd, 0);
+    if(unlikely(header == MAP_FAILED)){
+        eprintf_exit( "Could not memory map bring file \"%s\". Error=%s\n", descr->query, strerror(errno));
+    }
+
+    //Wait for the ostream to do any init work it must do
+    while(!header->ostream_created){
+        asm("PAUSE");
     }
-    else{
-        priv->slot_size  = CAMIO_BRING_SLOT_SIZE_DEFAULT;
-        priv->slot_count = CAMIO_BRING_SLOT_COUNT_DEFAULT;
+
+    if(unlikely(header->magic != CAMIO_BRING_MAGIC || header->version != CAMIO_BRING_VERSION)){
+        eprintf_exit( "File \"%s\" is not a version %lu bring\n", descr->query, (uint64_t)CAMIO_BRING_VERSION);
     }
 
-    //printf("Making bring istream %s with %lu slots of size %lu\n", descr->query, priv->slot_count, priv->slot_size);
+    priv->slot_size  = header->slot_size;
+    priv->slot_count = header->slot_count;
+    munmap((void*)header, CAMIO_BRING_HEADER_SIZE);
 
-    //Wait until there is a bring file to open.
-    while( (bring_fd = open(descr->query, O_RDWR)) < 0 ){ usleep(1000); }
+    if( (slot_size && slot_size != priv->slot_size) || (slot_count && slot_count != priv->slot_count) ){
+        wprintf("Bring geometry requested (%lu x %lu) does not match the writer's (%lu x %lu). Using the writer's.\n",
+                slot_count, slot_size, priv->slot_count, priv->slot_size);
+    }
 
     bring = mmap( NULL, CAMIO_BRING_MEM_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, bring_fd, 0);
     if(unlikely(bring == MAP_FAILED)){
@@ -142,18 +302,30 @@ static int camio_istream_bring_open(camio_istream_t* this, const camio_descr_t*
         wprintf("Could not remove bring file \"%s\". Error = \"%s\"", descr->query, strerror(errno));
     }
 
-    priv->bring_size = priv->slot_count * priv->slot_size;
+    priv->bring_size = CAMIO_BRING_MEM_SIZE;
+    priv->bring_fd = bring_fd;
     this->selector.fd = bring_fd;
-    priv->bring = bring;
-    priv->curr = bring;
+    priv->bring = bring + CAMIO_BRING_HEADER_SIZE;
     priv->is_closed = 0;
 
-    //Wait for the ostream to do any init work it must do
-    while(!bring_ostream_created){
-        asm("PAUSE");
+    //In fd mode, the selector waits on the wake fifo instead of the bring file, which is always readable
+    if(priv->wait_mode == CAMIO_WAIT_FD){
+        this->selector.fd = camio_wait_fd_open(priv->filename);
+        camio_wait_fd_ring(this->selector.fd); //Start out readable, so the first select looks at the bring and arms the fifo
     }
 
-    //Tell the ostream it can send now
+    //Claim a bit in the doorbell, and tell the ostream where it is
+    if(priv->doorbell_name){
+        priv->doorbell     = camio_doorbell_attach(priv->doorbell_name);
+        priv->doorbell_bit = camio_doorbell_claim(priv->doorbell, priv->doorbell_name);
+        strcpy((char*)bring_doorbell->name, priv->doorbell_name);
+        bring_doorbell->bit = priv->doorbell_bit + 1;
+        camio_doorbell_register(&this->selector, priv->doorbell_name, priv->doorbell_bit);
+    }
+
+    //Tell the ostream how we wait, then that it can send now
+    bring_istream_wait = priv->wait_mode;
+    __sync_synchronize();
     bring_istream_connected = 1;
     //printf("Bring connected =%lu (%s) %lu\n", bring_istream_connected, descr->query, (&bring_istream_connected - (volatile uint64_t*)priv->bring));
 
@@ -163,8 +335,24 @@ static int camio_istream_bring_open(camio_istream_t* this, const camio_descr_t*
 
 static void camio_istream_bring_close(camio_istream_t* this){
     camio_istream_bring_t* priv = this->priv;
-    munmap((void*)priv->bring, priv->bring_size);
-    close(this->selector.fd);
+    if(priv->doorbell){
+        //Stop the ostream ringing our bit before we give it up, it may go to another stream
+        bring_doorbell->bit = 0;
+        __sync_synchronize();
+        camio_doorbell_unregister(&this->selector);
+        camio_doorbell_release(priv->doorbell, priv->doorbell_bit);
+        camio_doorbell_detach(priv->doorbell, priv->doorbell_name);
+        priv->doorbell = NULL;
+    }
+    free(priv->doorbell_name);
+    priv->doorbell_name = NULL;
+
+    munmap((void*)bring_header, priv->bring_size);
+    close(priv->bring_fd);
+    if(priv->wait_mode == CAMIO_WAIT_FD){
+        camio_wait_fd_close(priv->filename, this->selector.fd);
+    }
+    free(priv->filename);
     priv->is_closed = 1;
 }
 
@@ -190,12 +378,20 @@ static camio_istream_t* camio_istream_bring_construct(camio_istream_bring_t* pri
     priv->is_closed         = 1;
     priv->bring              = NULL;
     priv->bring_size         = 0;
-    priv->curr              = NULL;
     priv->read_size         = 0;
-    priv->sync_counter      = 1; //We will expect 1 when the first write occurs
-    priv->index             = 0;
+    priv->tail              = 0;
+    priv->tail_published    = 0;
+    priv->head_cache        = 0;
     priv->slot_count        = 0;
     priv->slot_size         = 0;
+    priv->batch_count       = 0;
+    priv->filename          = NULL;
+    priv->bring_fd          = -1;
+    priv->wait_mode         = CAMIO_WAIT_SPIN;
+    priv->spin_count        = CAMIO_WAIT_SPIN_DEFAULT;
+    priv->doorbell_name     = NULL;
+    priv->doorbell          = NULL;
+    priv->doorbell_bit      = 0;
     priv->params            = params;
 
 
@@ -207,7 +403,10 @@ static camio_istream_t* camio_istream_bring_construct(camio_istream_bring_t* pri
     priv->istream.end_read       = camio_istream_bring_end_read;
     priv->istream.ready          = camio_istream_bring_ready;
     priv->istream.delete         = camio_istream_bring_delete;
+    priv->istream.start_read_batch = camio_istream_bring_start_read_batch;
+    priv->istream.end_read_batch = camio_istream_bring_end_read_batch;
     priv->istream.clock          = clock;
+    priv->istream.meta           = (camio_meta_t){ .flags = CAMIO_META_SEQ }; //A blocking ring never drops
     priv->istream.selector.fd    = -1;
     priv->istream.selector.ready = camio_istream_bring_selector_ready;
 
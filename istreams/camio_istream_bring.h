@@ -9,6 +9,7 @@
 #define CAMIO_ISTREAM_BRING_H_
 
 #include "camio_istream.h"
+#include "../utils/camio_doorbell.h"
 
 #define CAMIO_ISTREAM_BRING_BLOCKING    1
 #define CAMIO_ISTREAM_BRING_NONBLOCKING 0
@@ -28,12 +29,20 @@ typedef struct {
     int is_closed;                       //Has close be called?
     volatile uint8_t* bring;              //Pointer to the head of the bring
     size_t bring_size;                    //Size of the bring buffer
-    volatile uint8_t* curr;              //Current slot in the bring
     size_t read_size;                    //Size of the current read waiting (if any)
-    uint64_t sync_counter;               //Synchronization counter
-    uint64_t index;                      //Current index into the buffer
+    uint64_t tail;                       //Number of slots consumed, the next slot to read is tail % slot_count
+    uint64_t tail_published;             //Last value of tail handed back to the ostream
+    uint64_t head_cache;                 //Last value of the ostream's head that we saw
     uint64_t slot_size;                  //Size of each slot in the ring
     uint64_t slot_count;                 //Number of slots in the ring
+    size_t batch_count;                  //Number of slots handed out by the last start_read_batch
+    char* filename;                      //Name of the bring file, the wake fifo is named after it
+    int bring_fd;                        //The bring file. The selector fd is the wake fifo in fd wait mode
+    uint64_t wait_mode;                  //How to wait for data, one of CAMIO_WAIT_*
+    uint64_t spin_count;                 //How many times to look for data before sleeping
+    char* doorbell_name;                 //Doorbell file to ring us through, if any
+    volatile camio_doorbell_t* doorbell; //The doorbell, once attached
+    uint64_t doorbell_bit;               //Our bit in the doorbell
     camio_istream_bring_params_t* params;  //Parameters passed in from the outside
     camio_perf_t* perf_mon;
 
@@ -15,6 +15,7 @@
 #include <sys/mman.h>
 #include <memory.h>
 #include <netinet/in.h>
+#include <endian.h>
 
 #include "camio_istream_dag.h"
 #include "../errors/camio_errors.h"
@@ -115,9 +116,13 @@ int camio_istream_dag_ready(camio_istream_t* this){
     return prepare_next(this);
 }
 
-//Convert fixed point dagtime to nanoseconds since 1970
+//Convert fixed point dagtime to nanoseconds since 1970. ERF times are little endian, with seconds in the top 32 bits and
+//a binary fraction of a second in the bottom 32.
 void camio_dagtime_to_time(camio_time_t* time_out, dag_record_t* dag_record){
-    time_out->counter = dag_record->ts;
+    const uint64_t ts       = le64toh(dag_record->ts);
+    const uint64_t seconds  = ts >> 32;
+    const uint64_t fraction = ((ts & 0xFFFFFFFFULL) * 1000 * 1000 * 1000ULL + (1ULL << 31)) >> 32; //Rounded to nearest
+    time_out->counter = seconds * 1000 * 1000 * 1000ULL + fraction;
 }
 
 
@@ -136,9 +141,25 @@ int camio_istream_dag_start_read(camio_istream_t* this, uint8_t** out){
         }
     }
 
+    dag_record_t* record = priv->dag_data;
     camio_time_t current;
-    camio_dagtime_to_time(&current,priv->dag_data);
-    //this->clock->set(this->clock,&current);
+    camio_dagtime_to_time(&current,record);
+
+    //The card counts what it lost before this record, and flags records that arrived damaged
+    this->meta.ts_ns = current.counter;
+    this->meta.seq   = priv->seq++;
+    this->meta.flags = CAMIO_META_TS | CAMIO_META_SEQ;
+    if(unlikely(record->lctr)){
+        this->meta.flags |= CAMIO_META_OVERRUN;
+    }
+    if(unlikely(record->flags.rxerror || record->flags.dserror)){
+        this->meta.flags |= CAMIO_META_ERROR;
+    }
+
+    //Drive the clock from the capture, so that anything timed off it runs in the capture's time
+    if(this->clock){
+        this->clock->set(this->clock,&current);
+    }
 
     *out = (uint8_t*)priv->dag_data;
     return priv->data_size;
@@ -177,6 +198,7 @@ camio_istream_t* camio_istream_dag_construct(camio_istream_dag_t* priv, const ca
     //Initialize the local variables
     priv->is_closed         = 1;
     priv->dag_stream        = 0;
+    priv->seq               = 0;
     priv->dag_data          = NULL;
     priv->data_size			= 0;
     priv->params            = params;
@@ -189,7 +211,10 @@ camio_istream_t* camio_istream_dag_construct(camio_istream_dag_t* priv, const ca
     priv->istream.end_read       = camio_istream_dag_end_read;
     priv->istream.ready          = camio_istream_dag_ready;
     priv->istream.delete         = camio_istream_dag_delete;
+    priv->istream.start_read_batch = camio_istream_generic_start_read_batch;
+    priv->istream.end_read_batch = camio_istream_generic_end_read_batch;
     priv->istream.clock          = clock;
+    priv->istream.meta           = (camio_meta_t){ .flags = 0 };
     priv->istream.selector.fd    = -1;
     priv->istream.selector.ready = camio_istream_dag_selector_ready;
 
@@ -25,6 +25,7 @@ typedef struct {
     int dag_stream;
     void* dag_data;
     size_t data_size;
+    uint64_t seq;                        //Number of records read so far
     camio_istream_t istream;
     camio_istream_dag_params_t* params;  //Parameters passed in from the outside
     camio_perf_t* perf_mon;              //Performance monitoring and measurement
@@ -132,6 +132,7 @@ static int prepare_next(camio_istream_fio_t* priv, int blocking){
 
     //Woot
     priv->read_buff_data_size = bytes;
+    priv->istream.meta.seq    = priv->seq++;
     camio_perf_event_start(priv->perf_mon,CAMIO_PERF_EVENT_ISTREAM_FIO,CAMIO_PERF_COND_NEW_DATA);
     return bytes;
 
@@ -204,6 +205,7 @@ camio_istream_t* camio_istream_fio_construct(camio_istream_fio_t* priv, const ca
     priv->read_buff_size        = 0;
     priv->read_buff_data_size   = 0;
     priv->params                = params;
+    priv->seq                   = 0;
 
     //Populate the function members
     priv->istream.priv           = priv; //Lets us access private members
@@ -213,7 +215,10 @@ camio_istream_t* camio_istream_fio_construct(camio_istream_fio_t* priv, const ca
     priv->istream.end_read       = camio_istream_fio_end_read;
     priv->istream.ready          = camio_istream_fio_ready;
     priv->istream.delete         = camio_istream_fio_delete;
+    priv->istream.start_read_batch = camio_istream_generic_start_read_batch;
+    priv->istream.end_read_batch = camio_istream_generic_end_read_batch;
     priv->istream.clock          = clock;
+    priv->istream.meta           = (camio_meta_t){ .flags = CAMIO_META_SEQ };
     priv->istream.selector.fd    = -1;
     priv->istream.selector.ready = camio_istream_fio_selector_ready;
 
@@ -29,6 +29,7 @@ typedef struct {
     size_t read_buff_size;               //Size of a line that is ready for start_read
     uint8_t* read_buff;                  //Place to read data from in by calling start_read
     int64_t read_buff_data_size;         //Amount of data currently waiting in the read buffer
+    uint64_t seq;                        //Number of chunks read so far
     camio_istream_fio_params_t* params;  //Parameters passed in from the outside
     camio_perf_t* perf_mon;
 
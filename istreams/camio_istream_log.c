@@ -205,6 +205,7 @@ static int prepare_next(camio_istream_log_t* priv, int blocking){
                 }
                 i++; //Add 1 to include the line feed
                 priv->read_size = i;
+                priv->istream.meta.seq = priv->seq++;
                 return i; //Found a new line, return the line size
             }
         }
@@ -318,6 +319,7 @@ camio_istream_t* camio_istream_log_construct(camio_istream_log_t* priv, const ca
     priv->data_head_ptr     = NULL;
     priv->escape            = 0; //Off for the moment since this is borked
     priv->params            = params;
+    priv->seq               = 0;
 
     //Populate the function members
     priv->istream.priv           = priv; //Lets us access private members
@@ -327,7 +329,10 @@ camio_istream_t* camio_istream_log_construct(camio_istream_log_t* priv, const ca
     priv->istream.end_read       = camio_istream_log_end_read;
     priv->istream.ready          = camio_istream_log_ready;
     priv->istream.delete         = camio_istream_log_delete;
+    priv->istream.start_read_batch = camio_istream_generic_start_read_batch;
+    priv->istream.end_read_batch = camio_istream_generic_end_read_batch;
     priv->istream.clock          = clock;
+    priv->istream.meta           = (camio_meta_t){ .flags = CAMIO_META_SEQ };
     priv->istream.selector.fd    = -1;
     priv->istream.selector.ready = camio_istream_log_selector_ready;
 
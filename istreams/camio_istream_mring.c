@@ -0,0 +1,316 @@
+/*
+ * Copyright  (C) Matthew P. Grosvenor, 2012, All Rights Reserved
+ *
+ * Camio multi-producer, multi-consumer shared memory ring input stream
+ *
+ */
+#include <errno.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <string.h>
+#include <memory.h>
+
+#include "camio_istream_mring.h"
+#include "../errors/camio_errors.h"
+#include "../utils/camio_util.h"
+#include "../stream_description/camio_opt_parser.h"
+#include "../utils/camio_mring.h"
+
+
+
+//Try to claim up to count ready slots, starting at pos. Returns the number claimed, or 0 if pos is not ready or another
+//reader claimed it first.
+static inline uint64_t claim_from(camio_istream_mring_t* priv, uint64_t pos, uint64_t count){
+    uint64_t ready = 0;
+    for(; ready < count; ready++){
+        if(mring_slot(pos + ready)->seq != pos + ready + 1){
+            break;
+        }
+    }
+
+    if(ready && __sync_bool_compare_and_swap(&mring_header->tail, pos, pos + ready)){
+        asm volatile("" ::: "memory"); //Make sure the compiler does not hoist slot reads above the claim
+        return ready;
+    }
+
+    return 0;
+}
+
+
+//Try to claim up to count ready slots at the tail of the mring. Returns the number claimed, or 0 if the mring is empty.
+static inline uint64_t try_claim(camio_istream_mring_t* priv, uint64_t count){
+    count = MIN(count, priv->slot_count);
+
+    while(1){
+        const uint64_t pos = mring_header->tail;
+        const uint64_t claimed = claim_from(priv, pos, count);
+        if(likely(claimed)){
+            priv->read_pos = pos;
+            priv->claimed  = claimed;
+            return claimed;
+        }
+
+        //A sequence number behind pos + 1 means the writer has not published the slot yet, the mring is empty.
+        //Otherwise another reader got there first and tail has moved on.
+        if((int64_t)(mring_slot(pos)->seq - (pos + 1)) < 0){
+            return 0;
+        }
+    }
+
+    return 0;
+}
+
+
+//Hand the first count claimed slots back to the writers
+static inline void release(camio_istream_mring_t* priv, uint64_t count){
+    asm volatile("" ::: "memory"); //Make sure the compiler does not sink slot reads below the release
+
+    uint64_t i = 0;
+    for(; i < count; i++){
+        mring_slot(priv->read_pos + i)->seq = priv->read_pos + i + priv->slot_count;
+    }
+
+    priv->read_pos += count;
+    priv->claimed  -= count;
+}
+
+
+//Hand back any slots at the front of our claim that a departed writer left empty
+static inline void skip_abandoned(camio_istream_mring_t* priv){
+    while(priv->claimed && unlikely(mring_slot(priv->read_pos)->len & CAMIO_MRING_LEN_SKIP)){
+        release(priv, 1);
+    }
+}
+
+
+static int prepare_next(camio_istream_mring_t* priv, uint64_t count){
+
+    //Simple case, there's already data waiting
+    if(unlikely(priv->claimed)){
+        camio_perf_event_start(priv->perf_mon,CAMIO_PERF_EVENT_ISTREAM_MRING,CAMIO_PERF_COND_EXISTING_DATA);
+        return priv->claimed;
+    }
+
+    //Is there new data?
+    if(likely(try_claim(priv, count))){
+        skip_abandoned(priv);
+        if(unlikely(!priv->claimed)){
+            return 0;
+        }
+        camio_perf_event_start(priv->perf_mon,CAMIO_PERF_EVENT_ISTREAM_MRING,CAMIO_PERF_COND_NEW_DATA);
+        return priv->claimed;
+    }
+
+    return 0;
+}
+
+
+//Other readers may be competing for the same data, so a ready slot is claimed here and kept for the next read.
+static int camio_istream_mring_ready(camio_istream_t* this){
+    camio_istream_mring_t* priv = this->priv;
+    if(priv->claimed || priv->is_closed){
+        return 1;
+    }
+
+    return prepare_next(priv, 1);
+}
+
+static int camio_istream_mring_start_read(camio_istream_t* this, uint8_t** out){
+    camio_istream_mring_t* priv = this->priv;
+    *out = NULL;
+
+    if(unlikely(priv->is_closed)){
+        return 0;
+    }
+
+    //Called read without calling ready, they must want to block/spin waiting for data
+    while(!prepare_next(priv, 1)){
+        asm("pause"); //Tell the CPU we're spinning
+    }
+
+    this->meta.seq = priv->read_pos;
+    *out = mring_slot_data(priv->read_pos);
+    return mring_slot(priv->read_pos)->len;
+}
+
+
+static int camio_istream_mring_end_read(camio_istream_t* this, uint8_t* free_buff){
+    camio_istream_mring_t* priv = this->priv;
+    if(likely(priv->claimed)){
+        release(priv, 1);
+    }
+
+    return 0;
+}
+
+
+//Everything claimed is ours alone to read, in order
+static int camio_istream_mring_start_read_batch(camio_istream_t* this, camio_batch_item_t* items, size_t max_items){
+    camio_istream_mring_t* priv = this->priv;
+
+    if(unlikely(priv->is_closed || !max_items)){
+        return 0;
+    }
+
+    //Called read without calling ready, they must want to block/spin waiting for data
+    while(!prepare_next(priv, max_items)){
+        asm("pause"); //Tell the CPU we're spinning
+    }
+
+    //If ready() claimed a single slot for us, try to grow the claim while nobody else has moved the tail
+    if(priv->claimed < max_items){
+        priv->claimed += claim_from(priv, priv->read_pos + priv->claimed, max_items - priv->claimed);
+    }
+
+    //Slots left by a departed writer may be anywhere in a grown claim. They are left out here, and released along with
+    //everything else in end_read_batch.
+    const size_t claimed = MIN(max_items, priv->claimed);
+    size_t count = 0;
+    size_t i = 0;
+    for(; i < claimed; i++){
+        const uint64_t len = mring_slot(priv->read_pos + i)->len;
+        if(unlikely(len & CAMIO_MRING_LEN_SKIP)){
+            continue;
+        }
+        items[count].buffer = mring_slot_data(priv->read_pos + i);
+        items[count].len    = len;
+        items[count].meta   = (camio_meta_t){ .seq = priv->read_pos + i, .flags = CAMIO_META_SEQ };
+        count++;
+    }
+
+    return count;
+}
+
+
+static int camio_istream_mring_end_read_batch(camio_istream_t* this){
+    camio_istream_mring_t* priv = this->priv;
+    release(priv, priv->claimed);
+    return 0;
+}
+
+
+static int camio_istream_mring_selector_ready(camio_selectable_t* stream){
+    camio_istream_t* this = container_of(stream, camio_istream_t,selector);
+    return this->ready(this);
+}
+
+
+static int camio_istream_mring_open(camio_istream_t* this, const camio_descr_t* descr, camio_perf_t* perf_mon ){
+    camio_istream_mring_t* priv = this->priv;
+
+    if(unlikely(perf_mon == NULL)){
+        eprintf_exit("No performance monitor supplied\n");
+    }
+    priv->perf_mon = perf_mon;
+
+    //Zero means use the geometry of an existing mring, or the default if we are the first
+    if(priv->params){
+        priv->slot_size  = priv->params->slot_size;
+        priv->slot_count = priv->params->slot_count;
+    }
+
+    if(unlikely(camio_descr_has_opts(descr->opt_head))){
+        struct camio_opt_t* opt;
+        for(opt = descr->opt_head; opt; opt = opt->next){
+            if(strcmp(opt->name,"slots") == 0){
+                camio_descr_get_opt_uint(opt, &priv->slot_count);
+            }
+            else if(strcmp(opt->name,"slot_size") == 0){
+                camio_descr_get_opt_uint(opt, &priv->slot_size);
+            }
+            else{
+                eprintf_exit( "Unknown option supplied \"%s\". Valid options for this stream are: \"slots=<uint64>\", \"slot_size=<uint64>\"\n", opt->name);
+            }
+        }
+    }
+
+    if(unlikely(!descr->query)){
+        eprintf_exit( "No filename supplied\n");
+    }
+
+    //Make a local copy of the filename in case the descr pointer goes away (probable)
+    size_t filename_len = strlen(descr->query);
+    priv->filename = malloc(filename_len + 1);
+    memcpy(priv->filename,descr->query, filename_len);
+    priv->filename[filename_len] = '\0'; //Make sure it's null terminated
+
+    priv->mring = camio_mring_attach(priv->filename, &priv->slot_size, &priv->slot_count, &this->selector.fd);
+    priv->is_closed = 0;
+
+    return 0;
+}
+
+
+static void camio_istream_mring_close(camio_istream_t* this){
+    camio_istream_mring_t* priv = this->priv;
+    if(priv->is_closed){
+        return;
+    }
+
+    //Anything claimed but not read is lost, but the writers must get the slots back
+    release(priv, priv->claimed);
+
+    camio_mring_detach(priv->mring, priv->filename, this->selector.fd);
+    free(priv->filename);
+    priv->is_closed = 1;
+}
+
+static void camio_istream_mring_delete(camio_istream_t* this){
+    this->close(this);
+    camio_istream_mring_t* priv = this->priv;
+    free(priv);
+}
+
+
+
+
+/* ****************************************************
+ * Construction
+ */
+
+static camio_istream_t* camio_istream_mring_construct(camio_istream_mring_t* priv, const camio_descr_t* descr, camio_clock_t* clock, camio_istream_mring_params_t* params, camio_perf_t* perf_mon ){
+    if(!priv){
+        eprintf_exit("mring stream supplied is null\n");
+    }
+
+    //Initialize the local variables
+    priv->is_closed         = 1;
+    priv->filename          = NULL;
+    priv->mring             = NULL;
+    priv->read_pos          = 0;
+    priv->claimed           = 0;
+    priv->slot_count        = 0;
+    priv->slot_size         = 0;
+    priv->params            = params;
+
+
+    //Populate the function members
+    priv->istream.priv           = priv; //Lets us access private members
+    priv->istream.open           = camio_istream_mring_open;
+    priv->istream.close          = camio_istream_mring_close;
+    priv->istream.start_read     = camio_istream_mring_start_read;
+    priv->istream.end_read       = camio_istream_mring_end_read;
+    priv->istream.ready          = camio_istream_mring_ready;
+    priv->istream.delete         = camio_istream_mring_delete;
+    priv->istream.start_read_batch = camio_istream_mring_start_read_batch;
+    priv->istream.end_read_batch = camio_istream_mring_end_read_batch;
+    priv->istream.clock          = clock;
+    priv->istream.meta           = (camio_meta_t){ .flags = CAMIO_META_SEQ }; //Shared by many readers, so seq has gaps
+    priv->istream.selector.fd    = -1;
+    priv->istream.selector.ready = camio_istream_mring_selector_ready;
+
+    //Call open, because its the obvious thing to do now...
+    priv->istream.open(&priv->istream, descr, perf_mon);
+
+    //Return the generic istream interface for the outside world to use
+    return &priv->istream;
+
+}
+
+camio_istream_t* camio_istream_mring_new( const camio_descr_t* descr, camio_clock_t* clock, camio_istream_mring_params_t* params, camio_perf_t* perf_mon ){
+    camio_istream_mring_t* priv = malloc(sizeof(camio_istream_mring_t));
+    if(!priv){
+        eprintf_exit("No memory available for mring istream creation\n");
+    }
+    return camio_istream_mring_construct(priv, descr, clock, params, perf_mon );
+}
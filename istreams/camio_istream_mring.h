@@ -0,0 +1,47 @@
+/*
+ * camio_istream_mring.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: mgrosvenor
+ */
+
+#ifndef CAMIO_ISTREAM_MRING_H_
+#define CAMIO_ISTREAM_MRING_H_
+
+#include "camio_istream.h"
+
+/********************************************************************
+ *                  PRIVATE DEFS
+ ********************************************************************/
+
+
+typedef struct {
+    uint64_t slot_size;
+    uint64_t slot_count;
+} camio_istream_mring_params_t;
+
+typedef struct {
+    camio_istream_t istream;
+    char* filename;                      //Keep the file name so the last one out can delete it
+    int is_closed;                       //Has close be called?
+    volatile uint8_t* mring;             //Pointer to the first slot of the mring
+    uint64_t read_pos;                   //Position of the first slot we have claimed
+    uint64_t claimed;                    //Number of slots claimed from read_pos, but not yet handed back
+    uint64_t slot_size;                  //Size of each slot in the mring
+    uint64_t slot_count;                 //Number of slots in the mring
+    camio_istream_mring_params_t* params;  //Parameters passed in from the outside
+    camio_perf_t* perf_mon;
+
+} camio_istream_mring_t;
+
+
+
+
+/********************************************************************
+ *                  PUBLIC DEFS
+ ********************************************************************/
+
+camio_istream_t* camio_istream_mring_new( const camio_descr_t* opts, camio_clock_t* clock, camio_istream_mring_params_t* params, camio_perf_t* perf_mon );
+
+
+#endif /* CAMIO_ISTREAM_MRING_H_ */
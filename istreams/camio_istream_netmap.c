@@ -172,6 +172,11 @@ static int camio_istream_netmap_open(camio_istream_t* this, const camio_descr_t*
     struct netmap_ring *rxring = NETMAP_RXRING(priv->nifp, priv->begin);
     priv->packet_buff_bottom = ((uint8_t *)(rxring) + (rxring)->buf_ofs);
 
+    priv->batch_taken = calloc(priv->end, sizeof(size_t));
+    if(!priv->batch_taken){
+        eprintf_exit( "Could not allocate batch descriptors\n");
+    }
+
     this->selector.fd = netmap_fd;
     priv->is_closed = 0;
     return 0;
@@ -191,6 +196,13 @@ static void camio_istream_netmap_close(camio_istream_t* this){
     //close(this->fd);
 }
 
+//Netmap stamps each ring when it is synchronised, which is as close as we can get to the arrival time for free
+static inline void meta_fill(camio_meta_t* meta, struct netmap_ring* ring, uint64_t seq){
+    meta->ts_ns = ring->ts.tv_sec * 1000 * 1000 * 1000ULL + ring->ts.tv_usec * 1000ULL;
+    meta->seq   = seq;
+    meta->flags = CAMIO_META_TS | CAMIO_META_SEQ;
+}
+
 static int prepare_next(camio_istream_t* this){
     camio_istream_netmap_t* priv = this->priv;
 
@@ -209,6 +221,7 @@ static int prepare_next(camio_istream_t* this){
             priv->packet_size   = ring->slot[ring->cur].len;
             priv->nm_slot       = &ring->slot[ring->cur];
             priv->ring          = ring; //Keep the ring for later
+            meta_fill(&this->meta, ring, priv->seq++);
             //printf("Packet of size %lu is available on ring %lu at slot %u\n", priv->packet_size, i, ring->cur );
             //printf("Data on buffer idx=%u\n", ring->slot[ring->cur].buf_idx);
             camio_perf_event_start(priv->perf_mon,CAMIO_PERF_EVENT_ISTREAM_NETMAP,CAMIO_PERF_COND_NEW_DATA);
@@ -285,6 +298,83 @@ static int camio_istream_netmap_end_read(camio_istream_t* this,uint8_t* free_buf
 }
 
 
+//Take up to max_items packets from the rx rings, without touching cur so that they stay ours
+//until end_read_batch
+static size_t prepare_next_batch(camio_istream_netmap_t* priv, camio_batch_item_t* items, size_t max_items){
+    size_t count = 0;
+    size_t i = 0;
+    for (i = priv->begin; i < priv->end && count < max_items; i++) {
+        struct netmap_ring *ring = NETMAP_RXRING(priv->nifp, i);
+        const size_t taken = MIN(ring->avail, max_items - count);
+        uint32_t slot = ring->cur;
+        size_t j = 0;
+        for(j = 0; j < taken; j++, count++){
+            items[count].buffer = (uint8_t*)NETMAP_BUF(ring, ring->slot[slot].buf_idx);
+            items[count].len    = ring->slot[slot].len;
+            meta_fill(&items[count].meta, ring, priv->seq++);
+            slot = NETMAP_RING_NEXT(ring, slot);
+        }
+
+        ring->avail          -= taken;
+        priv->batch_taken[i]  = taken;
+    }
+
+    if(likely(count)){
+        camio_perf_event_start(priv->perf_mon,CAMIO_PERF_EVENT_ISTREAM_NETMAP,CAMIO_PERF_COND_NEW_DATA);
+    }
+
+    return count;
+}
+
+
+static int camio_istream_netmap_start_read_batch(camio_istream_t* this, camio_batch_item_t* items, size_t max_items){
+    camio_istream_netmap_t* priv = this->priv;
+
+    if(unlikely(priv->is_closed || !max_items)){
+        return 0;
+    }
+
+    //A call to ready may have taken a packet already. It hasn't moved cur, so just give it back
+    //and let the batch pick it up again.
+    if(priv->packet){
+        priv->ring->avail++;
+        priv->seq--;
+        priv->packet        = NULL;
+        priv->packet_size   = 0;
+    }
+
+    size_t count = 0;
+    while(!(count = prepare_next_batch(priv, items, max_items))){
+        //There are no packets, wait for some. Poll synchronises the rings for us.
+        struct pollfd fds[1];
+        fds[0].fd = this->selector.fd;
+        fds[0].events = (POLLIN);
+        if( poll(fds, 1, -1) < 0){
+            eprintf_exit_simple("Poll error!\n");
+        }
+    }
+
+    return count;
+}
+
+
+static int camio_istream_netmap_end_read_batch(camio_istream_t* this){
+    camio_istream_netmap_t* priv = this->priv;
+
+    //Advance the ring pointers now that we're done
+    size_t i = 0;
+    for (i = priv->begin; i < priv->end; i++) {
+        if(priv->batch_taken[i]){
+            struct netmap_ring *ring = NETMAP_RXRING(priv->nifp, i);
+            ring->cur = (ring->cur + priv->batch_taken[i]) % ring->num_slots;
+            priv->batch_taken[i] = 0;
+        }
+    }
+
+    return 0;
+}
+
+
 static int camio_istream_netmap_selector_ready(camio_selectable_t* stream){
     camio_istream_t* this = container_of(stream, camio_istream_t,selector);
     return this->ready(this);
@@ -293,6 +383,7 @@ static int camio_istream_netmap_selector_ready(camio_selectable_t* stream){
 static void camio_istream_netmap_delete(camio_istream_t* this){
     this->close(this);
     camio_istream_netmap_t* priv = this->priv;
+    free(priv->batch_taken);
     free(priv);
 }
 
@@ -319,7 +410,9 @@ static camio_istream_t* camio_istream_netmap_construct(camio_istream_netmap_t* p
     priv->packet_buff_bottom    = NULL;
     priv->nm_slot               = NULL;
     priv->ring                  = NULL;
+    priv->batch_taken           = NULL;
     priv->params                = params;
+    priv->seq                   = 0;
 
 
     //Populate the function members
@@ -330,7 +423,10 @@ static camio_istream_t* camio_istream_netmap_construct(camio_istream_netmap_t* p
     priv->istream.end_read       = camio_istream_netmap_end_read;
     priv->istream.ready          = camio_istream_netmap_ready;
     priv->istream.delete         = camio_istream_netmap_delete;
+    priv->istream.start_read_batch = camio_istream_netmap_start_read_batch;
+    priv->istream.end_read_batch = camio_istream_netmap_end_read_batch;
     priv->istream.clock          = clock;
+    priv->istream.meta           = (camio_meta_t){ .flags = 0 };
     priv->istream.selector.fd    = -1;
     priv->istream.selector.ready = camio_istream_netmap_selector_ready;
 
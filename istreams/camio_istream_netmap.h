@@ -39,6 +39,8 @@ typedef struct {
     void* packet_buff_bottom;
     struct netmap_slot* nm_slot;
     struct netmap_ring *ring;
+    size_t* batch_taken;                    //Slots handed out from each ring by the last start_read_batch
+    uint64_t seq;                           //Number of packets read so far
 
     camio_istream_t istream;
     camio_istream_netmap_params_t* params;  //Parameters passed in from the outside
@@ -56,6 +56,7 @@ static int camio_istream_netmap_eth_start_read(camio_istream_t* this, uint8_t**
 
     uint8_t* buff;
     const uint64_t len = priv->netmap_base->start_read(priv->netmap_base, &buff);
+    this->meta = priv->netmap_base->meta;
     //printf("Read %lu bytes into %p\n", len, buff);
 
     if(len < sizeof(ether_head_t)){
@@ -119,7 +120,10 @@ static camio_istream_t* camio_istream_netmap_eth_construct(camio_istream_netmap_
     priv->istream.end_read       = camio_istream_netmap_eth_end_read;
     priv->istream.ready          = camio_istream_netmap_eth_ready;
     priv->istream.delete         = camio_istream_netmap_eth_delete;
+    priv->istream.start_read_batch = camio_istream_generic_start_read_batch;
+    priv->istream.end_read_batch = camio_istream_generic_end_read_batch;
     priv->istream.clock          = clock;
+    priv->istream.meta           = (camio_meta_t){ .flags = 0 };
     priv->istream.selector.fd    = -1;
     priv->istream.selector.ready = camio_istream_netmap_eth_selector_ready;
 
@@ -55,6 +55,20 @@ int camio_istream_periodic_timeout_open(camio_istream_t* this, const camio_descr
 
 
 
+    //A driven clock (eg. one following capture timestamps) has no timerfd, so the ticks are worked out from the clock
+    //whenever we're polled. Ticks are as far apart in the clock's time as they would have been in real time.
+    if(this->clock && this->clock->is_driven(this->clock)){
+        priv->is_virtual    = 1;
+        priv->period        = seconds * 1000 * 1000 * 1000ULL + nanoseconds;
+        if(!priv->period){
+            eprintf_exit( "Timer period must be at least 1ns\n");
+        }
+        priv->ns_aim        = 0;
+        this->selector.fd   = -1;
+        priv->is_closed     = 0;
+        return 0;
+    }
+
     //Set the time spec
     struct itimerspec new = { .it_value = { seconds , nanoseconds }, .it_interval = { seconds , nanoseconds } };
 
@@ -76,6 +90,10 @@ int camio_istream_periodic_timeout_open(camio_istream_t* this, const camio_descr
 
 void camio_istream_periodic_timeout_close(camio_istream_t* this){
     camio_istream_periodic_timeout_t* priv = this->priv;
+    if(priv->is_virtual){
+        priv->is_closed = 1;
+        return;
+    }
 
     //Stop the timer
     struct itimerspec new = { .it_value = {0,0}, .it_interval = {0 , 0 } };
@@ -107,7 +125,39 @@ static void set_fd_blocking(int fd, int blocking){
 }
 
 
+//Each tick that the clock has passed is delivered on its own, with one expiry, as a reader that kept up with a timerfd
+//would have seen it. The clock only moves when its driver is read, so there's never anything to block on.
+static int prepare_next_virtual(camio_istream_periodic_timeout_t* priv){
+    const int64_t now = priv->istream.clock->get(priv->istream.clock)->counter;
+    if(unlikely(!priv->ns_aim)){
+        if(now <= 0){
+            return 0; //The clock hasn't been set yet
+        }
+        priv->ns_aim = now + priv->period;
+        return 0;
+    }
+
+    if(likely((uint64_t)now < priv->ns_aim)){
+        return 0;
+    }
+
+    priv->istream.meta.ts_ns = priv->ns_aim;
+    priv->istream.meta.seq   = ++priv->ticks;
+    priv->istream.meta.flags = CAMIO_META_TS | CAMIO_META_SEQ;
+
+    priv->ns_aim   += priv->period;
+    priv->expiries  = 1;
+    priv->read_size = sizeof(priv->expiries);
+    camio_perf_event_start(priv->perf_mon,CAMIO_PERF_EVENT_ISTREAM_PERIODIC,CAMIO_PERF_COND_NEW_DATA);
+    return priv->read_size;
+}
+
+
 static int prepare_next(camio_istream_periodic_timeout_t* priv, int blocking){
+    if(priv->is_virtual){
+        return prepare_next_virtual(priv);
+    }
+
     //Set the file blocking mode as requested
     if(blocking != priv->blocking){
         set_fd_blocking(priv->istream.selector.fd,blocking);
@@ -130,6 +180,9 @@ static int prepare_next(camio_istream_periodic_timeout_t* priv, int blocking){
 
     //Woot
     priv->read_size = bytes;
+    priv->ticks    += priv->expiries;
+    priv->istream.meta.seq   = priv->ticks;
+    priv->istream.meta.flags = CAMIO_META_SEQ | (priv->expiries > 1 ? CAMIO_META_OVERRUN : 0);
     camio_perf_event_start(priv->perf_mon,CAMIO_PERF_EVENT_ISTREAM_PERIODIC,CAMIO_PERF_COND_NEW_DATA);
     return bytes;
 }
@@ -151,9 +204,13 @@ int camio_istream_periodic_timeout_start_read(camio_istream_t* this, uint8_t** o
         return 0;
     }
 
-    //Called read without calling ready, they must want to block
+    //Called read without calling ready, they must want to block. A driven clock won't move while we wait on it though,
+    //and returning 0 would say the stream is closed, so when virtual, reads have to be prompted by ready().
     if(!priv->read_size){
         if(!prepare_next(priv,CAMIO_ISTREAM_PERIODIC_TIMEOUT_BLOCKING)){
+            if(priv->is_virtual){
+                eprintf_exit("Blocking read on a virtual periodic timeout with no tick due. Use ready() or a selector\n");
+            }
             return 0;
         }
     }
@@ -196,6 +253,10 @@ camio_istream_t* camio_istream_periodic_timeout_construct(camio_istream_periodic
     priv->expiries          = 0;
     priv->blocking          = 1;
     priv->params            = params;
+    priv->is_virtual        = 0;
+    priv->period            = 0;
+    priv->ns_aim            = 0;
+    priv->ticks             = 0;
 
     //Populate the function members
     priv->istream.priv           = priv; //Lets us access private members
@@ -205,7 +266,10 @@ camio_istream_t* camio_istream_periodic_timeout_construct(camio_istream_periodic
     priv->istream.end_read       = camio_istream_periodic_timeout_end_read;
     priv->istream.ready          = camio_istream_periodic_timeout_ready;
     priv->istream.delete         = camio_istream_periodic_timeout_delete;
+    priv->istream.start_read_batch = camio_istream_generic_start_read_batch;
+    priv->istream.end_read_batch = camio_istream_generic_end_read_batch;
     priv->istream.clock          = clock;
+    priv->istream.meta           = (camio_meta_t){ .flags = 0 };
     priv->istream.selector.fd    = -1;
     priv->istream.selector.ready = camio_istream_periodic_timeout_selector_ready;
 
@@ -30,6 +30,10 @@ typedef struct {
     camio_istream_periodic_timeout_params_t* params;  //Parameters passed in from the outside
     int blocking;
     camio_perf_t* perf_mon;
+    int is_virtual;                     //Running off a driven clock rather than a timerfd. Selector driven only
+    uint64_t period;                    //In ns, when virtual
+    uint64_t ns_aim;                    //Next deadline on the clock, when virtual. 0 until the clock has a time
+    uint64_t ticks;                     //Expiries so far
 } camio_istream_periodic_timeout_t;
 
 
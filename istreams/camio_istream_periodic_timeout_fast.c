@@ -13,6 +13,7 @@
 #include <sys/timerfd.h>
 #include <time.h>
 #include <sys/time.h>
+#include <string.h>
 
 
 #include "camio_istream_periodic_timeout_fast.h"
@@ -32,6 +33,18 @@ static inline uint64_t timespec_to_ns(struct timespec* ts){
 //}
 
 
+//Calibrating takes a few ms, so only do it once however many streams there are
+static camio_tsc_t* shared_tsc(void){
+    static camio_tsc_t tsc;
+    static int calibrated = 0;
+    if(!calibrated){
+        camio_tsc_calibrate(&tsc, CLOCK_MONOTONIC);
+        calibrated = 1;
+    }
+    return &tsc;
+}
+
+
 int camio_istream_periodic_timeout_fast_open(camio_istream_t* this, const camio_descr_t* descr, camio_perf_t* perf_mon ){
     camio_istream_periodic_timeout_fast_t* priv = this->priv;
 
@@ -41,8 +54,38 @@ int camio_istream_periodic_timeout_fast_open(camio_istream_t* this, const camio_
     priv->perf_mon = perf_mon;
 
 
+    if(priv->params){
+        priv->clock_type = priv->params->clock_type;
+        priv->mode       = priv->params->mode;
+    }
+    else{
+        priv->clock_type = CLOCK_MONOTONIC_COARSE;
+        priv->mode       = CAMIO_ISTREAM_PERIODIC_FAST_CLOCK;
+    }
+
     if(unlikely(camio_descr_has_opts(descr->opt_head))){
-        eprintf_exit( "Option(s) supplied, but none expected\n");
+        struct camio_opt_t* opt;
+        for(opt = descr->opt_head; opt; opt = opt->next){
+            if(strcmp(opt->name,"mode") == 0){
+                char* mode = NULL;
+                camio_descr_get_opt_string(opt, &mode);
+                if(strcmp(mode,"clock") == 0){
+                    priv->mode = CAMIO_ISTREAM_PERIODIC_FAST_CLOCK;
+                }
+                else if(strcmp(mode,"tsc") == 0){
+                    priv->mode = CAMIO_ISTREAM_PERIODIC_FAST_TSC;
+                }
+                else if(strcmp(mode,"virtual") == 0){
+                    priv->mode = CAMIO_ISTREAM_PERIODIC_FAST_VIRTUAL;
+                }
+                else{
+                    eprintf_exit( "Unknown mode \"%s\", expected \"clock\", \"tsc\" or \"virtual\"\n", mode);
+                }
+            }
+            else{
+                eprintf_exit( "Unknown option supplied \"%s\". Valid options for this stream are: \"mode=clock|tsc|virtual\"\n", opt->name);
+            }
+        }
     }
 
     //Parse the time spec
@@ -50,13 +93,6 @@ int camio_istream_periodic_timeout_fast_open(camio_istream_t* this, const camio_
         eprintf_exit( "No timer specification supplied expected nanoseconds format\n");
     }
 
-    if(priv->params){
-        priv->clock_type = priv->params->clock_type;
-    }
-    else{
-        priv->clock_type = CLOCK_MONOTONIC_COARSE;
-    }
-
     uint64_t temp = 0;
     size_t i = 0;
     for(; descr->query[i] != '\0'; i++){
@@ -65,10 +101,47 @@ int camio_istream_periodic_timeout_fast_open(camio_istream_t* this, const camio_
     }
     priv->period = temp;
 
+    //A driven clock always wins, there's no point following real time when the clock is being replayed
+    const int is_driven = this->clock && this->clock->is_driven(this->clock);
+    if(is_driven){
+        priv->mode = CAMIO_ISTREAM_PERIODIC_FAST_VIRTUAL;
+    }
+    else if(priv->mode == CAMIO_ISTREAM_PERIODIC_FAST_VIRTUAL){
+        eprintf_exit( "Virtual mode needs a driven clock (eg. \"tistream\")\n");
+    }
+
+    //Ticks in virtual time are anchored on the first time the clock is seen to have
+    if(priv->mode == CAMIO_ISTREAM_PERIODIC_FAST_VIRTUAL){
+        if(!priv->period){
+            eprintf_exit( "Timer period must be at least 1ns\n");
+        }
+        priv->ns_aim     = 0;
+        priv->tsc_aim    = 0;
+        priv->tick       = 1;
+        priv->missed     = 0;
+        priv->ts_flags   = CAMIO_META_TS; //Whatever the driver's times are in, usually capture times since 1970
+        this->selector.fd = -1;
+        priv->is_closed  = 0;
+        return 0;
+    }
+
+    //The TSC is measured against CLOCK_MONOTONIC, so that's the clock that its times are in
+    if(priv->mode == CAMIO_ISTREAM_PERIODIC_FAST_TSC){
+        priv->tsc        = *shared_tsc();
+        priv->clock_type = CLOCK_MONOTONIC;
+    }
+
     struct timespec ts_now;
     clock_gettime(priv->clock_type,&ts_now);
     const uint64_t ns_now = timespec_to_ns(&ts_now);
-    priv->ns_aim = ns_now + priv->period;
+    priv->ns_aim  = ns_now + priv->period;
+    priv->tsc_aim = priv->mode == CAMIO_ISTREAM_PERIODIC_FAST_TSC ? camio_tsc_from_ns(&priv->tsc, priv->ns_aim) : 0;
+    priv->tick    = 1;
+    priv->missed  = 0;
+
+    //Monotonic clocks are cheaper to read, but their times aren't comparable with packet timestamps
+    const int is_realtime = priv->clock_type == CLOCK_REALTIME || priv->clock_type == CLOCK_REALTIME_COARSE;
+    priv->ts_flags = CAMIO_META_TS | (is_realtime ? 0 : CAMIO_META_TS_MONO);
 
 
 
@@ -87,25 +160,89 @@ void camio_istream_periodic_timeout_fast_close(camio_istream_t* this){
 
 
 
+//A tick has been seen at ns_now. Work out which one it is, and aim for the one after it.
+static inline void fire(camio_istream_periodic_timeout_fast_t* priv, uint64_t ns_now){
+    //The TSC may round either side of the deadline
+    const uint64_t late   = ns_now > priv->ns_aim ? ns_now - priv->ns_aim : 0;
+    const uint64_t missed = priv->period ? late / priv->period : 0;
+
+    priv->result.ns      = ns_now;
+    priv->result.tick    = priv->tick + missed;
+    priv->result.missed  = missed;
+    priv->result.late_ns = late - missed * priv->period;
+
+    priv->istream.meta.ts_ns = ns_now;
+    priv->istream.meta.seq   = priv->result.tick;
+    priv->istream.meta.flags = priv->ts_flags | CAMIO_META_SEQ | (missed ? CAMIO_META_OVERRUN : 0);
+
+    priv->tick   += missed + 1;
+    priv->missed += missed;
+    priv->ns_aim += (missed + 1) * priv->period; //Aim from the deadline, not from now, so there's no drift
+
+    if(priv->mode == CAMIO_ISTREAM_PERIODIC_FAST_TSC){
+        priv->tsc_aim = camio_tsc_from_ns(&priv->tsc, priv->ns_aim);
+    }
+
+    priv->is_ready = 1;
+}
+
+
+//The clock only moves when whatever drives it is read, so a jump in the clock can pass many ticks at once. Each one is
+//delivered in turn, on time at its own deadline, exactly as a reader keeping up in real time would have seen them.
+static int prepare_next_virtual(camio_istream_periodic_timeout_fast_t* priv){
+    const int64_t now = priv->istream.clock->get(priv->istream.clock)->counter;
+    if(unlikely(!priv->ns_aim)){
+        if(now > 0){
+            priv->ns_aim = now + priv->period; //The clock hasn't been set until now
+        }
+        return 0;
+    }
+
+    if(likely((uint64_t)now < priv->ns_aim)){
+        return 0;
+    }
+
+    fire(priv, priv->ns_aim);
+    camio_perf_event_start(priv->perf_mon,CAMIO_PERF_EVENT_ISTREAM_PERIODIC_FAST,CAMIO_PERF_COND_NEW_DATA);
+    return 1;
+}
+
+
 static int prepare_next(camio_istream_periodic_timeout_fast_t* priv){
     if(priv->is_ready){
         camio_perf_event_start(priv->perf_mon,CAMIO_PERF_EVENT_ISTREAM_PERIODIC_FAST,CAMIO_PERF_COND_NO_DATA);
         return 1;
     }
 
-    struct timespec ts_now;
-    clock_gettime(priv->clock_type,&ts_now);
-    const uint64_t ns_now = timespec_to_ns(&ts_now);
-    if(unlikely(ns_now >= priv->ns_aim)){
-        //printf("Timer fired\n");
-        priv->ns_aim    = ns_now + priv->period;
-        priv->is_ready  = 1;
-        priv->result    = ns_now;
-        camio_perf_event_start(priv->perf_mon,CAMIO_PERF_EVENT_ISTREAM_PERIODIC_FAST,CAMIO_PERF_COND_NEW_DATA);
-        return 1;
+    if(priv->mode == CAMIO_ISTREAM_PERIODIC_FAST_VIRTUAL){
+        return prepare_next_virtual(priv);
     }
 
-    return 0;
+    uint64_t ns_now = 0;
+    if(priv->mode == CAMIO_ISTREAM_PERIODIC_FAST_TSC){
+        const uint64_t tsc_now = camio_tsc_read();
+        if(likely(tsc_now < priv->tsc_aim)){
+            return 0;
+        }
+
+        if(unlikely(tsc_now >= priv->tsc.tsc_refine)){
+            camio_tsc_refine(&priv->tsc);
+        }
+        ns_now = camio_tsc_to_ns(&priv->tsc, tsc_now);
+    }
+    else{
+        struct timespec ts_now;
+        clock_gettime(priv->clock_type,&ts_now);
+        ns_now = timespec_to_ns(&ts_now);
+        if(likely(ns_now < priv->ns_aim)){
+            return 0;
+        }
+    }
+
+    //printf("Timer fired\n");
+    fire(priv, ns_now);
+    camio_perf_event_start(priv->perf_mon,CAMIO_PERF_EVENT_ISTREAM_PERIODIC_FAST,CAMIO_PERF_COND_NEW_DATA);
+    return 1;
 }
 
 int camio_istream_periodic_timeout_fast_ready(camio_istream_t* this){
@@ -124,8 +261,13 @@ int camio_istream_periodic_timeout_fast_start_read(camio_istream_t* this, uint8_
         return 0;
     }
 
-    //Called read without calling ready, they must want to block
+    //Called read without calling ready, they must want to block. A driven clock won't move while we wait on it though,
+    //and returning 0 would say the stream is closed, so in virtual mode reads have to be prompted by ready().
     if(unlikely(!priv->is_ready)){
+        if(priv->mode == CAMIO_ISTREAM_PERIODIC_FAST_VIRTUAL && !prepare_next(priv)){
+            *out = NULL;
+            eprintf_exit("Blocking read on a virtual periodic timeout with no tick due. Use ready() or a selector\n");
+        }
         while(!prepare_next(priv)){
             //spin waiting for this
         }
@@ -167,6 +309,10 @@ camio_istream_t* camio_istream_periodic_timeout_fast_construct(camio_istream_per
     priv->is_ready          = 0;
     priv->period            = 0;
     priv->ns_aim            = 0;
+    priv->tsc_aim           = 0;
+    priv->tick              = 0;
+    priv->missed            = 0;
+    priv->mode              = CAMIO_ISTREAM_PERIODIC_FAST_CLOCK;
     priv->params            = params;
 
     //Populate the function members
@@ -177,7 +323,10 @@ camio_istream_t* camio_istream_periodic_timeout_fast_construct(camio_istream_per
     priv->istream.end_read       = camio_istream_periodic_timeout_fast_end_read;
     priv->istream.ready          = camio_istream_periodic_timeout_fast_ready;
     priv->istream.delete         = camio_istream_periodic_timeout_fast_delete;
+    priv->istream.start_read_batch = camio_istream_generic_start_read_batch;
+    priv->istream.end_read_batch = camio_istream_generic_end_read_batch;
     priv->istream.clock          = clock;
+    priv->istream.meta           = (camio_meta_t){ .flags = 0 };
     priv->istream.selector.fd    = -1;
     priv->istream.selector.ready = camio_istream_periodic_timeout_fast_selector_ready;
 
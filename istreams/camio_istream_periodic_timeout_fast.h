@@ -9,24 +9,48 @@
 #define CAMIO_ISTREAM_PERIODIC_TIMEOUT_FAST_H_
 
 #include "camio_istream.h"
+#include "../utils/camio_tsc.h"
 
 /********************************************************************
  *                  PRIVATE DEFS
  ********************************************************************/
 
 
+enum {
+    CAMIO_ISTREAM_PERIODIC_FAST_CLOCK = 0,  //Read clock_type on every poll
+    CAMIO_ISTREAM_PERIODIC_FAST_TSC,        //Compare the TSC with a precomputed deadline on every poll
+    CAMIO_ISTREAM_PERIODIC_FAST_VIRTUAL,    //Follow a driven clock (eg. capture timestamps), every tick is delivered.
+                                            //Selector driven only, start_read must follow a ready() that returned 1
+};
+
 typedef struct {
     int clock_type;
+    int mode;
 } camio_istream_periodic_timeout_fast_params_t;
 
+//What a read returns. Ticks are scheduled from the time the stream was opened, not from when the last one was read,
+//so they don't drift. Ticks that go by while nobody is reading are counted, rather than delivered late.
+typedef struct {
+    uint64_t ns;                        //When the tick was seen
+    uint64_t tick;                      //Number of this tick since the stream was opened, counting missed ticks
+    uint64_t missed;                    //Ticks that went by without being read, since the last one that was
+    uint64_t late_ns;                   //How long after its deadline this tick was seen
+} camio_istream_periodic_timeout_fast_result_t;
+
 typedef struct {
     camio_istream_t istream;
     int is_closed;                      //Has close be called?
     uint64_t is_ready;
     uint64_t ns_aim;
+    uint64_t tsc_aim;                   //ns_aim on the TSC, in TSC mode
     uint64_t period;
+    uint64_t tick;                      //Number of the next tick
+    uint64_t missed;                    //Total ticks missed so far
     int clock_type;
-    uint64_t result;
+    int mode;
+    uint16_t ts_flags;                  //Meta flags for ts_ns, which says which clock it is on
+    camio_tsc_t tsc;
+    camio_istream_periodic_timeout_fast_result_t result;
     camio_istream_periodic_timeout_fast_params_t* params;  //Parameters passed in from the outside
     camio_perf_t* perf_mon;
 
@@ -1,3 +1,4 @@
+//#CFLAGS=-D_GNU_SOURCE
 /*
  * Copyright  (C) Matthew P. Grosvenor, 2012, All Rights Reserved
  *
@@ -8,6 +9,7 @@
 #include <stdio.h>
 #include <unistd.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <netinet/in.h>
 #include <sys/ioctl.h>
 #include <net/if.h>
@@ -36,7 +38,17 @@ int camio_istream_raw_open(camio_istream_t* this, const camio_descr_t* descr, ca
     priv->perf_mon = perf_mon;
 
     if(unlikely(camio_descr_has_opts(descr->opt_head))){
-        eprintf_exit( "Option(s) supplied, but none expected\n");
+        struct camio_opt_t* opt;
+        for(opt = descr->opt_head; opt; opt = opt->next){
+            if(strcmp(opt->name,"tstamp") == 0){
+                char* value = NULL;
+                camio_descr_get_opt_string(opt, &value);
+                priv->tstamp = camio_tstamp_parse(value);
+            }
+            else{
+                eprintf_exit( "Unknown option supplied \"%s\". Valid options for this stream are: \"tstamp=sw|hw\"\n", opt->name);
+            }
+        }
     }
 
     if(!descr->query){
@@ -49,6 +61,32 @@ int camio_istream_raw_open(camio_istream_t* this, const camio_descr_t* descr, ca
     }
     priv->buffer_size = getpagesize() * 1024;
 
+    //Carve the buffer up into slots so that batched reads can fetch many frames at once
+    priv->batch_slots = MIN(CAMIO_ISTREAM_RAW_BATCH_MAX, priv->buffer_size / CAMIO_ISTREAM_RAW_BATCH_SLOT);
+    priv->msgs        = calloc(priv->batch_slots, sizeof(struct mmsghdr));
+    priv->iovecs      = calloc(priv->batch_slots, sizeof(struct iovec));
+    priv->controls    = priv->tstamp ? calloc(priv->batch_slots, CAMIO_TSTAMP_CONTROL_SIZE) : NULL;
+    if(!priv->msgs || !priv->iovecs || (priv->tstamp && !priv->controls)){
+        eprintf_exit("Failed to allocate batch descriptors\n");
+    }
+
+    size_t i = 0;
+    for(i = 0; i < priv->batch_slots; i++){
+        priv->iovecs[i].iov_base          = priv->buffer + i * CAMIO_ISTREAM_RAW_BATCH_SLOT;
+        priv->iovecs[i].iov_len           = CAMIO_ISTREAM_RAW_BATCH_SLOT;
+        priv->msgs[i].msg_hdr.msg_iov     = &priv->iovecs[i];
+        priv->msgs[i].msg_hdr.msg_iovlen  = 1;
+        priv->msgs[i].msg_hdr.msg_control = priv->controls ? priv->controls + i * CAMIO_TSTAMP_CONTROL_SIZE : NULL;
+    }
+
+    //Reads one at a time can have the whole buffer, and share the first slot's timestamp space
+    priv->iovec.iov_base    = priv->buffer;
+    priv->iovec.iov_len     = priv->buffer_size;
+    memset(&priv->msg, 0, sizeof(priv->msg));
+    priv->msg.msg_iov       = &priv->iovec;
+    priv->msg.msg_iovlen    = 1;
+    priv->msg.msg_control   = priv->controls;
+
     /* Open the raw socket MAC/PHY layer output stage */
     if ( !(raw_sock_fd = socket(AF_PACKET, SOCK_RAW, htons(ETH_P_ALL))) ){
         eprintf_exit("Could not open raw socket. Error = %s\n",strerror(errno));
@@ -88,6 +126,8 @@ int camio_istream_raw_open(camio_istream_t* this, const camio_descr_t* descr, ca
         eprintf_exit("Could not set socket option. Error = %s\n",strerror(errno));
     }
 
+    camio_tstamp_enable(raw_sock_fd, priv->tstamp, 0, iface);
+
     this->selector.fd = raw_sock_fd;
     priv->is_closed = 0;
     return 0;
@@ -98,6 +138,9 @@ void camio_istream_raw_close(camio_istream_t* this){
     camio_istream_raw_t* priv = this->priv;
     close(this->selector.fd);
     free(priv->buffer);
+    free(priv->msgs);
+    free(priv->iovecs);
+    free(priv->controls);
 }
 
 static void set_fd_blocking(int fd, int blocking){
@@ -119,6 +162,17 @@ static void set_fd_blocking(int fd, int blocking){
     }
 }
 
+//Pick up the kernel's (or the NIC's) timestamp for a frame, and move the clock on to it
+static inline void stamp(camio_istream_raw_t* priv, camio_meta_t* meta, struct msghdr* msg){
+    meta->flags &= ~(CAMIO_META_TS | CAMIO_META_TS_HW);
+    meta->flags |= camio_tstamp_rx(msg, &meta->ts_ns);
+    if(priv->istream.clock && (meta->flags & CAMIO_META_TS)){
+        camio_time_t time = { .counter = meta->ts_ns };
+        priv->istream.clock->set(priv->istream.clock, &time);
+    }
+}
+
+
 static int prepare_next(camio_istream_raw_t* priv, int blocking){
     if(priv->bytes_read){
         camio_perf_event_start(priv->perf_mon,CAMIO_PERF_EVENT_ISTREAM_RAW,CAMIO_PERF_COND_EXISTING_DATA);
@@ -127,13 +181,22 @@ static int prepare_next(camio_istream_raw_t* priv, int blocking){
 
     set_fd_blocking(priv->istream.selector.fd, blocking);
 
-    int bytes = recv(priv->istream.selector.fd,priv->buffer,priv->buffer_size, 0);
+    priv->msg.msg_controllen = priv->controls ? CAMIO_TSTAMP_CONTROL_SIZE : 0;
+    int bytes = recvmsg(priv->istream.selector.fd, &priv->msg, 0);
     if( bytes < 0){
+        if(errno == EAGAIN || errno == EWOULDBLOCK){
+            return 0; //Reading would have blocked, we don't want this
+        }
+
         camio_perf_event_start(priv->perf_mon,CAMIO_PERF_EVENT_ISTREAM_RAW,CAMIO_PERF_COND_READ_ERROR);
         eprintf_exit("Could not receive from socket. Error = %s\n",strerror(errno));
     }
 
     priv->bytes_read = bytes;
+    priv->istream.meta.seq = priv->seq++;
+    if(priv->tstamp){
+        stamp(priv, &priv->istream.meta, &priv->msg);
+    }
     camio_perf_event_start(priv->perf_mon,CAMIO_PERF_EVENT_ISTREAM_RAW,CAMIO_PERF_COND_NEW_DATA);
     return bytes;
 
@@ -177,6 +240,72 @@ int camio_istream_raw_end_read(camio_istream_t* this, uint8_t* free_buff){
 }
 
 
+//Fetch as many frames as are waiting (up to max_items) with a single system call
+static int camio_istream_raw_start_read_batch(camio_istream_t* this, camio_batch_item_t* items, size_t max_items){
+    camio_istream_raw_t* priv = this->priv;
+    size_t count = 0;
+
+    if(unlikely(priv->is_closed || !max_items)){
+        return 0;
+    }
+
+    max_items = MIN(max_items, priv->batch_slots);
+
+    //A call to ready may have left a frame waiting in the first slot
+    if(priv->bytes_read){
+        items[0].buffer  = priv->buffer;
+        items[0].len     = priv->bytes_read;
+        items[0].meta    = priv->istream.meta;
+        priv->bytes_read = 0;
+        count = 1;
+
+        if(count == max_items){
+            return count;
+        }
+
+        set_fd_blocking(priv->istream.selector.fd, 0);
+    }
+    else{
+        //Called read without calling ready, they must want to block until there is at least one
+        set_fd_blocking(priv->istream.selector.fd, 1);
+    }
+
+    //The kernel shrinks the control space to what it used, so give it all back
+    size_t i = count;
+    for(; priv->controls && i < max_items; i++){
+        priv->msgs[i].msg_hdr.msg_controllen = CAMIO_TSTAMP_CONTROL_SIZE;
+    }
+
+    const int msgs = recvmmsg(priv->istream.selector.fd, priv->msgs + count, max_items - count, MSG_WAITFORONE, NULL);
+    if(msgs < 0){
+        if(errno == EAGAIN || errno == EWOULDBLOCK){
+            return count; //Reading more would have blocked, we don't want this
+        }
+
+        camio_perf_event_start(priv->perf_mon,CAMIO_PERF_EVENT_ISTREAM_RAW,CAMIO_PERF_COND_READ_ERROR);
+        eprintf_exit("Could not receive from socket. Error = %s\n",strerror(errno));
+    }
+
+    int j = 0;
+    for(j = 0; j < msgs; j++, count++){
+        items[count].buffer = priv->iovecs[count].iov_base;
+        items[count].len    = priv->msgs[count].msg_len;
+        items[count].meta   = (camio_meta_t){ .seq = priv->seq++, .flags = CAMIO_META_SEQ };
+        if(priv->tstamp){
+            stamp(priv, &items[count].meta, &priv->msgs[count].msg_hdr);
+        }
+    }
+
+    camio_perf_event_start(priv->perf_mon,CAMIO_PERF_EVENT_ISTREAM_RAW,CAMIO_PERF_COND_NEW_DATA);
+    return count;
+}
+
+
+static int camio_istream_raw_end_read_batch(camio_istream_t* this){
+    return 0; //Always true for socket I/O
+}
+
+
 int camio_istream_raw_selector_ready(camio_selectable_t* stream){
     camio_istream_t* this = container_of(stream, camio_istream_t,selector);
     return this->ready(this);
@@ -201,6 +330,12 @@ camio_istream_t* camio_istream_raw_construct(camio_istream_raw_t* priv, const ca
     priv->buffer            = NULL;
     priv->buffer_size       = 0;
     priv->bytes_read        = 0;
+    priv->msgs              = NULL;
+    priv->iovecs            = NULL;
+    priv->batch_slots       = 0;
+    priv->seq               = 0;
+    priv->controls          = NULL;
+    priv->tstamp            = CAMIO_TSTAMP_NONE;
     priv->params            = params;
 
 
@@ -212,7 +347,10 @@ camio_istream_t* camio_istream_raw_construct(camio_istream_raw_t* priv, const ca
     priv->istream.end_read       = camio_istream_raw_end_read;
     priv->istream.ready          = camio_istream_raw_ready;
     priv->istream.delete         = camio_istream_raw_delete;
+    priv->istream.start_read_batch = camio_istream_raw_start_read_batch;
+    priv->istream.end_read_batch = camio_istream_raw_end_read_batch;
     priv->istream.clock          = clock;
+    priv->istream.meta           = (camio_meta_t){ .flags = CAMIO_META_SEQ };
     priv->istream.selector.fd    = -1;
     priv->istream.selector.ready = camio_istream_raw_selector_ready;
 
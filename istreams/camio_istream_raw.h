@@ -8,12 +8,18 @@
 #ifndef CAMIO_ISTREAM_RAW_H_
 #define CAMIO_ISTREAM_RAW_H_
 
+#include <sys/socket.h>
+
 #include "camio_istream.h"
+#include "../utils/camio_tstamp.h"
 
 /********************************************************************
  *                  PRIVATE DEFS
  ********************************************************************/
 
+#define CAMIO_ISTREAM_RAW_BATCH_MAX  64            //Most frames fetched by a single call to recvmmsg
+#define CAMIO_ISTREAM_RAW_BATCH_SLOT (64 * 1024)   //Space for the largest possible (offloaded) frame
+
 typedef struct {
     //No params at this stage
 } camio_istream_raw_params_t;
@@ -24,6 +30,14 @@ typedef struct {
     size_t buffer_size;
     size_t bytes_read;
     int is_closed;                      //Has close be called?
+    uint64_t seq;                       //Number of frames read so far
+    int tstamp;                         //Kernel or NIC timestamps, one of CAMIO_TSTAMP_*
+    struct msghdr msg;                  //Message header for reads one at a time
+    struct iovec iovec;                 //The whole buffer, for reads one at a time
+    uint8_t* controls;                  //Space for timestamps, one for each batch slot, when tstamp is on
+    struct mmsghdr* msgs;               //Message headers for batched reads
+    struct iovec* iovecs;               //One slot in the buffer for each batched frame
+    size_t batch_slots;                 //Number of batch slots that fit in the buffer
     camio_istream_raw_params_t* params;  //Parameters passed in from the outside
     camio_perf_t* perf_mon;
 
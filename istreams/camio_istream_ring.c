@@ -10,6 +10,7 @@
 #include <string.h>
 #include <fcntl.h>
 #include <sys/mman.h>
+#include <sys/stat.h>
 #include <memory.h>
 
 #include "camio_istream_ring.h"
@@ -29,16 +30,78 @@ int camio_istream_ring_open(camio_istream_t* this, const camio_descr_t* descr, c
     }
     priv->perf_mon = perf_mon;
 
+    //The geometry is set by the ostream. Accept the same options so that both ends can share a description,
+    //but they are only used as a sanity check.
+    uint64_t slot_size  = 0;
+    uint64_t slot_count = 0;
     if(unlikely(camio_descr_has_opts(descr->opt_head))){
-        eprintf_exit( "Option(s) supplied, but none expected\n");
+        struct camio_opt_t* opt;
+        for(opt = descr->opt_head; opt; opt = opt->next){
+            if(strcmp(opt->name,"slots") == 0){
+                camio_descr_get_opt_uint(opt, &slot_count);
+            }
+            else if(strcmp(opt->name,"slot_size") == 0){
+                camio_descr_get_opt_uint(opt, &slot_size);
+            }
+            else if(strcmp(opt->name,"wait") == 0){
+                char* mode = NULL;
+                camio_descr_get_opt_string(opt, &mode);
+                priv->wait_mode = camio_wait_mode(mode);
+            }
+            else if(strcmp(opt->name,"spin") == 0){
+                camio_descr_get_opt_uint(opt, &priv->spin_count);
+            }
+            else if(strcmp(opt->name,"doorbell") == 0){
+                char* doorbell_name = NULL;
+                camio_descr_get_opt_string(opt, &doorbell_name);
+                priv->doorbell_name = strdup(doorbell_name); //The descr is likely to go away
+            }
+            else{
+                eprintf_exit( "Unknown option supplied \"%s\". Valid options for this stream are: \"slots=<uint64>\", \"slot_size=<uint64>\", \"wait=spin|futex|fd\", \"spin=<uint64>\", \"doorbell=<file>\"\n", opt->name);
+            }
+        }
     }
 
     if(unlikely(!descr->query)){
         eprintf_exit( "No filename supplied\n");
     }
 
-    //Wait until there is a ring file to open.
+    //Make a local copy of the filename, the wake fifo is named after it
+    size_t filename_len = strlen(descr->query);
+    priv->filename = malloc(filename_len + 1);
+    memcpy(priv->filename,descr->query, filename_len);
+    priv->filename[filename_len] = '\0'; //Make sure it's null terminated
+
+    //Wait until there is a ring file to open, and it is big enough to hold the header.
+    struct stat ring_stat;
     while( (ring_fd = open(descr->query, O_RDWR)) < 0 ){ usleep(100 * 1000); }
+    while( fstat(ring_fd, &ring_stat) == 0 && ring_stat.st_size < CAMIO_RING_HEADER_SIZE ){ usleep(100 * 1000); }
+
+    //Map just the header to begin with, the ring geometry tells us how much more there is
+    volatile camio_ring_header_t* header = mmap( NULL, CAMIO_RING_HEADER_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, ring_fd, 0);
+    if(unlikely(header == MAP_FAILED)){
+        eprintf_exit( "Could not memory map ring file \"%s\". Error=%s\n", descr->query, strerror(errno));
+    }
+
+    //Wait until the ostream is all initialized before reading the geometry
+    if(unlikely(!header->ostream_created) ){
+        while(!header->ostream_created){
+            asm("PAUSE");
+        }
+    }
+
+    if(unlikely(header->magic != CAMIO_RING_MAGIC || header->version != CAMIO_RING_VERSION)){
+        eprintf_exit( "File \"%s\" is not a version %lu ring\n", descr->query, (uint64_t)CAMIO_RING_VERSION);
+    }
+
+    priv->slot_size  = header->slot_size;
+    priv->slot_count = header->slot_count;
+    munmap((void*)header, CAMIO_RING_HEADER_SIZE);
+
+    if( (slot_size && slot_size != priv->slot_size) || (slot_count && slot_count != priv->slot_count) ){
+        wprintf("Ring geometry requested (%lu x %lu) does not match the writer's (%lu x %lu). Using the writer's.\n",
+                slot_count, slot_size, priv->slot_count, priv->slot_size);
+    }
 
     ring = mmap( NULL, CAMIO_RING_MEM_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, ring_fd, 0);
     if(unlikely(ring == MAP_FAILED)){
@@ -51,21 +114,31 @@ int camio_istream_ring_open(camio_istream_t* this, const camio_descr_t* descr, c
         wprintf("Could not remove ring file \"%s\". Error = \"%s\"", descr->query, strerror(errno));
     }
 
-    priv->ring_size = CAMIO_RING_SLOT_COUNT * CAMIO_RING_SLOT_SIZE;
+    priv->ring_size = CAMIO_RING_MEM_SIZE;
+    priv->ring_fd = ring_fd;
     this->selector.fd = ring_fd;
-    priv->ring = ring;
-    priv->curr = ring;
+    priv->ring = ring + CAMIO_RING_HEADER_SIZE;
+    priv->curr = priv->ring;
     priv->is_closed = 0;
 
-    //Wait until the ostream is all initialized before committing anything to the ring
-    if(unlikely(!ring_ostream_created) ){
-        //printf("Waiting for ostream to finish setting up...\n");
+    //In fd mode, the selector waits on the wake fifo instead of the ring file, which is always readable
+    if(priv->wait_mode == CAMIO_WAIT_FD){
+        this->selector.fd = camio_wait_fd_open(priv->filename);
+        camio_wait_fd_ring(this->selector.fd); //Start out readable, so the first select looks at the ring and arms the fifo
+    }
 
-        while(!ring_ostream_created){
-            asm("PAUSE");
-        }
+    //Claim a bit in the doorbell, and tell the ostream where it is
+    if(priv->doorbell_name){
+        priv->doorbell     = camio_doorbell_attach(priv->doorbell_name);
+        priv->doorbell_bit = camio_doorbell_claim(priv->doorbell, priv->doorbell_name);
+        strcpy((char*)ring_doorbell->name, priv->doorbell_name);
+        ring_doorbell->bit = priv->doorbell_bit + 1;
+        camio_doorbell_register(&this->selector, priv->doorbell_name, priv->doorbell_bit);
     }
 
+    //The ostream must know how we wait before it can see us
+    ring_istream_wait = priv->wait_mode;
+    __sync_synchronize();
     ring_istream_connected = 1;
     //printf("CAMIO_RING: Set Ring TO CONNECTED\n");
 
@@ -75,8 +148,24 @@ int camio_istream_ring_open(camio_istream_t* this, const camio_descr_t* descr, c
 
 void camio_istream_ring_close(camio_istream_t* this){
     camio_istream_ring_t* priv = this->priv;
-    munmap((void*)priv->ring, priv->ring_size);
-    close(this->selector.fd);
+    if(priv->doorbell){
+        //Stop the ostream ringing our bit before we give it up, it may go to another stream
+        ring_doorbell->bit = 0;
+        __sync_synchronize();
+        camio_doorbell_unregister(&this->selector);
+        camio_doorbell_release(priv->doorbell, priv->doorbell_bit);
+        camio_doorbell_detach(priv->doorbell, priv->doorbell_name);
+        priv->doorbell = NULL;
+    }
+    free(priv->doorbell_name);
+    priv->doorbell_name = NULL;
+
+    munmap((void*)ring_header, priv->ring_size);
+    close(priv->ring_fd);
+    if(priv->wait_mode == CAMIO_WAIT_FD){
+        camio_wait_fd_close(priv->filename, this->selector.fd);
+    }
+    free(priv->filename);
     priv->is_closed = 1;
 }
 
@@ -92,13 +181,15 @@ static int prepare_next(camio_istream_ring_t* priv){
     }
 
     //Is there new data?
-    register uint64_t curr_sync_count = *((volatile uint64_t*)(priv->curr + CAMIO_RING_SLOT_SIZE - sizeof(uint64_t)));
+    register uint64_t curr_sync_count = *((volatile uint64_t*)(priv->curr + priv->slot_size - sizeof(uint64_t)));
 //    if(curr_sync_count != 0){
 //        printf("CAMIO_RING: istream[%i]: sync count=%lu priv=%lu\n", priv->istream.selector.fd, curr_sync_count, priv->sync_counter);
 //    }
     if( likely(curr_sync_count == priv->sync_counter)){
-        const uint64_t data_len  = *((volatile uint64_t*)(priv->curr + CAMIO_RING_SLOT_SIZE - 2* sizeof(uint64_t)));
+        const uint64_t data_len  = *((volatile uint64_t*)(priv->curr + priv->slot_size - 2* sizeof(uint64_t)));
         priv->read_size = data_len;
+        priv->istream.meta.seq   = curr_sync_count;
+        priv->istream.meta.flags = CAMIO_META_SEQ;
         camio_perf_event_start(priv->perf_mon,CAMIO_PERF_EVENT_ISTREAM_RING,CAMIO_PERF_COND_NEW_DATA);
         return data_len;
     }
@@ -106,8 +197,10 @@ static int prepare_next(camio_istream_ring_t* priv){
     if( likely(curr_sync_count > priv->sync_counter)){
         wprintf( "Ring overflow. Catching up now. Dropping payloads from %lu to %lu\n", priv->sync_counter, curr_sync_count -1);
         priv->sync_counter = curr_sync_count;
-        const uint64_t data_len  = *((volatile uint64_t*)(priv->curr + CAMIO_RING_SLOT_SIZE - 2* sizeof(uint64_t)));
+        const uint64_t data_len  = *((volatile uint64_t*)(priv->curr + priv->slot_size - 2* sizeof(uint64_t)));
         priv->read_size = data_len;
+        priv->istream.meta.seq   = curr_sync_count;
+        priv->istream.meta.flags = CAMIO_META_SEQ | CAMIO_META_OVERRUN;
         camio_perf_event_start(priv->perf_mon,CAMIO_PERF_EVENT_ISTREAM_RING,CAMIO_PERF_COND_READ_ERROR);
         return data_len;
     }
@@ -115,13 +208,56 @@ static int prepare_next(camio_istream_ring_t* priv){
     return 0;
 }
 
+
+//Spin for a while, then (unless we have been told to spin forever) sleep until the ostream wakes us
+static void wait_for_data(camio_istream_ring_t* priv){
+    uint64_t spins = 0;
+    while(!prepare_next(priv)){
+        if(likely(priv->wait_mode == CAMIO_WAIT_SPIN || spins < priv->spin_count)){
+            spins++;
+            asm("pause"); //Tell the CPU we're spinning
+            continue;
+        }
+
+        const uint32_t futex_val = camio_wait_prepare(ring_wait);
+        if(!prepare_next(priv)){
+            camio_wait_sleep(ring_wait, futex_val);
+        }
+        camio_wait_finish(ring_wait);
+    }
+}
+
+
+//Ask the ostream for a byte on the wake fifo as soon as there is data. Only done when the ring is found empty, so a
+//busy stream never makes a syscall here.
+static void arm_wake_fd(camio_istream_ring_t* priv){
+    if(ring_wait->armed){
+        return; //Nothing has been written since we last armed it
+    }
+
+    camio_wait_fd_drain(priv->istream.selector.fd);
+    ring_wait->armed = 1;
+    __sync_synchronize();
+
+    //Data may have arrived before the ostream could see the flag. Whoever clears it rings the fifo.
+    if(prepare_next(priv) && __sync_bool_compare_and_swap(&ring_wait->armed, 1, 0)){
+        camio_wait_fd_ring(priv->istream.selector.fd);
+    }
+}
+
+
 int camio_istream_ring_ready(camio_istream_t* this){
     camio_istream_ring_t* priv = this->priv;
     if(priv->read_size || priv->is_closed){
         return 1;
     }
 
-    return prepare_next(priv);
+    const int result = prepare_next(priv);
+    if(!result && priv->wait_mode == CAMIO_WAIT_FD){
+        arm_wake_fd(priv);
+    }
+
+    return result;
 }
 
 int camio_istream_ring_start_read(camio_istream_t* this, uint8_t** out){
@@ -134,9 +270,7 @@ int camio_istream_ring_start_read(camio_istream_t* this, uint8_t** out){
 
     //Called read without calling ready, they must want to block/spin waiting for data
     if(unlikely(!priv->read_size)){
-        while(!prepare_next(priv)){
-            asm("pause"); //Tell the CPU we're spinning
-        }
+        wait_for_data(priv);
     }
 
     *out = (uint8_t*)priv->curr;
@@ -148,7 +282,7 @@ int camio_istream_ring_start_read(camio_istream_t* this, uint8_t** out){
 int camio_istream_ring_end_read(camio_istream_t* this, uint8_t* free_buff){
     camio_istream_ring_t* priv = this->priv;
 
-    register uint64_t curr_sync_count = *((volatile uint64_t*)(priv->curr + CAMIO_RING_SLOT_SIZE - sizeof(uint64_t)));
+    register uint64_t curr_sync_count = *((volatile uint64_t*)(priv->curr + priv->slot_size - sizeof(uint64_t)));
     if( unlikely(curr_sync_count != priv->sync_counter)){
         //wprintf(CAMIO_ERR_BUFFER_OVERRUN, "Detected overrun in ring buffer sync count is now=%lu, expected sync count=%lu\n", curr_sync_count, priv->sync_counter);
         priv->sync_counter = curr_sync_count;
@@ -158,9 +292,71 @@ int camio_istream_ring_end_read(camio_istream_t* this, uint8_t* free_buff){
 
     priv->read_size = 0;
     priv->sync_counter++;
-    priv->index = (priv->index + 1) % (CAMIO_RING_SLOT_COUNT);
-    priv->curr  = priv->ring + (priv->index * CAMIO_RING_SLOT_SIZE);
+    priv->index = (priv->index + 1) % (priv->slot_count);
+    priv->curr  = priv->ring + (priv->index * priv->slot_size);
+
+
+    return 0;
+}
+
+
+//Slots are filled in order, so the slot i places after the current one is ready if its sync
+//counter is exactly i more than the one we expect now.
+int camio_istream_ring_start_read_batch(camio_istream_t* this, camio_batch_item_t* items, size_t max_items){
+    camio_istream_ring_t* priv = this->priv;
+
+    if(unlikely(priv->is_closed || !max_items)){
+        return 0;
+    }
+
+    //Called read without calling ready, they must want to block/spin waiting for data
+    if(unlikely(!priv->read_size)){
+        wait_for_data(priv);
+    }
+
+    //prepare_next has already caught up with any overflow, so the current slot is good
+    items[0].buffer = (uint8_t*)priv->curr;
+    items[0].len    = priv->read_size;
+    items[0].meta   = priv->istream.meta;
+
+    size_t count = 1;
+    uint64_t index = priv->index;
+    for(; count < max_items; count++){
+        index = (index + 1) % (priv->slot_count);
+        volatile uint8_t* slot = priv->ring + (index * priv->slot_size);
+        const uint64_t slot_sync_count = *((volatile uint64_t*)(slot + priv->slot_size - sizeof(uint64_t)));
+        if(slot_sync_count != priv->sync_counter + count){
+            break;
+        }
+
+        items[count].buffer = (uint8_t*)slot;
+        items[count].len    = *((volatile uint64_t*)(slot + priv->slot_size - 2* sizeof(uint64_t)));
+        items[count].meta   = (camio_meta_t){ .seq = slot_sync_count, .flags = CAMIO_META_SEQ };
+    }
+
+    priv->batch_count = count;
+    return count;
+}
+
+
+//The writer overwrites slots in order, so if it has lapped us anywhere in the batch, it will have
+//overwritten the first slot of the batch.
+int camio_istream_ring_end_read_batch(camio_istream_t* this){
+    camio_istream_ring_t* priv = this->priv;
+
+    register uint64_t curr_sync_count = *((volatile uint64_t*)(priv->curr + priv->slot_size - sizeof(uint64_t)));
+    if( unlikely(curr_sync_count != priv->sync_counter)){
+        priv->sync_counter = curr_sync_count;
+        priv->read_size    = 0;
+        priv->batch_count  = 0;
+        return -1;
+    }
 
+    priv->read_size     = 0;
+    priv->sync_counter += priv->batch_count;
+    priv->index         = (priv->index + priv->batch_count) % (priv->slot_count);
+    priv->curr          = priv->ring + (priv->index * priv->slot_size);
+    priv->batch_count   = 0;
 
     return 0;
 }
@@ -195,6 +391,16 @@ camio_istream_t* camio_istream_ring_construct(camio_istream_ring_t* priv, const
     priv->read_size         = 0;
     priv->sync_counter      = 1; //We will expect 1 when the first write occurs
     priv->index             = 0;
+    priv->batch_count       = 0;
+    priv->slot_size         = 0;
+    priv->slot_count        = 0;
+    priv->filename          = NULL;
+    priv->ring_fd           = -1;
+    priv->wait_mode         = CAMIO_WAIT_SPIN;
+    priv->spin_count        = CAMIO_WAIT_SPIN_DEFAULT;
+    priv->doorbell_name     = NULL;
+    priv->doorbell          = NULL;
+    priv->doorbell_bit      = 0;
     priv->params            = params;
 
     //Populate the function members
@@ -205,7 +411,10 @@ camio_istream_t* camio_istream_ring_construct(camio_istream_ring_t* priv, const
     priv->istream.end_read       = camio_istream_ring_end_read;
     priv->istream.ready          = camio_istream_ring_ready;
     priv->istream.delete         = camio_istream_ring_delete;
+    priv->istream.start_read_batch = camio_istream_ring_start_read_batch;
+    priv->istream.end_read_batch = camio_istream_ring_end_read_batch;
     priv->istream.clock          = clock;
+    priv->istream.meta           = (camio_meta_t){ .flags = 0 };
     priv->istream.selector.fd    = -1;
     priv->istream.selector.ready = camio_istream_ring_selector_ready;
 
@@ -9,6 +9,7 @@
 #define CAMIO_ISTREAM_RING_H_
 
 #include "camio_istream.h"
+#include "../utils/camio_doorbell.h"
 
 #define CAMIO_ISTREAM_RING_BLOCKING    1
 #define CAMIO_ISTREAM_RING_NONBLOCKING 0
@@ -31,6 +32,16 @@ typedef struct {
     size_t read_size;                    //Size of the current read waiting (if any)
     uint64_t sync_counter;               //Synchronization counter
     uint64_t index;                      //Current index into the buffer
+    size_t batch_count;                  //Number of slots handed out by the last start_read_batch
+    uint64_t slot_size;                  //Size of each slot in the ring, as set by the writer
+    uint64_t slot_count;                 //Number of slots in the ring, as set by the writer
+    char* filename;                      //Name of the ring file, the wake fifo is named after it
+    int ring_fd;                         //The ring file. The selector fd is the wake fifo in fd wait mode
+    uint64_t wait_mode;                  //How to wait for data, one of CAMIO_WAIT_*
+    uint64_t spin_count;                 //How many times to look for data before sleeping
+    char* doorbell_name;                 //Doorbell file to ring us through, if any
+    volatile camio_doorbell_t* doorbell; //The doorbell, once attached
+    uint64_t doorbell_bit;               //Our bit in the doorbell
     camio_istream_ring_params_t* params;  //Parameters passed in from the outside
     camio_perf_t* perf_mon;
 
@@ -1,3 +1,4 @@
+//#CFLAGS=-D_GNU_SOURCE
 /*
  * Copyright  (C) Matthew P. Grosvenor, 2012, All Rights Reserved
  *
@@ -8,6 +9,7 @@
 #include <stdio.h>
 #include <unistd.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <netinet/in.h>
 #include <sys/ioctl.h>
 #include <net/if.h>
@@ -38,7 +40,17 @@ int camio_istream_udp_open(camio_istream_t* this, const camio_descr_t* descr, ca
     priv->perf_mon = perf_mon;
 
     if(unlikely(camio_descr_has_opts(descr->opt_head))){
-        eprintf_exit( "Option(s) supplied, but none expected\n");
+        struct camio_opt_t* opt;
+        for(opt = descr->opt_head; opt; opt = opt->next){
+            if(strcmp(opt->name,"tstamp") == 0){
+                char* value = NULL;
+                camio_descr_get_opt_string(opt, &value);
+                priv->tstamp = camio_tstamp_parse(value);
+            }
+            else{
+                eprintf_exit( "Unknown option supplied \"%s\". Valid options for this stream are: \"tstamp=sw|hw\"\n", opt->name);
+            }
+        }
     }
 
     if(!descr->query){
@@ -74,6 +86,35 @@ int camio_istream_udp_open(camio_istream_t* this, const camio_descr_t* descr, ca
     }
     priv->buffer_size = getpagesize() * 1024;
 
+    //Carve the buffer up into slots so that batched reads can fetch many datagrams at once
+    priv->batch_slots = MIN(CAMIO_ISTREAM_UDP_BATCH_MAX, priv->buffer_size / CAMIO_ISTREAM_UDP_BATCH_SLOT);
+    priv->msgs        = calloc(priv->batch_slots, sizeof(struct mmsghdr));
+    priv->iovecs      = calloc(priv->batch_slots, sizeof(struct iovec));
+    priv->srcs        = calloc(priv->batch_slots, sizeof(struct sockaddr_in));
+    priv->controls    = priv->tstamp ? calloc(priv->batch_slots, CAMIO_TSTAMP_CONTROL_SIZE) : NULL;
+    if(!priv->msgs || !priv->iovecs || !priv->srcs || (priv->tstamp && !priv->controls)){
+        eprintf_exit( "Failed to allocate batch descriptors\n");
+    }
+
+    for(i = 0; i < priv->batch_slots; i++){
+        priv->iovecs[i].iov_base          = priv->buffer + i * CAMIO_ISTREAM_UDP_BATCH_SLOT;
+        priv->iovecs[i].iov_len           = CAMIO_ISTREAM_UDP_BATCH_SLOT;
+        priv->msgs[i].msg_hdr.msg_iov     = &priv->iovecs[i];
+        priv->msgs[i].msg_hdr.msg_iovlen  = 1;
+        priv->msgs[i].msg_hdr.msg_name    = &priv->srcs[i];
+        priv->msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in); //Always the same for an AF_INET socket
+        priv->msgs[i].msg_hdr.msg_control = priv->controls ? priv->controls + i * CAMIO_TSTAMP_CONTROL_SIZE : NULL;
+    }
+
+    //Reads one at a time can have the whole buffer, and share the first slot's timestamp space
+    priv->iovec.iov_base    = priv->buffer;
+    priv->iovec.iov_len     = priv->buffer_size;
+    memset(&priv->msg, 0, sizeof(priv->msg));
+    priv->msg.msg_name      = &priv->src;
+    priv->msg.msg_iov       = &priv->iovec;
+    priv->msg.msg_iovlen    = 1;
+    priv->msg.msg_control   = priv->controls;
+
     /* Open the udp socket MAC/PHY layer output stage */
     udp_sock_fd = socket(AF_INET,SOCK_DGRAM,0);
     if (udp_sock_fd < 0 ){
@@ -90,6 +131,9 @@ int camio_istream_udp_open(camio_istream_t* this, const camio_descr_t* descr, ca
          eprintf_exit("%s\n", strerror(errno));
     }
 
+    //We don't know which NIC the datagrams come in on, so hardware stamping has to be switched on there already
+    camio_tstamp_enable(udp_sock_fd, priv->tstamp, 0, NULL);
+
 //    int RCVBUFF_SIZE = 512 * 1024 * 1024;
 //    if (setsockopt(udp_sock_fd, SOL_SOCKET, SO_RCVBUF, &RCVBUFF_SIZE, sizeof(RCVBUFF_SIZE)) < 0) {
 //        eprintf_exit(strerror(errno));
@@ -108,6 +152,10 @@ void camio_istream_udp_close(camio_istream_t* this){
     camio_istream_udp_t* priv = this->priv;
     close(this->selector.fd);
     free(priv->buffer);
+    free(priv->msgs);
+    free(priv->iovecs);
+    free(priv->srcs);
+    free(priv->controls);
 }
 
 static void set_fd_blocking(int fd, int blocking){
@@ -129,6 +177,17 @@ static void set_fd_blocking(int fd, int blocking){
     }
 }
 
+//Pick up the kernel's timestamp for a datagram, and move the clock on to it
+static inline void stamp(camio_istream_udp_t* priv, camio_meta_t* meta, struct msghdr* msg){
+    meta->flags &= ~(CAMIO_META_TS | CAMIO_META_TS_HW);
+    meta->flags |= camio_tstamp_rx(msg, &meta->ts_ns);
+    if(priv->istream.clock && (meta->flags & CAMIO_META_TS)){
+        camio_time_t time = { .counter = meta->ts_ns };
+        priv->istream.clock->set(priv->istream.clock, &time);
+    }
+}
+
+
 static int prepare_next(camio_istream_udp_t* priv, int blocking){
     if(priv->bytes_read){
         return priv->bytes_read;
@@ -136,7 +195,9 @@ static int prepare_next(camio_istream_udp_t* priv, int blocking){
 
     set_fd_blocking(priv->istream.selector.fd, blocking);
 
-    int bytes = recv(priv->istream.selector.fd,priv->buffer,priv->buffer_size, 0);
+    priv->msg.msg_namelen    = sizeof(priv->src);
+    priv->msg.msg_controllen = priv->controls ? CAMIO_TSTAMP_CONTROL_SIZE : 0;
+    int bytes = recvmsg(priv->istream.selector.fd, &priv->msg, 0);
     //Was there some error
     if(bytes < 0){
         if(errno == EAGAIN || errno == EWOULDBLOCK){
@@ -149,6 +210,12 @@ static int prepare_next(camio_istream_udp_t* priv, int blocking){
     }
 
     priv->bytes_read = bytes;
+    priv->istream.meta.seq      = priv->seq++;
+    priv->istream.meta.src_addr = priv->src.sin_addr.s_addr;
+    priv->istream.meta.src_port = priv->src.sin_port;
+    if(priv->tstamp){
+        stamp(priv, &priv->istream.meta, &priv->msg);
+    }
     camio_perf_event_start(priv->perf_mon,CAMIO_PERF_EVENT_ISTREAM_UDP,CAMIO_PERF_COND_NEW_DATA);
     return bytes;
 
@@ -192,6 +259,77 @@ int camio_istream_udp_end_read(camio_istream_t* this, uint8_t* free_buff){
 }
 
 
+//Fetch as many datagrams as are waiting (up to max_items) with a single system call
+static int camio_istream_udp_start_read_batch(camio_istream_t* this, camio_batch_item_t* items, size_t max_items){
+    camio_istream_udp_t* priv = this->priv;
+    size_t count = 0;
+
+    if(unlikely(priv->is_closed || !max_items)){
+        return 0;
+    }
+
+    max_items = MIN(max_items, priv->batch_slots);
+
+    //A call to ready may have left a datagram waiting in the first slot
+    if(priv->bytes_read){
+        items[0].buffer  = priv->buffer;
+        items[0].len     = priv->bytes_read;
+        items[0].meta    = priv->istream.meta;
+        priv->bytes_read = 0;
+        count = 1;
+
+        if(count == max_items){
+            return count;
+        }
+
+        set_fd_blocking(priv->istream.selector.fd, 0);
+    }
+    else{
+        //Called read without calling ready, they must want to block until there is at least one
+        set_fd_blocking(priv->istream.selector.fd, 1);
+    }
+
+    //The kernel shrinks the control space to what it used, so give it all back
+    size_t i = count;
+    for(; priv->controls && i < max_items; i++){
+        priv->msgs[i].msg_hdr.msg_controllen = CAMIO_TSTAMP_CONTROL_SIZE;
+    }
+
+    const int msgs = recvmmsg(priv->istream.selector.fd, priv->msgs + count, max_items - count, MSG_WAITFORONE, NULL);
+    if(msgs < 0){
+        if(errno == EAGAIN || errno == EWOULDBLOCK){
+            return count; //Reading more would have blocked, we don't want this
+        }
+
+        camio_perf_event_start(priv->perf_mon,CAMIO_PERF_EVENT_ISTREAM_UDP,CAMIO_PERF_COND_READ_ERROR);
+        eprintf_exit("Could not read UDP. error no=%i (%s)\n", errno, strerror(errno));
+    }
+
+    int j = 0;
+    for(j = 0; j < msgs; j++, count++){
+        items[count].buffer = priv->iovecs[count].iov_base;
+        items[count].len    = priv->msgs[count].msg_len;
+        items[count].meta   = (camio_meta_t){
+            .seq      = priv->seq++,
+            .src_addr = priv->srcs[count].sin_addr.s_addr,
+            .src_port = priv->srcs[count].sin_port,
+            .flags    = CAMIO_META_SEQ | CAMIO_META_SRC,
+        };
+        if(priv->tstamp){
+            stamp(priv, &items[count].meta, &priv->msgs[count].msg_hdr);
+        }
+    }
+
+    camio_perf_event_start(priv->perf_mon,CAMIO_PERF_EVENT_ISTREAM_UDP,CAMIO_PERF_COND_NEW_DATA);
+    return count;
+}
+
+
+static int camio_istream_udp_end_read_batch(camio_istream_t* this){
+    return 0; //Always true for socket I/O
+}
+
+
 int camio_istream_udp_selector_ready(camio_selectable_t* stream){
     camio_istream_t* this = container_of(stream, camio_istream_t,selector);
     return this->ready(this);
@@ -217,6 +355,13 @@ camio_istream_t* camio_istream_udp_construct(camio_istream_udp_t* priv, const ca
     priv->buffer            = NULL;
     priv->buffer_size       = 0;
     priv->bytes_read        = 0;
+    priv->msgs              = NULL;
+    priv->iovecs            = NULL;
+    priv->srcs              = NULL;
+    priv->controls          = NULL;
+    priv->tstamp            = CAMIO_TSTAMP_NONE;
+    priv->seq               = 0;
+    priv->batch_slots       = 0;
     priv->params            = params;
 
 
@@ -228,7 +373,10 @@ camio_istream_t* camio_istream_udp_construct(camio_istream_udp_t* priv, const ca
     priv->istream.end_read       = camio_istream_udp_end_read;
     priv->istream.ready          = camio_istream_udp_ready;
     priv->istream.delete         = camio_istream_udp_delete;
+    priv->istream.start_read_batch = camio_istream_udp_start_read_batch;
+    priv->istream.end_read_batch = camio_istream_udp_end_read_batch;
     priv->istream.clock          = clock;
+    priv->istream.meta           = (camio_meta_t){ .flags = CAMIO_META_SEQ | CAMIO_META_SRC };
     priv->istream.selector.fd    = -1;
     priv->istream.selector.ready = camio_istream_udp_selector_ready;
 
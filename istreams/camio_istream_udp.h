@@ -11,11 +11,15 @@
 #include <netinet/in.h>
 
 #include "camio_istream.h"
+#include "../utils/camio_tstamp.h"
 
 /********************************************************************
  *                  PRIVATE DEFS
  ********************************************************************/
 
+#define CAMIO_ISTREAM_UDP_BATCH_MAX  64            //Most datagrams fetched by a single call to recvmmsg
+#define CAMIO_ISTREAM_UDP_BATCH_SLOT (64 * 1024)   //Space for the largest possible datagram
+
 typedef struct {
     //No params at this stage
 } camio_istream_udp_params_t;
@@ -26,7 +30,17 @@ typedef struct {
     size_t buffer_size;
     size_t bytes_read;
     int is_closed;                      //Has close be called?
-    struct sockaddr_in addr;            //Source address/port
+    struct sockaddr_in addr;            //Address/port we are bound to
+    struct sockaddr_in src;             //Who sent the last datagram read one at a time
+    struct sockaddr_in* srcs;           //Who sent each batched datagram
+    uint64_t seq;                       //Number of datagrams read so far
+    int tstamp;                         //Kernel timestamps, one of CAMIO_TSTAMP_*
+    struct msghdr msg;                  //Message header for reads one at a time
+    struct iovec iovec;                 //The whole buffer, for reads one at a time
+    uint8_t* controls;                  //Space for timestamps, one for each batch slot, when tstamp is on
+    struct mmsghdr* msgs;               //Message headers for batched reads
+    struct iovec* iovecs;               //One slot in the buffer for each batched message
+    size_t batch_slots;                 //Number of batch slots that fit in the buffer
     camio_istream_udp_params_t* params;  //Parameters passed in from the outside
     camio_perf_t* perf_mon;
 
@@ -11,12 +11,15 @@
 
 #include "camio_ostream.h"
 #include "../errors/camio_errors.h"
+#include "../utils/camio_util.h"
 
 #include "camio_ostream_log.h"
 #include "camio_ostream_raw.h"
 #include "camio_ostream_udp.h"
 #include "camio_ostream_ring.h"
 #include "camio_ostream_bring.h"
+#include "camio_ostream_mring.h"
+#include "camio_ostream_bcast.h"
 #include "camio_ostream_blob.h"
 #include "camio_ostream_netmap.h"
 #include "camio_ostream_netmap_eth.h"
@@ -48,6 +51,12 @@ camio_ostream_t* camio_ostream_new( char* description, camio_clock_t* clock, voi
     else if(strcmp(descr.protocol,"bring") == 0 ){
             result = camio_ostream_bring_new(&descr,clock, parameters, perf_mon);
     }
+    else if(strcmp(descr.protocol,"mpmc-ring") == 0 ){
+            result = camio_ostream_mring_new(&descr,clock, parameters, perf_mon);
+    }
+    else if(strcmp(descr.protocol,"bcast") == 0 ){
+            result = camio_ostream_bcast_new(&descr,clock, parameters, perf_mon);
+    }
     else if(strcmp(descr.protocol,"udp") == 0 ){
             result = camio_ostream_udp_new(&descr,clock, parameters, perf_mon);
     }
@@ -68,3 +77,42 @@ camio_ostream_t* camio_ostream_new( char* description, camio_clock_t* clock, voi
     return result;
 
 }
+
+//Streams that reuse a single buffer for every write can only hand out one buffer at a time.
+int camio_ostream_generic_start_write_batch(camio_ostream_t* this, camio_batch_item_t* items, size_t count){
+    if(unlikely(!count)){
+        return 0;
+    }
+
+    items[0].buffer = this->start_write(this, items[0].len);
+    return items[0].buffer ? 1 : 0;
+}
+
+
+int camio_ostream_generic_commit_batch(camio_ostream_t* this, camio_batch_item_t* items, size_t count){
+    size_t i = 0;
+    for(; i < count; i++){
+        uint8_t* buffer = this->start_write(this, items[i].len);
+        if(unlikely(!buffer)){
+            break;
+        }
+
+        if(buffer != items[i].buffer){
+            memcpy(buffer, items[i].buffer, items[i].len);
+        }
+        this->end_write(this, items[i].len);
+    }
+
+    return i;
+}
+
+
+uint8_t* camio_ostream_generic_try_start_write(camio_ostream_t* this, size_t len){
+    return this->start_write(this, len);
+}
+
+
+int camio_ostream_generic_selector_ready(camio_selectable_t* stream){
+    camio_ostream_t* this = container_of(stream, camio_ostream_t, selector);
+    return this->ready(this);
+}
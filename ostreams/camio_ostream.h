@@ -14,6 +14,7 @@
 #include "../clocks/camio_clock.h"
 #include "../selectors/camio_selector.h"
 #include "../perf/camio_perf.h"
+#include "../utils/camio_batch.h"
 
 struct camio_ostream;
 typedef struct camio_ostream camio_ostream_t;
@@ -28,12 +29,24 @@ struct camio_ostream{
      void(*delete)(camio_ostream_t* this);                                      //Close the stream and free all memory
      int (*can_assign_write)(camio_ostream_t*);                                 //Is this stream capable of taking over another stream buffer
      int (*assign_write)(camio_ostream_t* this, uint8_t* buffer, size_t len);   //Assign the write buffer to the stream
+     int (*start_write_batch)(camio_ostream_t* this, camio_batch_item_t* items, size_t count); //Sets items[i].buffer to a space of size items[i].len for up to count items, returns the number of items filled (at least 1)
+     int (*commit_batch)(camio_ostream_t* this, camio_batch_item_t* items, size_t count);      //Commit count items in one go. Buffers not from start_write_batch are copied/sent from directly. Returns the number committed
+     uint8_t* (*try_start_write)(camio_ostream_t* this, size_t len );           //Like start_write, but returns NULL instead of waiting if there is no space to write into
      camio_clock_t* clock;                                                      //For timing information
      int fd;
+     camio_selectable_t selector;                                               //Lets a selector multiplex writers, ready when a write will not block
      void* priv;                                                                //For stream specific structures.
 };
 
 
 camio_ostream_t* camio_ostream_new( char* description, camio_clock_t* clock, void* params, camio_perf_t* perf_mon);
 
+//Generic batch implementation for streams that can only have one write outstanding. Commits are done one item at a time.
+int camio_ostream_generic_start_write_batch(camio_ostream_t* this, camio_batch_item_t* items, size_t count);
+int camio_ostream_generic_commit_batch(camio_ostream_t* this, camio_batch_item_t* items, size_t count);
+
+//Generic implementations for streams that never have to wait for space to write into
+uint8_t* camio_ostream_generic_try_start_write(camio_ostream_t* this, size_t len);
+int camio_ostream_generic_selector_ready(camio_selectable_t* stream);
+
 #endif /* OSTREAM_H_ */
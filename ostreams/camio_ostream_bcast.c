@@ -0,0 +1,354 @@
+/*
+ * Copyright  (C) Matthew P. Grosvenor, 2012, All Rights Reserved
+ *
+ * Camio broadcast (single writer, many reader) ring output stream
+ *
+ */
+#include <errno.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <memory.h>
+
+#include "../utils/camio_util.h"
+#include "../errors/camio_errors.h"
+#include "../stream_description/camio_opt_parser.h"
+#include "../utils/camio_bcast.h"
+
+#include "camio_ostream_bcast.h"
+
+
+static int camio_ostream_bcast_open(camio_ostream_t* this, const camio_descr_t* descr, camio_perf_t* perf_mon ){
+    camio_ostream_bcast_t* priv = this->priv;
+    int bcast_fd = -1;
+    volatile uint8_t* bcast = NULL;
+
+    if(unlikely(perf_mon == NULL)){
+        eprintf_exit("No performance monitor supplied\n");
+    }
+    priv->perf_mon = perf_mon;
+
+
+    if(priv->params){
+        priv->slot_size  = priv->params->slot_size;
+        priv->slot_count = priv->params->slot_count;
+    }
+    else{
+        priv->slot_size  = CAMIO_BCAST_SLOT_SIZE_DEFAULT;
+        priv->slot_count = CAMIO_BCAST_SLOT_COUNT_DEFAULT;
+    }
+
+    if(unlikely(camio_descr_has_opts(descr->opt_head))){
+        struct camio_opt_t* opt;
+        for(opt = descr->opt_head; opt; opt = opt->next){
+            if(strcmp(opt->name,"slots") == 0){
+                camio_descr_get_opt_uint(opt, &priv->slot_count);
+            }
+            else if(strcmp(opt->name,"slot_size") == 0){
+                camio_descr_get_opt_uint(opt, &priv->slot_size);
+            }
+            else{
+                eprintf_exit( "Unknown option supplied \"%s\". Valid options for this stream are: \"slots=<uint64>\", \"slot_size=<uint64>\"\n", opt->name);
+            }
+        }
+    }
+
+    if(priv->slot_count < 1){
+        eprintf_exit( "Bcast ring must have at least one slot\n");
+    }
+
+    //Slots must start on a cache line so that the descriptor and the data never share one with another slot
+    if(priv->slot_size < CAMIO_BCAST_SLOT_SIZE_MIN || priv->slot_size % CAMIO_BCAST_CACHE_LINE){
+        eprintf_exit( "Slot size (%lu) must be a multiple of %lu and at least %lu\n", priv->slot_size, CAMIO_BCAST_CACHE_LINE, CAMIO_BCAST_SLOT_SIZE_MIN);
+    }
+
+    if(!descr->query){
+        eprintf_exit( "No filename supplied\n");
+    }
+
+    //Make a local copy of the filename in case the descr pointer goes away (probable)
+    size_t filename_len = strlen(descr->query);
+    priv->filename = malloc(filename_len + 1);
+    memcpy(priv->filename,descr->query, filename_len);
+    priv->filename[filename_len] = '\0'; //Make sure it's null terminated
+
+
+    //See if a bcast file already exists, if so, get rid of it.
+    bcast_fd = open(descr->query, O_RDONLY);
+    if(unlikely(bcast_fd > 0)){
+        wprintf("Found stale bcast file. Trying to remove it.\n");
+        close(bcast_fd);
+        if( unlink(descr->query) < 0){
+            eprintf_exit("Could remove stale bcast file \"%s\". Error=%s\n", descr->query, strerror(errno));
+        }
+    }
+
+    bcast_fd = open(descr->query, O_RDWR | O_CREAT | O_TRUNC , (mode_t)(0666));
+    if(unlikely(bcast_fd < 0)){
+        eprintf_exit("Could not open file \"%s\". Error=%s\n", descr->query, strerror(errno));
+    }
+
+    //Resize the file
+    if(lseek(bcast_fd, CAMIO_BCAST_MEM_SIZE -1, SEEK_SET) < 0){
+        eprintf_exit( "Could not resize file for shared region \"%s\". Error=%s\n", descr->query, strerror(errno));
+    }
+
+    if(write(bcast_fd, "", 1) < 0){
+        eprintf_exit( "Could not resize file for shared region \"%s\". Error=%s\n", descr->query, strerror(errno));
+    }
+
+    bcast = mmap( NULL, CAMIO_BCAST_MEM_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, bcast_fd, 0);
+    if(unlikely(bcast == MAP_FAILED)){
+        eprintf_exit("Could not memory map bcast file \"%s\". Error=%s\n", descr->query, strerror(errno));
+    }
+
+    //Initialize the ring with 0
+    memset((uint8_t*)bcast, 0, CAMIO_BCAST_MEM_SIZE);
+
+    priv->bcast_size = CAMIO_BCAST_MEM_SIZE;
+    this->fd = bcast_fd;
+    priv->bcast = bcast + CAMIO_BCAST_HEADER_SIZE;
+
+    //Describe the ring so that istreams can find their way around it
+    bcast_header->magic      = CAMIO_BCAST_MAGIC;
+    bcast_header->version    = CAMIO_BCAST_VERSION;
+    bcast_header->slot_size  = priv->slot_size;
+    bcast_header->slot_count = priv->slot_count;
+
+    bcast_ostream_created = 1; //Tell any istreams that are listening that we are all initiliased.
+    priv->is_closed = 0;
+
+    return 0;
+}
+
+static void camio_ostream_bcast_close(camio_ostream_t* this){
+    camio_ostream_bcast_t* priv = this->priv;
+    munmap((void*)bcast_header, priv->bcast_size);
+    close(this->fd);
+    unlink(priv->filename); //Delete the file so readers can't get confused
+    priv->is_closed = 1;
+}
+
+
+//Like the ring, nothing is sent until the first istream has connected. Later istreams just join in where we are.
+static inline void wait_for_connect(camio_ostream_bcast_t* priv){
+    if(unlikely(!bcast_istream_count)){
+        while(!bcast_istream_count){
+            asm("PAUSE"); //Wait for an istream to connect before you send anything
+        }
+    }
+}
+
+
+//Mark the next count slots as being written, so that a reader that is still in one of them will find out
+static inline void reserve(camio_ostream_bcast_t* priv, uint64_t count){
+    for(; priv->reserved < count; priv->reserved++){
+        bcast_slot(priv->head + priv->reserved)->seq = 0;
+    }
+
+    asm volatile("" ::: "memory"); //Make sure the compiler does not hoist data stores above the reservation
+}
+
+
+//Hand the first count reserved slots over to the readers
+static inline void publish(camio_ostream_bcast_t* priv, uint64_t count){
+    asm volatile("" ::: "memory"); //Make sure the compiler does not sink the slot stores below the publish
+
+    uint64_t i = 0;
+    for(; i < count; i++){
+        bcast_slot(priv->head + i)->seq = priv->head + i + 1;
+    }
+
+    priv->head     += count;
+    priv->reserved -= count;
+    bcast_header->head = priv->head;
+}
+
+
+//Returns a pointer to a space of size len, ready for data
+//Returns NULL if this is impossible
+static uint8_t* camio_ostream_bcast_start_write(camio_ostream_t* this, size_t len ){
+    camio_ostream_bcast_t* priv = this->priv;
+    CHECK_LEN_OK(len);
+
+    wait_for_connect(priv);
+    reserve(priv, 1);
+    return bcast_slot_data(priv->head);
+}
+
+//Returns a pointer to a space of size len, ready for data
+//Returns NULL if no istream has connected yet
+static uint8_t* camio_ostream_bcast_try_start_write(camio_ostream_t* this, size_t len ){
+    camio_ostream_bcast_t* priv = this->priv;
+    CHECK_LEN_OK(len);
+
+    if(unlikely(!bcast_istream_count)){
+        return NULL;
+    }
+
+    reserve(priv, 1);
+    return bcast_slot_data(priv->head);
+}
+
+//Returns non-zero if a call to start_write will be non-blocking. We never wait for readers once one has connected.
+static int camio_ostream_bcast_ready(camio_ostream_t* this){
+    camio_ostream_bcast_t* priv = this->priv;
+    return bcast_istream_count != 0;
+}
+
+
+//Commit the data to the buffer previously allocated
+//Len must be equal to or less than len called with start_write
+static uint8_t* camio_ostream_bcast_end_write(camio_ostream_t* this, size_t len){
+    camio_ostream_bcast_t* priv = this->priv;
+    CHECK_LEN_OK(len);
+
+    camio_perf_event_stop(priv->perf_mon, CAMIO_PERF_EVENT_OSTREAM_BCAST, CAMIO_PERF_COND_WRITE);
+
+    reserve(priv, 1);
+
+    //Memory copy is done implicitly here
+    if(priv->assigned_buffer){
+        memcpy(bcast_slot_data(priv->head),priv->assigned_buffer,len);
+        priv->assigned_buffer    = NULL;
+        priv->assigned_buffer_sz = 0;
+    }
+
+    bcast_slot(priv->head)->len = len;
+    publish(priv, 1); //Write is now committed
+
+    return NULL;
+}
+
+
+//Returns up to count consecutive slots, ready for data
+static int camio_ostream_bcast_start_write_batch(camio_ostream_t* this, camio_batch_item_t* items, size_t count){
+    camio_ostream_bcast_t* priv = this->priv;
+
+    wait_for_connect(priv);
+
+    count = MIN(count, priv->slot_count);
+    reserve(priv, count);
+
+    size_t i = 0;
+    for(; i < count; i++){
+        CHECK_LEN_OK(items[i].len);
+        items[i].buffer = bcast_slot_data(priv->head + i);
+    }
+
+    return count;
+}
+
+
+//Fill in all of the slots first, then publish them to the readers in a single pass
+static int camio_ostream_bcast_commit_batch(camio_ostream_t* this, camio_batch_item_t* items, size_t count){
+    camio_ostream_bcast_t* priv = this->priv;
+
+    wait_for_connect(priv);
+
+    camio_perf_event_stop(priv->perf_mon, CAMIO_PERF_EVENT_OSTREAM_BCAST, CAMIO_PERF_COND_WRITE);
+
+    count = MIN(count, priv->slot_count);
+    reserve(priv, count);
+
+    size_t i = 0;
+    for(; i < count; i++){
+        CHECK_LEN_OK(items[i].len);
+        uint8_t* data = bcast_slot_data(priv->head + i);
+        if(items[i].buffer != data){
+            memcpy(data, items[i].buffer, items[i].len);
+        }
+        bcast_slot(priv->head + i)->len = items[i].len;
+    }
+
+    publish(priv, count); //Writes are now committed
+
+    return count;
+}
+
+
+static void camio_ostream_bcast_delete(camio_ostream_t* ostream){
+    ostream->close(ostream);
+    camio_ostream_bcast_t* priv = ostream->priv;
+    free(priv);
+}
+
+//Is this stream capable of taking over another stream buffer
+static int camio_ostream_bcast_can_assign_write(camio_ostream_t* this){
+    return 1;
+}
+
+//Assign the write buffer to the stream
+static int camio_ostream_bcast_assign_write(camio_ostream_t* this, uint8_t* buffer, size_t len){
+    camio_ostream_bcast_t* priv = this->priv;
+
+    if(!buffer){
+        eprintf_exit("Assigned buffer is null.");
+    }
+
+    CHECK_LEN_OK(len);
+    wait_for_connect(priv);
+
+    priv->assigned_buffer    = buffer;
+    priv->assigned_buffer_sz = len;
+
+    return 0;
+}
+
+
+/* ****************************************************
+ * Construction heavy lifting
+ */
+
+static camio_ostream_t* camio_ostream_bcast_construct(camio_ostream_bcast_t* priv, const camio_descr_t* descr, camio_clock_t* clock, camio_ostream_bcast_params_t* params, camio_perf_t* perf_mon){
+    if(!priv){
+        eprintf_exit("bcast stream supplied is null\n");
+    }
+    //Initialize the local variables
+    priv->is_closed             = 1;
+    priv->bcast                 = NULL;
+    priv->bcast_size            = 0;
+    priv->head                  = 0;
+    priv->reserved              = 0;
+    priv->slot_size             = 0;
+    priv->slot_count            = 0;
+    priv->assigned_buffer       = NULL;
+    priv->assigned_buffer_sz    = 0;
+    priv->params                = params;
+
+
+    //Populate the function members
+    priv->ostream.priv              = priv; //Lets us access private members from public functions
+    priv->ostream.open              = camio_ostream_bcast_open;
+    priv->ostream.close             = camio_ostream_bcast_close;
+    priv->ostream.start_write       = camio_ostream_bcast_start_write;
+    priv->ostream.end_write         = camio_ostream_bcast_end_write;
+    priv->ostream.ready             = camio_ostream_bcast_ready;
+    priv->ostream.delete            = camio_ostream_bcast_delete;
+    priv->ostream.can_assign_write  = camio_ostream_bcast_can_assign_write;
+    priv->ostream.assign_write      = camio_ostream_bcast_assign_write;
+    priv->ostream.start_write_batch = camio_ostream_bcast_start_write_batch;
+    priv->ostream.commit_batch      = camio_ostream_bcast_commit_batch;
+    priv->ostream.try_start_write   = camio_ostream_bcast_try_start_write;
+    priv->ostream.clock             = clock;
+    priv->ostream.fd                = -1;
+    priv->ostream.selector.fd       = -1;
+    priv->ostream.selector.ready    = camio_ostream_generic_selector_ready;
+
+    //Call open, because its the obvious thing to do now...
+    priv->ostream.open(&priv->ostream, descr, perf_mon);
+
+    //Return the generic ostream interface for the outside world
+    return &priv->ostream;
+
+}
+
+camio_ostream_t* camio_ostream_bcast_new( const camio_descr_t* descr, camio_clock_t* clock, camio_ostream_bcast_params_t* params, camio_perf_t* perf_mon){
+    camio_ostream_bcast_t* priv = malloc(sizeof(camio_ostream_bcast_t));
+    if(!priv){
+        eprintf_exit("No memory available for ostream bcast creation\n");
+    }
+    return camio_ostream_bcast_construct(priv, descr, clock, params, perf_mon);
+}
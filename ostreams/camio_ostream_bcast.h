@@ -0,0 +1,50 @@
+/*
+ * camio_ostream_bcast.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: mgrosvenor
+ */
+
+#ifndef CAMIO_OSTREAM_BCAST_H_
+#define CAMIO_OSTREAM_BCAST_H_
+
+#include "camio_ostream.h"
+
+/********************************************************************
+ *                  PRIVATE DEFS
+ ********************************************************************/
+
+
+typedef struct {
+    uint64_t slot_size;
+    uint64_t slot_count;
+} camio_ostream_bcast_params_t;
+
+typedef struct {
+    camio_ostream_t ostream;
+    char* filename;                         //Keep the file name so we can delete it
+    int is_closed;                          //Has close be called?
+    volatile uint8_t* bcast;                //Pointer to the first slot of the ring
+    size_t bcast_size;                      //Size of the ring buffer
+    uint8_t* assigned_buffer;               //Assigned write buffer
+    size_t assigned_buffer_sz;              //Assigned write buffer size
+    uint64_t head;                          //Number of messages published, the next slot to write is head % slot_count
+    uint64_t reserved;                      //Number of slots from head handed out by start_write, but not yet published
+    uint64_t slot_size;                     //Size of each slot in the ring
+    uint64_t slot_count;                    //Number of slots in the ring
+    camio_ostream_bcast_params_t* params;   //Parameters from the outside world
+    camio_perf_t* perf_mon;
+
+} camio_ostream_bcast_t;
+
+
+
+/********************************************************************
+ *                  PUBLIC DEFS
+ ********************************************************************/
+
+camio_ostream_t* camio_ostream_bcast_new( const camio_descr_t* opts, camio_clock_t* clock, camio_ostream_bcast_params_t* params, camio_perf_t* perf_mon);
+
+
+
+#endif /* CAMIO_OSTREAM_BCAST_H_ */
@@ -31,15 +31,6 @@ static int camio_ostream_bring_open(camio_ostream_t* this, const camio_descr_t*
     priv->perf_mon = perf_mon;
 
 
-    if(unlikely(camio_descr_has_opts(descr->opt_head))){
-        eprintf_exit( "Option(s) supplied, but none expected\n");
-    }
-
-    if(!descr->query){
-        eprintf_exit( "No filename supplied\n");
-    }
-
-
     if(priv->params){
         priv->slot_size  = priv->params->slot_size;
         priv->slot_count = priv->params->slot_count;
@@ -49,6 +40,34 @@ static int camio_ostream_bring_open(camio_ostream_t* this, const camio_descr_t*
         priv->slot_count = CAMIO_BRING_SLOT_COUNT_DEFAULT;
     }
 
+    if(unlikely(camio_descr_has_opts(descr->opt_head))){
+        struct camio_opt_t* opt;
+        for(opt = descr->opt_head; opt; opt = opt->next){
+            if(strcmp(opt->name,"slots") == 0){
+                camio_descr_get_opt_uint(opt, &priv->slot_count);
+            }
+            else if(strcmp(opt->name,"slot_size") == 0){
+                camio_descr_get_opt_uint(opt, &priv->slot_size);
+            }
+            else{
+                eprintf_exit( "Unknown option supplied \"%s\". Valid options for this stream are: \"slots=<uint64>\", \"slot_size=<uint64>\"\n", opt->name);
+            }
+        }
+    }
+
+    if(priv->slot_count < 1){
+        eprintf_exit( "Bring must have at least one slot\n");
+    }
+
+    //Slots must start on a cache line so that the descriptor and the data never share one with another slot
+    if(priv->slot_size < CAMIO_BRING_SLOT_SIZE_MIN || priv->slot_size % CAMIO_BRING_CACHE_LINE){
+        eprintf_exit( "Slot size (%lu) must be a multiple of %lu and at least %lu\n", priv->slot_size, CAMIO_BRING_CACHE_LINE, CAMIO_BRING_SLOT_SIZE_MIN);
+    }
+
+    if(!descr->query){
+        eprintf_exit( "No filename supplied\n");
+    }
+
     //printf("Making bring ostream %s with %lu slots of size %lu\n", descr->query, priv->slot_count, priv->slot_size);
 
 
@@ -95,8 +114,14 @@ static int camio_ostream_bring_open(camio_ostream_t* this, const camio_descr_t*
 
     priv->bring_size = CAMIO_BRING_MEM_SIZE;
     this->fd = bring_fd;
-    priv->bring = bring;
-    priv->curr = bring;
+    priv->bring = bring + CAMIO_BRING_HEADER_SIZE;
+
+    //Describe the bring so that istreams can find their way around it
+    bring_header->magic      = CAMIO_BRING_MAGIC;
+    bring_header->version    = CAMIO_BRING_VERSION;
+    bring_header->slot_size  = priv->slot_size;
+    bring_header->slot_count = priv->slot_count;
+
     bring_ostream_created = 1; //Tell a waiting reader that everything is initilaised
     priv->is_closed = 0;
 
@@ -105,46 +130,117 @@ static int camio_ostream_bring_open(camio_ostream_t* this, const camio_descr_t*
 
 static void camio_ostream_bring_close(camio_ostream_t* this){
     camio_ostream_bring_t* priv = this->priv;
-    munmap((void*)priv->bring, priv->bring_size);
+    if(priv->doorbell){
+        camio_doorbell_detach(priv->doorbell, (const char*)bring_doorbell->name);
+        priv->doorbell = NULL;
+    }
+    munmap((void*)bring_header, priv->bring_size);
     close(this->fd);
+    if(priv->wake_fd >= 0){
+        close(priv->wake_fd);
+        priv->wake_fd = -1;
+    }
     unlink(priv->filename); //Delete the file so reader can't get confused
     priv->is_closed = 1;
 }
 
 
+//The istream only connects once, so once we've seen it we never need to look at the shared flag again
+static inline int is_connected(camio_ostream_bring_t* priv){
+    if(likely(priv->connected)){
+        return 1;
+    }
+
+    priv->connected = bring_istream_connected != 0;
+    if(priv->connected){
+        //Both are set by the istream before it connects
+        priv->wake = bring_istream_wait != CAMIO_WAIT_SPIN;
+        if(bring_doorbell->bit){
+            priv->doorbell = camio_doorbell_attach((const char*)bring_doorbell->name);
+        }
+    }
+    return priv->connected;
+}
+
+
+//An istream that does not spin forever may be asleep, or waiting on its wake fifo. It may also have a doorbell, which
+//it takes back when it closes, so the bit is read each time rather than kept.
+static inline void wake_istream(camio_ostream_bring_t* priv){
+    if(unlikely(priv->wake)){
+        camio_wait_notify(bring_wait, priv->filename, &priv->wake_fd);
+    }
+    if(unlikely(priv->doorbell != NULL)){
+        const uint64_t bit = bring_doorbell->bit;
+        if(likely(bit)){
+            camio_doorbell_ring(priv->doorbell, bit - 1);
+        }
+    }
+}
+
+
+//Spin until the istream has connected, nothing can be sent before then
+static inline void wait_for_connect(camio_ostream_bring_t* priv){
+    while(unlikely(!is_connected(priv))){
+        asm("pause"); //relax the CPU while we're spinning
+    }
+}
+
+
+//Returns the number of free slots. Only reads the istream's tail (and so only pulls its cache line over) when our
+//cached copy says there are fewer than count.
+static inline uint64_t free_slots(camio_ostream_bring_t* priv, uint64_t count){
+    if(priv->slot_count - (priv->head - priv->tail_cache) < count){
+        priv->tail_cache = bring_header->tail;
+    }
+
+    return priv->slot_count - (priv->head - priv->tail_cache);
+}
+
+
+//Spin until at least count slots are free, returns the number of free slots.
+static inline uint64_t wait_for_slots(camio_ostream_bring_t* priv, uint64_t count){
+    uint64_t free;
+    while( (free = free_slots(priv, count)) < count){
+        asm("pause"); //relax the CPU while we're spinning
+    }
+
+    return free;
+}
+
+
 //Returns a pointer to a space of size len, ready for data
 //Returns NULL if this is impossible
 static uint8_t* camio_ostream_bring_start_write(camio_ostream_t* this, size_t len ){
     camio_ostream_bring_t* priv = this->priv;
     CHECK_LEN_OK(len);
 
-    printf("Start write connected=%lu\n", bring_istream_connected);
-    if(!bring_istream_connected){
-        printf("Waiting for connect\n");
-
-        while(!bring_istream_connected){
-            asm("PAUSE");
-        }
+    wait_for_connect(priv);
+    wait_for_slots(priv, 1);
+    return bring_slot_data(priv->head);
+}
 
-        printf("Done waiting for connect\n");
-    }
+//Returns a pointer to a space of size len, ready for data
+//Returns NULL if start_write would have to wait for the istream to connect or to free a slot
+static uint8_t* camio_ostream_bring_try_start_write(camio_ostream_t* this, size_t len ){
+    camio_ostream_bring_t* priv = this->priv;
+    CHECK_LEN_OK(len);
 
-    while(1){
-        register const uint64_t curr_sync_count = *((volatile uint64_t*)(priv->curr + priv->slot_size - sizeof(uint64_t)));
-        if(curr_sync_count == 0x00ULL){ //The istream will set this to zero when it's done
-            break;
-        }
-        asm("pause"); //relax the CPU while we're spinning
+    if(unlikely(!is_connected(priv) || !free_slots(priv, 1))){
+        return NULL;
     }
 
-    return (uint8_t*)priv->curr;
+    return bring_slot_data(priv->head);
 }
 
-//Returns non-zero if a call to start_write will be non-blocking
+
+//Returns the number of free slots, so non-zero if a call to start_write will be non-blocking
 static int camio_ostream_bring_ready(camio_ostream_t* this){
-    //Not implemented
-    eprintf_exit("Not implemented \n");
-    return 0;
+    camio_ostream_bring_t* priv = this->priv;
+    if(unlikely(!is_connected(priv))){
+        return 0;
+    }
+
+    return free_slots(priv, 1);
 }
 
 
@@ -159,23 +255,76 @@ static uint8_t* camio_ostream_bring_end_write(camio_ostream_t* this, size_t len)
     //Memory copy is done implicitly here
     if(priv->assigned_buffer){
 
-        memcpy((uint8_t*)priv->curr,priv->assigned_buffer,len);
+        memcpy(bring_slot_data(priv->head),priv->assigned_buffer,len);
         priv->assigned_buffer    = NULL;
         priv->assigned_buffer_sz = 0;
     }
 
+    bring_slot(priv->head)->len = len;
+    bring_slot(priv->head)->seq = priv->head + 1;
+    priv->head++;
 
-    priv->sync_count++;
-    *(volatile uint64_t*)(priv->curr + priv->slot_size-2*sizeof(uint64_t)) = len;
-    *(volatile uint64_t*)(priv->curr + priv->slot_size-1*sizeof(uint64_t)) = priv->sync_count; //Write is now committed
-
-    priv->index = (priv->index + 1) % ( priv->slot_count);
-    priv->curr  = priv->bring + (priv->index * priv->slot_size);
+    asm volatile("" ::: "memory"); //Make sure the compiler does not sink the slot stores below the publish
+    bring_header->head = priv->head; //Write is now committed
+    wake_istream(priv);
 
     return NULL;
 }
 
 
+//Blocks until the first slot is free, then returns as many of the following free slots as are available, up to count
+static int camio_ostream_bring_start_write_batch(camio_ostream_t* this, camio_batch_item_t* items, size_t count){
+    camio_ostream_bring_t* priv = this->priv;
+
+    if(unlikely(!count)){
+        return 0;
+    }
+
+    wait_for_connect(priv);
+
+    count = MIN(count, wait_for_slots(priv, 1));
+    size_t i = 0;
+    for(; i < count; i++){
+        CHECK_LEN_OK(items[i].len);
+        items[i].buffer = bring_slot_data(priv->head + i);
+    }
+
+    return count;
+}
+
+
+//Fill in all of the slots first, then publish them to the reader with a single store to head
+static int camio_ostream_bring_commit_batch(camio_ostream_t* this, camio_batch_item_t* items, size_t count){
+    camio_ostream_bring_t* priv = this->priv;
+
+    wait_for_connect(priv);
+
+    camio_perf_event_stop(priv->perf_mon, CAMIO_PERF_EVENT_OSTREAM_BRING, CAMIO_PERF_COND_WRITE);
+
+    //Only waits if the caller did not reserve the slots with start_write_batch()
+    count = MIN(count, priv->slot_count);
+    wait_for_slots(priv, count);
+
+    size_t i = 0;
+    for(; i < count; i++){
+        CHECK_LEN_OK(items[i].len);
+        uint8_t* data = bring_slot_data(priv->head + i);
+        if(items[i].buffer != data){
+            memcpy(data, items[i].buffer, items[i].len);
+        }
+        bring_slot(priv->head + i)->len = items[i].len;
+        bring_slot(priv->head + i)->seq = priv->head + i + 1;
+    }
+    priv->head += count;
+
+    asm volatile("" ::: "memory"); //Make sure the compiler does not sink the slot stores below the publish
+    bring_header->head = priv->head; //Writes are now committed
+    wake_istream(priv);
+
+    return count;
+}
+
+
 static void camio_ostream_bring_delete(camio_ostream_t* ostream){
     ostream->close(ostream);
     camio_ostream_bring_t* priv = ostream->priv;
@@ -197,24 +346,8 @@ static int camio_ostream_bring_assign_write(camio_ostream_t* this, uint8_t* buff
 
 
 
-    if(unlikely(!bring_istream_connected )){
-        //printf("Waiting for connect on  %s\n", priv->filename);
-
-        while(!bring_istream_connected){
-            asm("PAUSE");
-        }
-
-        //printf("Done waiting for connect\n");
-    }
-
-
-    while(1){
-        register const uint64_t curr_sync_count = *((volatile uint64_t*)(priv->curr + priv->slot_size - sizeof(uint64_t)));
-        if(curr_sync_count == 0x00ULL){ //The istream will set this to zero when it's done
-            break;
-        }
-        asm("pause"); //relax the CPU while we're spinning
-    }
+    wait_for_connect(priv);
+    wait_for_slots(priv, 1);
     CHECK_LEN_OK(len);
 
     priv->assigned_buffer    = buffer;
@@ -234,11 +367,16 @@ static camio_ostream_t* camio_ostream_bring_construct(camio_ostream_bring_t* pri
     }
     //Initialize the local variables
     priv->is_closed             = 1;
+    priv->wake                  = 0;
+    priv->wake_fd               = -1;
+    priv->doorbell              = NULL;
     priv->bring                  = NULL;
     priv->bring_size             = 0;
-    priv->curr                  = NULL;
-    priv->sync_count            = 0;
-    priv->index                 = 0;
+    priv->head                  = 0;
+    priv->tail_cache            = 0;
+    priv->connected             = 0;
+    priv->slot_size             = 0;
+    priv->slot_count            = 0;
     priv->assigned_buffer       = NULL;
     priv->assigned_buffer_sz    = 0;
     priv->params                = params;
@@ -254,8 +392,13 @@ static camio_ostream_t* camio_ostream_bring_construct(camio_ostream_bring_t* pri
     priv->ostream.delete            = camio_ostream_bring_delete;
     priv->ostream.can_assign_write  = camio_ostream_bring_can_assign_write;
     priv->ostream.assign_write      = camio_ostream_bring_assign_write;
+    priv->ostream.start_write_batch = camio_ostream_bring_start_write_batch;
+    priv->ostream.commit_batch      = camio_ostream_bring_commit_batch;
+    priv->ostream.try_start_write   = camio_ostream_bring_try_start_write;
     priv->ostream.clock             = clock;
     priv->ostream.fd                = -1;
+    priv->ostream.selector.fd       = -1;
+    priv->ostream.selector.ready    = camio_ostream_generic_selector_ready;
 
     //Call open, because its the obvious thing to do now...
     priv->ostream.open(&priv->ostream, descr, perf_mon);
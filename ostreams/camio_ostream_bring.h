@@ -9,6 +9,7 @@
 #define CAMIO_OSTREAM_BRING_H_
 
 #include "camio_ostream.h"
+#include "../utils/camio_doorbell.h"
 
 /********************************************************************
  *                  PRIVATE DEFS
@@ -26,11 +27,14 @@ typedef struct {
     int is_closed;              			//Has close be called?
     volatile uint8_t* bring;				//Pointer to the head of the bring
     size_t bring_size;                      //Size of the bring buffer
-    volatile uint8_t* curr;                 //Current slot in the bring
     uint8_t* assigned_buffer;               //Assigned write buffer
     size_t assigned_buffer_sz;              //Assigned write buffer size
-    uint64_t sync_count;                    //Synchronization counter
-    uint64_t index;                         //Current slot in the bring
+    uint64_t head;                          //Number of slots published, the next slot to write is head % slot_count
+    uint64_t tail_cache;                    //Last value of the istream's tail that we saw
+    int connected;                          //Has the istream connected? Saves going back to the shared flag
+    int wake;                               //Does the istream need waking when there is new data?
+    int wake_fd;                            //Write end of the istream's wake fifo, opened when first needed
+    volatile camio_doorbell_t* doorbell;    //The istream's doorbell, if it has one
     uint64_t slot_size;                     //Size of each slot in the ring
     uint64_t slot_count;                    //Number of slots in the ring
     camio_ostream_bring_params_t* params;   //Parameters from the outside world
@@ -205,8 +205,13 @@ camio_ostream_t* camio_ostream_log_construct(camio_ostream_log_t* priv, const ca
     priv->ostream.delete            = camio_ostream_log_delete;
     priv->ostream.can_assign_write  = camio_ostream_log_can_assign_write;
     priv->ostream.assign_write      = camio_ostream_log_assign_write;
+    priv->ostream.start_write_batch = camio_ostream_generic_start_write_batch;
+    priv->ostream.commit_batch      = camio_ostream_generic_commit_batch;
+    priv->ostream.try_start_write   = camio_ostream_generic_try_start_write;
     priv->ostream.clock             = clock;
     priv->ostream.fd                = -1;
+    priv->ostream.selector.fd       = -1;
+    priv->ostream.selector.ready    = camio_ostream_generic_selector_ready;
 
     //Call open, because its the obvious thing to do now...
     priv->ostream.open(&priv->ostream, descr, perf_mon);
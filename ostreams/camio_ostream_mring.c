@@ -0,0 +1,348 @@
+/*
+ * Copyright  (C) Matthew P. Grosvenor, 2012, All Rights Reserved
+ *
+ * Camio multi-producer, multi-consumer shared memory ring output stream
+ *
+ */
+#include <errno.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <string.h>
+#include <memory.h>
+
+#include "../utils/camio_util.h"
+#include "../errors/camio_errors.h"
+#include "../stream_description/camio_opt_parser.h"
+#include "../utils/camio_mring.h"
+
+#include "camio_ostream_mring.h"
+
+
+static int camio_ostream_mring_open(camio_ostream_t* this, const camio_descr_t* descr, camio_perf_t* perf_mon ){
+    camio_ostream_mring_t* priv = this->priv;
+
+    if(unlikely(perf_mon == NULL)){
+        eprintf_exit("No performance monitor supplied\n");
+    }
+    priv->perf_mon = perf_mon;
+
+    //Zero means use the geometry of an existing mring, or the default if we are the first
+    if(priv->params){
+        priv->slot_size  = priv->params->slot_size;
+        priv->slot_count = priv->params->slot_count;
+    }
+
+    if(unlikely(camio_descr_has_opts(descr->opt_head))){
+        struct camio_opt_t* opt;
+        for(opt = descr->opt_head; opt; opt = opt->next){
+            if(strcmp(opt->name,"slots") == 0){
+                camio_descr_get_opt_uint(opt, &priv->slot_count);
+            }
+            else if(strcmp(opt->name,"slot_size") == 0){
+                camio_descr_get_opt_uint(opt, &priv->slot_size);
+            }
+            else{
+                eprintf_exit( "Unknown option supplied \"%s\". Valid options for this stream are: \"slots=<uint64>\", \"slot_size=<uint64>\"\n", opt->name);
+            }
+        }
+    }
+
+    if(!descr->query){
+        eprintf_exit( "No filename supplied\n");
+    }
+
+    //Make a local copy of the filename in case the descr pointer goes away (probable)
+    size_t filename_len = strlen(descr->query);
+    priv->filename = malloc(filename_len + 1);
+    memcpy(priv->filename,descr->query, filename_len);
+    priv->filename[filename_len] = '\0'; //Make sure it's null terminated
+
+    //Unlike ring and bring there is no connect handshake. Writers can start as soon as they are attached, if there
+    //are no readers yet, the mring fills up and writers wait for space as usual.
+    priv->mring = camio_mring_attach(priv->filename, &priv->slot_size, &priv->slot_count, &this->fd);
+    priv->is_closed = 0;
+
+    return 0;
+}
+
+
+//Try to claim up to count free slots, starting at pos. Returns the number claimed, or 0 if pos is not free or another
+//writer claimed it first.
+static inline uint64_t claim_from(camio_ostream_mring_t* priv, uint64_t pos, uint64_t count){
+    uint64_t free = 0;
+    for(; free < count; free++){
+        if(mring_slot(pos + free)->seq != pos + free){
+            break;
+        }
+    }
+
+    if(free && __sync_bool_compare_and_swap(&mring_header->head, pos, pos + free)){
+        return free;
+    }
+
+    return 0;
+}
+
+
+//Try to claim up to count free slots at the head of the mring. Returns the number claimed, or 0 if the mring is full.
+static inline uint64_t try_claim(camio_ostream_mring_t* priv, uint64_t count){
+    count = MIN(count, priv->slot_count);
+
+    while(1){
+        const uint64_t pos = mring_header->head;
+        const uint64_t claimed = claim_from(priv, pos, count);
+        if(likely(claimed)){
+            priv->write_pos = pos;
+            priv->claimed   = claimed;
+            return claimed;
+        }
+
+        //A sequence number behind pos means a reader has not handed the slot back yet, the mring is full. Otherwise
+        //another writer got there first and head has moved on.
+        if((int64_t)(mring_slot(pos)->seq - pos) < 0){
+            return 0;
+        }
+    }
+
+    return 0;
+}
+
+
+//Spin until we have at least one slot, returns the number claimed
+static inline uint64_t claim(camio_ostream_mring_t* priv, uint64_t count){
+    if(likely(priv->claimed)){
+        return priv->claimed;
+    }
+
+    while(!try_claim(priv, count)){
+        asm("pause"); //relax the CPU while we're spinning
+    }
+
+    return priv->claimed;
+}
+
+
+//Hand the first count claimed slots over to the readers
+static inline void publish(camio_ostream_mring_t* priv, uint64_t count){
+    asm volatile("" ::: "memory"); //Make sure the compiler does not sink the slot stores below the publish
+
+    uint64_t i = 0;
+    for(; i < count; i++){
+        mring_slot(priv->write_pos + i)->seq = priv->write_pos + i + 1;
+    }
+
+    priv->write_pos += count;
+    priv->claimed   -= count;
+}
+
+
+static void camio_ostream_mring_close(camio_ostream_t* this){
+    camio_ostream_mring_t* priv = this->priv;
+    if(priv->is_closed){
+        return;
+    }
+
+    //Readers wait on slots in order, so anything we have claimed must be handed over, even if there is nothing in it.
+    //A length of 0 would look like the end of the stream to a reader, so the slots are marked to be skipped instead.
+    uint64_t i = 0;
+    for(; i < priv->claimed; i++){
+        mring_slot(priv->write_pos + i)->len = CAMIO_MRING_LEN_SKIP;
+    }
+    publish(priv, priv->claimed);
+
+    camio_mring_detach(priv->mring, priv->filename, this->fd);
+    free(priv->filename);
+    priv->is_closed = 1;
+}
+
+
+//Returns a pointer to a space of size len, ready for data
+//Returns NULL if this is impossible
+static uint8_t* camio_ostream_mring_start_write(camio_ostream_t* this, size_t len ){
+    camio_ostream_mring_t* priv = this->priv;
+    CHECK_LEN_OK(len);
+
+    claim(priv, 1);
+    return mring_slot_data(priv->write_pos);
+}
+
+//Returns a pointer to a space of size len, ready for data
+//Returns NULL if the mring is full
+static uint8_t* camio_ostream_mring_try_start_write(camio_ostream_t* this, size_t len ){
+    camio_ostream_mring_t* priv = this->priv;
+    CHECK_LEN_OK(len);
+
+    if(unlikely(!priv->claimed && !try_claim(priv, 1))){
+        return NULL;
+    }
+
+    return mring_slot_data(priv->write_pos);
+}
+
+//Returns non-zero if a call to start_write will be non-blocking. Other writers may be competing for the same space,
+//so a free slot is claimed here and kept for the next write.
+static int camio_ostream_mring_ready(camio_ostream_t* this){
+    camio_ostream_mring_t* priv = this->priv;
+    if(priv->claimed){
+        return 1;
+    }
+
+    return try_claim(priv, 1) != 0;
+}
+
+
+//Commit the data to the buffer previously allocated
+//Len must be equal to or less than len called with start_write
+static uint8_t* camio_ostream_mring_end_write(camio_ostream_t* this, size_t len){
+    camio_ostream_mring_t* priv = this->priv;
+    CHECK_LEN_OK(len);
+
+    camio_perf_event_stop(priv->perf_mon, CAMIO_PERF_EVENT_OSTREAM_MRING, CAMIO_PERF_COND_WRITE);
+
+    claim(priv, 1);
+
+    //Memory copy is done implicitly here
+    if(priv->assigned_buffer){
+        memcpy(mring_slot_data(priv->write_pos),priv->assigned_buffer,len);
+        priv->assigned_buffer    = NULL;
+        priv->assigned_buffer_sz = 0;
+    }
+
+    mring_slot(priv->write_pos)->len = len;
+    publish(priv, 1); //Write is now committed
+
+    return NULL;
+}
+
+
+//Blocks until the first slot is claimed, then returns as many of the following free slots as we could claim, up to count
+static int camio_ostream_mring_start_write_batch(camio_ostream_t* this, camio_batch_item_t* items, size_t count){
+    camio_ostream_mring_t* priv = this->priv;
+
+    if(unlikely(!count)){
+        return 0;
+    }
+
+    count = MIN(count, claim(priv, count));
+    size_t i = 0;
+    for(; i < count; i++){
+        CHECK_LEN_OK(items[i].len);
+        items[i].buffer = mring_slot_data(priv->write_pos + i);
+    }
+
+    return count;
+}
+
+
+//Fill in the claimed slots, then hand them to the readers. Claims more slots as needed if the caller did not reserve
+//them all with start_write_batch()
+static int camio_ostream_mring_commit_batch(camio_ostream_t* this, camio_batch_item_t* items, size_t count){
+    camio_ostream_mring_t* priv = this->priv;
+
+    camio_perf_event_stop(priv->perf_mon, CAMIO_PERF_EVENT_OSTREAM_MRING, CAMIO_PERF_COND_WRITE);
+
+    size_t done = 0;
+    while(done < count){
+        const uint64_t batch = MIN(count - done, claim(priv, count - done));
+
+        size_t i = 0;
+        for(; i < batch; i++){
+            CHECK_LEN_OK(items[done + i].len);
+            uint8_t* data = mring_slot_data(priv->write_pos + i);
+            if(items[done + i].buffer != data){
+                memcpy(data, items[done + i].buffer, items[done + i].len);
+            }
+            mring_slot(priv->write_pos + i)->len = items[done + i].len;
+        }
+
+        publish(priv, batch); //Writes are now committed
+        done += batch;
+    }
+
+    return count;
+}
+
+
+static void camio_ostream_mring_delete(camio_ostream_t* ostream){
+    ostream->close(ostream);
+    camio_ostream_mring_t* priv = ostream->priv;
+    free(priv);
+}
+
+//Is this stream capable of taking over another stream buffer
+static int camio_ostream_mring_can_assign_write(camio_ostream_t* this){
+    return 1;
+}
+
+//Assign the write buffer to the stream
+static int camio_ostream_mring_assign_write(camio_ostream_t* this, uint8_t* buffer, size_t len){
+    camio_ostream_mring_t* priv = this->priv;
+
+    if(!buffer){
+        eprintf_exit("Assigned buffer is null.");
+    }
+
+    CHECK_LEN_OK(len);
+    claim(priv, 1);
+
+    priv->assigned_buffer    = buffer;
+    priv->assigned_buffer_sz = len;
+
+    return 0;
+}
+
+
+/* ****************************************************
+ * Construction heavy lifting
+ */
+
+static camio_ostream_t* camio_ostream_mring_construct(camio_ostream_mring_t* priv, const camio_descr_t* descr, camio_clock_t* clock, camio_ostream_mring_params_t* params, camio_perf_t* perf_mon){
+    if(!priv){
+        eprintf_exit("mring stream supplied is null\n");
+    }
+    //Initialize the local variables
+    priv->is_closed             = 1;
+    priv->filename              = NULL;
+    priv->mring                 = NULL;
+    priv->write_pos             = 0;
+    priv->claimed               = 0;
+    priv->slot_size             = 0;
+    priv->slot_count            = 0;
+    priv->assigned_buffer       = NULL;
+    priv->assigned_buffer_sz    = 0;
+    priv->params                = params;
+
+
+    //Populate the function members
+    priv->ostream.priv              = priv; //Lets us access private members from public functions
+    priv->ostream.open              = camio_ostream_mring_open;
+    priv->ostream.close             = camio_ostream_mring_close;
+    priv->ostream.start_write       = camio_ostream_mring_start_write;
+    priv->ostream.end_write         = camio_ostream_mring_end_write;
+    priv->ostream.ready             = camio_ostream_mring_ready;
+    priv->ostream.delete            = camio_ostream_mring_delete;
+    priv->ostream.can_assign_write  = camio_ostream_mring_can_assign_write;
+    priv->ostream.assign_write      = camio_ostream_mring_assign_write;
+    priv->ostream.start_write_batch = camio_ostream_mring_start_write_batch;
+    priv->ostream.commit_batch      = camio_ostream_mring_commit_batch;
+    priv->ostream.try_start_write   = camio_ostream_mring_try_start_write;
+    priv->ostream.clock             = clock;
+    priv->ostream.fd                = -1;
+    priv->ostream.selector.fd       = -1;
+    priv->ostream.selector.ready    = camio_ostream_generic_selector_ready;
+
+    //Call open, because its the obvious thing to do now...
+    priv->ostream.open(&priv->ostream, descr, perf_mon);
+
+    //Return the generic ostream interface for the outside world
+    return &priv->ostream;
+
+}
+
+camio_ostream_t* camio_ostream_mring_new( const camio_descr_t* descr, camio_clock_t* clock, camio_ostream_mring_params_t* params, camio_perf_t* perf_mon){
+    camio_ostream_mring_t* priv = malloc(sizeof(camio_ostream_mring_t));
+    if(!priv){
+        eprintf_exit("No memory available for ostream mring creation\n");
+    }
+    return camio_ostream_mring_construct(priv, descr, clock, params, perf_mon);
+}
@@ -0,0 +1,49 @@
+/*
+ * camio_ostream_mring.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: mgrosvenor
+ */
+
+#ifndef CAMIO_OSTREAM_MRING_H_
+#define CAMIO_OSTREAM_MRING_H_
+
+#include "camio_ostream.h"
+
+/********************************************************************
+ *                  PRIVATE DEFS
+ ********************************************************************/
+
+
+typedef struct {
+    uint64_t slot_size;
+    uint64_t slot_count;
+} camio_ostream_mring_params_t;
+
+typedef struct {
+    camio_ostream_t ostream;
+    char* filename;                         //Keep the file name so the last one out can delete it
+    int is_closed;                          //Has close be called?
+    volatile uint8_t* mring;                //Pointer to the first slot of the mring
+    uint8_t* assigned_buffer;               //Assigned write buffer
+    size_t assigned_buffer_sz;              //Assigned write buffer size
+    uint64_t write_pos;                     //Position of the first slot we have claimed
+    uint64_t claimed;                       //Number of slots claimed from write_pos, but not yet published
+    uint64_t slot_size;                     //Size of each slot in the mring
+    uint64_t slot_count;                    //Number of slots in the mring
+    camio_ostream_mring_params_t* params;   //Parameters from the outside world
+    camio_perf_t* perf_mon;
+
+} camio_ostream_mring_t;
+
+
+
+/********************************************************************
+ *                  PUBLIC DEFS
+ ********************************************************************/
+
+camio_ostream_t* camio_ostream_mring_new( const camio_descr_t* opts, camio_clock_t* clock, camio_ostream_mring_params_t* params, camio_perf_t* perf_mon);
+
+
+
+#endif /* CAMIO_OSTREAM_MRING_H_ */
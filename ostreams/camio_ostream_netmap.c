@@ -520,9 +520,14 @@ camio_ostream_t* camio_ostream_netmap_construct(camio_ostream_netmap_t* priv, co
     priv->ostream.delete            = camio_ostream_netmap_delete;
     priv->ostream.can_assign_write  = camio_ostream_netmap_can_assign_write;
     priv->ostream.assign_write      = camio_ostream_netmap_assign_write;
+    priv->ostream.start_write_batch = camio_ostream_generic_start_write_batch;
+    priv->ostream.commit_batch      = camio_ostream_generic_commit_batch;
+    priv->ostream.try_start_write   = camio_ostream_generic_try_start_write;
     priv->ostream.flush             = camio_ostream_netmap_flush;
     priv->ostream.clock             = clock;
     priv->ostream.fd                = -1;
+    priv->ostream.selector.fd       = -1;
+    priv->ostream.selector.ready    = camio_ostream_generic_selector_ready;
 
     //Call open, because its the obvious thing to do now...
     priv->ostream.open(&priv->ostream, descr, perf_mon);
@@ -152,9 +152,14 @@ camio_ostream_t* camio_ostream_netmap_eth_construct(camio_ostream_netmap_eth_t*
     priv->ostream.delete            = camio_ostream_netmap_eth_delete;
     priv->ostream.can_assign_write  = camio_ostream_netmap_eth_can_assign_write;
     priv->ostream.assign_write      = camio_ostream_netmap_eth_assign_write;
+    priv->ostream.start_write_batch = camio_ostream_generic_start_write_batch;
+    priv->ostream.commit_batch      = camio_ostream_generic_commit_batch;
+    priv->ostream.try_start_write   = camio_ostream_generic_try_start_write;
     priv->ostream.flush             = camio_ostream_netmap_eth_flush;
     priv->ostream.clock             = clock;
     priv->ostream.fd                = -1;
+    priv->ostream.selector.fd       = -1;
+    priv->ostream.selector.ready    = camio_ostream_generic_selector_ready;
 
     //Call open, because its the obvious thing to do now...
     priv->ostream.open(&priv->ostream, descr, perf_mon);
@@ -15,6 +15,8 @@
  ********************************************************************/
 
 
+#define CAMIO_OSTREAM_RAW_BATCH_MAX 64     //Most frames sent by a single call to sendmmsg
+
 typedef struct {
     //No params at this stage
 } camio_ostream_raw_params_t;
@@ -26,6 +28,8 @@ typedef struct {
     size_t buffer_size;                     //Size of output buffer
     uint8_t* assigned_buffer;               //Assigned write buffer
     size_t assigned_buffer_sz;              //Assigned write buffer size
+    struct mmsghdr* msgs;                   //Message headers for batched writes
+    struct iovec* iovecs;                   //One entry per message in a batched write
     camio_ostream_raw_params_t* params;      //Parameters from the outside world
     camio_perf_t* perf_mon;
 
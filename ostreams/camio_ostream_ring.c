@@ -31,8 +31,37 @@ static int camio_ostream_ring_open(camio_ostream_t* this, const camio_descr_t* d
     priv->perf_mon = perf_mon;
 
 
+    if(priv->params){
+        priv->slot_size  = priv->params->slot_size;
+        priv->slot_count = priv->params->slot_count;
+    }
+    else{
+        priv->slot_size  = CAMIO_RING_SLOT_SIZE_DEFAULT;
+        priv->slot_count = CAMIO_RING_SLOT_COUNT_DEFAULT;
+    }
+
     if(unlikely(camio_descr_has_opts(descr->opt_head))){
-        eprintf_exit( "Option(s) supplied, but none expected\n");
+        struct camio_opt_t* opt;
+        for(opt = descr->opt_head; opt; opt = opt->next){
+            if(strcmp(opt->name,"slots") == 0){
+                camio_descr_get_opt_uint(opt, &priv->slot_count);
+            }
+            else if(strcmp(opt->name,"slot_size") == 0){
+                camio_descr_get_opt_uint(opt, &priv->slot_size);
+            }
+            else{
+                eprintf_exit( "Unknown option supplied \"%s\". Valid options for this stream are: \"slots=<uint64>\", \"slot_size=<uint64>\"\n", opt->name);
+            }
+        }
+    }
+
+    if(priv->slot_count < 1){
+        eprintf_exit( "Ring must have at least one slot\n");
+    }
+
+    //The length and sync words at the end of each slot need to be aligned
+    if(priv->slot_size < CAMIO_RING_SLOT_SIZE_MIN || priv->slot_size % sizeof(uint64_t)){
+        eprintf_exit( "Slot size (%lu) must be a multiple of %lu and at least %lu\n", priv->slot_size, sizeof(uint64_t), CAMIO_RING_SLOT_SIZE_MIN);
     }
 
     if(!descr->query){
@@ -81,8 +110,14 @@ static int camio_ostream_ring_open(camio_ostream_t* this, const camio_descr_t* d
 
     priv->ring_size = CAMIO_RING_MEM_SIZE;
     this->fd = ring_fd;
-    priv->ring = ring;
-    priv->curr = ring;
+    priv->ring = ring + CAMIO_RING_HEADER_SIZE;
+    priv->curr = priv->ring;
+
+    //Describe the ring so that istreams can find their way around it
+    ring_header->magic      = CAMIO_RING_MAGIC;
+    ring_header->version    = CAMIO_RING_VERSION;
+    ring_header->slot_size  = priv->slot_size;
+    ring_header->slot_count = priv->slot_count;
 
     ring_ostream_created = 1; //Tell any istreams that are listening that we are all initiliased.
     priv->is_closed = 0;
@@ -93,34 +128,90 @@ static int camio_ostream_ring_open(camio_ostream_t* this, const camio_descr_t* d
 
 static void camio_ostream_ring_close(camio_ostream_t* this){
     camio_ostream_ring_t* priv = this->priv;
-    munmap((void*)priv->ring, priv->ring_size);
+    if(priv->doorbell){
+        camio_doorbell_detach(priv->doorbell, (const char*)ring_doorbell->name);
+        priv->doorbell = NULL;
+    }
+    munmap((void*)ring_header, priv->ring_size);
     close(this->fd);
+    if(priv->wake_fd >= 0){
+        close(priv->wake_fd);
+        priv->wake_fd = -1;
+    }
     unlink(priv->filename); //Delete the file so reader can't get confused
     priv->is_closed = 1;
 }
 
 
+//Once we've seen the istream connect we never need to look at the shared flag again. The istream sets up its doorbell
+//before it connects, so this is where we attach to it, rather than on the write path.
+static inline int is_connected(camio_ostream_ring_t* priv){
+    if(likely(priv->connected)){
+        return 1;
+    }
+
+    priv->connected = ring_istream_connected != 0;
+    if(priv->connected && ring_doorbell->bit){
+        priv->doorbell = camio_doorbell_attach((const char*)ring_doorbell->name);
+    }
+    return priv->connected;
+}
+
+
+//Spin until the istream has connected, nothing can be sent before then
+static inline void wait_for_connect(camio_ostream_ring_t* priv){
+    while(unlikely(!is_connected(priv))){
+        asm("pause"); //relax the CPU while we're spinning
+    }
+}
+
+
+//An istream that does not spin forever may be asleep, or waiting on its wake fifo. It may also have a doorbell, which
+//it takes back when it closes, so the bit is read each time rather than kept.
+static inline void wake_istream(camio_ostream_ring_t* priv){
+    if(unlikely(ring_istream_wait != CAMIO_WAIT_SPIN)){
+        camio_wait_notify(ring_wait, priv->filename, &priv->wake_fd);
+    }
+
+    if(unlikely(priv->doorbell != NULL)){
+        const uint64_t bit = ring_doorbell->bit;
+        if(likely(bit)){
+            camio_doorbell_ring(priv->doorbell, bit - 1);
+        }
+    }
+}
+
+
 //Returns a pointer to a space of size len, ready for data
 //Returns NULL if this is impossible
 static uint8_t* camio_ostream_ring_start_write(camio_ostream_t* this, size_t len ){
     camio_ostream_ring_t* priv = this->priv;
     CHECK_LEN_OK(len);
 
-    if(unlikely(!ring_istream_connected)){
-        //printf("Waiting for istream to connect...\n");
-        while(!ring_istream_connected){
-            asm("PAUSE"); //Wait for an istream to connect before you send anything
-        }
-    }
+    wait_for_connect(priv);
 
     return (uint8_t*)priv->curr;
 }
 
-//Returns non-zero if a call to start_write will be non-blocking
+//Returns non-zero if a call to start_write will be non-blocking. The ring overwrites slow readers rather than waiting
+//for them, so the only thing we ever wait for is the first istream to connect.
 static int camio_ostream_ring_ready(camio_ostream_t* this){
-    //Not implemented
-    eprintf_exit( "\n");
-    return 0;
+    camio_ostream_ring_t* priv = this->priv;
+    return is_connected(priv);
+}
+
+
+//Returns a pointer to a space of size len, ready for data
+//Returns NULL if start_write would have to wait
+static uint8_t* camio_ostream_ring_try_start_write(camio_ostream_t* this, size_t len ){
+    camio_ostream_ring_t* priv = this->priv;
+    CHECK_LEN_OK(len);
+
+    if(unlikely(!is_connected(priv))){
+        return NULL;
+    }
+
+    return (uint8_t*)priv->curr;
 }
 
 
@@ -142,17 +233,71 @@ static uint8_t* camio_ostream_ring_end_write(camio_ostream_t* this, size_t len){
 
 
     priv->sync_count++;
-    *(volatile uint64_t*)(priv->curr + CAMIO_RING_SLOT_SIZE-2*sizeof(uint64_t)) = len;
-    *(volatile uint64_t*)(priv->curr + CAMIO_RING_SLOT_SIZE-1*sizeof(uint64_t)) = priv->sync_count; //Write is now committed
+    *(volatile uint64_t*)(priv->curr + priv->slot_size-2*sizeof(uint64_t)) = len;
+    *(volatile uint64_t*)(priv->curr + priv->slot_size-1*sizeof(uint64_t)) = priv->sync_count; //Write is now committed
     //printf("CAMIO_RING: Sync count = %lu\n", priv->sync_count);
+    wake_istream(priv);
 
-    priv->index = (priv->index + 1) % ( CAMIO_RING_SLOT_COUNT);
-    priv->curr  = priv->ring + (priv->index * CAMIO_RING_SLOT_SIZE);
+    priv->index = (priv->index + 1) % (priv->slot_count);
+    priv->curr  = priv->ring + (priv->index * priv->slot_size);
 
     return NULL;
 }
 
 
+//Returns up to count consecutive slots, ready for data
+static int camio_ostream_ring_start_write_batch(camio_ostream_t* this, camio_batch_item_t* items, size_t count){
+    camio_ostream_ring_t* priv = this->priv;
+
+    wait_for_connect(priv);
+
+    count = MIN(count, priv->slot_count);
+    size_t i = 0;
+    for(; i < count; i++){
+        CHECK_LEN_OK(items[i].len);
+        items[i].buffer = (uint8_t*)priv->ring + ((priv->index + i) % priv->slot_count) * priv->slot_size;
+    }
+
+    return count;
+}
+
+
+//Fill in all of the slots first, then publish them to the reader in a single pass, so the reader sees the whole batch at
+//once and the data stores are never interleaved with the sync counter stores.
+static int camio_ostream_ring_commit_batch(camio_ostream_t* this, camio_batch_item_t* items, size_t count){
+    camio_ostream_ring_t* priv = this->priv;
+
+    wait_for_connect(priv);
+
+    camio_perf_event_stop(priv->perf_mon, CAMIO_PERF_EVENT_OSTREAM_RING, CAMIO_PERF_COND_WRITE);
+
+    count = MIN(count, priv->slot_count);
+    size_t i = 0;
+    for(; i < count; i++){
+        CHECK_LEN_OK(items[i].len);
+        volatile uint8_t* slot = priv->ring + ((priv->index + i) % priv->slot_count) * priv->slot_size;
+        if(items[i].buffer != (uint8_t*)slot){
+            memcpy((uint8_t*)slot, items[i].buffer, items[i].len);
+        }
+        *(volatile uint64_t*)(slot + priv->slot_size-2*sizeof(uint64_t)) = items[i].len;
+    }
+
+    asm volatile("" ::: "memory"); //Make sure the compiler does not sink the data stores below the publish
+
+    for(i = 0; i < count; i++){
+        volatile uint8_t* slot = priv->ring + ((priv->index + i) % priv->slot_count) * priv->slot_size;
+        priv->sync_count++;
+        *(volatile uint64_t*)(slot + priv->slot_size-1*sizeof(uint64_t)) = priv->sync_count; //Write is now committed
+    }
+    wake_istream(priv);
+
+    priv->index = (priv->index + count) % (priv->slot_count);
+    priv->curr  = priv->ring + (priv->index * priv->slot_size);
+
+    return count;
+}
+
+
 static void camio_ostream_ring_delete(camio_ostream_t* ostream){
     ostream->close(ostream);
     camio_ostream_ring_t* priv = ostream->priv;
@@ -175,12 +320,7 @@ static int camio_ostream_ring_assign_write(camio_ostream_t* this, uint8_t* buffe
     CHECK_LEN_OK(len);
 
 
-    if(unlikely(!ring_istream_connected)){
-        //printf("Waiting for istream to connect...\n");
-        while(!ring_istream_connected){
-            asm("PAUSE"); //Wait for an istream to connect before you send anything
-        }
-    }
+    wait_for_connect(priv);
 
     priv->assigned_buffer    = buffer;
     priv->assigned_buffer_sz = len;
@@ -199,11 +339,16 @@ static camio_ostream_t* camio_ostream_ring_construct(camio_ostream_ring_t* priv,
     }
     //Initialize the local variables
     priv->is_closed             = 1;
+    priv->wake_fd               = -1;
+    priv->doorbell              = NULL;
+    priv->connected             = 0;
     priv->ring                  = NULL;
     priv->ring_size             = 0;
     priv->curr                  = NULL;
     priv->sync_count            = 0;
     priv->index                 = 0;
+    priv->slot_size             = 0;
+    priv->slot_count            = 0;
     priv->assigned_buffer       = NULL;
     priv->assigned_buffer_sz    = 0;
     priv->params                = params;
@@ -219,8 +364,13 @@ static camio_ostream_t* camio_ostream_ring_construct(camio_ostream_ring_t* priv,
     priv->ostream.delete            = camio_ostream_ring_delete;
     priv->ostream.can_assign_write  = camio_ostream_ring_can_assign_write;
     priv->ostream.assign_write      = camio_ostream_ring_assign_write;
+    priv->ostream.start_write_batch = camio_ostream_ring_start_write_batch;
+    priv->ostream.commit_batch      = camio_ostream_ring_commit_batch;
+    priv->ostream.try_start_write   = camio_ostream_ring_try_start_write;
     priv->ostream.clock             = clock;
     priv->ostream.fd                = -1;
+    priv->ostream.selector.fd       = -1;
+    priv->ostream.selector.ready    = camio_ostream_generic_selector_ready;
 
     //Call open, because its the obvious thing to do now...
     priv->ostream.open(&priv->ostream, descr, perf_mon);
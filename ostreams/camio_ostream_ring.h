@@ -9,6 +9,7 @@
 #define CAMIO_OSTREAM_RING_H_
 
 #include "camio_ostream.h"
+#include "../utils/camio_doorbell.h"
 
 /********************************************************************
  *                  PRIVATE DEFS
@@ -16,7 +17,8 @@
 
 
 typedef struct {
-    //No params at this stage
+    uint64_t slot_size;
+    uint64_t slot_count;
 } camio_ostream_ring_params_t;
 
 typedef struct {
@@ -30,6 +32,11 @@ typedef struct {
     size_t assigned_buffer_sz;              //Assigned write buffer size
     uint64_t sync_count;                    //Synchronization counter
     uint64_t index;                         //Current slot in the ring
+    uint64_t slot_size;                     //Size of each slot in the ring
+    uint64_t slot_count;                    //Number of slots in the ring
+    int wake_fd;                            //Write end of the istream's wake fifo, opened when first needed
+    int connected;                          //Has the istream connected? Saves going back to the shared flag
+    volatile camio_doorbell_t* doorbell;    //The istream's doorbell, if it had one when it connected
     camio_ostream_ring_params_t* params;     //Parameters from the outside world
     camio_perf_t* perf_mon;
 
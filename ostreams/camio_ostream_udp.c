@@ -1,3 +1,4 @@
+//#CFLAGS=-D_GNU_SOURCE
 /*
  * Copyright  (C) Matthew P. Grosvenor, 2012, All Rights Reserved
  *
@@ -8,6 +9,7 @@
 #include <stdio.h>
 #include <unistd.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <netinet/in.h>
 #include <sys/ioctl.h>
 #include <net/if.h>
@@ -93,6 +95,22 @@ int camio_ostream_udp_open(camio_ostream_t* this, const camio_descr_t* descr, ca
     addr.sin_port        = htons(strtol(udp_port,NULL,10));
 
     priv->addr = addr;
+
+    //Message headers for batched writes, the iovecs are filled in on each commit
+    priv->msgs   = calloc(CAMIO_OSTREAM_UDP_BATCH_MAX, sizeof(struct mmsghdr));
+    priv->iovecs = calloc(CAMIO_OSTREAM_UDP_BATCH_MAX, sizeof(struct iovec));
+    if(!priv->msgs || !priv->iovecs){
+        eprintf_exit( "Failed to allocate batch descriptors\n");
+    }
+
+    size_t j = 0;
+    for(j = 0; j < CAMIO_OSTREAM_UDP_BATCH_MAX; j++){
+        priv->msgs[j].msg_hdr.msg_iov     = &priv->iovecs[j];
+        priv->msgs[j].msg_hdr.msg_iovlen  = 1;
+        priv->msgs[j].msg_hdr.msg_name    = &priv->addr;
+        priv->msgs[j].msg_hdr.msg_namelen = sizeof(priv->addr);
+    }
+
     this->fd = udp_sock_fd;
     priv->is_closed = 0;
     return 0;
@@ -101,6 +119,10 @@ int camio_ostream_udp_open(camio_ostream_t* this, const camio_descr_t* descr, ca
 void camio_ostream_udp_close(camio_ostream_t* this){
     camio_ostream_udp_t* priv = this->priv;
     close(this->fd);
+    free(priv->msgs);
+    free(priv->iovecs);
+    priv->msgs   = NULL;
+    priv->iovecs = NULL;
     priv->is_closed = 1;
 }
 
@@ -179,6 +201,64 @@ uint8_t* camio_ostream_udp_end_write(camio_ostream_t* this, size_t len){
 }
 
 
+//Carve the output buffer up so that every item in the batch gets its own space
+static int camio_ostream_udp_start_write_batch(camio_ostream_t* this, camio_batch_item_t* items, size_t count){
+    camio_ostream_udp_t* priv = this->priv;
+    size_t total = 0;
+    size_t i = 0;
+
+    for(i = 0; i < count; i++){
+        total += items[i].len;
+    }
+
+    //Grow the buffer if it's not big enough
+    if(total > priv->buffer_size){
+        priv->buffer = realloc(priv->buffer, total);
+        if(!priv->buffer){
+            eprintf_exit( "Could not grow message buffer\n");
+        }
+        priv->buffer_size = total;
+    }
+
+    uint8_t* head = priv->buffer;
+    for(i = 0; i < count; i++){
+        items[i].buffer = head;
+        head += items[i].len;
+    }
+
+    return count;
+}
+
+
+//Send the whole batch with as few system calls as possible
+static int camio_ostream_udp_commit_batch(camio_ostream_t* this, camio_batch_item_t* items, size_t count){
+    camio_ostream_udp_t* priv = this->priv;
+    size_t sent = 0;
+    size_t i = 0;
+
+    camio_perf_event_stop(priv->perf_mon, CAMIO_PERF_EVENT_OSTREAM_UDP, CAMIO_PERF_COND_WRITE);
+    while(sent < count){
+        const size_t todo = MIN(count - sent, CAMIO_OSTREAM_UDP_BATCH_MAX);
+        for(i = 0; i < todo; i++){
+            priv->iovecs[i].iov_base = items[sent + i].buffer;
+            priv->iovecs[i].iov_len  = items[sent + i].len;
+        }
+
+        const int result = sendmmsg(this->fd, priv->msgs, todo, 0);
+        if(unlikely(result < 0)){
+            if(errno == EAGAIN){
+                continue;
+            }
+            eprintf_exit( "Could not send on udp socket. Error = %s\n", strerror(errno));
+        }
+
+        sent += result;
+    }
+
+    return sent;
+}
+
+
 void camio_ostream_udp_delete(camio_ostream_t* ostream){
     ostream->close(ostream);
     camio_ostream_udp_t* priv = ostream->priv;
@@ -219,6 +299,8 @@ camio_ostream_t* camio_ostream_udp_construct(camio_ostream_udp_t* priv, const ca
     priv->buffer                = NULL;
     priv->assigned_buffer       = NULL;
     priv->assigned_buffer_sz    = 0;
+    priv->msgs                  = NULL;
+    priv->iovecs                = NULL;
     priv->params                = params;
 
 
@@ -232,8 +314,13 @@ camio_ostream_t* camio_ostream_udp_construct(camio_ostream_udp_t* priv, const ca
     priv->ostream.delete            = camio_ostream_udp_delete;
     priv->ostream.can_assign_write  = camio_ostream_udp_can_assign_write;
     priv->ostream.assign_write      = camio_ostream_udp_assign_write;
+    priv->ostream.start_write_batch = camio_ostream_udp_start_write_batch;
+    priv->ostream.commit_batch      = camio_ostream_udp_commit_batch;
+    priv->ostream.try_start_write   = camio_ostream_generic_try_start_write;
     priv->ostream.clock             = clock;
     priv->ostream.fd                = -1;
+    priv->ostream.selector.fd       = -1;
+    priv->ostream.selector.ready    = camio_ostream_generic_selector_ready;
 
     //Call open, because its the obvious thing to do now...
     priv->ostream.open(&priv->ostream, descr, perf_mon);
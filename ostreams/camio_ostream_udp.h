@@ -17,6 +17,8 @@
  ********************************************************************/
 
 
+#define CAMIO_OSTREAM_UDP_BATCH_MAX 64     //Most datagrams sent by a single call to sendmmsg
+
 typedef struct {
     //No params at this stage
 } camio_ostream_udp_params_t;
@@ -29,6 +31,8 @@ typedef struct {
     size_t buffer_size;                     //Size of output buffer
     uint8_t* assigned_buffer;                  //Assigned write buffer
     size_t assigned_buffer_sz;              //Assigned write buffer size
+    struct mmsghdr* msgs;                   //Message headers for batched writes
+    struct iovec* iovecs;                   //One entry per message in a batched write
     camio_ostream_udp_params_t* params;      //Parameters from the outside world
     camio_perf_t* perf_mon;
 
@@ -6,64 +6,468 @@
  */
 
 #include <string.h>
+#include <stdio.h>
+#include <sys/syscall.h>
 
 #include "camio_perf.h"
 #include "../utils/camio_util.h"
+#include "../utils/camio_tsc.h"
 #include "../errors/camio_errors.h"
 #include "../ostreams/camio_ostream.h"
+#include "../stream_description/camio_opt_parser.h"
+#include "camio_perf_counters.h"
+
+#define CAMIO_PERF_TEXT_BUFF (1024)
+#define CAMIO_PERF_WRITE_CHUNK (1024 * 1024)
+
+
+const char* camio_perf_event_names[CAMIO_PERF_EVENT_COUNT] = {
+    [CAMIO_PERF_EVENT_ISTREAM_BLOB]          = "istream_blob",
+    [CAMIO_PERF_EVENT_ISTREAM_DAG]           = "istream_dag",
+    [CAMIO_PERF_EVENT_ISTREAM_LOG]           = "istream_log",
+    [CAMIO_PERF_EVENT_ISTREAM_NETMAP]        = "istream_netmap",
+    [CAMIO_PERF_EVENT_ISTREAM_PCAP]          = "istream_pcap",
+    [CAMIO_PERF_EVENT_ISTREAM_PERIODIC_FAST] = "istream_periodic_fast",
+    [CAMIO_PERF_EVENT_ISTREAM_PERIODIC]      = "istream_periodic",
+    [CAMIO_PERF_EVENT_ISTREAM_RAW]           = "istream_raw",
+    [CAMIO_PERF_EVENT_ISTREAM_RING]          = "istream_ring",
+    [CAMIO_PERF_EVENT_ISTREAM_BRING]         = "istream_bring",
+    [CAMIO_PERF_EVENT_ISTREAM_MRING]         = "istream_mring",
+    [CAMIO_PERF_EVENT_ISTREAM_BCAST]         = "istream_bcast",
+    [CAMIO_PERF_EVENT_ISTREAM_UDP]           = "istream_udp",
+    [CAMIO_PERF_EVENT_ISTREAM_FIO]           = "istream_fio",
+
+    [CAMIO_PERF_EVENT_OSTREAM_BLOB]          = "ostream_blob",
+    [CAMIO_PERF_EVENT_OSTREAM_LOG]           = "ostream_log",
+    [CAMIO_PERF_EVENT_OSTREAM_NETMAP]        = "ostream_netmap",
+    [CAMIO_PERF_EVENT_OSTREAM_RAW]           = "ostream_raw",
+    [CAMIO_PERF_EVENT_OSTREAM_RING]          = "ostream_ring",
+    [CAMIO_PERF_EVENT_OSTREAM_BRING]         = "ostream_bring",
+    [CAMIO_PERF_EVENT_OSTREAM_MRING]         = "ostream_mring",
+    [CAMIO_PERF_EVENT_OSTREAM_BCAST]         = "ostream_bcast",
+    [CAMIO_PERF_EVENT_OSTREAM_UDP]           = "ostream_udp",
+
+    [CAMIO_PERF_EVENT_IOSTREAM_TCP]          = "iostream_tcp",
+    [CAMIO_PERF_EVENT_IOSTREAM_TCPS]         = "iostream_tcps",
+    [CAMIO_PERF_EVENT_IOSTREAM_UDP]          = "iostream_udp",
+    [CAMIO_PERF_EVENT_IOSTREAM_SHMEM]        = "iostream_shmem",
+
+    [CAMIO_PERF_EVENT_SELECTOR_WEIGHTED]     = "selector_weighted",
+};
+
+const char* camio_perf_cond_names[CAMIO_PERF_COND_COUNT] = {
+    [CAMIO_PERF_COND_NEW_DATA]               = "new_data",
+    [CAMIO_PERF_COND_EXISTING_DATA]          = "existing_data",
+    [CAMIO_PERF_COND_NO_DATA]                = "no_data",
+    [CAMIO_PERF_COND_READ_ERROR]             = "read_error",
+
+    [CAMIO_PERF_COND_WRITE]                  = "write",
+    [CAMIO_PERF_COND_WRITE_ASSIGNED]         = "write_assigned",
+    [CAMIO_PERF_COND_WRITE_ESCAPED]          = "write_escaped",
+    [CAMIO_PERF_COND_WRITE_ERROR]            = "write_error",
+};
+
+
+__thread camio_perf_thread_cache_t camio_perf_thread_cache[CAMIO_PERF_THREAD_CACHE];
+static __thread uint64_t camio_perf_thread_tid  = 0;  //Fetched once per thread
+static uint64_t camio_perf_next_id              = 0;
+
+
+//Event names separated by '+', since ',' separates the options
+static uint64_t parse_events(const char* value){
+    if(!value){
+        eprintf_exit("Perf option events needs a list of events, eg events=istream_udp+ostream_udp\n");
+    }
+
+    uint64_t mask = 0;
+    while(*value){
+        const char* end = strchr(value, '+');
+        const size_t len = end ? (size_t)(end - value) : strlen(value);
+
+        uint32_t i = 0;
+        for(; i < CAMIO_PERF_EVENT_COUNT; i++){
+            if(strlen(camio_perf_event_names[i]) == len && strncmp(camio_perf_event_names[i], value, len) == 0){
+                break;
+            }
+        }
+        if(i == CAMIO_PERF_EVENT_COUNT){
+            eprintf_exit("Unknown perf event \"%.*s\"\n", (int)len, value);
+        }
+        mask |= 1ULL << i;
+
+        value += len + (end ? 1 : 0);
+    }
+
+    return mask;
+}
+
+
+//Take the perf options off the end of the output description, and put back whatever is left for the output stream
+static void parse_output_descr(camio_perf_t* camio_perf, char* output_descr){
+    camio_perf->output_descr = output_descr;
+    if(!output_descr || !*output_descr){
+        return;
+    }
+
+    camio_descr_t descr;
+    camio_descr_construct(&descr);
+    camio_descr_parse(output_descr, &descr);
+
+    char* out = calloc(1, strlen(output_descr) + 1);
+    if(!out){
+        eprintf_exit("Could not allocate memory for camio perf output description\n");
+    }
+    strcat(out, descr.protocol);
+    if(descr.query){
+        strcat(out, ":");
+        strcat(out, descr.query);
+    }
+
+    struct camio_opt_t* opt = NULL;
+    for(opt = descr.opt_head; opt; opt = opt->next){
+        if(strcmp("ring", opt->name) == 0){
+            if(camio_descr_get_opt_bool(opt, &camio_perf->ring)){
+                eprintf_exit("Could not parse perf option ring=\"%s\"\n", opt->value);
+            }
+        }
+        else if(strcmp("counters", opt->name) == 0){
+            if(camio_descr_get_opt_bool(opt, &camio_perf->counters)){
+                eprintf_exit("Could not parse perf option counters=\"%s\"\n", opt->value);
+            }
+        }
+        else if(strcmp("events", opt->name) == 0){
+            camio_perf->event_mask = parse_events(opt->value);
+        }
+        else if(strcmp("sample", opt->name) == 0){
+            if(camio_descr_get_opt_uint(opt, &camio_perf->sample) || !camio_perf->sample){
+                eprintf_exit("Could not parse perf option sample=\"%s\", expected 1 or more\n", opt->value);
+            }
+        }
+        else if(strcmp("format", opt->name) == 0){
+            if(strcmp("bin", opt->value) == 0){
+                camio_perf->binary = 1;
+            }
+            else if(strcmp("text", opt->value) == 0){
+                camio_perf->binary = 0;
+            }
+            else{
+                eprintf_exit("Unknown perf output format \"%s\", expected bin or text\n", opt->value);
+            }
+        }
+        else{
+            strcat(out, ",");
+            strcat(out, opt->name);
+            if(opt->value){
+                strcat(out, "=");
+                strcat(out, opt->value);
+            }
+        }
+    }
+
+    if(camio_perf->binary && strcmp("log", descr.protocol) == 0){
+        eprintf_exit("Binary perf output needs a byte stream, try \"blob:%s\"\n", descr.query ? descr.query : "");
+    }
+
+    camio_descr_destroy(&descr);
+    camio_perf->output_descr = out;
+}
+
 
 camio_perf_t* camio_perf_init(char* output_descr, uint64_t max_events_count){
     if(sizeof(camio_perf_event_t) != 2 * sizeof(uint64_t)){
         eprintf_exit("size of camio_perf_event_t is not a multiple of uin64_t");
     }
 
+    if(CAMIO_PERF_EVENT_COUNT > 64){
+        eprintf_exit("There are more event IDs than bits in the event mask\n");
+    }
+
     camio_perf_t* result = malloc(sizeof(camio_perf_t));
     if(!result){
         eprintf_exit("Could not allocate memory for camio perf\n");
     }
     bzero(result,sizeof(camio_perf_t));
 
-    result->events = malloc(sizeof(camio_perf_event_t) * max_events_count);
-    if(!result){
-        eprintf_exit("Could not allocate memory for camio perf events\n");
+    result->event_mask = ~0ULL;
+    result->sample     = 1;
+    parse_output_descr(result, output_descr);
+    result->id = __sync_add_and_fetch(&camio_perf_next_id, 1);
+
+    if(!max_events_count){
+        result->event_mask = 0; //Nothing to log into, so don't even look for a buffer
+    }
+
+    if(result->ring && max_events_count){
+        //Round up to a power of two, so that an index becomes a slot with a mask
+        uint64_t size = 1;
+        while(size < max_events_count){
+            size <<= 1;
+        }
+        result->max_events = size;
+        result->limit      = ~0ULL;
+        result->mask       = size - 1;
+    }
+    else{
+        result->ring       = 0;
+        result->max_events = max_events_count;
+        result->limit      = max_events_count;
+        result->mask       = ~0ULL;
     }
 
-    bzero(result->events,sizeof(camio_perf_event_t) * max_events_count);
-    result->output_descr = output_descr;
-    result->max_events   = max_events_count;
     return result;
 }
 
+
+void camio_perf_enable(camio_perf_t* camio_perf, uint32_t event, int enable){
+    if(!camio_perf->max_events || event >= 64){
+        return;
+    }
+
+    if(enable){
+        __sync_fetch_and_or(&camio_perf->event_mask, 1ULL << event);
+    }
+    else{
+        __sync_fetch_and_and(&camio_perf->event_mask, ~(1ULL << event));
+    }
+}
+
+
+//Slow path of camio_perf_buff(), the first time a thread logs to a monitor, or when two monitors share a cache slot
+camio_perf_buff_t* camio_perf_buff_find(camio_perf_t* camio_perf){
+    if(unlikely(!camio_perf_thread_tid)){
+        camio_perf_thread_tid = syscall(SYS_gettid);
+    }
+    const uint64_t tid = camio_perf_thread_tid;
+
+    camio_perf_buff_t* buff = camio_perf->buffs;
+    for(; buff; buff = buff->next){
+        if(buff->tid == tid){
+            break;
+        }
+    }
+
+    if(!buff){
+        buff = calloc(1, sizeof(camio_perf_buff_t) + sizeof(camio_perf_event_t) * camio_perf->max_events);
+        if(!buff){
+            eprintf_exit("Could not allocate memory for camio perf events\n");
+        }
+        buff->tid = tid;
+
+        if(camio_perf->counters && camio_perf->max_events){
+            buff->counter_kind = camio_perf_counters_open(buff->counter_fds);
+            if(buff->counter_kind != CAMIO_PERF_COUNTERS_NONE){
+                buff->counts = calloc(camio_perf->max_events, sizeof(camio_perf_counts_t));
+                if(!buff->counts){
+                    eprintf_exit("Could not allocate memory for camio perf counts\n");
+                }
+            }
+        }
+
+        //Only this thread will ever add a buffer with this tid, so there's no need to search the list again
+        do{
+            buff->next = camio_perf->buffs;
+        } while(!__sync_bool_compare_and_swap(&camio_perf->buffs, buff->next, buff));
+    }
+
+    camio_perf_thread_cache_t* cache = &camio_perf_thread_cache[camio_perf->id & (CAMIO_PERF_THREAD_CACHE - 1)];
+    cache->id   = camio_perf->id;
+    cache->buff = buff;
+    return buff;
+}
+
+
+//Slots in a buffer, oldest first, as up to two runs
+static uint64_t buff_runs(const camio_perf_t* camio_perf, const camio_perf_buff_t* buff, uint64_t* runs,
+        uint64_t* lens){
+    if(!camio_perf->ring || buff->event_index <= camio_perf->max_events){
+        runs[0] = 0;
+        lens[0] = MIN(buff->event_index, camio_perf->max_events);
+        runs[1] = 0;
+        lens[1] = 0;
+        return lens[0];
+    }
+
+    const uint64_t head = buff->event_index & camio_perf->mask;
+    runs[0] = head;
+    lens[0] = camio_perf->max_events - head;
+    runs[1] = 0;
+    lens[1] = head;
+    return camio_perf->max_events;
+}
+
+
+static void write_bytes(camio_ostream_t* out, const void* data, uint64_t len){
+    const uint8_t* bytes = data;
+    while(len){
+        const uint64_t chunk = MIN(len, CAMIO_PERF_WRITE_CHUNK);
+        out->assign_write(out, (uint8_t*)bytes, chunk);
+        out->end_write(out, chunk);
+        bytes += chunk;
+        len   -= chunk;
+    }
+}
+
+
+static void finish_binary(camio_perf_t* camio_perf, camio_ostream_t* out){
+    camio_tsc_t tsc;
+    camio_tsc_calibrate(&tsc, CLOCK_REALTIME);
+
+    camio_perf_file_hdr_t hdr;
+    bzero(&hdr, sizeof(hdr));
+    memcpy(hdr.magic, CAMIO_PERF_FILE_MAGIC, sizeof(hdr.magic));
+    hdr.version       = CAMIO_PERF_FILE_VERSION;
+    hdr.event_size    = sizeof(camio_perf_event_t);
+    hdr.tsc_hz        = (uint64_t)(((unsigned __int128)tsc.tsc_per_ns * 1000 * 1000 * 1000) >> 32);
+    hdr.tsc_base      = tsc.tsc_base;
+    hdr.ns_base       = tsc.ns_base;
+    hdr.event_names   = CAMIO_PERF_EVENT_COUNT;
+    hdr.cond_names    = CAMIO_PERF_COND_COUNT;
+    hdr.counters      = CAMIO_PERF_COUNTERS;
+    hdr.counter_kinds = CAMIO_PERF_COUNTERS_KINDS;
+
+    camio_perf_buff_t* buff = camio_perf->buffs;
+    for(; buff; buff = buff->next){
+        hdr.buff_count++;
+    }
+    write_bytes(out, &hdr, sizeof(hdr));
+
+    char names[CAMIO_PERF_EVENT_COUNT + CAMIO_PERF_COND_COUNT + CAMIO_PERF_COUNTERS_KINDS * CAMIO_PERF_COUNTERS][CAMIO_PERF_FILE_NAME_LEN];
+    bzero(names, sizeof(names));
+    size_t i = 0;
+    for(i = 0; i < CAMIO_PERF_EVENT_COUNT; i++){
+        strncpy(names[i], camio_perf_event_names[i], CAMIO_PERF_FILE_NAME_LEN - 1);
+    }
+    for(i = 0; i < CAMIO_PERF_COND_COUNT; i++){
+        strncpy(names[CAMIO_PERF_EVENT_COUNT + i], camio_perf_cond_names[i], CAMIO_PERF_FILE_NAME_LEN - 1);
+    }
+    for(i = 0; i < CAMIO_PERF_COUNTERS_KINDS * CAMIO_PERF_COUNTERS; i++){
+        strncpy(names[CAMIO_PERF_EVENT_COUNT + CAMIO_PERF_COND_COUNT + i],
+                camio_perf_counter_names[i / CAMIO_PERF_COUNTERS][i % CAMIO_PERF_COUNTERS], CAMIO_PERF_FILE_NAME_LEN - 1);
+    }
+    write_bytes(out, names, sizeof(names));
+
+    for(buff = camio_perf->buffs; buff; buff = buff->next){
+        uint64_t runs[2];
+        uint64_t lens[2];
+        camio_perf_file_buff_t file_buff;
+        file_buff.tid          = buff->tid;
+        file_buff.event_count  = buff->event_count;
+        file_buff.events       = buff_runs(camio_perf, buff, runs, lens);
+        file_buff.ring         = camio_perf->ring;
+        file_buff.counter_kind = buff->counts ? buff->counter_kind : CAMIO_PERF_COUNTERS_NONE;
+        write_bytes(out, &file_buff, sizeof(file_buff));
+        write_bytes(out, buff->events + runs[0], lens[0] * sizeof(camio_perf_event_t));
+        write_bytes(out, buff->events + runs[1], lens[1] * sizeof(camio_perf_event_t));
+        if(buff->counts){
+            write_bytes(out, buff->counts + runs[0], lens[0] * sizeof(camio_perf_counts_t));
+            write_bytes(out, buff->counts + runs[1], lens[1] * sizeof(camio_perf_counts_t));
+        }
+    }
+}
+
+
+static void finish_text(camio_perf_t* camio_perf, camio_ostream_t* out){
+    char out_buff[CAMIO_PERF_TEXT_BUFF];
+    uint64_t out_len;
+
+    uint64_t event_count = 0;
+    uint64_t event_index = 0;
+    camio_perf_buff_t* buff = camio_perf->buffs;
+    for(; buff; buff = buff->next){
+        event_count += buff->event_count;
+        event_index += buff->event_index;
+    }
+
+    out_len = snprintf(out_buff,CAMIO_PERF_TEXT_BUFF,"F %lu, C %lu", event_count, event_index);
+    out->assign_write(out,(uint8_t*)out_buff,out_len);
+    out->end_write(out,out_len);
+
+    for(buff = camio_perf->buffs; buff; buff = buff->next){
+        uint64_t runs[2];
+        uint64_t lens[2];
+        buff_runs(camio_perf, buff, runs, lens);
+
+        out_len = snprintf(out_buff,CAMIO_PERF_TEXT_BUFF,"T %lu, F %lu, C %lu", buff->tid, buff->event_count, buff->event_index);
+        if(buff->counts){
+            //Name the counters that follow the events
+            int c = 0;
+            for(c = 0; c < CAMIO_PERF_COUNTERS; c++){
+                out_len += snprintf(out_buff + out_len, CAMIO_PERF_TEXT_BUFF - out_len, ", %s",
+                        camio_perf_counter_names[buff->counter_kind][c]);
+            }
+        }
+        out->assign_write(out,(uint8_t*)out_buff,out_len);
+        out->end_write(out,out_len);
+
+        int run = 0;
+        for(run = 0; run < 2; run++){
+            size_t i = 0;
+            for(i = 0; i < lens[run]; i++ ){
+                const camio_perf_event_t event = buff->events[runs[run] + i];
+                const char start_stop = event.event_id & CAMIO_PERF_EVENT_STOP ? 'O' : 'A'; //"stArt", "stOp"
+                const uint64_t event_id = event.event_id & ~CAMIO_PERF_EVENT_STOP;
+                out_len = snprintf(out_buff,CAMIO_PERF_TEXT_BUFF,"%c, %lu, %lu, %u",  start_stop, event.ts, event_id, event.cond_id);
+                const camio_perf_counts_t* counts = buff->counts ? &buff->counts[runs[run] + i] : NULL;
+                if(counts && counts->values[0] != CAMIO_PERF_COUNT_NONE){
+                    int c = 0;
+                    for(c = 0; c < CAMIO_PERF_COUNTERS; c++){
+                        out_len += snprintf(out_buff + out_len, CAMIO_PERF_TEXT_BUFF - out_len, ", %lu", counts->values[c]);
+                    }
+                }
+                out->assign_write(out,(uint8_t*)out_buff,out_len);
+                out->end_write(out,out_len);
+            }
+        }
+    }
+}
+
+
 void camio_perf_finish(camio_perf_t* camio_perf){
     if(!camio_perf){
         return;
     }
 
-    if(camio_perf->event_index && camio_perf->max_events){
-        char out_buff[1024];
-        uint64_t out_len;
+    uint64_t stored = 0;
+    camio_perf_buff_t* buff = camio_perf->buffs;
+    for(; buff; buff = buff->next){
+        stored += buff->event_index;
+    }
+
+    if(stored && camio_perf->max_events){
         camio_ostream_t* out = camio_ostream_new(camio_perf->output_descr,NULL,NULL, NULL);
         if(!out){
             eprintf_exit("Could not create output stream for camio perf\n");
         }
 
-        out_len = snprintf(out_buff,1024,"F %lu, C %lu", camio_perf->event_count, camio_perf->event_index);
-        out->assign_write(out,(uint8_t*)out_buff,out_len);
-        out->end_write(out,out_len);
-        size_t i = 0;
-        for(i = 0; i < MIN(camio_perf->event_index, camio_perf->max_events); i++ ){
-            const camio_perf_event_t event = camio_perf->events[i];
-            char start_stop = event.event_id > (1<<31) ? 'O' : 'A'; //"stArt", "stOp"
-            const uint64_t event_id = event.event_id > (1<<31) ? event.event_id & ~(1<<31) : event.event_id;
-            out_len = snprintf(out_buff,1024,"%c, %lu, %lu, %u",  start_stop, event.ts, event_id, event.cond_id);
-            out->assign_write(out,(uint8_t*)out_buff,out_len);
-            out->end_write(out,out_len);
+        if(camio_perf->binary){
+            finish_binary(camio_perf, out);
+        }
+        else{
+            finish_text(camio_perf, out);
         }
 
         out->delete(out);
     }
 
+    buff = camio_perf->buffs;
+    while(buff){
+        camio_perf_buff_t* next = buff->next;
+        if(buff->counts){
+            camio_perf_counters_close(buff->counter_fds);
+            free(buff->counts);
+        }
+        free(buff);
+        buff = next;
+    }
 
-    free(camio_perf->events);
+    camio_perf_thread_cache_t* cache = &camio_perf_thread_cache[camio_perf->id & (CAMIO_PERF_THREAD_CACHE - 1)];
+    if(cache->id == camio_perf->id){
+        cache->id   = 0;
+        cache->buff = NULL;
+    }
+
+    if(camio_perf->output_descr && *camio_perf->output_descr){
+        free(camio_perf->output_descr);
+    }
     free(camio_perf);
 }
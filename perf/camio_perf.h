@@ -12,6 +12,9 @@
 #include <stdint.h>
 #include <stdlib.h>
 
+#include "../utils/camio_util.h"
+#include "camio_perf_counters.h"
+
 
 typedef struct {
     uint64_t ts;             //Time the event was logged
@@ -31,6 +34,8 @@ enum {
     CAMIO_PERF_EVENT_ISTREAM_RAW,
     CAMIO_PERF_EVENT_ISTREAM_RING,
     CAMIO_PERF_EVENT_ISTREAM_BRING,
+    CAMIO_PERF_EVENT_ISTREAM_MRING,
+    CAMIO_PERF_EVENT_ISTREAM_BCAST,
     CAMIO_PERF_EVENT_ISTREAM_UDP,
     CAMIO_PERF_EVENT_ISTREAM_FIO,
 
@@ -40,6 +45,8 @@ enum {
     CAMIO_PERF_EVENT_OSTREAM_RAW,
     CAMIO_PERF_EVENT_OSTREAM_RING,
     CAMIO_PERF_EVENT_OSTREAM_BRING,
+    CAMIO_PERF_EVENT_OSTREAM_MRING,
+    CAMIO_PERF_EVENT_OSTREAM_BCAST,
     CAMIO_PERF_EVENT_OSTREAM_UDP,
 
     CAMIO_PERF_EVENT_IOSTREAM_TCP,
@@ -47,6 +54,8 @@ enum {
     CAMIO_PERF_EVENT_IOSTREAM_UDP,
     CAMIO_PERF_EVENT_IOSTREAM_SHMEM,
 
+    CAMIO_PERF_EVENT_SELECTOR_WEIGHTED, //Start when a stream was seen ready, stop when it was selected. Cond is the class.
+
     CAMIO_PERF_EVENT_COUNT
 };
 #define CAMIO_PERF_EVENT_ID_MAX ( (1 << 31) - 1 )  //Cannot have more than 2 billion event IDs....
@@ -69,65 +78,269 @@ enum{
 };
 
 
-typedef struct {
-    char* output_descr;
-    uint64_t event_count;
-    uint64_t event_index;
-    uint64_t max_events;
-    camio_perf_event_t* events;
+#define CAMIO_PERF_EVENT_STOP (1U << 31)          //Set in the event ID of stop events
+
+//Options taken from the end of the output description, eg "log:/tmp/x.perf,ring=1" or "blob:/tmp/x.perf,format=bin"
+// - ring=1      Keep the last max_events events of each thread, rather than the first
+// - format=bin  Dump in the binary format below rather than as text. Needs a byte stream such as blob, not log
+// - counters=1  Read a group of perf_event_open counters (see camio_perf_counters.h) with every start and stop
+// - events=a+b  Only log these events, by name, eg events=istream_udp+ostream_udp. All of them by default
+// - sample=N    Only log 1 in N starts of each event, along with their stops. Stops without starts are sampled alone
+//
+//Building with -DCAMIO_NO_PERF takes the event macros out altogether. A monitor with max_events of 0, such as the one
+//that streams make for themselves when they are given none, logs nothing, and costs a test of its event mask.
+
+
+//Every thread that logs to a perf monitor gets a buffer of its own, found through a thread local cache, so that the
+//event macros never share a cache line or need to synchronise with another thread. Buffers are pushed onto the
+//monitor lock free the first time a thread logs, and live until camio_perf_finish().
+struct camio_perf_buff;
+typedef struct camio_perf_buff camio_perf_buff_t;
+struct camio_perf_buff {
+    uint64_t event_count;                   //Events logged, including those that there was no space for
+    uint64_t event_index;                   //Events stored. In ring mode this keeps going, and is masked to a slot
+    uint64_t tid;                           //Thread that owns the buffer
+    camio_perf_buff_t* next;
+    uint32_t counter_kind;
+    int counter_fds[CAMIO_PERF_COUNTERS];
+    camio_perf_counts_t* counts;            //A slot for each event, or NULL when there are no counters
+    uint64_t sample_left[64];               //For each event, how many to skip before the next one is logged
+    uint64_t sampled;                       //Bit for each event with a start that was logged, and no stop yet
+    uint64_t skipped;                       //Bit for each event with a start that was skipped, and no stop yet
+    camio_perf_event_t events[];
+};
 
+typedef struct {
+    char* output_descr;                     //With the perf options above taken out
+    uint64_t max_events;                    //Per thread
+    uint64_t limit;                         //Events stop being stored at this index. ~0 in ring mode
+    uint64_t mask;                          //Index to slot. ~0, or max_events - 1 in ring mode
+    int ring;
+    int binary;
+    int counters;
+    uint64_t event_mask;                    //Bit for each event ID that is logged. IDs past 63 are on with any of them
+    uint64_t sample;                        //Log 1 in sample
+    uint64_t id;                            //Unique to this monitor, so that a stale thread local cache is never used
+    camio_perf_buff_t* volatile buffs;
 } camio_perf_t;
 
 
 camio_perf_t* camio_perf_init(char* output_descr, uint64_t max_events_count);
 void camio_perf_finish(camio_perf_t* camio_perf);
 
+//Turn logging of an event on or off at runtime. Has no effect on a monitor with max_events of 0.
+void camio_perf_enable(camio_perf_t* camio_perf, uint32_t event, int enable);
+
+
+//The binary dump is a header, the event, condition and counter names, then for each thread a camio_perf_file_buff_t
+//followed by its events, oldest first, and then the counts for each event if it has counters. All values are little
+//endian, as written by the host.
+#define CAMIO_PERF_FILE_MAGIC "CAMIOPRF"
+#define CAMIO_PERF_FILE_VERSION (2)
+#define CAMIO_PERF_FILE_NAME_LEN (32)       //Names are NUL padded to this length
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t event_size;                    //sizeof(camio_perf_event_t)
+    uint64_t tsc_hz;                        //Event timestamps are in TSC ticks,
+    uint64_t tsc_base;                      //and this TSC reading was taken
+    uint64_t ns_base;                       //at this CLOCK_REALTIME time
+    uint32_t event_names;
+    uint32_t cond_names;
+    uint32_t counters;                      //Counters in a group. There is a name for each, for each kind of group
+    uint32_t counter_kinds;
+    uint64_t buff_count;
+} camio_perf_file_hdr_t;
+
+typedef struct {
+    uint64_t tid;
+    uint64_t event_count;                   //Events logged
+    uint64_t events;                        //Events that follow
+    uint64_t ring;                          //Non zero if these are the last events logged, rather than the first
+    uint64_t counter_kind;                  //CAMIO_PERF_COUNTERS_NONE if there are no counts after the events
+} camio_perf_file_buff_t;
+
+extern const char* camio_perf_event_names[CAMIO_PERF_EVENT_COUNT];
+extern const char* camio_perf_cond_names[CAMIO_PERF_COND_COUNT];
+
+
+//Find this thread's buffer. The fast path is a compare with the thread local cache, which has a slot for each of a few
+//monitors, so that a thread logging to a stream's monitor and a selector's monitor doesn't miss on every event. Monitor
+//IDs are never reused, so a slot left by a monitor that has finished never matches again.
+#define CAMIO_PERF_THREAD_CACHE (8)        //Power of two
+
+typedef struct {
+    uint64_t id;                            //Monitor the buffer belongs to, 0 when empty
+    camio_perf_buff_t* buff;
+} camio_perf_thread_cache_t;
+
+extern __thread camio_perf_thread_cache_t camio_perf_thread_cache[CAMIO_PERF_THREAD_CACHE];
+camio_perf_buff_t* camio_perf_buff_find(camio_perf_t* camio_perf);
+
+static inline camio_perf_buff_t* camio_perf_buff(camio_perf_t* camio_perf){
+    const camio_perf_thread_cache_t* cache = &camio_perf_thread_cache[camio_perf->id & (CAMIO_PERF_THREAD_CACHE - 1)];
+    if(likely(cache->id == camio_perf->id)){
+        return cache->buff;
+    }
+    return camio_perf_buff_find(camio_perf);
+}
+
 
 //Stolen from linux/arch/x86/include/asm/msr.h
 #define EAX_EDX_VAL(low, high)     ((low) | ((uint64_t)(high) << 32))
 #define EAX_EDX_RET(low, high)     "=a" (low), "=d" (high)
 #define DECLARE_ARGS(low, high)    uint32_t low, high
 
+//Read the same counter that the event macros use, so that times can be taken ahead of logging them
 //Notes:
-//- This function is written as a macro to ensure that it is inlined
 //- Generally calls to rdtsc are prepended by a call to cpuid. This is done so that the
 //  pipeline is flushed and that there is determinism about the moment when rdtsc is called.
 //  Flushing the pipeline is an expensive call and not something that we want to do too much
 //  on the critical path. For this reason I've decided to trade a little accuracy for
 //  better overall performance.
-#define camio_perf_event_start(camio_perf, event, cond)                                         \
-    if(likely(camio_perf->event_index < camio_perf->max_events)){                               \
-        camio_perf->events[camio_perf->event_index].event_id = event;                           \
-        camio_perf->events[camio_perf->event_index].cond_id  = cond;                            \
-        DECLARE_ARGS(lo, hi);                                                                   \
-        asm volatile("rdtsc" : EAX_EDX_RET(lo, hi));                                            \
-        camio_perf->events[camio_perf->event_index].ts       = EAX_EDX_VAL(lo, hi);             \
-        camio_perf->event_index++;                                                              \
-    }                                                                                           \
-    camio_perf->event_count++;
+static inline uint64_t camio_perf_ts(void){
+    DECLARE_ARGS(lo, hi);
+    asm volatile("rdtsc" : EAX_EDX_RET(lo, hi));
+    return EAX_EDX_VAL(lo, hi);
+}
 
 
-//Notes:
-//- This function is written as a macro to ensure that it is inlined
-//- Generally calls to rdtsc are prepended by a call to cpuid. This is done so that the
-//  pipeline is flushed and that there is determinism about the moment when rdtsc is called.
-//  Flushing the pipeline is an expensive call and not something that we want to do too much
-//  on the critical path. For this reason I've decided to trade a little accuracy for
-//  better overall performance.
+static inline int camio_perf_wanted(const camio_perf_t* camio_perf, uint32_t event){
+    return event < 64 ? (camio_perf->event_mask >> event) & 1 : camio_perf->event_mask != 0;
+}
+
+
+//Decide whether to log an event when sampling. A start's stop goes the same way as the start did, so that pairs stay
+//whole. The bookkeeping is by event, so a start/stop pair is assumed not to overlap another of the same event.
+static inline int camio_perf_sample(camio_perf_buff_t* buff, const camio_perf_t* camio_perf, uint32_t event, int stop){
+    const uint64_t bit = 1ULL << (event & 63);
+    if(stop){
+        if(buff->sampled & bit){
+            buff->sampled &= ~bit;
+            return 1;
+        }
+        if(buff->skipped & bit){
+            buff->skipped &= ~bit;
+            buff->event_count++;
+            return 0;
+        }
+    }
+
+    if(likely(buff->sample_left[event & 63])){
+        buff->sample_left[event & 63]--;
+        buff->skipped |= stop ? 0 : bit;
+        buff->event_count++;
+        return 0;
+    }
+
+    buff->sample_left[event & 63] = camio_perf->sample - 1;
+    buff->sampled |= stop ? 0 : bit;
+    return 1;
+}
+
+
+//Log n events, handing back the first slot, or NULL if there is no space. Slots are consecutive (mod the ring size).
+static inline camio_perf_event_t* camio_perf_claim(camio_perf_buff_t* buff, const camio_perf_t* camio_perf, uint64_t n){
+    buff->event_count += n;
+    if(likely(buff->event_index + n <= camio_perf->limit)){
+        camio_perf_event_t* const slot = &buff->events[buff->event_index & camio_perf->mask];
+        buff->event_index += n;
+        return slot;
+    }
+    return NULL;
+}
+
+static inline void camio_perf_log_start(camio_perf_t* camio_perf, uint32_t event, uint32_t cond){
+    if(!camio_perf_wanted(camio_perf, event)){
+        return;
+    }
+    camio_perf_buff_t* const buff = camio_perf_buff(camio_perf);
+    if(unlikely(camio_perf->sample > 1) && !camio_perf_sample(buff, camio_perf, event, 0)){
+        return;
+    }
+    camio_perf_event_t* const slot = camio_perf_claim(buff, camio_perf, 1);
+    if(likely(slot != NULL)){
+        slot->event_id = event;
+        slot->cond_id  = cond;
+        if(unlikely(buff->counts != NULL)){
+            camio_perf_counters_read(buff->counter_fds, &buff->counts[slot - buff->events]);
+        }
+        slot->ts       = camio_perf_ts(); //Last, so the bookkeeping isn't timed
+    }
+}
+
+static inline void camio_perf_log_stop(camio_perf_t* camio_perf, uint32_t event, uint32_t cond){
+    if(!camio_perf_wanted(camio_perf, event)){
+        return;
+    }
+    const uint64_t ts = camio_perf_ts(); //As soon as we can, so the bookkeeping isn't timed
+    camio_perf_buff_t* const buff = camio_perf_buff(camio_perf);
+    if(unlikely(camio_perf->sample > 1) && !camio_perf_sample(buff, camio_perf, event, 1)){
+        return;
+    }
+    camio_perf_event_t* const slot = camio_perf_claim(buff, camio_perf, 1);
+    if(likely(slot != NULL)){
+        if(unlikely(buff->counts != NULL)){
+            camio_perf_counters_read(buff->counter_fds, &buff->counts[slot - buff->events]);
+        }
+        slot->ts       = ts;
+        slot->event_id = event | CAMIO_PERF_EVENT_STOP;
+        slot->cond_id  = cond;
+    }
+}
+
+static inline void camio_perf_log_span(camio_perf_t* camio_perf, uint32_t event, uint32_t cond, uint64_t start_ts,
+        uint64_t stop_ts){
+    if(!camio_perf_wanted(camio_perf, event)){
+        return;
+    }
+    camio_perf_buff_t* const buff = camio_perf_buff(camio_perf);
+    if(unlikely(camio_perf->sample > 1) && !camio_perf_sample(buff, camio_perf, event, 1)){
+        buff->event_count++; //For the start that goes with it
+        return;
+    }
+    camio_perf_event_t* const slot = camio_perf_claim(buff, camio_perf, 2);
+    if(likely(slot != NULL)){
+        slot->ts       = start_ts;
+        slot->event_id = event;
+        slot->cond_id  = cond;
+
+        camio_perf_event_t* const next = &buff->events[(buff->event_index - 1) & camio_perf->mask];
+        next->ts       = stop_ts;
+        next->event_id = event | CAMIO_PERF_EVENT_STOP;
+        next->cond_id  = cond;
+
+        //The times were taken earlier, so counts read now would not match them
+        if(unlikely(buff->counts != NULL)){
+            buff->counts[slot - buff->events].values[0] = CAMIO_PERF_COUNT_NONE;
+            buff->counts[next - buff->events].values[0] = CAMIO_PERF_COUNT_NONE;
+        }
+    }
+}
+
+
+//The event macros are what streams call, so that the way events are logged can change without touching them
+#ifndef CAMIO_NO_PERF
+
+#define camio_perf_event_start(camio_perf, event, cond)                                         \
+    camio_perf_log_start(camio_perf, event, cond)
+
 #define camio_perf_event_stop(camio_perf, event, cond)                                          \
-    if(likely(camio_perf->event_index < camio_perf->max_events)){                               \
-        DECLARE_ARGS(lo, hi);                                                                   \
-        asm volatile("rdtsc" : EAX_EDX_RET(lo, hi));                                            \
-        camio_perf->events[camio_perf->event_index].ts       = EAX_EDX_VAL(lo, hi);             \
-        camio_perf->events[camio_perf->event_index].event_id = event + (1<<31);                 \
-        camio_perf->events[camio_perf->event_index].cond_id  = cond;                            \
-        camio_perf->event_index++;                                                              \
-    }                                                                                           \
-    camio_perf->event_count++;
+    camio_perf_log_stop(camio_perf, event, cond)
 
+//Log a start/stop pair with times that were taken earlier using camio_perf_ts(). The two events are written side by
+//side, so that they can be matched up even when there are many of the same event outstanding at once.
+#define camio_perf_event_span(camio_perf, event, cond, start_ts, stop_ts)                       \
+    camio_perf_log_span(camio_perf, event, cond, start_ts, stop_ts)
 
+#else
 
+#define camio_perf_event_start(camio_perf, event, cond) ((void)0)
+#define camio_perf_event_stop(camio_perf, event, cond) ((void)0)
+#define camio_perf_event_span(camio_perf, event, cond, start_ts, stop_ts) ((void)0)
 
+#endif
 
 
 #endif /* CAMIO_PERF_H_ */
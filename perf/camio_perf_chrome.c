@@ -0,0 +1,196 @@
+/*
+ * Copyright  (C) Matthew P. Grosvenor, 2012, All Rights Reserved
+ *
+ * Exports a camio perf trace as a timeline in the Chrome trace event format
+ *
+ */
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+
+#include "camio_perf_chrome.h"
+#include "../utils/camio_util.h"
+#include "../errors/camio_errors.h"
+#include "../ostreams/camio_ostream.h"
+
+#define CAMIO_PERF_CHROME_BUFF (1024 * 1024)
+#define CAMIO_PERF_CHROME_LINE (1024)                           //Longest single emit()
+#define CAMIO_PERF_CHROME_SLACK (8 * CAMIO_PERF_CHROME_LINE)    //Longest event
+
+
+//JSON is collected into a big buffer and written out a whole number of events at a time. Line based streams add
+//a newline after each write, which is then always between events, where JSON doesn't mind. The buffer has room
+//past CAMIO_PERF_CHROME_BUFF for the event that is being written when it fills up.
+typedef struct {
+    const camio_perf_trace_t* trace;
+    camio_ostream_t* out;
+    char* buff;
+    size_t len;
+    uint64_t events;
+    uint64_t origin;                        //TSC of the earliest event, which becomes time 0
+} chrome_t;
+
+
+static void flush(chrome_t* chrome){
+    if(chrome->len){
+        chrome->out->assign_write(chrome->out, (uint8_t*)chrome->buff, chrome->len);
+        chrome->out->end_write(chrome->out, chrome->len);
+        chrome->len = 0;
+    }
+}
+
+
+static void emit(chrome_t* chrome, const char* format, ...){
+    va_list args;
+    va_start(args, format);
+    const int len = vsnprintf(chrome->buff + chrome->len, CAMIO_PERF_CHROME_LINE, format, args);
+    va_end(args);
+    chrome->len += MIN(len, CAMIO_PERF_CHROME_LINE - 1);
+}
+
+
+//Start a new trace event, with a comma if it isn't the first
+static void begin_event(chrome_t* chrome){
+    if(chrome->len > CAMIO_PERF_CHROME_BUFF){
+        flush(chrome);
+    }
+    emit(chrome, chrome->events++ ? ",\n" : "\n");
+}
+
+
+//Microseconds since the first event, to the ns
+static void emit_us(chrome_t* chrome, const char* name, uint64_t ns){
+    emit(chrome, ",\"%s\":%lu.%03lu", name, ns / 1000, ns % 1000);
+}
+
+
+static void on_pair(void* arg, const camio_perf_trace_buff_t* buff, const camio_perf_event_t* start,
+        const camio_perf_event_t* stop){
+    chrome_t* chrome = arg;
+    const camio_perf_trace_t* trace = chrome->trace;
+    const uint64_t event_id = start->event_id;
+    const uint64_t stop_id  = stop->event_id & ~CAMIO_PERF_EVENT_STOP;
+
+    begin_event(chrome);
+    emit(chrome, "{\"ph\":\"X\",\"pid\":%lu,\"tid\":%lu,\"name\":\"%s\"", event_id, buff->tid,
+            camio_perf_trace_cond_name(trace, start->cond_id));
+    emit(chrome, ",\"cat\":\"%s\"", camio_perf_trace_event_name(trace, event_id));
+    emit_us(chrome, "ts", start->ts > chrome->origin ? camio_perf_trace_ticks_to_ns(trace, start->ts - chrome->origin) : 0);
+    emit_us(chrome, "dur", stop->ts > start->ts ? camio_perf_trace_ticks_to_ns(trace, stop->ts - start->ts) : 0);
+    emit(chrome, ",\"args\":{\"stop_cond\":\"%s\"", camio_perf_trace_cond_name(trace, stop->cond_id));
+    if(stop_id != event_id){
+        emit(chrome, ",\"stop_event\":\"%s\"", camio_perf_trace_event_name(trace, stop_id));
+    }
+
+    camio_perf_counts_t deltas;
+    if(camio_perf_trace_deltas(buff, start, stop, &deltas)){
+        int c = 0;
+        for(c = 0; c < CAMIO_PERF_COUNTERS; c++){
+            emit(chrome, ",\"%s\":%lu", camio_perf_trace_counter_name(trace, buff->counter_kind, c), deltas.values[c]);
+        }
+    }
+    emit(chrome, "}}");
+}
+
+
+static void on_single(void* arg, const camio_perf_trace_buff_t* buff, const camio_perf_event_t* event){
+    chrome_t* chrome = arg;
+    const camio_perf_trace_t* trace = chrome->trace;
+    const uint64_t event_id = event->event_id & ~CAMIO_PERF_EVENT_STOP;
+
+    begin_event(chrome);
+    emit(chrome, "{\"ph\":\"i\",\"s\":\"t\",\"pid\":%lu,\"tid\":%lu,\"name\":\"%s %s\"", event_id, buff->tid,
+            event->event_id & CAMIO_PERF_EVENT_STOP ? "stop" : "start", camio_perf_trace_cond_name(trace, event->cond_id));
+    emit(chrome, ",\"cat\":\"%s\"", camio_perf_trace_event_name(trace, event_id));
+    emit_us(chrome, "ts", event->ts > chrome->origin ? camio_perf_trace_ticks_to_ns(trace, event->ts - chrome->origin) : 0);
+    emit(chrome, "}");
+}
+
+
+//Name the process for each stream type, and the track for each thread that logged it
+static void emit_names(chrome_t* chrome){
+    const camio_perf_trace_t* trace = chrome->trace;
+    const uint64_t events = trace->event_names_len;
+    uint8_t* seen = calloc(events, 1);
+    if(!seen){
+        eprintf_exit("Could not allocate memory for perf trace names\n");
+    }
+
+    uint64_t b = 0, i = 0;
+    for(b = 0; b < trace->buffs_len; b++){
+        const camio_perf_trace_buff_t* buff = &trace->buffs[b];
+        uint8_t* in_buff = calloc(events, 1);
+        if(!in_buff){
+            eprintf_exit("Could not allocate memory for perf trace names\n");
+        }
+
+        for(i = 0; i < buff->events_len; i++){
+            const uint64_t event_id = buff->events[i].event_id & ~CAMIO_PERF_EVENT_STOP;
+            if(event_id >= events || in_buff[event_id]){
+                continue;
+            }
+            in_buff[event_id] = 1;
+
+            if(!seen[event_id]){
+                seen[event_id] = 1;
+                begin_event(chrome);
+                emit(chrome, "{\"ph\":\"M\",\"pid\":%lu,\"name\":\"process_name\",\"args\":{\"name\":\"%s\"}}",
+                        event_id, camio_perf_trace_event_name(trace, event_id));
+            }
+
+            begin_event(chrome);
+            emit(chrome, "{\"ph\":\"M\",\"pid\":%lu,\"tid\":%lu,\"name\":\"thread_name\",\"args\":{\"name\":\"thread %lu\"}}",
+                    event_id, buff->tid, buff->tid);
+        }
+
+        free(in_buff);
+    }
+
+    free(seen);
+}
+
+
+void camio_perf_chrome_export(const camio_perf_trace_t* trace, int64_t from_event, int64_t to_event,
+        char* output_descr){
+    chrome_t chrome;
+    bzero(&chrome, sizeof(chrome));
+    chrome.trace = trace;
+    chrome.buff  = malloc(CAMIO_PERF_CHROME_BUFF + CAMIO_PERF_CHROME_SLACK);
+    if(!chrome.buff){
+        eprintf_exit("Could not allocate memory for trace output\n");
+    }
+
+    //Not just the first event in each buffer. Spans log times taken before they were logged, so a buffer isn't
+    //always in time order.
+    chrome.origin = ~0ULL;
+    uint64_t b = 0, i = 0;
+    for(b = 0; b < trace->buffs_len; b++){
+        for(i = 0; i < trace->buffs[b].events_len; i++){
+            chrome.origin = MIN(chrome.origin, trace->buffs[b].events[i].ts);
+        }
+    }
+    if(chrome.origin == ~0ULL){
+        chrome.origin = 0;
+    }
+
+    chrome.out = camio_ostream_new(output_descr, NULL, NULL, NULL);
+    if(!chrome.out){
+        eprintf_exit("Could not create output stream for trace\n");
+    }
+
+    emit(&chrome, "{\"displayTimeUnit\":\"ns\",\"otherData\":{\"origin_realtime_ns\":\"%lu\",\"tsc_hz\":\"%lu\"},",
+            camio_perf_trace_ns(trace, chrome.origin), trace->tsc_hz);
+    emit(&chrome, "\"traceEvents\":[");
+
+    emit_names(&chrome);
+
+    camio_perf_trace_pair_stats_t stats;
+    camio_perf_trace_pairs(trace, from_event, to_event, on_pair, on_single, &chrome, &stats);
+
+    emit(&chrome, "\n]}");
+    flush(&chrome);
+
+    chrome.out->delete(chrome.out);
+    free(chrome.buff);
+}
@@ -0,0 +1,20 @@
+/*
+ * Copyright  (C) Matthew P. Grosvenor, 2012, All Rights Reserved
+ *
+ * Exports a camio perf trace as a timeline in the Chrome trace event format
+ *
+ */
+
+#ifndef CAMIO_PERF_CHROME_H_
+#define CAMIO_PERF_CHROME_H_
+
+#include "camio_perf_trace.h"
+
+//Write the trace as Chrome trace event JSON, which chrome://tracing and ui.perfetto.dev both open. Each stream type
+//is a process, with a track for each thread that logged it. Start/stop pairs (see camio_perf_trace_pairs()) become
+//slices, with any counter deltas in their args, and unmatched events become instants. Times are in us from the earliest
+//event in the trace, and the CLOCK_REALTIME time of that event is kept in the metadata.
+void camio_perf_chrome_export(const camio_perf_trace_t* trace, int64_t from_event, int64_t to_event,
+        char* output_descr);
+
+#endif /* CAMIO_PERF_CHROME_H_ */
@@ -0,0 +1,114 @@
+/*
+ * Copyright  (C) Matthew P. Grosvenor, 2012, All Rights Reserved
+ *
+ * Per thread performance counters for camio perf, using perf_event_open
+ *
+ */
+
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include "camio_perf_counters.h"
+#include "../utils/camio_util.h"
+#include "../errors/camio_errors.h"
+
+
+const char* camio_perf_counter_names[CAMIO_PERF_COUNTERS_KINDS][CAMIO_PERF_COUNTERS] = {
+    [CAMIO_PERF_COUNTERS_NONE] = { "none_0", "none_1", "none_2", "none_3" },
+    [CAMIO_PERF_COUNTERS_HW]   = { "cycles", "instructions", "cache_misses", "branch_misses" },
+    [CAMIO_PERF_COUNTERS_SW]   = { "task_clock_ns", "context_switches", "page_faults", "cpu_migrations" },
+};
+
+static const struct { uint32_t type; uint64_t config; } counters[CAMIO_PERF_COUNTERS_KINDS][CAMIO_PERF_COUNTERS] = {
+    [CAMIO_PERF_COUNTERS_HW] = {
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+    },
+    [CAMIO_PERF_COUNTERS_SW] = {
+        { PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK },
+        { PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES },
+        { PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS },
+        { PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CPU_MIGRATIONS },
+    },
+};
+
+static int warned = 0;
+
+
+static int open_counter(uint32_t kind, int i, int group_fd){
+    struct perf_event_attr attr;
+    bzero(&attr, sizeof(attr));
+    attr.size           = sizeof(attr);
+    attr.type           = counters[kind][i].type;
+    attr.config         = counters[kind][i].config;
+    attr.read_format    = PERF_FORMAT_GROUP;
+    attr.exclude_kernel = 1; //Allowed at perf_event_paranoid=2, and keeps the read() itself out of the counts
+    attr.exclude_hv     = 1;
+
+    return syscall(__NR_perf_event_open, &attr, 0, -1, group_fd, 0);
+}
+
+
+//All or nothing, so that the counters in a group are always the same set
+static int open_group(uint32_t kind, int* fds, int* err){
+    int i = 0;
+    for(; i < CAMIO_PERF_COUNTERS; i++){
+        fds[i] = open_counter(kind, i, i ? fds[0] : -1);
+        if(fds[i] < 0){
+            *err = errno;
+            for(i--; i >= 0; i--){
+                close(fds[i]);
+                fds[i] = -1;
+            }
+            return -1;
+        }
+    }
+    return 0;
+}
+
+
+uint32_t camio_perf_counters_open(int* fds){
+    int hw_err = 0;
+    if(open_group(CAMIO_PERF_COUNTERS_HW, fds, &hw_err) == 0){
+        return CAMIO_PERF_COUNTERS_HW;
+    }
+
+    int sw_err = 0;
+    if(open_group(CAMIO_PERF_COUNTERS_SW, fds, &sw_err) == 0){
+        if(__sync_bool_compare_and_swap(&warned, 0, 1)){
+            wprintf("Hardware performance counters are not available (%s), using software counters\n", strerror(hw_err));
+        }
+        return CAMIO_PERF_COUNTERS_SW;
+    }
+
+    if(__sync_bool_compare_and_swap(&warned, 0, 1)){
+        wprintf("Performance counters are not available (%s), only times will be logged\n", strerror(sw_err));
+    }
+    return CAMIO_PERF_COUNTERS_NONE;
+}
+
+
+void camio_perf_counters_close(int* fds){
+    int i = 0;
+    for(; i < CAMIO_PERF_COUNTERS; i++){
+        if(fds[i] >= 0){
+            close(fds[i]);
+            fds[i] = -1;
+        }
+    }
+}
+
+
+void camio_perf_counters_read(const int* fds, camio_perf_counts_t* counts){
+    uint64_t group[1 + CAMIO_PERF_COUNTERS]; //nr, then a value for each counter
+    if(unlikely(read(fds[0], group, sizeof(group)) != sizeof(group) || group[0] != CAMIO_PERF_COUNTERS)){
+        counts->values[0] = CAMIO_PERF_COUNT_NONE;
+        return;
+    }
+    memcpy(counts->values, group + 1, sizeof(counts->values));
+}
@@ -0,0 +1,39 @@
+/*
+ * Copyright  (C) Matthew P. Grosvenor, 2012, All Rights Reserved
+ *
+ * Per thread performance counters for camio perf, using perf_event_open
+ *
+ */
+
+#ifndef CAMIO_PERF_COUNTERS_H_
+#define CAMIO_PERF_COUNTERS_H_
+
+#include <stdint.h>
+
+#define CAMIO_PERF_COUNTERS (4)                 //Counters in a group, read together
+#define CAMIO_PERF_COUNT_NONE (~0ULL)           //In values[0] when no counters were read for an event
+
+//Which counters a group is made of. Hardware counters are tried first, then the kernel's software counters when
+//there is no PMU (eg. in many VMs) or it is not ours to use.
+enum {
+    CAMIO_PERF_COUNTERS_NONE = 0,
+    CAMIO_PERF_COUNTERS_HW,                     //cycles, instructions, cache_misses, branch_misses
+    CAMIO_PERF_COUNTERS_SW,                     //task_clock_ns, context_switches, page_faults, cpu_migrations
+
+    CAMIO_PERF_COUNTERS_KINDS
+};
+
+typedef struct {
+    uint64_t values[CAMIO_PERF_COUNTERS];       //Running totals for the thread, user space only
+} camio_perf_counts_t;
+
+extern const char* camio_perf_counter_names[CAMIO_PERF_COUNTERS_KINDS][CAMIO_PERF_COUNTERS];
+
+
+//Open a group of counters for the calling thread. Returns the kind of group that could be opened, and
+//CAMIO_PERF_COUNTERS_NONE (with a warning, once) if there are none at all.
+uint32_t camio_perf_counters_open(int* fds);
+void camio_perf_counters_close(int* fds);
+void camio_perf_counters_read(const int* fds, camio_perf_counts_t* counts);
+
+#endif /* CAMIO_PERF_COUNTERS_H_ */
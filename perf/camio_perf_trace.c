@@ -0,0 +1,402 @@
+/*
+ * Copyright  (C) Matthew P. Grosvenor, 2012, All Rights Reserved
+ *
+ * Reads back the output of camio_perf_finish() for offline analysis
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "camio_perf_trace.h"
+#include "../utils/camio_util.h"
+#include "../utils/camio_tsc.h"
+#include "../errors/camio_errors.h"
+
+#define CAMIO_PERF_TRACE_LINE (1024)
+#define CAMIO_PERF_TRACE_EVENTS_INIT (1024)
+
+
+static camio_perf_trace_buff_t* add_buff(camio_perf_trace_t* trace, uint64_t tid){
+    trace->buffs = realloc(trace->buffs, sizeof(camio_perf_trace_buff_t) * (trace->buffs_len + 1));
+    if(!trace->buffs){
+        eprintf_exit("Could not allocate memory for perf trace buffers\n");
+    }
+
+    camio_perf_trace_buff_t* buff = &trace->buffs[trace->buffs_len];
+    bzero(buff, sizeof(camio_perf_trace_buff_t));
+    buff->tid = tid;
+    trace->buffs_len++;
+    return buff;
+}
+
+
+static void fread_all(FILE* file, void* data, size_t len, const char* filename){
+    if(len && fread(data, len, 1, file) != 1){
+        eprintf_exit("Perf dump \"%s\" is truncated\n", filename);
+    }
+}
+
+
+static void load_binary(camio_perf_trace_t* trace, FILE* file, const char* filename){
+    camio_perf_file_hdr_t hdr;
+    fread_all(file, &hdr, sizeof(hdr), filename);
+    if(hdr.version != CAMIO_PERF_FILE_VERSION || hdr.event_size != sizeof(camio_perf_event_t)){
+        eprintf_exit("Perf dump \"%s\" is version %u with %u byte events, expected version %u with %lu byte events\n",
+                filename, hdr.version, hdr.event_size, CAMIO_PERF_FILE_VERSION, sizeof(camio_perf_event_t));
+    }
+
+    trace->tsc_hz          = hdr.tsc_hz;
+    trace->tsc_base        = hdr.tsc_base;
+    trace->ns_base         = hdr.ns_base;
+    if(hdr.counters != CAMIO_PERF_COUNTERS){
+        eprintf_exit("Perf dump \"%s\" has %u counters in a group, expected %u\n", filename, hdr.counters, CAMIO_PERF_COUNTERS);
+    }
+
+    trace->event_names_len = hdr.event_names;
+    trace->cond_names_len  = hdr.cond_names;
+    trace->counters        = hdr.counters;
+    trace->counter_kinds   = hdr.counter_kinds;
+
+    const size_t names_len = (size_t)(hdr.event_names + hdr.cond_names + hdr.counters * hdr.counter_kinds) *
+            CAMIO_PERF_FILE_NAME_LEN;
+    trace->names = malloc(names_len + 1);
+    if(!trace->names){
+        eprintf_exit("Could not allocate memory for perf trace names\n");
+    }
+    fread_all(file, trace->names, names_len, filename);
+
+    uint64_t i = 0;
+    for(i = 0; i < hdr.buff_count; i++){
+        camio_perf_file_buff_t file_buff;
+        fread_all(file, &file_buff, sizeof(file_buff), filename);
+
+        camio_perf_trace_buff_t* buff = add_buff(trace, file_buff.tid);
+        buff->event_count = file_buff.event_count;
+        buff->ring        = file_buff.ring;
+        buff->events_len  = file_buff.events;
+        buff->events      = malloc(sizeof(camio_perf_event_t) * MAX(buff->events_len, 1));
+        if(!buff->events){
+            eprintf_exit("Could not allocate memory for %lu perf trace events\n", buff->events_len);
+        }
+        fread_all(file, buff->events, sizeof(camio_perf_event_t) * buff->events_len, filename);
+
+        buff->counter_kind = file_buff.counter_kind;
+        if(buff->counter_kind != CAMIO_PERF_COUNTERS_NONE){
+            buff->counts = malloc(sizeof(camio_perf_counts_t) * MAX(buff->events_len, 1));
+            if(!buff->counts){
+                eprintf_exit("Could not allocate memory for %lu perf trace counts\n", buff->events_len);
+            }
+            fread_all(file, buff->counts, sizeof(camio_perf_counts_t) * buff->events_len, filename);
+        }
+    }
+}
+
+
+//The counters named at the end of a "T" line, if there are any
+static uint32_t text_counter_kind(const char* names){
+    uint32_t kind = CAMIO_PERF_COUNTERS_NONE + 1;
+    for(; kind < CAMIO_PERF_COUNTERS_KINDS; kind++){
+        char expected[CAMIO_PERF_TRACE_LINE] = "";
+        int c = 0;
+        for(c = 0; c < CAMIO_PERF_COUNTERS; c++){
+            strcat(expected, ", ");
+            strcat(expected, camio_perf_counter_names[kind][c]);
+        }
+        if(strncmp(names, expected, strlen(expected)) == 0){
+            return kind;
+        }
+    }
+    return CAMIO_PERF_COUNTERS_NONE;
+}
+
+
+static void load_text(camio_perf_trace_t* trace, FILE* file, const char* filename){
+    camio_perf_trace_buff_t* buff = NULL;
+    uint64_t events_size = 0;
+
+    char line[CAMIO_PERF_TRACE_LINE];
+    uint64_t line_no = 0;
+    while(fgets(line, CAMIO_PERF_TRACE_LINE, file)){
+        line_no++;
+
+        uint64_t a = 0, b = 0, c = 0;
+        char kind = 0;
+        int used = 0;
+        if(sscanf(line, "T %lu, F %lu, C %lu%n", &a, &b, &c, &used) == 3){
+            buff = add_buff(trace, a);
+            buff->event_count  = b;
+            buff->counter_kind = text_counter_kind(line + used);
+            events_size = 0;
+            continue;
+        }
+
+        if(line[0] == 'F' || line[0] == '\n'){
+            continue; //The totals are worked out again from the events
+        }
+
+        if(sscanf(line, "%c, %lu, %lu, %lu%n", &kind, &a, &b, &c, &used) != 4 || (kind != 'A' && kind != 'O')){
+            eprintf_exit("Could not parse line %lu of perf dump \"%s\": %s", line_no, filename, line);
+        }
+
+        if(!buff){
+            buff = add_buff(trace, 0); //Dumps from before there were per thread buffers
+        }
+
+        if(buff->events_len == events_size){
+            events_size = events_size ? events_size * 2 : CAMIO_PERF_TRACE_EVENTS_INIT;
+            buff->events = realloc(buff->events, sizeof(camio_perf_event_t) * events_size);
+            if(!buff->events){
+                eprintf_exit("Could not allocate memory for %lu perf trace events\n", events_size);
+            }
+            if(buff->counter_kind != CAMIO_PERF_COUNTERS_NONE){
+                buff->counts = realloc(buff->counts, sizeof(camio_perf_counts_t) * events_size);
+                if(!buff->counts){
+                    eprintf_exit("Could not allocate memory for %lu perf trace counts\n", events_size);
+                }
+            }
+        }
+
+        if(buff->counts){
+            camio_perf_counts_t* counts = &buff->counts[buff->events_len];
+            uint64_t* v = counts->values;
+            if(sscanf(line + used, ", %lu, %lu, %lu, %lu", &v[0], &v[1], &v[2], &v[3]) != CAMIO_PERF_COUNTERS){
+                counts->values[0] = CAMIO_PERF_COUNT_NONE;
+            }
+        }
+
+        camio_perf_event_t* event = &buff->events[buff->events_len++];
+        event->ts       = a;
+        event->event_id = b | (kind == 'O' ? CAMIO_PERF_EVENT_STOP : 0);
+        event->cond_id  = c;
+        buff->event_count = MAX(buff->event_count, buff->events_len);
+    }
+
+    trace->event_names_len = CAMIO_PERF_EVENT_COUNT;
+    trace->cond_names_len  = CAMIO_PERF_COND_COUNT;
+    trace->counters        = CAMIO_PERF_COUNTERS;
+    trace->counter_kinds   = CAMIO_PERF_COUNTERS_KINDS;
+    trace->names = calloc(CAMIO_PERF_EVENT_COUNT + CAMIO_PERF_COND_COUNT + CAMIO_PERF_COUNTERS_KINDS * CAMIO_PERF_COUNTERS,
+            CAMIO_PERF_FILE_NAME_LEN);
+    if(!trace->names){
+        eprintf_exit("Could not allocate memory for perf trace names\n");
+    }
+
+    uint64_t i = 0;
+    for(i = 0; i < CAMIO_PERF_EVENT_COUNT; i++){
+        strncpy(trace->names[i], camio_perf_event_names[i], CAMIO_PERF_FILE_NAME_LEN - 1);
+    }
+    for(i = 0; i < CAMIO_PERF_COND_COUNT; i++){
+        strncpy(trace->names[CAMIO_PERF_EVENT_COUNT + i], camio_perf_cond_names[i], CAMIO_PERF_FILE_NAME_LEN - 1);
+    }
+    for(i = 0; i < CAMIO_PERF_COUNTERS_KINDS * CAMIO_PERF_COUNTERS; i++){
+        strncpy(trace->names[CAMIO_PERF_EVENT_COUNT + CAMIO_PERF_COND_COUNT + i],
+                camio_perf_counter_names[i / CAMIO_PERF_COUNTERS][i % CAMIO_PERF_COUNTERS], CAMIO_PERF_FILE_NAME_LEN - 1);
+    }
+}
+
+
+camio_perf_trace_t* camio_perf_trace_load(const char* filename, uint64_t tsc_hz){
+    FILE* file = fopen(filename, "r");
+    if(!file){
+        eprintf_exit("Could not open perf dump \"%s\"\n", filename);
+    }
+
+    camio_perf_trace_t* trace = calloc(1, sizeof(camio_perf_trace_t));
+    if(!trace){
+        eprintf_exit("Could not allocate memory for perf trace\n");
+    }
+
+    char magic[sizeof(CAMIO_PERF_FILE_MAGIC) - 1];
+    const size_t got = fread(magic, 1, sizeof(magic), file);
+    rewind(file);
+    if(got == sizeof(magic) && memcmp(magic, CAMIO_PERF_FILE_MAGIC, sizeof(magic)) == 0){
+        load_binary(trace, file, filename);
+    }
+    else{
+        load_text(trace, file, filename);
+        if(!tsc_hz){
+            wprintf("Text perf dumps don't record the TSC rate, measuring it on this machine instead\n");
+            camio_tsc_t tsc;
+            camio_tsc_calibrate(&tsc, CLOCK_REALTIME);
+            trace->tsc_hz   = (uint64_t)(((unsigned __int128)tsc.tsc_per_ns * 1000 * 1000 * 1000) >> 32);
+            trace->tsc_base = tsc.tsc_base;
+            trace->ns_base  = tsc.ns_base;
+        }
+    }
+    fclose(file);
+
+    if(tsc_hz){
+        trace->tsc_hz = tsc_hz;
+    }
+
+    if(!trace->tsc_hz){
+        eprintf_exit("Perf dump \"%s\" has a TSC rate of 0Hz\n", filename);
+    }
+
+    return trace;
+}
+
+
+void camio_perf_trace_free(camio_perf_trace_t* trace){
+    if(!trace){
+        return;
+    }
+
+    uint64_t i = 0;
+    for(i = 0; i < trace->buffs_len; i++){
+        free(trace->buffs[i].events);
+        free(trace->buffs[i].counts);
+    }
+    free(trace->buffs);
+    free(trace->names);
+    free(trace);
+}
+
+
+const char* camio_perf_trace_event_name(const camio_perf_trace_t* trace, uint64_t event_id){
+    static char name[CAMIO_PERF_FILE_NAME_LEN];
+    if(event_id < trace->event_names_len && trace->names[event_id][0]){
+        return trace->names[event_id];
+    }
+    snprintf(name, CAMIO_PERF_FILE_NAME_LEN, "event_%lu", event_id);
+    return name;
+}
+
+
+const char* camio_perf_trace_cond_name(const camio_perf_trace_t* trace, uint64_t cond_id){
+    static char name[CAMIO_PERF_FILE_NAME_LEN];
+    if(cond_id < trace->cond_names_len && trace->names[trace->event_names_len + cond_id][0]){
+        return trace->names[trace->event_names_len + cond_id];
+    }
+    snprintf(name, CAMIO_PERF_FILE_NAME_LEN, "cond_%lu", cond_id);
+    return name;
+}
+
+
+const char* camio_perf_trace_counter_name(const camio_perf_trace_t* trace, uint32_t kind, uint32_t counter){
+    static char name[CAMIO_PERF_FILE_NAME_LEN];
+    if(kind < trace->counter_kinds && counter < trace->counters){
+        const char* found = trace->names[trace->event_names_len + trace->cond_names_len + kind * trace->counters + counter];
+        if(found[0]){
+            return found;
+        }
+    }
+    snprintf(name, CAMIO_PERF_FILE_NAME_LEN, "counter_%u", counter);
+    return name;
+}
+
+
+int camio_perf_trace_deltas(const camio_perf_trace_buff_t* buff, const camio_perf_event_t* start,
+        const camio_perf_event_t* stop, camio_perf_counts_t* deltas){
+    if(!buff->counts){
+        return 0;
+    }
+
+    const camio_perf_counts_t* before = &buff->counts[start - buff->events];
+    const camio_perf_counts_t* after  = &buff->counts[stop - buff->events];
+    if(before->values[0] == CAMIO_PERF_COUNT_NONE || after->values[0] == CAMIO_PERF_COUNT_NONE){
+        return 0;
+    }
+
+    int c = 0;
+    for(c = 0; c < CAMIO_PERF_COUNTERS; c++){
+        deltas->values[c] = after->values[c] - before->values[c];
+    }
+    return 1;
+}
+
+
+int64_t camio_perf_trace_find_event(const camio_perf_trace_t* trace, const char* name){
+    uint32_t i = 0;
+    for(i = 0; i < trace->event_names_len; i++){
+        if(strncmp(name, trace->names[i], CAMIO_PERF_FILE_NAME_LEN) == 0){
+            return i;
+        }
+    }
+    return -1;
+}
+
+
+uint64_t camio_perf_trace_ticks_to_ns(const camio_perf_trace_t* trace, uint64_t ticks){
+    return (uint64_t)((unsigned __int128)ticks * 1000 * 1000 * 1000 / trace->tsc_hz);
+}
+
+
+uint64_t camio_perf_trace_ns(const camio_perf_trace_t* trace, uint64_t ts){
+    if(ts >= trace->tsc_base){
+        return trace->ns_base + camio_perf_trace_ticks_to_ns(trace, ts - trace->tsc_base);
+    }
+    return trace->ns_base - camio_perf_trace_ticks_to_ns(trace, trace->tsc_base - ts);
+}
+
+
+void camio_perf_trace_pairs(const camio_perf_trace_t* trace, int64_t from_event, int64_t to_event,
+        camio_perf_trace_pair_f on_pair, camio_perf_trace_single_f on_single, void* arg,
+        camio_perf_trace_pair_stats_t* stats){
+    bzero(stats, sizeof(camio_perf_trace_pair_stats_t));
+    const int same = from_event < 0 || to_event < 0;
+
+    uint64_t b = 0;
+    for(b = 0; b < trace->buffs_len; b++){
+        const camio_perf_trace_buff_t* buff = &trace->buffs[b];
+
+        //The start waiting for a stop, for each event
+        uint64_t max_id = 0;
+        uint64_t i = 0;
+        for(i = 0; i < buff->events_len; i++){
+            max_id = MAX(max_id, buff->events[i].event_id & ~CAMIO_PERF_EVENT_STOP);
+        }
+        const camio_perf_event_t** open = calloc(max_id + 1, sizeof(camio_perf_event_t*));
+        if(!open){
+            eprintf_exit("Could not allocate memory for %lu open perf events\n", max_id + 1);
+        }
+
+        for(i = 0; i < buff->events_len; i++){
+            const camio_perf_event_t* event = &buff->events[i];
+            const uint64_t event_id = event->event_id & ~CAMIO_PERF_EVENT_STOP;
+
+            if(!(event->event_id & CAMIO_PERF_EVENT_STOP)){
+                if(!same && event_id != (uint64_t)from_event){
+                    continue;
+                }
+                if(open[event_id]){
+                    stats->unmatched_starts++;
+                    if(on_single){
+                        on_single(arg, buff, open[event_id]);
+                    }
+                }
+                open[event_id] = event;
+                continue;
+            }
+
+            if(!same && event_id != (uint64_t)to_event){
+                continue;
+            }
+
+            const uint64_t start_id = same ? event_id : (uint64_t)from_event;
+            if(start_id > max_id || !open[start_id]){
+                stats->unmatched_stops++;
+                if(on_single){
+                    on_single(arg, buff, event);
+                }
+                continue;
+            }
+
+            on_pair(arg, buff, open[start_id], event);
+            open[start_id] = NULL;
+            stats->pairs++;
+        }
+
+        for(i = 0; i <= max_id; i++){
+            if(open[i]){
+                stats->unmatched_starts++;
+                if(on_single){
+                    on_single(arg, buff, open[i]);
+                }
+            }
+        }
+        free(open);
+    }
+}
@@ -0,0 +1,82 @@
+/*
+ * Copyright  (C) Matthew P. Grosvenor, 2012, All Rights Reserved
+ *
+ * Reads back the output of camio_perf_finish() for offline analysis
+ *
+ */
+
+#ifndef CAMIO_PERF_TRACE_H_
+#define CAMIO_PERF_TRACE_H_
+
+#include <stdint.h>
+
+#include "camio_perf.h"
+
+typedef struct {
+    uint64_t tid;
+    uint64_t event_count;                       //Events logged, including those that were not kept
+    uint64_t ring;                              //Non zero if the events are the last ones logged, not the first
+    uint64_t events_len;
+    camio_perf_event_t* events;                 //Oldest first
+    uint32_t counter_kind;
+    camio_perf_counts_t* counts;                //A set for each event, or NULL if the thread had no counters
+} camio_perf_trace_buff_t;
+
+typedef struct {
+    uint64_t tsc_hz;
+    uint64_t tsc_base;                          //TSC reading at ns_base (CLOCK_REALTIME)
+    uint64_t ns_base;
+    uint32_t event_names_len;
+    uint32_t cond_names_len;
+    uint32_t counters;
+    uint32_t counter_kinds;
+    char (*names)[CAMIO_PERF_FILE_NAME_LEN];    //Event names, then condition names, then counter names by kind
+    uint64_t buffs_len;
+    camio_perf_trace_buff_t* buffs;
+} camio_perf_trace_t;
+
+
+//Load a binary or text dump. Text dumps don't say how fast the TSC was ticking, so if tsc_hz is zero it is measured
+//here, which is only right if the dump came from this machine. A non zero tsc_hz overrides the one in a binary dump.
+camio_perf_trace_t* camio_perf_trace_load(const char* filename, uint64_t tsc_hz);
+void camio_perf_trace_free(camio_perf_trace_t* trace);
+
+//Names are "event_<id>" or "cond_<id>" when the dump doesn't have them. The returned string is only good until the
+//next call.
+const char* camio_perf_trace_event_name(const camio_perf_trace_t* trace, uint64_t event_id);
+const char* camio_perf_trace_cond_name(const camio_perf_trace_t* trace, uint64_t cond_id);
+
+const char* camio_perf_trace_counter_name(const camio_perf_trace_t* trace, uint32_t kind, uint32_t counter);
+
+//Returns -1 if there is no event by that name
+int64_t camio_perf_trace_find_event(const camio_perf_trace_t* trace, const char* name);
+
+//Convert TSC ticks to CLOCK_REALTIME ns, and a number of ticks to a duration in ns
+uint64_t camio_perf_trace_ns(const camio_perf_trace_t* trace, uint64_t ts);
+uint64_t camio_perf_trace_ticks_to_ns(const camio_perf_trace_t* trace, uint64_t ticks);
+
+
+//Start and stop events are paired up within each thread. A start of from_event is closed by the next stop of
+//to_event. When both are -1, each start is closed by the next stop of the same event. A start that is followed by
+//another start of the same event before it is closed is counted as unmatched, as are stops with nothing to close.
+//Unmatched events go to on_single, if it isn't NULL.
+typedef void (*camio_perf_trace_pair_f)(void* arg, const camio_perf_trace_buff_t* buff,
+        const camio_perf_event_t* start, const camio_perf_event_t* stop);
+typedef void (*camio_perf_trace_single_f)(void* arg, const camio_perf_trace_buff_t* buff,
+        const camio_perf_event_t* event);
+
+typedef struct {
+    uint64_t pairs;
+    uint64_t unmatched_starts;
+    uint64_t unmatched_stops;
+} camio_perf_trace_pair_stats_t;
+
+//The change in each counter from start to stop. Returns 0 if either has no counts.
+int camio_perf_trace_deltas(const camio_perf_trace_buff_t* buff, const camio_perf_event_t* start,
+        const camio_perf_event_t* stop, camio_perf_counts_t* deltas);
+
+void camio_perf_trace_pairs(const camio_perf_trace_t* trace, int64_t from_event, int64_t to_event,
+        camio_perf_trace_pair_f on_pair, camio_perf_trace_single_f on_single, void* arg,
+        camio_perf_trace_pair_stats_t* stats);
+
+#endif /* CAMIO_PERF_TRACE_H_ */
@@ -6,33 +6,111 @@
  */
 
 #include <string.h>
+#include <stdlib.h>
+#include <limits.h>
 
 #include "../errors/camio_errors.h"
+#include "../utils/camio_util.h"
 
 #include "camio_selector.h"
 #include "camio_selector_spin.h"
 #include "camio_selector_seq.h"
 #include "camio_selector_poll.h"
+#include "camio_selector_epoll.h"
+#include "camio_selector_adaptive.h"
+#include "camio_selector_doorbell.h"
+#include "camio_selector_weighted.h"
 
 
 
 camio_selector_t* camio_selector_new(const char* description, camio_clock_t* clock, void* parameters){
     camio_selector_t* result = NULL;
+    camio_descr_t descr;
+    camio_descr_construct(&descr);
+    camio_descr_parse(description,&descr);
 
-    if(strcmp(description,"spin") == 0 ){
+    if(strcmp(descr.protocol,"spin") == 0 ){
         result = camio_selector_spin_new(clock, parameters);
     }
-    else if(strcmp(description,"seq") == 0 ){
+    else if(strcmp(descr.protocol,"seq") == 0 ){
         result = camio_selector_seq_new(clock, parameters);
     }
-    else if(strcmp(description,"poll") == 0 ){
+    else if(strcmp(descr.protocol,"poll") == 0 ){
         result = camio_selector_poll_new(clock, parameters);
     }
+    else if(strcmp(descr.protocol,"epoll") == 0 ){
+        result = camio_selector_epoll_new(clock, parameters);
+    }
+    else if(strcmp(descr.protocol,"adaptive") == 0 ){
+        result = camio_selector_adaptive_new(&descr, clock, parameters);
+    }
+    else if(strcmp(descr.protocol,"doorbell") == 0 ){
+        result = camio_selector_doorbell_new(clock, parameters);
+    }
+    else if(strcmp(descr.protocol,"weighted") == 0 ){
+        result = camio_selector_weighted_new(&descr, clock, parameters);
+    }
 
     else{
         eprintf_exit("Could not create selector from description \"%s\" \n", description);
     }
 
+    camio_descr_destroy(&descr);
     return result;
 
 }
+
+
+void camio_selector_timer_add(camio_selector_t* this, camio_timer_t* timer, uint64_t expiry_ns, size_t index){
+    if(unlikely(!this->timers)){
+        this->timers = malloc(sizeof(camio_timer_wheel_t));
+        if(!this->timers){
+            eprintf_exit("No memory available for selector timers\n");
+        }
+        camio_timer_wheel_init(this->timers, CAMIO_TIMER_TICK_NS_DEFAULT, camio_timer_now_ns());
+    }
+
+    camio_timer_add(this->timers, timer, expiry_ns, index);
+}
+
+
+void camio_selector_timer_cancel(camio_selector_t* this, camio_timer_t* timer){
+    if(this->timers){
+        camio_timer_cancel(this->timers, timer);
+    }
+}
+
+
+int camio_selector_timer_due(camio_selector_t* this, uint64_t now, size_t* index_out){
+    if(likely(!this->timers)){
+        return 0;
+    }
+
+    camio_timer_advance(this->timers, now);
+    camio_timer_t* timer = camio_timer_pop_expired(this->timers);
+    if(timer){
+        *index_out = timer->index;
+        return 1;
+    }
+
+    return 0;
+}
+
+
+uint64_t camio_selector_wait_ns(camio_selector_t* this, uint64_t now, uint64_t deadline){
+    const uint64_t until = this->timers ? MIN(deadline, camio_timer_next_ns(this->timers)) : deadline;
+    return until > now ? until - now : 0;
+}
+
+
+int camio_selector_wait_ms(camio_selector_t* this, uint64_t now, uint64_t deadline){
+    const uint64_t wait_ns = camio_selector_wait_ns(this, now, deadline);
+    const uint64_t wait_ms = wait_ns / (1000 * 1000) + (wait_ns % (1000 * 1000) != 0);
+    return wait_ms > INT_MAX ? -1 : (int)wait_ms;
+}
+
+
+void camio_selector_timers_delete(camio_selector_t* this){
+    free(this->timers);
+    this->timers = NULL;
+}
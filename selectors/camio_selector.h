@@ -12,6 +12,7 @@
 
 #include "../stream_description/camio_descr.h"
 #include "../clocks/camio_clock.h"
+#include "../utils/camio_timer.h"
 
 struct camio_selectable;
 typedef struct camio_selectable camio_selectable_t;
@@ -21,6 +22,9 @@ struct camio_selectable {
 };
 
 
+#define CAMIO_SELECTOR_FOREVER (~0ULL)             //A deadline that never comes
+#define CAMIO_SELECTOR_TIMEOUT ((size_t)~0ULL)     //Returned by select_until() when the deadline passes
+
 struct camio_selector;
 typedef struct camio_selector camio_selector_t;
 struct camio_selector{
@@ -28,12 +32,28 @@ struct camio_selector{
      int(*insert)(camio_selector_t* this, camio_selectable_t* stream, size_t index);    //Insert a stream at index specified
      int(*remove)(camio_selector_t* this, size_t index);                                //Remove the istream at index specified
      size_t(*select)(camio_selector_t* this);                                           //Block waiting for a change on a given istream
+     size_t(*select_many)(camio_selector_t* this, size_t* out, size_t max);             //Block until a stream is ready, then return up to max ready indices in out
+     size_t(*select_until)(camio_selector_t* this, uint64_t deadline);                  //As select, but also returns expired timers, and gives up at deadline (CLOCK_MONOTONIC ns)
      void(*delete)(camio_selector_t* this);                                             //Closes the stream and deletes the memory used
      size_t (*count)(camio_selector_t* this);                                           //Returns the number of streams in this selctor
      camio_clock_t* clock;
+     camio_timer_wheel_t* timers;                                                       //Created when the first timer is added
      void* priv;
 };
 
 camio_selector_t* camio_selector_new(const char* description, camio_clock_t* clock, void* parameters);
 
+//Timers are returned by select_until() with the index they were added with, just like a stream that is ready. The
+//timer structure belongs to the caller, and must stay put until the timer goes off or is cancelled.
+void camio_selector_timer_add(camio_selector_t* this, camio_timer_t* timer, uint64_t expiry_ns, size_t index);
+void camio_selector_timer_cancel(camio_selector_t* this, camio_timer_t* timer);
+
+//For selector implementations. Moves the timers on to now, returns 1 and the index of a timer that has gone off.
+int camio_selector_timer_due(camio_selector_t* this, uint64_t now, size_t* index_out);
+//How long we can block for, in ns, before the deadline or the timers need us.
+uint64_t camio_selector_wait_ns(camio_selector_t* this, uint64_t now, uint64_t deadline);
+//The same, rounded up to whole ms for poll() style calls. -1 means there's nothing to wait for.
+int camio_selector_wait_ms(camio_selector_t* this, uint64_t now, uint64_t deadline);
+void camio_selector_timers_delete(camio_selector_t* this);
+
 #endif /* SELECTOR_H_ */
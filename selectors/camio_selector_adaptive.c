@@ -0,0 +1,371 @@
+/*
+ * Copyright  (C) Matthew P. Grosvenor, 2012, All Rights Reserved
+ *
+ * Camio adaptive (spin, then block) selector
+ *
+ */
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <time.h>
+
+
+#include "../errors/camio_errors.h"
+#include "../utils/camio_util.h"
+#include "../stream_description/camio_opt_parser.h"
+
+#include "camio_selector_adaptive.h"
+
+
+//Spins over ready() like the spin selector while there is traffic, then blocks in epoll when things go quiet.
+// - Each stream's hit rate is measured over a window of polls. Streams that rarely have data (and have an fd) are left
+//   to the kernel, and only polled now and then. If no stream is worth spinning on, we block straight away.
+// - The spin time adapts. If data turns up soon after we have given up and blocked, we should have spun for longer. If
+//   we block for longer than we would ever spin, spinning was a waste. It halves down to nothing when things are idle.
+// - Streams with no fd that epoll can wait on are always polled, so the block has a timeout while there are any.
+
+
+static inline uint64_t now_ns(){
+    return camio_timer_now_ns();
+}
+
+
+int camio_selector_adaptive_init(camio_selector_t* this){
+    camio_selector_adaptive_t* priv = this->priv;
+
+    priv->epoll_fd = epoll_create1(0);
+    if(priv->epoll_fd < 0){
+        eprintf_exit( "Could not create epoll instance. Error=%s\n", strerror(errno));
+    }
+
+    return 0;
+}
+
+//Insert an istream at index specified
+int camio_selector_adaptive_insert(camio_selector_t* this, camio_selectable_t* stream, size_t index){
+    camio_selector_adaptive_t* priv = this->priv;
+    if(!stream){
+        eprintf_exit("No stream supplied\n");
+    }
+
+    size_t i;
+    for(i = 0; i < CAMIO_SELECTOR_ADAPTIVE_MAX_STREAMS; i++ ){
+        if(priv->streams[i].stream == NULL){
+            break;
+        }
+    }
+
+    if(i == CAMIO_SELECTOR_ADAPTIVE_MAX_STREAMS){
+        wprintf( "Cannot insert more than %u streams in this selector\n", CAMIO_SELECTOR_ADAPTIVE_MAX_STREAMS);
+        return -1;
+    }
+
+    camio_selector_adaptive_stream_t* s = &priv->streams[i];
+    s->stream = stream;
+    s->index  = index;
+    s->hybrid = 1;
+    s->hot    = 1; //Assume it's busy until we know better
+    s->polls  = 0;
+    s->hits   = 0;
+
+    if(stream->fd >= 0){
+        struct epoll_event event;
+        event.events   = EPOLLIN;
+        event.data.u64 = i;
+        if(epoll_ctl(priv->epoll_fd, EPOLL_CTL_ADD, stream->fd, &event) == 0){
+            s->hybrid = 0;
+        }
+        else if(errno != EPERM){ //EPERM means a file that is always readable, it has to be polled
+            wprintf( "Could not add fd %i to adaptive selector. Error=%s\n", stream->fd, strerror(errno));
+            s->stream = NULL;
+            return -1;
+        }
+    }
+
+    priv->hybrid_count += s->hybrid;
+    priv->hot_count++;
+    priv->stream_avail++;
+    priv->stream_used = MAX(priv->stream_used, i + 1);
+
+    return 0;
+}
+
+
+
+size_t camio_selector_adaptive_count(camio_selector_t* this){
+    camio_selector_adaptive_t* priv = this->priv;
+    return priv->stream_avail;
+}
+
+
+//Remove the istream at index specified
+int camio_selector_adaptive_remove(camio_selector_t* this, size_t index){
+    camio_selector_adaptive_t* priv = this->priv;
+
+    size_t i = 0;
+    for(i = 0; i < priv->stream_used; i++ ){
+        camio_selector_adaptive_stream_t* s = &priv->streams[i];
+        if(s->stream != NULL && s->index == index){
+            if(!s->hybrid){
+                epoll_ctl(priv->epoll_fd, EPOLL_CTL_DEL, s->stream->fd, NULL); //The fd may already be gone, that's fine
+            }
+            priv->hybrid_count -= s->hybrid;
+            priv->hot_count    -= s->hot;
+            priv->stream_avail--;
+            s->stream = NULL;
+            return 0;
+        }
+    }
+
+    wprintf( "Cannot remove this stream (%lu) from this selector. The index could not be found.\n", index);
+    return -1;
+}
+
+
+//Poll a stream and keep track of how often it has data
+static inline int poll_stream(camio_selector_adaptive_t* priv, camio_selector_adaptive_stream_t* s){
+    const int ready = s->stream->ready(s->stream);
+    s->hits += ready != 0;
+    s->polls++;
+
+    //A cold stream that has already had enough hits to be hot over a whole window doesn't need to wait for the end of it
+    const int hot_early = !s->hot && s->hits * CAMIO_SELECTOR_ADAPTIVE_HOT_RATE >= CAMIO_SELECTOR_ADAPTIVE_WINDOW;
+    if(unlikely(s->polls >= CAMIO_SELECTOR_ADAPTIVE_WINDOW || hot_early)){
+        const int hot = s->hits * CAMIO_SELECTOR_ADAPTIVE_HOT_RATE >= s->polls;
+        priv->hot_count += hot - s->hot;
+        s->hot   = hot;
+        s->polls = 0;
+        s->hits  = 0;
+    }
+
+    return ready;
+}
+
+
+//Go once around the streams, starting after the last one that fired. Returns the number of ready streams put in out.
+static size_t spin_pass(camio_selector_adaptive_t* priv, size_t* out, size_t max){
+    priv->pass++;
+    const int cold_turn = priv->pass % CAMIO_SELECTOR_ADAPTIVE_COLD_EVERY == 0;
+
+    const size_t start = priv->last + 1;
+    size_t count = 0;
+    size_t n = 0;
+    for(; n < priv->stream_used && count < max; n++){
+        const size_t i = (start + n) % priv->stream_used;
+        camio_selector_adaptive_stream_t* s = &priv->streams[i];
+        if(s->stream == NULL || !(s->hot || s->hybrid || cold_turn)){
+            continue;
+        }
+
+        if(poll_stream(priv, s)){
+            priv->last   = i;
+            out[count++] = s->index;
+        }
+    }
+
+    return count;
+}
+
+
+//Block in epoll until an fd has data, it's time to poll the hybrid streams again, or limit_ms (-1 for none) is up.
+//Returns the number of ready streams put in out. Events we don't get to are level triggered, so they will come up again.
+static size_t block(camio_selector_adaptive_t* priv, size_t* out, size_t max, int limit_ms){
+    int timeout = priv->hybrid_count ? (int)priv->block_ms : -1;
+    if(limit_ms >= 0 && (timeout < 0 || limit_ms < timeout)){
+        timeout = limit_ms;
+    }
+
+    const uint64_t start = now_ns();
+    const int result = epoll_wait(priv->epoll_fd, priv->events, CAMIO_SELECTOR_ADAPTIVE_EVENTS, timeout);
+    const uint64_t blocked = now_ns() - start;
+    if(result < 0 && errno != EINTR){
+        eprintf_exit( "Epoll wait failed with error =%s", strerror(errno));
+    }
+
+    //Data that turned up within the longest spin would have been caught by spinning, so spin for longer next time
+    if(result > 0 && blocked < priv->spin_max_ns){
+        priv->spin_ns = MIN(MAX(priv->spin_ns * 2, CAMIO_SELECTOR_ADAPTIVE_SPIN_MIN_NS), priv->spin_max_ns);
+    }
+    else if(blocked > priv->spin_max_ns){
+        priv->spin_ns = priv->spin_ns / 2 >= CAMIO_SELECTOR_ADAPTIVE_SPIN_MIN_NS ? priv->spin_ns / 2 : 0;
+    }
+
+    size_t count = 0;
+    int e = 0;
+    for(; e < result && count < max; e++){
+        const size_t i = priv->events[e].data.u64;
+        camio_selector_adaptive_stream_t* s = &priv->streams[i];
+        if(s->stream && poll_stream(priv, s)){
+            priv->last   = i;
+            out[count++] = s->index;
+        }
+    }
+
+    return count;
+}
+
+
+//Block waiting for at least one istream to be ready, then return the ready ones (up to max)
+size_t camio_selector_adaptive_select_many(camio_selector_t* this, size_t* out, size_t max){
+    camio_selector_adaptive_t* priv = this->priv;
+    size_t count = 0;
+
+    if(unlikely(!max)){
+        return 0;
+    }
+
+    uint64_t spin_start = now_ns();
+    while(1){
+        count = spin_pass(priv, out, max);
+        if(count){
+            return count;
+        }
+
+        //Nothing is worth spinning on, or we've spun for long enough
+        const int quiet = !priv->hot_count && !priv->hybrid_count;
+        if(quiet || now_ns() - spin_start >= priv->spin_ns){
+            count = block(priv, out, max, -1);
+            if(count){
+                return count;
+            }
+            spin_start = now_ns();
+        }
+    }
+
+    return 0; //Unreachable
+}
+
+
+//Block waiting for a change on a given istream
+//return the stream number that changed
+size_t camio_selector_adaptive_select(camio_selector_t* this){
+    size_t index = ~0;
+    camio_selector_adaptive_select_many(this, &index, 1);
+    return index;
+}
+
+
+//Block waiting for a change on a given istream, a timer to go off, or the deadline to pass
+size_t camio_selector_adaptive_select_until(camio_selector_t* this, uint64_t deadline){
+    camio_selector_adaptive_t* priv = this->priv;
+    size_t index = 0;
+
+    uint64_t spin_start = now_ns();
+    while(1){
+        const uint64_t now = now_ns();
+        if(camio_selector_timer_due(this, now, &index)){
+            return index;
+        }
+        if(now >= deadline){
+            return CAMIO_SELECTOR_TIMEOUT;
+        }
+
+        if(spin_pass(priv, &index, 1)){
+            return index;
+        }
+
+        const int quiet = !priv->hot_count && !priv->hybrid_count;
+        if(quiet || now - spin_start >= priv->spin_ns){
+            if(block(priv, &index, 1, camio_selector_wait_ms(this, now, deadline))){
+                return index;
+            }
+            spin_start = now_ns();
+        }
+    }
+
+    return CAMIO_SELECTOR_TIMEOUT; //Unreachable
+}
+
+
+void camio_selector_adaptive_delete(camio_selector_t* this){
+    camio_selector_adaptive_t* priv = this->priv;
+    camio_selector_timers_delete(this);
+    close(priv->epoll_fd);
+    free(priv);
+}
+
+/* ****************************************************
+ * Construction
+ */
+
+//Options are "spin_ns=<n>", "spin_max_ns=<n>" and "block_ms=<n>", which override the params. eg "adaptive,spin_ns=0"
+static void parse_descr(camio_selector_adaptive_t* priv, const camio_descr_t* descr){
+    if(!descr || !camio_descr_has_opts(descr->opt_head)){
+        return;
+    }
+
+    struct camio_opt_t* opt;
+    for(opt = descr->opt_head; opt; opt = opt->next){
+        if(strcmp(opt->name,"spin_ns") == 0){
+            camio_descr_get_opt_uint(opt, &priv->spin_ns);
+        }
+        else if(strcmp(opt->name,"spin_max_ns") == 0){
+            camio_descr_get_opt_uint(opt, &priv->spin_max_ns);
+        }
+        else if(strcmp(opt->name,"block_ms") == 0){
+            camio_descr_get_opt_uint(opt, &priv->block_ms);
+        }
+        else{
+            eprintf_exit( "Unknown option supplied \"%s\". Valid options for this selector are: \"spin_ns=<uint64>\", \"spin_max_ns=<uint64>\", \"block_ms=<uint64>\"\n", opt->name);
+        }
+    }
+}
+
+
+camio_selector_t* camio_selector_adaptive_construct(camio_selector_adaptive_t* priv, const camio_descr_t* descr, camio_clock_t* clock, camio_selector_adaptive_params_t* params){
+    if(!priv){
+        eprintf_exit("adaptive stream supplied is null\n");
+    }
+    //Initialize the local variables
+    priv->params           = params;
+    priv->stream_used      = 0;
+    priv->stream_avail     = 0;
+    priv->hot_count        = 0;
+    priv->hybrid_count     = 0;
+    priv->last             = 0;
+    priv->pass             = 0;
+    priv->epoll_fd         = -1;
+    priv->spin_ns          = CAMIO_SELECTOR_ADAPTIVE_SPIN_NS_DEFAULT;
+    priv->spin_max_ns      = CAMIO_SELECTOR_ADAPTIVE_SPIN_MAX_NS_DEFAULT;
+    priv->block_ms         = CAMIO_SELECTOR_ADAPTIVE_BLOCK_MS_DEFAULT;
+    bzero(&priv->streams,sizeof(camio_selector_adaptive_stream_t) * CAMIO_SELECTOR_ADAPTIVE_MAX_STREAMS) ;
+
+    if(params){
+        priv->spin_ns     = params->spin_ns;
+        priv->spin_max_ns = params->spin_max_ns;
+        priv->block_ms    = params->block_ms;
+    }
+    parse_descr(priv, descr);
+    priv->spin_max_ns = MAX(priv->spin_max_ns, priv->spin_ns);
+
+
+    //Populate the function members
+    priv->selector.priv          = priv; //Lets us access private members
+    priv->selector.init          = camio_selector_adaptive_init;
+    priv->selector.insert        = camio_selector_adaptive_insert;
+    priv->selector.remove        = camio_selector_adaptive_remove;
+    priv->selector.select        = camio_selector_adaptive_select;
+    priv->selector.select_many   = camio_selector_adaptive_select_many;
+    priv->selector.select_until  = camio_selector_adaptive_select_until;
+    priv->selector.delete        = camio_selector_adaptive_delete;
+    priv->selector.count         = camio_selector_adaptive_count;
+    priv->selector.clock         = clock;
+    priv->selector.timers        = NULL;
+
+    //Call init, because its the obvious thing to do now...
+    priv->selector.init(&priv->selector);
+
+    //Return the generic selector interface for the outside world to use
+    return &priv->selector;
+
+}
+
+camio_selector_t* camio_selector_adaptive_new(const camio_descr_t* descr, camio_clock_t* clock, camio_selector_adaptive_params_t* params){
+    camio_selector_adaptive_t* priv = malloc(sizeof(camio_selector_adaptive_t));
+    if(!priv){
+        eprintf_exit("No memory available for adaptive selector creation\n");
+    }
+    return camio_selector_adaptive_construct(priv, descr, clock, params);
+}
@@ -0,0 +1,74 @@
+/*
+ * Copyright  (C) Matthew P. Grosvenor, 2012, All Rights Reserved
+ *
+ * Camio adaptive (spin, then block) selector
+ *
+ */
+
+#ifndef CAMIO_SELECTOR_ADAPTIVE_H_
+#define CAMIO_SELECTOR_ADAPTIVE_H_
+
+#include <sys/epoll.h>
+
+#include "camio_selector.h"
+#include "../istreams/camio_istream.h"
+
+/********************************************************************
+ *                  PRIVATE DEFS
+ ********************************************************************/
+
+typedef struct {
+    uint64_t spin_ns;           //Initial time to spin before blocking. 0 means block straight away
+    uint64_t spin_max_ns;       //Most the spin time will grow to
+    uint64_t block_ms;          //Longest to block for when there are streams that can only be polled
+} camio_selector_adaptive_params_t;
+
+
+typedef struct {
+    camio_selectable_t* stream;
+    size_t index;
+    int hybrid;                 //No fd that epoll can wait on, so it has to be polled
+    int hot;                    //Has data often enough to be worth spinning on
+    uint64_t polls;             //Number of polls in the current window
+    uint64_t hits;              //Number of those polls that found data
+} camio_selector_adaptive_stream_t;
+
+#define CAMIO_SELECTOR_ADAPTIVE_MAX_STREAMS 4096
+#define CAMIO_SELECTOR_ADAPTIVE_EVENTS 64
+
+#define CAMIO_SELECTOR_ADAPTIVE_SPIN_NS_DEFAULT (50 * 1000)         //50us
+#define CAMIO_SELECTOR_ADAPTIVE_SPIN_MAX_NS_DEFAULT (1000 * 1000)   //1ms
+#define CAMIO_SELECTOR_ADAPTIVE_SPIN_MIN_NS (1000)                  //1us
+#define CAMIO_SELECTOR_ADAPTIVE_BLOCK_MS_DEFAULT (1)
+
+#define CAMIO_SELECTOR_ADAPTIVE_WINDOW (4096)       //Polls over which a stream's hit rate is measured
+#define CAMIO_SELECTOR_ADAPTIVE_HOT_RATE (1024)     //A stream is hot if at least 1 in this many polls finds data
+#define CAMIO_SELECTOR_ADAPTIVE_COLD_EVERY (64)     //Cold streams with an fd are only polled on every nth pass
+
+typedef struct {
+    camio_selector_t selector;                         //Underlying selector interface
+    camio_selector_adaptive_params_t* params;          //Parameters passed in from the outside
+    camio_selector_adaptive_stream_t streams[CAMIO_SELECTOR_ADAPTIVE_MAX_STREAMS]; //Statically allow up to n streams on this selector
+    size_t stream_used;                                //Streams below this have been used at some stage
+    size_t stream_avail;                               //Number of streams that are non null in the selector
+    size_t hot_count;                                  //Number of streams that are worth spinning on
+    size_t hybrid_count;                               //Number of streams that epoll can't wait on
+    size_t last;
+    uint64_t pass;                                     //Number of passes over the streams so far
+    uint64_t spin_ns;                                  //Current time to spin for before blocking
+    uint64_t spin_max_ns;
+    uint64_t block_ms;
+    int epoll_fd;
+    struct epoll_event events[CAMIO_SELECTOR_ADAPTIVE_EVENTS];
+} camio_selector_adaptive_t;
+
+
+
+/********************************************************************
+ *                  PUBLIC DEFS
+ ********************************************************************/
+
+camio_selector_t* camio_selector_adaptive_new(const camio_descr_t* descr, camio_clock_t* clock, camio_selector_adaptive_params_t* params);
+
+
+#endif /* CAMIO_SELECTOR_ADAPTIVE_H_ */
@@ -0,0 +1,389 @@
+/*
+ * Copyright  (C) Matthew P. Grosvenor, 2012, All Rights Reserved
+ *
+ * Camio doorbell selector
+ *
+ */
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+
+
+#include "../errors/camio_errors.h"
+#include "../utils/camio_util.h"
+
+#include "camio_selector_doorbell.h"
+
+
+//Streams opened with a doorbell (eg "ring:/tmp/r,doorbell=/tmp/bell") have their bit rung by the ostream whenever it
+//publishes. While nothing is happening, a select pass only reads the summary line of each doorbell. Rung bits are
+//moved to a local pending set, and a stream stays pending until its ready() says it has nothing left, since it will
+//only be rung again for new data. Streams without a doorbell are polled on every pass, like the spin selector does.
+
+
+int camio_selector_doorbell_init(camio_selector_t* this){
+    //camio_selector_doorbell_t* priv = this->priv;
+    return 0;
+}
+
+
+//Find the doorbell in filename, or attach to it if this is the first stream that uses it
+static int find_bell(camio_selector_doorbell_t* priv, const char* filename){
+    size_t i = 0;
+    for(; i < priv->bell_count; i++){
+        if(strcmp(priv->bells[i]->filename, filename) == 0){
+            return i;
+        }
+    }
+
+    if(priv->bell_count >= CAMIO_SELECTOR_DOORBELL_MAX_BELLS){
+        wprintf( "Cannot use more than %u doorbells in this selector\n", CAMIO_SELECTOR_DOORBELL_MAX_BELLS);
+        return -1;
+    }
+
+    camio_selector_doorbell_bell_t* bell = malloc(sizeof(camio_selector_doorbell_bell_t));
+    if(!bell){
+        eprintf_exit("No memory available for doorbell selector\n");
+    }
+    bzero(bell, sizeof(camio_selector_doorbell_bell_t));
+
+    bell->filename = strdup(filename);
+    bell->bell     = camio_doorbell_attach(filename);
+    for(i = 0; i < CAMIO_DOORBELL_BITS; i++){
+        bell->slots[i] = CAMIO_SELECTOR_DOORBELL_NO_SLOT;
+    }
+
+    priv->bells[priv->bell_count] = bell;
+    return priv->bell_count++;
+}
+
+
+static inline void set_pending(camio_selector_doorbell_bell_t* bell, uint64_t bit){
+    bell->pending[bit / 64] |= 1ULL << (bit % 64);
+    bell->pending_words     |= 1ULL << (bit / 64);
+}
+
+static inline void clear_pending(camio_selector_doorbell_bell_t* bell, uint64_t bit){
+    bell->pending[bit / 64] &= ~(1ULL << (bit % 64));
+    if(!bell->pending[bit / 64]){
+        bell->pending_words &= ~(1ULL << (bit / 64));
+    }
+}
+
+
+//Insert an istream at index specified
+int camio_selector_doorbell_insert(camio_selector_t* this, camio_selectable_t* stream, size_t index){
+    camio_selector_doorbell_t* priv = this->priv;
+    if(!stream){
+        eprintf_exit("No stream supplied\n");
+    }
+
+    size_t i;
+    for(i = 0; i < CAMIO_SELECTOR_DOORBELL_MAX_STREAMS; i++ ){
+        if(priv->streams[i].stream == NULL){
+            break;
+        }
+    }
+
+    if(i == CAMIO_SELECTOR_DOORBELL_MAX_STREAMS){
+        wprintf( "Cannot insert more than %u streams in this selector\n", CAMIO_SELECTOR_DOORBELL_MAX_STREAMS);
+        return -1;
+    }
+
+    camio_selector_doorbell_stream_t* s = &priv->streams[i];
+    s->stream = stream;
+    s->index  = index;
+    s->bell   = -1;
+    s->bit    = 0;
+
+    const char* filename = camio_doorbell_lookup(stream, &s->bit);
+    if(filename){
+        s->bell = find_bell(priv, filename);
+    }
+
+    if(s->bell >= 0){
+        camio_selector_doorbell_bell_t* bell = priv->bells[s->bell];
+        bell->slots[s->bit] = i;
+        bell->streams++;
+        set_pending(bell, s->bit); //It may have been rung before we were watching
+    }
+    else{
+        priv->plain_count++;
+    }
+
+    priv->stream_avail++;
+    priv->stream_used = MAX(priv->stream_used, i + 1);
+
+    return 0;
+}
+
+
+
+size_t camio_selector_doorbell_count(camio_selector_t* this){
+    camio_selector_doorbell_t* priv = this->priv;
+    return priv->stream_avail;
+}
+
+
+//Remove the istream at index specified
+int camio_selector_doorbell_remove(camio_selector_t* this, size_t index){
+    camio_selector_doorbell_t* priv = this->priv;
+
+    size_t i = 0;
+    for(i = 0; i < priv->stream_used; i++ ){
+        camio_selector_doorbell_stream_t* s = &priv->streams[i];
+        if(s->stream != NULL && s->index == index){
+            if(s->bell >= 0){
+                camio_selector_doorbell_bell_t* bell = priv->bells[s->bell];
+                bell->slots[s->bit] = CAMIO_SELECTOR_DOORBELL_NO_SLOT;
+                bell->streams--;
+                clear_pending(bell, s->bit);
+            }
+            else{
+                priv->plain_count--;
+            }
+
+            s->stream = NULL;
+            priv->stream_avail--;
+            return 0;
+        }
+    }
+
+    wprintf( "Cannot remove this stream (%lu) from this selector. The index could not be found.\n", index);
+    return -1;
+}
+
+
+//Returns the first pending bit at or after from, wrapping around. There must be at least one.
+static inline uint64_t next_pending(camio_selector_doorbell_bell_t* bell, uint64_t from){
+    from %= CAMIO_DOORBELL_BITS;
+
+    uint64_t word = from / 64;
+    const uint64_t rest = bell->pending[word] & (~0ULL << (from % 64));
+    if(rest){
+        return word * 64 + __builtin_ctzll(rest);
+    }
+
+    const uint64_t later = word + 1 < CAMIO_DOORBELL_WORDS ? bell->pending_words & (~0ULL << (word + 1)) : 0;
+    word = __builtin_ctzll(later ? later : bell->pending_words);
+    return word * 64 + __builtin_ctzll(bell->pending[word]);
+}
+
+
+//Pick up anything that has been rung, then go once around the pending streams after the last one that fired.
+//Returns the number of ready streams put in out.
+static size_t select_bell(camio_selector_doorbell_t* priv, camio_selector_doorbell_bell_t* bell, size_t* out, size_t max){
+    uint64_t words = camio_doorbell_take(bell->bell, bell->pending);
+    for(; words; words &= words - 1){
+        const uint64_t word = __builtin_ctzll(words);
+        if(bell->pending[word]){
+            bell->pending_words |= 1ULL << word;
+        }
+    }
+
+    if(likely(!bell->pending_words)){
+        return 0;
+    }
+
+    size_t pending = 0;
+    for(words = bell->pending_words; words; words &= words - 1){
+        pending += __builtin_popcountll(bell->pending[__builtin_ctzll(words)]);
+    }
+
+    size_t count = 0;
+    uint64_t bit = bell->last + 1;
+    for(; pending && count < max && bell->pending_words; pending--){
+        bit = next_pending(bell, bit);
+
+        const uint64_t slot = bell->slots[bit];
+        if(likely(slot != CAMIO_SELECTOR_DOORBELL_NO_SLOT)){
+            camio_selectable_t* stream = priv->streams[slot].stream;
+            if(stream->ready(stream)){
+                bell->last   = bit; //Stays pending, there may be more
+                out[count++] = priv->streams[slot].index;
+                bit++;
+                continue;
+            }
+        }
+
+        clear_pending(bell, bit); //It will be rung again when there is new data
+        bit++;
+    }
+
+    return count;
+}
+
+
+//Go once around the streams that don't have a doorbell. Returns the number of ready streams put in out.
+static size_t select_plain(camio_selector_doorbell_t* priv, size_t* out, size_t max){
+    const size_t start = priv->last + 1;
+    size_t count = 0;
+    size_t n = 0;
+    for(; n < priv->stream_used && count < max; n++){
+        const size_t i = (start + n) % priv->stream_used;
+        camio_selector_doorbell_stream_t* s = &priv->streams[i];
+        if(s->stream != NULL && s->bell < 0 && s->stream->ready(s->stream)){
+            priv->last   = i;
+            out[count++] = s->index;
+        }
+    }
+
+    return count;
+}
+
+
+//Go once around the doorbells and the streams without one. Returns the number of ready streams put in out.
+static size_t select_pass(camio_selector_doorbell_t* priv, size_t* out, size_t max){
+    size_t count = 0;
+
+    //Take turns at going first, so that busy streams of one kind can't starve the other
+    priv->plain_first = !priv->plain_first;
+    if(priv->plain_first && priv->plain_count){
+        count += select_plain(priv, out, max);
+    }
+
+    const size_t start = priv->bell_last + 1;
+    size_t n = 0;
+    for(; n < priv->bell_count && count < max; n++){
+        const size_t b = (start + n) % priv->bell_count;
+        if(priv->bells[b]->streams){
+            const size_t found = select_bell(priv, priv->bells[b], out + count, max - count);
+            if(found){
+                priv->bell_last = b;
+                count += found;
+            }
+        }
+    }
+
+    if(!priv->plain_first && priv->plain_count && count < max){
+        count += select_plain(priv, out + count, max - count);
+    }
+
+    return count;
+}
+
+
+//Block waiting for at least one istream to be ready, then return the ready ones (up to max)
+size_t camio_selector_doorbell_select_many(camio_selector_t* this, size_t* out, size_t max){
+    camio_selector_doorbell_t* priv = this->priv;
+
+    if(unlikely(!max)){
+        return 0;
+    }
+
+    while(1){
+        const size_t count = select_pass(priv, out, max);
+        if(count){
+            return count;
+        }
+
+        asm("pause"); //Tell the CPU we're spinning
+    }
+
+    return 0; //Unreachable
+}
+
+
+//Block waiting for a change on a given istream
+//return the stream number that changed
+size_t camio_selector_doorbell_select(camio_selector_t* this){
+    size_t index = ~0;
+    camio_selector_doorbell_select_many(this, &index, 1);
+    return index;
+}
+
+
+//Block waiting for a change on a given istream, a timer to go off, or the deadline to pass
+size_t camio_selector_doorbell_select_until(camio_selector_t* this, uint64_t deadline){
+    camio_selector_doorbell_t* priv = this->priv;
+    size_t index = 0;
+
+    if(!this->timers && deadline == CAMIO_SELECTOR_FOREVER){
+        return camio_selector_doorbell_select(this); //Don't look at the time if there's no need to
+    }
+
+    while(1){
+        const uint64_t now = camio_timer_now_ns();
+        if(camio_selector_timer_due(this, now, &index)){
+            return index;
+        }
+        if(now >= deadline){
+            return CAMIO_SELECTOR_TIMEOUT;
+        }
+
+        if(select_pass(priv, &index, 1)){
+            return index;
+        }
+
+        asm("pause"); //Tell the CPU we're spinning
+    }
+
+    return CAMIO_SELECTOR_TIMEOUT; //Unreachable
+}
+
+
+void camio_selector_doorbell_delete(camio_selector_t* this){
+    camio_selector_doorbell_t* priv = this->priv;
+    camio_selector_timers_delete(this);
+
+    size_t i = 0;
+    for(; i < priv->bell_count; i++){
+        camio_doorbell_detach(priv->bells[i]->bell, priv->bells[i]->filename);
+        free(priv->bells[i]->filename);
+        free(priv->bells[i]);
+    }
+
+    free(priv);
+}
+
+/* ****************************************************
+ * Construction
+ */
+
+camio_selector_t* camio_selector_doorbell_construct(camio_selector_doorbell_t* priv, camio_clock_t* clock, camio_selector_doorbell_params_t* params){
+    if(!priv){
+        eprintf_exit("doorbell stream supplied is null\n");
+    }
+    //Initialize the local variables
+    priv->params           = params;
+    priv->stream_used      = 0;
+    priv->stream_avail     = 0;
+    priv->plain_count      = 0;
+    priv->last             = 0;
+    priv->bell_count       = 0;
+    priv->bell_last        = 0;
+    priv->plain_first      = 0;
+    bzero(&priv->streams,sizeof(camio_selector_doorbell_stream_t) * CAMIO_SELECTOR_DOORBELL_MAX_STREAMS) ;
+    bzero(&priv->bells,sizeof(camio_selector_doorbell_bell_t*) * CAMIO_SELECTOR_DOORBELL_MAX_BELLS) ;
+
+
+    //Populate the function members
+    priv->selector.priv          = priv; //Lets us access private members
+    priv->selector.init          = camio_selector_doorbell_init;
+    priv->selector.insert        = camio_selector_doorbell_insert;
+    priv->selector.remove        = camio_selector_doorbell_remove;
+    priv->selector.select        = camio_selector_doorbell_select;
+    priv->selector.select_many   = camio_selector_doorbell_select_many;
+    priv->selector.select_until  = camio_selector_doorbell_select_until;
+    priv->selector.delete        = camio_selector_doorbell_delete;
+    priv->selector.count         = camio_selector_doorbell_count;
+    priv->selector.clock         = clock;
+    priv->selector.timers        = NULL;
+
+    //Call init, because its the obvious thing to do now...
+    priv->selector.init(&priv->selector);
+
+    //Return the generic selector interface for the outside world to use
+    return &priv->selector;
+
+}
+
+camio_selector_t* camio_selector_doorbell_new(camio_clock_t* clock, camio_selector_doorbell_params_t* params){
+    camio_selector_doorbell_t* priv = malloc(sizeof(camio_selector_doorbell_t));
+    if(!priv){
+        eprintf_exit("No memory available for doorbell selector creation\n");
+    }
+    return camio_selector_doorbell_construct(priv, clock, params);
+}
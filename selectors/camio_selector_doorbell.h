@@ -0,0 +1,68 @@
+/*
+ * Copyright  (C) Matthew P. Grosvenor, 2012, All Rights Reserved
+ *
+ * Camio doorbell selector
+ *
+ */
+
+#ifndef CAMIO_SELECTOR_DOORBELL_H_
+#define CAMIO_SELECTOR_DOORBELL_H_
+
+#include "camio_selector.h"
+#include "../istreams/camio_istream.h"
+#include "../utils/camio_doorbell.h"
+
+/********************************************************************
+ *                  PRIVATE DEFS
+ ********************************************************************/
+
+typedef struct {
+    //No params at this stage
+} camio_selector_doorbell_params_t;
+
+
+typedef struct {
+    camio_selectable_t* stream;
+    size_t index;
+    int bell;                                           //Which of our doorbells this stream rings, -1 if it has none
+    uint64_t bit;                                       //The stream's bit in that doorbell
+} camio_selector_doorbell_stream_t;
+
+#define CAMIO_SELECTOR_DOORBELL_MAX_STREAMS 4096
+#define CAMIO_SELECTOR_DOORBELL_MAX_BELLS 8
+#define CAMIO_SELECTOR_DOORBELL_NO_SLOT (~0ULL)
+
+typedef struct {
+    char* filename;
+    volatile camio_doorbell_t* bell;
+    uint64_t pending[CAMIO_DOORBELL_WORDS];             //Bits that have been rung, and not yet found to be empty
+    uint64_t pending_words;                             //Bit w is set when pending[w] is non zero
+    uint64_t last;                                      //Bit of the last stream that fired
+    size_t streams;                                     //Number of our streams on this doorbell
+    uint64_t slots[CAMIO_DOORBELL_BITS];                //Stream slot for each bit
+} camio_selector_doorbell_bell_t;
+
+typedef struct {
+    camio_selector_t selector;                          //Underlying selector interface
+    camio_selector_doorbell_params_t* params;           //Parameters passed in from the outside
+    camio_selector_doorbell_stream_t streams[CAMIO_SELECTOR_DOORBELL_MAX_STREAMS]; //Statically allow up to n streams on this selector
+    size_t stream_used;                                 //Streams below this have been used at some stage
+    size_t stream_avail;                                //Number of streams that are non null in the selector
+    size_t plain_count;                                 //Number of streams without a doorbell, these are polled
+    size_t last;                                        //Last stream without a doorbell that fired
+    int plain_first;                                    //Look at the streams without a doorbell first, alternates
+    camio_selector_doorbell_bell_t* bells[CAMIO_SELECTOR_DOORBELL_MAX_BELLS];
+    size_t bell_count;
+    size_t bell_last;                                   //Last doorbell that had a stream fire
+} camio_selector_doorbell_t;
+
+
+
+/********************************************************************
+ *                  PUBLIC DEFS
+ ********************************************************************/
+
+camio_selector_t* camio_selector_doorbell_new( camio_clock_t* clock, camio_selector_doorbell_params_t* params);
+
+
+#endif /* CAMIO_SELECTOR_DOORBELL_H_ */
@@ -0,0 +1,394 @@
+/*
+ * Copyright  (C) Matthew P. Grosvenor, 2012, All Rights Reserved
+ *
+ * Camio epoll selector
+ *
+ */
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+
+
+#include "../errors/camio_errors.h"
+#include "../utils/camio_util.h"
+
+#include "camio_selector_epoll.h"
+
+
+//Each fd is registered once, edge triggered. epoll only tells us when a stream goes from empty to ready, so a stream
+//stays on the ready queue (and is asked if it is ready) until it says it has nothing left. Streams that epoll cannot
+//wait on (no fd, or a regular file like the ring file) are polled in user space, like the spin selector does.
+
+
+static void queue_push(camio_selector_epoll_t* priv, size_t slot){
+    priv->queue[(priv->queue_head + priv->queue_count) % priv->stream_slots] = slot;
+    priv->queue_count++;
+}
+
+static size_t queue_pop(camio_selector_epoll_t* priv){
+    const size_t slot = priv->queue[priv->queue_head];
+    priv->queue_head = (priv->queue_head + 1) % priv->stream_slots;
+    priv->queue_count--;
+    return slot;
+}
+
+
+static void* grow_array(void* array, size_t size){
+    void* result = realloc(array, size);
+    if(!result){
+        eprintf_exit("No memory available to grow epoll selector\n");
+    }
+    return result;
+}
+
+//Double the size of the stream table and everything that is indexed by it
+static void grow(camio_selector_epoll_t* priv){
+    const size_t old_slots = priv->stream_slots;
+    const size_t new_slots = old_slots * 2;
+
+    priv->streams    = grow_array(priv->streams, new_slots * sizeof(camio_selector_epoll_stream_t));
+    priv->free_slots = grow_array(priv->free_slots, new_slots * sizeof(size_t));
+    priv->hybrids    = grow_array(priv->hybrids, new_slots * sizeof(size_t));
+    bzero(priv->streams + old_slots, (new_slots - old_slots) * sizeof(camio_selector_epoll_stream_t));
+
+    //The queue wraps around, so lay it out again from the start
+    size_t* queue = grow_array(NULL, new_slots * sizeof(size_t));
+    size_t i = 0;
+    for(; i < priv->queue_count; i++){
+        queue[i] = priv->queue[(priv->queue_head + i) % old_slots];
+    }
+    free(priv->queue);
+    priv->queue        = queue;
+    priv->queue_head   = 0;
+    priv->stream_slots = new_slots;
+}
+
+
+int camio_selector_epoll_init(camio_selector_t* this){
+    camio_selector_epoll_t* priv = this->priv;
+
+    priv->epoll_fd = epoll_create1(0);
+    if(priv->epoll_fd < 0){
+        eprintf_exit( "Could not create epoll instance. Error=%s\n", strerror(errno));
+    }
+
+    priv->stream_slots = CAMIO_SELECTOR_EPOLL_INIT_STREAMS;
+    priv->streams      = grow_array(NULL, priv->stream_slots * sizeof(camio_selector_epoll_stream_t));
+    priv->free_slots   = grow_array(NULL, priv->stream_slots * sizeof(size_t));
+    priv->hybrids      = grow_array(NULL, priv->stream_slots * sizeof(size_t));
+    priv->queue        = grow_array(NULL, priv->stream_slots * sizeof(size_t));
+    bzero(priv->streams, priv->stream_slots * sizeof(camio_selector_epoll_stream_t));
+
+    return 0;
+}
+
+//Insert an istream at index specified
+int camio_selector_epoll_insert(camio_selector_t* this, camio_selectable_t* stream, size_t index){
+    camio_selector_epoll_t* priv = this->priv;
+    if(!stream){
+        eprintf_exit("No stream supplied\n");
+    }
+
+    size_t slot;
+    if(priv->free_count){
+        slot = priv->free_slots[--priv->free_count];
+    }
+    else{
+        if(priv->stream_used == priv->stream_slots){
+            grow(priv);
+        }
+        slot = priv->stream_used++;
+    }
+
+    //A reused slot may still be on the ready queue. That's harmless, the new stream will just be asked if it's ready.
+    priv->streams[slot].stream = stream;
+    priv->streams[slot].index  = index;
+    priv->streams[slot].hybrid = 1;
+
+    if(stream->fd >= 0){
+        struct epoll_event event;
+        event.events   = EPOLLIN | EPOLLET;
+        event.data.u64 = slot;
+        if(epoll_ctl(priv->epoll_fd, EPOLL_CTL_ADD, stream->fd, &event) == 0){
+            priv->streams[slot].hybrid = 0;
+        }
+        else if(errno != EPERM){ //EPERM means a file that is always readable, poll it in user space instead
+            wprintf( "Could not add fd %i to epoll selector. Error=%s\n", stream->fd, strerror(errno));
+            priv->streams[slot].stream = NULL;
+            priv->free_slots[priv->free_count++] = slot;
+            return -1;
+        }
+    }
+
+    if(priv->streams[slot].hybrid){
+        priv->hybrids[priv->hybrid_count++] = slot;
+    }
+
+    priv->stream_avail++;
+    return 0;
+}
+
+
+
+size_t camio_selector_epoll_count(camio_selector_t* this){
+    camio_selector_epoll_t* priv = this->priv;
+    return priv->stream_avail;
+}
+
+
+//Remove the istream at index specified
+int camio_selector_epoll_remove(camio_selector_t* this, size_t index){
+    camio_selector_epoll_t* priv = this->priv;
+
+    size_t slot = 0;
+    for(; slot < priv->stream_used; slot++){
+        if(priv->streams[slot].stream != NULL && priv->streams[slot].index == index){
+            break;
+        }
+    }
+
+    if(slot == priv->stream_used){
+        wprintf( "Cannot remove this stream (%lu) from this selector. The index could not be found.\n", index);
+        return -1;
+    }
+
+    camio_selector_epoll_stream_t* stream = &priv->streams[slot];
+    if(stream->hybrid){
+        size_t i = 0;
+        for(; i < priv->hybrid_count; i++){
+            if(priv->hybrids[i] == slot){
+                priv->hybrids[i] = priv->hybrids[--priv->hybrid_count];
+                break;
+            }
+        }
+    }
+    else{
+        //The fd may already be closed, in which case epoll has dropped it for us
+        epoll_ctl(priv->epoll_fd, EPOLL_CTL_DEL, stream->stream->fd, NULL);
+    }
+
+    stream->stream = NULL;
+    priv->free_slots[priv->free_count++] = slot;
+    priv->stream_avail--;
+
+    return 0;
+}
+
+
+//Ask epoll for more ready streams and put them on the queue
+static void wait_events(camio_selector_epoll_t* priv, int timeout){
+    const int result = epoll_wait(priv->epoll_fd, priv->events, CAMIO_SELECTOR_EPOLL_EVENTS, timeout);
+    if(result < 0){
+        if(errno == EINTR){
+            return;
+        }
+        eprintf_exit( "Epoll wait failed with error =%s", strerror(errno));
+    }
+
+    int i = 0;
+    for(; i < result; i++){
+        const size_t slot = priv->events[i].data.u64;
+        if(priv->streams[slot].stream && !priv->streams[slot].queued){
+            priv->streams[slot].queued = 1;
+            queue_push(priv, slot);
+        }
+    }
+
+    priv->popped = 0;
+}
+
+
+//Go once around the ready queue. Streams that are still ready go to the back, the rest wait for their next edge.
+//Returns the number of ready streams put in out.
+static size_t select_queue(camio_selector_epoll_t* priv, size_t* out, size_t max){
+    size_t found = 0;
+    size_t count = priv->queue_count;
+    for(; count && found < max; count--){
+        const size_t slot = queue_pop(priv);
+        priv->popped++;
+
+        camio_selector_epoll_stream_t* stream = &priv->streams[slot];
+        if(likely(stream->stream && stream->stream->ready(stream->stream))){
+            queue_push(priv, slot);
+            out[found++] = stream->index;
+            continue;
+        }
+
+        stream->queued = 0;
+    }
+
+    return found;
+}
+
+
+//Go once around the streams that epoll can't wait on. Returns the number of ready streams put in out.
+static size_t select_hybrid(camio_selector_epoll_t* priv, size_t* out, size_t max){
+    size_t found = 0;
+    size_t count = 0;
+    for(; count < priv->hybrid_count && found < max; count++){
+        priv->hybrid_last = (priv->hybrid_last + 1) % priv->hybrid_count;
+        const size_t slot = priv->hybrids[priv->hybrid_last];
+        if(priv->streams[slot].stream->ready(priv->streams[slot].stream)){
+            out[found++] = priv->streams[slot].index;
+        }
+    }
+
+    return found;
+}
+
+
+//Block waiting for at least one istream to be ready, then return the ready ones (up to max)
+size_t camio_selector_epoll_select_many(camio_selector_t* this, size_t* out, size_t max){
+    camio_selector_epoll_t* priv = this->priv;
+
+    if(unlikely(!max)){
+        return 0;
+    }
+
+    while(1){
+        //Only block in the kernel if there's nothing that we have to poll ourselves. Once we've been around the queue,
+        //top it up without blocking so that busy streams can't starve the ones that have just become ready.
+        if(!priv->queue_count){
+            wait_events(priv, priv->hybrid_count ? 0 : -1);
+        }
+        else if(priv->popped >= priv->queue_count){
+            wait_events(priv, 0);
+        }
+
+        //Take turns at going first, so neither kind of stream can starve the other
+        priv->hybrid_first = !priv->hybrid_first;
+        size_t count = 0;
+        if(priv->hybrid_first){
+            count += select_hybrid(priv, out, max);
+            count += select_queue(priv, out + count, max - count);
+        }
+        else{
+            count += select_queue(priv, out, max);
+            count += select_hybrid(priv, out + count, max - count);
+        }
+
+        if(count){
+            return count;
+        }
+    }
+
+    return 0; //Unreachable
+}
+
+
+//Block waiting for a change on a given istream
+//return the stream number that changed
+size_t camio_selector_epoll_select(camio_selector_t* this){
+    size_t index = ~0;
+    camio_selector_epoll_select_many(this, &index, 1);
+    return index;
+}
+
+
+//Block waiting for a change on a given istream, a timer to go off, or the deadline to pass
+size_t camio_selector_epoll_select_until(camio_selector_t* this, uint64_t deadline){
+    camio_selector_epoll_t* priv = this->priv;
+    size_t index = 0;
+
+    if(!this->timers && deadline == CAMIO_SELECTOR_FOREVER){
+        return camio_selector_epoll_select(this); //Don't look at the time if there's no need to
+    }
+
+    while(1){
+        const uint64_t now = camio_timer_now_ns();
+        if(camio_selector_timer_due(this, now, &index)){
+            return index;
+        }
+        if(now >= deadline){
+            return CAMIO_SELECTOR_TIMEOUT;
+        }
+
+        //As for select, but the block can't go past the deadline or the next timer
+        if(!priv->queue_count){
+            wait_events(priv, priv->hybrid_count ? 0 : camio_selector_wait_ms(this, now, deadline));
+        }
+        else if(priv->popped >= priv->queue_count){
+            wait_events(priv, 0);
+        }
+
+        priv->hybrid_first = !priv->hybrid_first;
+        const size_t count = priv->hybrid_first ?
+                select_hybrid(priv, &index, 1) || select_queue(priv, &index, 1) :
+                select_queue(priv, &index, 1)  || select_hybrid(priv, &index, 1);
+        if(count){
+            return index;
+        }
+    }
+
+    return CAMIO_SELECTOR_TIMEOUT; //Unreachable
+}
+
+
+void camio_selector_epoll_delete(camio_selector_t* this){
+    camio_selector_epoll_t* priv = this->priv;
+    camio_selector_timers_delete(this);
+    close(priv->epoll_fd);
+    free(priv->streams);
+    free(priv->free_slots);
+    free(priv->hybrids);
+    free(priv->queue);
+    free(priv);
+}
+
+/* ****************************************************
+ * Construction
+ */
+
+camio_selector_t* camio_selector_epoll_construct(camio_selector_epoll_t* priv, camio_clock_t* clock, camio_selector_epoll_params_t* params){
+    if(!priv){
+        eprintf_exit("epoll stream supplied is null\n");
+    }
+    //Initialize the local variables
+    priv->params           = params;
+    priv->epoll_fd         = -1;
+    priv->streams          = NULL;
+    priv->stream_slots     = 0;
+    priv->stream_used      = 0;
+    priv->stream_avail     = 0;
+    priv->free_slots       = NULL;
+    priv->free_count       = 0;
+    priv->hybrids          = NULL;
+    priv->hybrid_count     = 0;
+    priv->hybrid_last      = 0;
+    priv->hybrid_first     = 0;
+    priv->queue            = NULL;
+    priv->queue_head       = 0;
+    priv->queue_count      = 0;
+    priv->popped           = 0;
+
+
+    //Populate the function members
+    priv->selector.priv          = priv; //Lets us access private members
+    priv->selector.init          = camio_selector_epoll_init;
+    priv->selector.insert        = camio_selector_epoll_insert;
+    priv->selector.remove        = camio_selector_epoll_remove;
+    priv->selector.select        = camio_selector_epoll_select;
+    priv->selector.select_many   = camio_selector_epoll_select_many;
+    priv->selector.select_until  = camio_selector_epoll_select_until;
+    priv->selector.delete        = camio_selector_epoll_delete;
+    priv->selector.count         = camio_selector_epoll_count;
+    priv->selector.clock         = clock;
+    priv->selector.timers        = NULL;
+
+    //Call init, because its the obvious thing to do now...
+    priv->selector.init(&priv->selector);
+
+    //Return the generic selector interface for the outside world to use
+    return &priv->selector;
+
+}
+
+camio_selector_t* camio_selector_epoll_new(camio_clock_t* clock, camio_selector_epoll_params_t* params){
+    camio_selector_epoll_t* priv = malloc(sizeof(camio_selector_epoll_t));
+    if(!priv){
+        eprintf_exit("No memory available for epoll selector creation\n");
+    }
+    return camio_selector_epoll_construct(priv, clock, params);
+}
@@ -0,0 +1,65 @@
+/*
+ * Copyright  (C) Matthew P. Grosvenor, 2012, All Rights Reserved
+ *
+ * Camio epoll selector
+ *
+ */
+
+#ifndef CAMIO_SELECTOR_EPOLL_H_
+#define CAMIO_SELECTOR_EPOLL_H_
+
+#include <sys/epoll.h>
+
+#include "camio_selector.h"
+#include "../istreams/camio_istream.h"
+
+/********************************************************************
+ *                  PRIVATE DEFS
+ ********************************************************************/
+
+typedef struct {
+    //No params at this stage
+} camio_selector_epoll_params_t;
+
+
+typedef struct {
+    camio_selectable_t* stream;
+    size_t index;
+    int queued;                                         //Is this slot on the ready queue?
+    int hybrid;                                         //No fd that epoll can wait on, so ready() is polled in user space
+} camio_selector_epoll_stream_t;
+
+#define CAMIO_SELECTOR_EPOLL_EVENTS 256                 //Most events picked up in one epoll_wait
+#define CAMIO_SELECTOR_EPOLL_INIT_STREAMS 64            //Initial size of the stream table, it doubles as needed
+
+typedef struct {
+    camio_selector_t selector;                          //Underlying selector interface
+    camio_selector_epoll_params_t* params;              //Parameters passed in from the outside
+    int epoll_fd;
+    camio_selector_epoll_stream_t* streams;             //Stream table, the slot number is the epoll user data
+    size_t stream_slots;                                //Size of the stream table
+    size_t stream_used;                                 //Slots below this have been used at some stage
+    size_t stream_avail;                                //Number of streams that are non null in the selector
+    size_t* free_slots;                                 //Stack of slots given back by remove
+    size_t free_count;
+    size_t* hybrids;                                    //Slots of streams that have to be polled in user space
+    size_t hybrid_count;
+    size_t hybrid_last;
+    int hybrid_first;                                   //Which kind of stream select looks at first, alternates
+    size_t* queue;                                      //Ring of slots that epoll says have data, each appears at most once
+    size_t queue_head;
+    size_t queue_count;
+    size_t popped;                                      //Slots taken off the queue since we last asked epoll for more
+    struct epoll_event events[CAMIO_SELECTOR_EPOLL_EVENTS];
+} camio_selector_epoll_t;
+
+
+
+/********************************************************************
+ *                  PUBLIC DEFS
+ ********************************************************************/
+
+camio_selector_t* camio_selector_epoll_new( camio_clock_t* clock, camio_selector_epoll_params_t* params);
+
+
+#endif /* CAMIO_SELECTOR_EPOLL_H_ */
@@ -1,3 +1,4 @@
+//#CFLAGS=-D_GNU_SOURCE
 /*
  * Copyright  (C) Matthew P. Grosvenor, 2012, All Rights Reserved
  *
@@ -98,8 +99,87 @@ size_t camio_selector_poll_select(camio_selector_t* this){
 }
 
 
+//Block waiting for at least one istream to change, then return every one that poll() reported (up to max), starting
+//after the last one that fired. Hang ups and errors are reported too, so that the reader finds out about them.
+size_t camio_selector_poll_select_many(camio_selector_t* this, size_t* out, size_t max){
+    camio_selector_poll_t* priv = this->priv;
+
+    if(unlikely(!max)){
+        return 0;
+    }
+
+    while(1){
+        int result = poll(priv->fds,priv->stream_count,-1);
+        if(result < 0){
+            if(errno == EINTR){
+                continue;
+            }
+            eprintf_exit( "Poll failed with error =%s", strerror(errno));
+        }
+
+        const size_t start = priv->last + 1;
+        size_t count = 0;
+        size_t n = 0;
+        for(; n < priv->stream_count && count < max; n++){
+            const size_t i = (start + n) % priv->stream_count;
+            if(likely(priv->streams[i].stream != NULL && priv->fds[i].fd != -1 && (priv->fds[i].revents & (POLLIN | POLLHUP | POLLERR)) )){
+                out[count++] = priv->streams[i].index;
+                priv->last   = i;
+            }
+        }
+
+        if(count){
+            return count;
+        }
+    }
+
+    return 0; //Unreachable
+}
+
+
+//Block waiting for a change on a given istream, a timer to go off, or the deadline to pass
+size_t camio_selector_poll_select_until(camio_selector_t* this, uint64_t deadline){
+    camio_selector_poll_t* priv = this->priv;
+    size_t index = 0;
+
+    while(1){
+        const uint64_t now = camio_timer_now_ns();
+        if(camio_selector_timer_due(this, now, &index)){
+            return index;
+        }
+        if(now >= deadline){
+            return CAMIO_SELECTOR_TIMEOUT;
+        }
+
+        const uint64_t wait_ns = camio_selector_wait_ns(this, now, deadline);
+        struct timespec timeout = { .tv_sec = wait_ns / (1000 * 1000 * 1000), .tv_nsec = wait_ns % (1000 * 1000 * 1000) };
+        const int forever = wait_ns >= CAMIO_SELECTOR_FOREVER - now;
+
+        int result = ppoll(priv->fds,priv->stream_count, forever ? NULL : &timeout, NULL);
+        if(result < 0){
+            if(errno == EINTR){
+                continue;
+            }
+            eprintf_exit( "Poll failed with error =%s", strerror(errno));
+        }
+
+        size_t n = 0;
+        for(; result > 0 && n < priv->stream_count; n++){
+            const size_t i = (priv->last + 1 + n) % priv->stream_count;
+            if(likely(priv->streams[i].stream != NULL && priv->fds[i].fd != -1 && (priv->fds[i].revents & (POLLIN | POLLHUP | POLLERR)) )){
+                priv->last = i;
+                return priv->streams[i].index;
+            }
+        }
+    }
+
+    return CAMIO_SELECTOR_TIMEOUT; //Unreachable
+}
+
+
 void camio_selector_poll_delete(camio_selector_t* this){
     camio_selector_poll_t* priv = this->priv;
+    camio_selector_timers_delete(this);
     free(priv);
 }
 
@@ -126,9 +206,12 @@ camio_selector_t* camio_selector_poll_construct(camio_selector_poll_t* priv, cam
     priv->selector.insert        = camio_selector_poll_insert;
     priv->selector.remove        = camio_selector_poll_remove;
     priv->selector.select        = camio_selector_poll_select;
+    priv->selector.select_many   = camio_selector_poll_select_many;
+    priv->selector.select_until  = camio_selector_poll_select_until;
     priv->selector.delete        = camio_selector_poll_delete;
     priv->selector.count         = camio_selector_poll_count;
     priv->selector.clock         = clock;
+    priv->selector.timers        = NULL;
 
     //Call init, because its the obvious thing to do now...
     priv->selector.init(&priv->selector);
@@ -89,8 +89,69 @@ size_t camio_selector_seq_select(camio_selector_t* this){
 }
 
 
+//Block waiting for at least one istream to be ready, then return every ready one (up to max), in order
+size_t camio_selector_seq_select_many(camio_selector_t* this, size_t* out, size_t max){
+    camio_selector_seq_t* priv = this->priv;
+
+    if(unlikely(!max)){
+        return 0;
+    }
+
+    while(1){
+        size_t count = 0;
+        size_t i = 0; //Start from zero every time to ensure starvation
+        for(; i < priv->stream_count && count < max; i++){
+            if(likely(priv->streams[i].stream != NULL)){
+                if(priv->streams[i].stream->ready(priv->streams[i].stream)){
+                    out[count++] = priv->streams[i].index;
+                }
+            }
+        }
+
+        if(count){
+            return count;
+        }
+    }
+
+    return 0; //Unreachable
+}
+
+
+//Block waiting for a change on a given istream, a timer to go off, or the deadline to pass
+size_t camio_selector_seq_select_until(camio_selector_t* this, uint64_t deadline){
+    camio_selector_seq_t* priv = this->priv;
+    size_t index = 0;
+
+    if(!this->timers && deadline == CAMIO_SELECTOR_FOREVER){
+        return camio_selector_seq_select(this); //Don't look at the time if there's no need to
+    }
+
+    while(1){
+        const uint64_t now = camio_timer_now_ns();
+        if(camio_selector_timer_due(this, now, &index)){
+            return index;
+        }
+        if(now >= deadline){
+            return CAMIO_SELECTOR_TIMEOUT;
+        }
+
+        size_t i = 0; //Start from zero every time to ensure starvation
+        for(; i < priv->stream_count; i++){
+            if(likely(priv->streams[i].stream != NULL)){
+                if(priv->streams[i].stream->ready(priv->streams[i].stream)){
+                    return priv->streams[i].index;
+                }
+            }
+        }
+    }
+
+    return CAMIO_SELECTOR_TIMEOUT; //Unreachable
+}
+
+
 void camio_selector_seq_delete(camio_selector_t* this){
     camio_selector_seq_t* priv = this->priv;
+    camio_selector_timers_delete(this);
     free(priv);
 }
 
@@ -116,9 +177,12 @@ camio_selector_t* camio_selector_seq_construct(camio_selector_seq_t* priv, camio
     priv->selector.insert        = camio_selector_seq_insert;
     priv->selector.remove        = camio_selector_seq_remove;
     priv->selector.select        = camio_selector_seq_select;
+    priv->selector.select_many   = camio_selector_seq_select_many;
+    priv->selector.select_until  = camio_selector_seq_select_until;
     priv->selector.delete        = camio_selector_seq_delete;
     priv->selector.count         = camio_selector_seq_count;
     priv->selector.clock         = clock;
+    priv->selector.timers        = NULL;
 
     //Call init, because its the obvious thing to do now...
     priv->selector.init(&priv->selector);
@@ -63,6 +63,7 @@ int camio_selector_spin_insert(camio_selector_t* this, camio_selectable_t* strea
             priv->streams[i].index = index;
             priv->streams[i].stream = stream;
             priv->stream_count++;
+            priv->stream_used = MAX(priv->stream_used, i + 1);
             //printf("[0x%016lx] selector added at index %i\n", priv->streams[i].index, i);
             return priv->stream_count;
         }
@@ -109,9 +110,9 @@ uint64_t str1 = 0;
 size_t camio_selector_spin_select(camio_selector_t* this){
     camio_selector_spin_t* priv = this->priv;
 
-    size_t i = (priv->last + 1) % priv->stream_count; //Start from the next stream to avoid starvation
+    size_t i = (priv->last + 1) % priv->stream_used; //Start from the next stream to avoid starvation
     while(1){
-        for(; i < priv->stream_count; i++){
+        for(; i < priv->stream_used; i++){
 //            uint64_t start = 0;
 //            uint64_t end = 0;
 //            do_rdtsc(start);
@@ -143,8 +144,76 @@ size_t camio_selector_spin_select(camio_selector_t* this){
 }
 
 
+//Block waiting for at least one istream to be ready, then return every ready one (up to max), starting after the
+//last one that fired
+size_t camio_selector_spin_select_many(camio_selector_t* this, size_t* out, size_t max){
+    camio_selector_spin_t* priv = this->priv;
+
+    if(unlikely(!max)){
+        return 0;
+    }
+
+    while(1){
+        const size_t start = priv->last + 1;
+        size_t count = 0;
+        size_t n = 0;
+        for(; n < priv->stream_used && count < max; n++){
+            const size_t i = (start + n) % priv->stream_used;
+            if(likely(priv->streams[i].stream != NULL)){
+                if(priv->streams[i].stream->ready(priv->streams[i].stream)){
+                    out[count++] = priv->streams[i].index;
+                    priv->last   = i;
+                }
+            }
+        }
+
+        if(count){
+            return count;
+        }
+    }
+
+    return 0; //Unreachable
+}
+
+
+//Block waiting for a change on a given istream, a timer to go off, or the deadline to pass
+size_t camio_selector_spin_select_until(camio_selector_t* this, uint64_t deadline){
+    camio_selector_spin_t* priv = this->priv;
+    size_t index = 0;
+
+    if(!this->timers && deadline == CAMIO_SELECTOR_FOREVER){
+        return camio_selector_spin_select(this); //Don't look at the time if there's no need to
+    }
+
+    while(1){
+        const uint64_t now = camio_timer_now_ns();
+        if(camio_selector_timer_due(this, now, &index)){
+            return index;
+        }
+        if(now >= deadline){
+            return CAMIO_SELECTOR_TIMEOUT;
+        }
+
+        const size_t start = priv->last + 1;
+        size_t n = 0;
+        for(; n < priv->stream_used; n++){
+            const size_t i = (start + n) % priv->stream_used;
+            if(likely(priv->streams[i].stream != NULL)){
+                if(priv->streams[i].stream->ready(priv->streams[i].stream)){
+                    priv->last = i;
+                    return priv->streams[i].index;
+                }
+            }
+        }
+    }
+
+    return CAMIO_SELECTOR_TIMEOUT; //Unreachable
+}
+
+
 void camio_selector_spin_delete(camio_selector_t* this){
     camio_selector_spin_t* priv = this->priv;
+    camio_selector_timers_delete(this);
     free(priv);
 }
 
@@ -159,6 +228,7 @@ camio_selector_t* camio_selector_spin_construct(camio_selector_spin_t* priv, cam
     //Initialize the local variables
     priv->params           = params;
     priv->stream_count     = 0;
+    priv->stream_used      = 0;
     priv->last			   = 0;
     bzero(&priv->streams,sizeof(camio_selector_spin_stream_t) * CAMIO_SELECTOR_SPIN_MAX_STREAMS) ;
 
@@ -170,9 +240,12 @@ camio_selector_t* camio_selector_spin_construct(camio_selector_spin_t* priv, cam
     priv->selector.insert        = camio_selector_spin_insert;
     priv->selector.remove        = camio_selector_spin_remove;
     priv->selector.select        = camio_selector_spin_select;
+    priv->selector.select_many   = camio_selector_spin_select_many;
+    priv->selector.select_until  = camio_selector_spin_select_until;
     priv->selector.delete        = camio_selector_spin_delete;
     priv->selector.count         = camio_selector_spin_count;
     priv->selector.clock         = clock;
+    priv->selector.timers        = NULL;
 
     //Call init, because its the obvious thing to do now...
     priv->selector.init(&priv->selector);
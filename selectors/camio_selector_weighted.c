@@ -0,0 +1,414 @@
+/*
+ * Copyright  (C) Matthew P. Grosvenor, 2012, All Rights Reserved
+ *
+ * Camio weighted (priority class + deficit round robin) selector
+ *
+ */
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+
+
+#include "../errors/camio_errors.h"
+#include "../utils/camio_util.h"
+#include "../stream_description/camio_opt_parser.h"
+
+#include "camio_selector_weighted.h"
+
+
+//Each stream belongs to a priority class and has a weight.
+// - Classes are strictly ordered. A pass looks at the classes in order, and stops at the first one that has any streams
+//   ready, so a control stream in class 0 is never stuck behind bulk streams for more than one pass. Classes below that
+//   aren't asked, as ready() can hold on to data (an mring istream claims a slot) that other readers could have had.
+// - Within a class, streams take turns. On its turn, a stream can be selected up to weight times in a row before the
+//   turn moves on. A stream that has nothing ready gives up the rest of its turn, as in deficit round robin. We can't
+//   see message sizes from here, so every selection costs one.
+// - A stream is handed out at most once by each call to select_many(), so weights only come into play when there are
+//   more streams ready than the caller asked for.
+// - The time from a pass first seeing a stream ready to it being selected is its queueing delay. It is logged to
+//   camio_perf against the stream's class, and summed up per class.
+
+
+int camio_selector_weighted_init(camio_selector_t* this){
+    //camio_selector_weighted_t* priv = this->priv;
+    return 0;
+}
+
+
+int camio_selector_weighted_insert(camio_selector_t* this, camio_selectable_t* stream, size_t index, uint64_t class, uint64_t weight){
+    camio_selector_weighted_t* priv = this->priv;
+    if(!stream){
+        eprintf_exit("No stream supplied\n");
+    }
+
+    if(class >= priv->params.classes){
+        wprintf( "Cannot insert a stream in class %lu, this selector has %lu classes\n", class, priv->params.classes);
+        return -1;
+    }
+
+    if(!weight){
+        wprintf( "Cannot insert a stream with a weight of zero, it would never be selected\n");
+        return -1;
+    }
+
+    size_t i;
+    for(i = 0; i < CAMIO_SELECTOR_WEIGHTED_MAX_STREAMS; i++ ){
+        if(priv->streams[i].stream == NULL){
+            break;
+        }
+    }
+
+    if(i == CAMIO_SELECTOR_WEIGHTED_MAX_STREAMS){
+        wprintf( "Cannot insert more than %u streams in this selector\n", CAMIO_SELECTOR_WEIGHTED_MAX_STREAMS);
+        return -1;
+    }
+
+    camio_selector_weighted_stream_t* s = &priv->streams[i];
+    s->stream   = stream;
+    s->index    = index;
+    s->class    = class;
+    s->weight   = weight;
+    s->ready    = 0;
+    s->taken    = 0;
+    s->ready_ts = 0;
+
+    camio_selector_weighted_class_t* c = &priv->classes[class];
+    c->members[c->member_count++] = i;
+
+    priv->stream_avail++;
+    priv->stream_used = MAX(priv->stream_used, i + 1);
+
+    return 0;
+}
+
+
+//Insert an istream at index specified, with the class and weight from the description
+static int camio_selector_weighted_insert_default(camio_selector_t* this, camio_selectable_t* stream, size_t index){
+    camio_selector_weighted_t* priv = this->priv;
+
+    size_t r = 0;
+    for(; r < priv->rule_count; r++){
+        if(priv->rules[r].index == index){
+            return camio_selector_weighted_insert(this, stream, index, priv->rules[r].class, priv->rules[r].weight);
+        }
+    }
+
+    return camio_selector_weighted_insert(this, stream, index, priv->params.default_class, priv->params.default_weight);
+}
+
+
+
+size_t camio_selector_weighted_count(camio_selector_t* this){
+    camio_selector_weighted_t* priv = this->priv;
+    return priv->stream_avail;
+}
+
+
+//Remove the istream at index specified
+int camio_selector_weighted_remove(camio_selector_t* this, size_t index){
+    camio_selector_weighted_t* priv = this->priv;
+
+    size_t i = 0;
+    for(i = 0; i < priv->stream_used; i++ ){
+        camio_selector_weighted_stream_t* s = &priv->streams[i];
+        if(s->stream == NULL || s->index != index){
+            continue;
+        }
+
+        //Take it out of the round robin, keeping the order of the others so that nobody loses their turn
+        camio_selector_weighted_class_t* c = &priv->classes[s->class];
+        size_t m = 0;
+        for(; m < c->member_count && c->members[m] != i; m++){}
+        memmove(&c->members[m], &c->members[m + 1], (c->member_count - m - 1) * sizeof(size_t));
+        c->member_count--;
+
+        if(m < c->turn){
+            c->turn--;
+        }
+        else if(m == c->turn){
+            c->deficit = 0;
+        }
+        if(c->turn >= c->member_count){
+            c->turn = 0;
+        }
+
+        s->stream = NULL;
+        priv->stream_avail--;
+        return 0;
+    }
+
+    wprintf( "Cannot remove this stream (%lu) from this selector. The index could not be found.\n", index);
+    return -1;
+}
+
+
+//Look at the streams a class at a time, noting when each one was first seen ready, until a class has something ready.
+//Returns that class, or the number of classes if there's nothing. Streams in the classes below keep the time they
+//were first seen ready, so their queueing delay still counts the passes in which they weren't looked at.
+static uint64_t probe(camio_selector_weighted_t* priv){
+    const uint64_t now = camio_perf_ts();
+
+    uint64_t class = 0;
+    for(; class < priv->params.classes; class++){
+        camio_selector_weighted_class_t* c = &priv->classes[class];
+        c->ready_count = 0;
+
+        size_t m = 0;
+        for(; m < c->member_count; m++){
+            camio_selector_weighted_stream_t* s = &priv->streams[c->members[m]];
+            s->ready = s->stream->ready(s->stream) != 0;
+            if(s->ready){
+                s->ready_ts = s->ready_ts ? s->ready_ts : now;
+                c->ready_count++;
+            }
+            else{
+                s->ready_ts = 0;
+            }
+        }
+
+        if(c->ready_count){
+            return class;
+        }
+    }
+
+    return priv->params.classes;
+}
+
+
+//Pick the next stream in the class, deficit round robin style. Returns NULL if there is nothing left for this pass.
+static camio_selector_weighted_stream_t* pick(camio_selector_weighted_t* priv, camio_selector_weighted_class_t* c){
+    size_t n = 0;
+    for(; n < c->member_count; n++){
+        camio_selector_weighted_stream_t* s = &priv->streams[c->members[c->turn]];
+        if(s->ready && s->taken != priv->pass){
+            if(!c->deficit){
+                c->deficit = s->weight; //Start of its turn
+            }
+
+            c->deficit--;
+            if(!c->deficit){
+                c->turn = (c->turn + 1) % c->member_count;
+            }
+
+            return s;
+        }
+
+        //Nothing ready (or it has already been handed out this pass), so it gives up the rest of its turn
+        c->deficit = 0;
+        c->turn    = (c->turn + 1) % c->member_count;
+    }
+
+    return NULL;
+}
+
+
+//Probe the classes, and hand out the ready streams from the best one (up to max). Returns how many.
+static size_t select_pass(camio_selector_weighted_t* priv, size_t* out, size_t max){
+    const uint64_t class = probe(priv);
+    if(class == priv->params.classes){
+        return 0;
+    }
+
+    priv->pass++;
+    camio_selector_weighted_class_t* c = &priv->classes[class];
+    const uint64_t now = camio_perf_ts();
+
+    size_t count = 0;
+    camio_selector_weighted_stream_t* s = NULL;
+    while(count < max && (s = pick(priv, c))){
+        s->taken     = priv->pass;
+        out[count++] = s->index;
+
+        const uint64_t delay = now - s->ready_ts;
+        c->stats.selected++;
+        c->stats.delay_total += delay;
+        c->stats.delay_max    = MAX(c->stats.delay_max, delay);
+        camio_perf_event_span(priv->perf_mon, CAMIO_PERF_EVENT_SELECTOR_WEIGHTED, class, s->ready_ts, now);
+        s->ready_ts = 0; //Whatever is left is counted from the next time we look
+    }
+
+    return count;
+}
+
+
+//Block waiting for at least one istream to be ready, then return the ready ones from the best class (up to max)
+size_t camio_selector_weighted_select_many(camio_selector_t* this, size_t* out, size_t max){
+    camio_selector_weighted_t* priv = this->priv;
+
+    if(unlikely(!max)){
+        return 0;
+    }
+
+    while(1){
+        const size_t count = select_pass(priv, out, max);
+        if(count){
+            return count;
+        }
+
+        asm("pause"); //Tell the CPU we're spinning
+    }
+
+    return 0; //Unreachable
+}
+
+
+//Block waiting for a change on a given istream
+//return the stream number that changed
+size_t camio_selector_weighted_select(camio_selector_t* this){
+    size_t index = ~0;
+    camio_selector_weighted_select_many(this, &index, 1);
+    return index;
+}
+
+
+//Block waiting for a change on a given istream, a timer to go off, or the deadline to pass
+size_t camio_selector_weighted_select_until(camio_selector_t* this, uint64_t deadline){
+    camio_selector_weighted_t* priv = this->priv;
+    size_t index = 0;
+
+    while(1){
+        const uint64_t now = camio_timer_now_ns();
+        if(camio_selector_timer_due(this, now, &index)){
+            return index;
+        }
+        if(now >= deadline){
+            return CAMIO_SELECTOR_TIMEOUT;
+        }
+
+        if(select_pass(priv, &index, 1)){
+            return index;
+        }
+
+        asm("pause"); //Tell the CPU we're spinning
+    }
+
+    return CAMIO_SELECTOR_TIMEOUT; //Unreachable
+}
+
+
+void camio_selector_weighted_stats(camio_selector_t* this, uint64_t class, camio_selector_weighted_stats_t* stats_out){
+    camio_selector_weighted_t* priv = this->priv;
+    if(class >= priv->params.classes){
+        eprintf_exit("There is no class %lu in this selector\n", class);
+    }
+
+    *stats_out = priv->classes[class].stats;
+}
+
+
+void camio_selector_weighted_delete(camio_selector_t* this){
+    camio_selector_weighted_t* priv = this->priv;
+    camio_selector_timers_delete(this);
+    if(priv->own_perf_mon){
+        camio_perf_finish(priv->perf_mon);
+    }
+    free(priv);
+}
+
+/* ****************************************************
+ * Construction
+ */
+
+//Options are "classes=<n>", "class=<n>" and "weight=<n>" for streams added with insert(), and any number of
+//"stream=<index>:<class>:<weight>" for particular streams. eg "weighted,classes=3,stream=0:0:1,stream=1:1:4"
+static void parse_descr(camio_selector_weighted_t* priv, const camio_descr_t* descr){
+    if(!descr || !camio_descr_has_opts(descr->opt_head)){
+        return;
+    }
+
+    int class_set = 0;
+    struct camio_opt_t* opt;
+    for(opt = descr->opt_head; opt; opt = opt->next){
+        if(strcmp(opt->name,"classes") == 0){
+            camio_descr_get_opt_uint(opt, &priv->params.classes);
+        }
+        else if(strcmp(opt->name,"class") == 0){
+            camio_descr_get_opt_uint(opt, &priv->params.default_class);
+            class_set = 1;
+        }
+        else if(strcmp(opt->name,"weight") == 0){
+            camio_descr_get_opt_uint(opt, &priv->params.default_weight);
+        }
+        else if(strcmp(opt->name,"stream") == 0){
+            if(priv->rule_count >= CAMIO_SELECTOR_WEIGHTED_MAX_RULES){
+                eprintf_exit( "Cannot have more than %u stream rules\n", CAMIO_SELECTOR_WEIGHTED_MAX_RULES);
+            }
+            camio_selector_weighted_rule_t* rule = &priv->rules[priv->rule_count];
+            if(sscanf(opt->value, "%lu:%lu:%lu", &rule->index, &rule->class, &rule->weight) != 3){
+                eprintf_exit( "Could not parse stream rule \"%s\", expected \"<index>:<class>:<weight>\"\n", opt->value);
+            }
+            priv->rule_count++;
+        }
+        else{
+            eprintf_exit( "Unknown option supplied \"%s\". Valid options for this selector are: \"classes=<uint64>\", \"class=<uint64>\", \"weight=<uint64>\", \"stream=<index>:<class>:<weight>\"\n", opt->name);
+        }
+    }
+
+    //Streams go in the lowest class unless we're told otherwise
+    if(!class_set && priv->params.classes){
+        priv->params.default_class = priv->params.classes - 1;
+    }
+}
+
+
+camio_selector_t* camio_selector_weighted_construct(camio_selector_weighted_t* priv, const camio_descr_t* descr, camio_clock_t* clock, camio_selector_weighted_params_t* params){
+    if(!priv){
+        eprintf_exit("weighted stream supplied is null\n");
+    }
+    //Initialize the local variables
+    bzero(priv, sizeof(camio_selector_weighted_t));
+    priv->params.classes        = CAMIO_SELECTOR_WEIGHTED_CLASSES_DEFAULT;
+    priv->params.default_class  = CAMIO_SELECTOR_WEIGHTED_CLASSES_DEFAULT - 1;
+    priv->params.default_weight = CAMIO_SELECTOR_WEIGHTED_WEIGHT_DEFAULT;
+    priv->params.perf_mon       = NULL;
+
+    if(params){
+        priv->params = *params;
+    }
+    parse_descr(priv, descr);
+
+    if(!priv->params.classes || priv->params.classes > CAMIO_SELECTOR_WEIGHTED_MAX_CLASSES){
+        eprintf_exit("Weighted selector needs between 1 and %u classes, not %lu\n", CAMIO_SELECTOR_WEIGHTED_MAX_CLASSES, priv->params.classes);
+    }
+
+    if(priv->params.default_class >= priv->params.classes){
+        eprintf_exit("Default class %lu is out of range, there are %lu classes\n", priv->params.default_class, priv->params.classes);
+    }
+
+    priv->perf_mon = priv->params.perf_mon;
+    if(!priv->perf_mon){
+        priv->perf_mon     = camio_perf_init("",0);
+        priv->own_perf_mon = 1;
+    }
+
+
+    //Populate the function members
+    priv->selector.priv          = priv; //Lets us access private members
+    priv->selector.init          = camio_selector_weighted_init;
+    priv->selector.insert        = camio_selector_weighted_insert_default;
+    priv->selector.remove        = camio_selector_weighted_remove;
+    priv->selector.select        = camio_selector_weighted_select;
+    priv->selector.select_many   = camio_selector_weighted_select_many;
+    priv->selector.select_until  = camio_selector_weighted_select_until;
+    priv->selector.delete        = camio_selector_weighted_delete;
+    priv->selector.count         = camio_selector_weighted_count;
+    priv->selector.clock         = clock;
+    priv->selector.timers        = NULL;
+
+    //Call init, because its the obvious thing to do now...
+    priv->selector.init(&priv->selector);
+
+    //Return the generic selector interface for the outside world to use
+    return &priv->selector;
+
+}
+
+camio_selector_t* camio_selector_weighted_new(const camio_descr_t* descr, camio_clock_t* clock, camio_selector_weighted_params_t* params){
+    camio_selector_weighted_t* priv = malloc(sizeof(camio_selector_weighted_t));
+    if(!priv){
+        eprintf_exit("No memory available for weighted selector creation\n");
+    }
+    return camio_selector_weighted_construct(priv, descr, clock, params);
+}
@@ -0,0 +1,102 @@
+/*
+ * Copyright  (C) Matthew P. Grosvenor, 2012, All Rights Reserved
+ *
+ * Camio weighted (priority class + deficit round robin) selector
+ *
+ */
+
+#ifndef CAMIO_SELECTOR_WEIGHTED_H_
+#define CAMIO_SELECTOR_WEIGHTED_H_
+
+#include "camio_selector.h"
+#include "../istreams/camio_istream.h"
+#include "../perf/camio_perf.h"
+
+/********************************************************************
+ *                  PRIVATE DEFS
+ ********************************************************************/
+
+#define CAMIO_SELECTOR_WEIGHTED_MAX_STREAMS 1024
+#define CAMIO_SELECTOR_WEIGHTED_MAX_CLASSES 8
+#define CAMIO_SELECTOR_WEIGHTED_MAX_RULES 64
+
+#define CAMIO_SELECTOR_WEIGHTED_CLASSES_DEFAULT 2           //A control class and a bulk class
+#define CAMIO_SELECTOR_WEIGHTED_WEIGHT_DEFAULT 1
+
+
+typedef struct {
+    uint64_t classes;                                   //Number of priority classes, class 0 is serviced first
+    uint64_t default_class;                             //Class for streams added with insert(), defaults to the lowest
+    uint64_t default_weight;                            //Weight for streams added with insert()
+    camio_perf_t* perf_mon;                             //Where to log queueing delays, may be NULL
+} camio_selector_weighted_params_t;
+
+
+//Class and weight for the stream inserted at a given index, from the description
+typedef struct {
+    size_t index;
+    uint64_t class;
+    uint64_t weight;
+} camio_selector_weighted_rule_t;
+
+
+typedef struct {
+    camio_selectable_t* stream;
+    size_t index;
+    uint64_t class;
+    uint64_t weight;                                    //Number of selections in a row this stream gets on its turn
+    int ready;                                          //Result of ready() on the last pass
+    uint64_t taken;                                     //Pass on which this stream was last selected
+    uint64_t ready_ts;                                  //When this stream was first seen ready, 0 if it hasn't been
+} camio_selector_weighted_stream_t;
+
+
+//Queueing delay stats, in camio_perf_ts() ticks
+typedef struct {
+    uint64_t selected;                                  //Number of times a stream in this class was selected
+    uint64_t delay_total;
+    uint64_t delay_max;
+} camio_selector_weighted_stats_t;
+
+
+typedef struct {
+    size_t members[CAMIO_SELECTOR_WEIGHTED_MAX_STREAMS]; //Stream slots in this class, in round robin order
+    size_t member_count;
+    size_t ready_count;                                 //Members that were ready the last time the class was probed
+    size_t turn;                                        //Member whose turn it is
+    uint64_t deficit;                                   //Selections left in its turn
+    camio_selector_weighted_stats_t stats;
+} camio_selector_weighted_class_t;
+
+
+typedef struct {
+    camio_selector_t selector;                          //Underlying selector interface
+    camio_selector_weighted_params_t params;            //Parameters passed in from the outside, or from the description
+    camio_selector_weighted_stream_t streams[CAMIO_SELECTOR_WEIGHTED_MAX_STREAMS]; //Statically allow up to n streams on this selector
+    size_t stream_used;                                 //Streams below this have been used at some stage
+    size_t stream_avail;                                //Number of streams that are non null in the selector
+    camio_selector_weighted_class_t classes[CAMIO_SELECTOR_WEIGHTED_MAX_CLASSES];
+    camio_selector_weighted_rule_t rules[CAMIO_SELECTOR_WEIGHTED_MAX_RULES];
+    size_t rule_count;
+    uint64_t pass;                                      //Number of select passes so far
+    camio_perf_t* perf_mon;
+    int own_perf_mon;                                   //We made perf_mon, because none was supplied, so we free it
+} camio_selector_weighted_t;
+
+
+
+/********************************************************************
+ *                  PUBLIC DEFS
+ ********************************************************************/
+
+camio_selector_t* camio_selector_weighted_new( const camio_descr_t* descr, camio_clock_t* clock, camio_selector_weighted_params_t* params);
+
+//Insert a stream with an explicit priority class and weight. Plain insert() uses the defaults or the rules from the
+//description.
+int camio_selector_weighted_insert(camio_selector_t* this, camio_selectable_t* stream, size_t index, uint64_t class, uint64_t weight);
+
+//Queueing delay stats for a class, so far
+void camio_selector_weighted_stats(camio_selector_t* this, uint64_t class, camio_selector_weighted_stats_t* stats_out);
+
+
+#endif /* CAMIO_SELECTOR_WEIGHTED_H_ */
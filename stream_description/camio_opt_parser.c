@@ -44,7 +44,7 @@ static int get_opt_num(struct camio_opt_t* opt, num_result_t* num ){
         return -1;
     }
 
-   *num = parse_number(opt->value, strlen(opt->value));
+   *num = parse_number(opt->value, 0);
    return 0;
 }
 
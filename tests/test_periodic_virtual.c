@@ -0,0 +1,90 @@
+/*
+ * test_periodic_virtual.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: mgrosvenor
+ */
+
+#include "../istreams/camio_istream.h"
+#include "../clocks/camio_clock.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+
+//A clock that only moves when we say so, like one following capture timestamps
+static camio_time_t driven_time;
+
+static int driven_is_driven(camio_clock_t* this){
+    return 1;
+}
+
+static camio_time_t* driven_get(camio_clock_t* this){
+    return &driven_time;
+}
+
+static camio_clock_t driven_clock = { .is_driven = driven_is_driven, .get = driven_get };
+
+
+//Read from a virtual timer with no tick due, without asking ready() first. This used to report end of stream, it
+//should now refuse the read. Runs in a child, as refusing the read exits.
+static int idle_read_refused(char* description){
+    fflush(stdout);
+    const pid_t child = fork();
+    if(child < 0){
+        return 0;
+    }
+
+    if(child == 0){
+        //Quiet, the error is expected
+        if(!freopen("/dev/null", "w", stderr) || !freopen("/dev/null", "w", stdout)){
+            exit(3);
+        }
+        driven_time.counter = 1000;
+        camio_istream_t* in = camio_istream_new(description, &driven_clock, NULL, NULL);
+        in->ready(in); //Anchors the ticks on the clock
+        uint8_t* buff = NULL;
+        exit(in->start_read(in, &buff) == 0 ? 0 : 2);
+    }
+
+    int status = 0;
+    waitpid(child, &status, 0);
+    return WIFEXITED(status) && WEXITSTATUS(status) != 0 && WEXITSTATUS(status) != 2 && WEXITSTATUS(status) != 3;
+}
+
+
+//Once the clock has passed a tick, a read should get it
+static int due_read(char* description){
+    driven_time.counter = 1000;
+    camio_istream_t* in = camio_istream_new(description, &driven_clock, NULL, NULL);
+    in->ready(in);
+
+    driven_time.counter = 1000 + 100;
+    uint8_t* buff = NULL;
+    const int len = in->start_read(in, &buff);
+    in->end_read(in, NULL);
+    in->delete(in);
+    return len > 0 && buff != NULL;
+}
+
+
+void test_periodic_virtual() {
+    int i = 0;
+    for(; i < 4; i++){
+        printf("Test %i:", i);
+        switch(i){
+            case 0: printf("%s\n", idle_read_refused("periodic:100")     ? "Pass" : "Fail" ); break;
+            case 1: printf("%s\n", idle_read_refused("period_fast:100")  ? "Pass" : "Fail" ); break;
+            case 2: printf("%s\n", due_read("periodic:100")              ? "Pass" : "Fail" ); break;
+            case 3: printf("%s\n", due_read("period_fast:100")           ? "Pass" : "Fail" ); break;
+            default: printf("Fail\n"); break;
+        }
+    }
+}
+
+
+int main(int argc, char** argv){
+    test_periodic_virtual();
+    return 0;
+}
@@ -0,0 +1,115 @@
+/*
+ * test_timer_wheel.c
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: mgrosvenor
+ */
+
+#include "../utils/camio_timer.h"
+#include <stdio.h>
+
+
+//Set a single timer at start + after ticks, and check that it goes off on that tick and not the one before
+static int fires_on_time(uint64_t start, uint64_t after){
+    camio_timer_wheel_t wheel;
+    camio_timer_t timer = { 0 };
+    camio_timer_wheel_init(&wheel, 1, start);
+    camio_timer_add(&wheel, &timer, start + after, 42);
+
+    camio_timer_advance(&wheel, start + after - 1);
+    if(camio_timer_pop_expired(&wheel)){
+        return 0;
+    }
+
+    camio_timer_advance(&wheel, start + after);
+    if(camio_timer_pop_expired(&wheel) != &timer || timer.index != 42 || camio_timer_is_set(&timer)){
+        return 0;
+    }
+
+    return camio_timer_pop_expired(&wheel) == NULL && wheel.pending == 0;
+}
+
+
+//Cascade a timer down from level 2, then cancel it. It should leave nothing behind in the wheel.
+static int cancel_after_cascade(){
+    camio_timer_wheel_t wheel;
+    camio_timer_t timer = { 0 };
+    camio_timer_wheel_init(&wheel, 1, 0);
+    camio_timer_add(&wheel, &timer, 4096 + 10, 0);
+    if(timer.level != 2){
+        return 0;
+    }
+
+    camio_timer_advance(&wheel, 4096);
+    if(timer.level != 0 || camio_timer_pop_expired(&wheel)){
+        return 0;
+    }
+
+    camio_timer_cancel(&wheel, &timer);
+    uint64_t occupied = 0;
+    int level = 0;
+    for(; level < CAMIO_TIMER_LEVELS; level++){
+        occupied |= wheel.occupied[level];
+    }
+    if(camio_timer_is_set(&timer) || wheel.pending || occupied || wheel.slots[0][10]){
+        return 0;
+    }
+
+    camio_timer_advance(&wheel, 8192);
+    return camio_timer_pop_expired(&wheel) == NULL && camio_timer_next_ns(&wheel) == ~0ULL;
+}
+
+
+//Check next_ns with an empty wheel, with a timer waiting, and with one to collect
+static int next_ns_stages(){
+    camio_timer_wheel_t wheel;
+    camio_timer_t timer = { 0 };
+    camio_timer_wheel_init(&wheel, 1, 0);
+    if(camio_timer_next_ns(&wheel) != ~0ULL){
+        return 0; //Empty
+    }
+
+    camio_timer_add(&wheel, &timer, 4096, 0);
+    const uint64_t next = camio_timer_next_ns(&wheel);
+    if(next == 0 || next > 4096){
+        return 0; //Never later than the timer
+    }
+
+    camio_timer_advance(&wheel, 4096);
+    if(camio_timer_next_ns(&wheel) != 0){
+        return 0; //Waiting to be collected
+    }
+
+    camio_timer_pop_expired(&wheel);
+    return camio_timer_next_ns(&wheel) == ~0ULL;
+}
+
+
+void test_timer_wheel() {
+    int i = 0;
+    for(; i < 10; i++){
+        printf("Test %i:", i);
+        switch(i){
+            //Expiry either side of the level boundaries
+            case 0: printf("%s\n", fires_on_time(0, 63)                   ? "Pass" : "Fail" ); break;
+            case 1: printf("%s\n", fires_on_time(0, 64)                   ? "Pass" : "Fail" ); break;
+            case 2: printf("%s\n", fires_on_time(0, 4095)                 ? "Pass" : "Fail" ); break;
+            case 3: printf("%s\n", fires_on_time(0, 4096)                 ? "Pass" : "Fail" ); break;
+            //The same, from a start that isn't on a slot boundary
+            case 4: printf("%s\n", fires_on_time(4000, 63)                ? "Pass" : "Fail" ); break;
+            case 5: printf("%s\n", fires_on_time(4000, 4096)              ? "Pass" : "Fail" ); break;
+            case 6: printf("%s\n", fires_on_time(1ULL << 40, 1ULL << 30)  ? "Pass" : "Fail" ); break;
+            //Cancelling and next_ns
+            case 7: printf("%s\n", cancel_after_cascade()                 ? "Pass" : "Fail" ); break;
+            case 8: printf("%s\n", next_ns_stages()                       ? "Pass" : "Fail" ); break;
+            case 9: printf("%s\n", fires_on_time(0, 1)                   ? "Pass" : "Fail" ); break;
+            default: printf("Fail\n"); break;
+        }
+    }
+}
+
+
+int main(int argc, char** argv){
+    test_timer_wheel();
+    return 0;
+}
@@ -0,0 +1,25 @@
+/*
+ * camio_batch.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: mgrosvenor
+ */
+
+#ifndef CAMIO_BATCH_H_
+#define CAMIO_BATCH_H_
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "camio_meta.h"
+
+//A single buffer in a batched read or write. Batches are plain arrays of these, in the spirit of
+//struct iovec, so that the per message cost of the stream interface is paid once per batch.
+typedef struct {
+    uint8_t* buffer;    //Pointer to the head of the data
+    size_t len;         //Number of bytes valid at buffer
+    camio_meta_t meta;  //What the istream knows about the message. Ignored for writes
+} camio_batch_item_t;
+
+
+#endif /* CAMIO_BATCH_H_ */
@@ -0,0 +1,66 @@
+/*
+ * camio_bcast.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: mgrosvenor
+ */
+
+#ifndef CAMIO_BCAST_H_
+#define CAMIO_BCAST_H_
+
+#include <stdint.h>
+
+#define CAMIO_BCAST_SLOT_COUNT_DEFAULT (1024)
+#define CAMIO_BCAST_SLOT_SIZE_DEFAULT (4 * 1024)  //4K
+
+#define CAMIO_BCAST_MAGIC   (0x434D494F42435354ULL) //"CMIOBCST"
+#define CAMIO_BCAST_VERSION (1)
+
+#define CAMIO_BCAST_CACHE_LINE (64)
+
+//A single writer, many reader ring in a shared file. The writer never waits for readers, it publishes each message
+//once and every reader follows along with its own private cursor, so fan out costs the same no matter how many readers
+//there are. Readers never write to the ring, so they do not slow the writer or each other down.
+// - Each slot starts with a descriptor holding the sequence number of the message in it (position + 1). The writer
+//   zeros the sequence number before it touches a slot and sets it once the slot is full.
+// - A reader at position pos waits for seq == pos + 1. If it finds a bigger number, the writer has lapped it and it
+//   catches up, like the ring istream does. Reads are checked again when they are released, so a reader that is lapped
+//   part way through a read finds out.
+typedef struct {
+    uint64_t magic;                         //Identifies this as a bcast file
+    uint64_t version;                       //Layout version of the bcast ring
+    uint64_t slot_size;                     //Size of each slot in bytes, including the descriptor
+    uint64_t slot_count;                    //Number of slots in the ring
+    volatile uint64_t ostream_created;      //Set by the ostream once the header and slots are initialised
+    volatile uint64_t istream_count;        //Number of istreams that have connected
+    uint8_t pad0[CAMIO_BCAST_CACHE_LINE - 6 * sizeof(uint64_t)];
+
+    volatile uint64_t head;                 //Number of messages published, readers that connect late start here
+    uint8_t pad1[CAMIO_BCAST_CACHE_LINE - sizeof(uint64_t)];
+} camio_bcast_header_t;
+
+typedef struct {
+    volatile uint64_t seq;                  //Position + 1 of the message in this slot, 0 while it is being written
+    uint64_t len;                           //Number of bytes of data in the slot
+    uint8_t pad[CAMIO_BCAST_CACHE_LINE - 2 * sizeof(uint64_t)];
+} camio_bcast_slot_t;
+
+#define CAMIO_BCAST_HEADER_SIZE (4 * 1024)  //Keep the slots page aligned
+#define CAMIO_BCAST_SLOT_SIZE_MIN (2 * CAMIO_BCAST_CACHE_LINE)
+#define CAMIO_BCAST_SLOT_AVAIL  (priv->slot_size - sizeof(camio_bcast_slot_t))
+#define CAMIO_BCAST_MEM_SIZE    (CAMIO_BCAST_HEADER_SIZE + priv->slot_size * priv->slot_count)
+
+
+#define CHECK_LEN_OK(len) \
+    if(len > CAMIO_BCAST_SLOT_AVAIL){ \
+        eprintf_exit("Length supplied (%lu) is greater than slot size (%lu, corruption is likely.\n", len, CAMIO_BCAST_SLOT_AVAIL ); \
+    }
+
+
+#define bcast_header ((volatile camio_bcast_header_t*)(priv->bcast - CAMIO_BCAST_HEADER_SIZE))
+#define bcast_slot(i) ((volatile camio_bcast_slot_t*)(priv->bcast + ((i) % priv->slot_count) * priv->slot_size))
+#define bcast_slot_data(i) ((uint8_t*)bcast_slot(i) + sizeof(camio_bcast_slot_t))
+#define bcast_ostream_created (bcast_header->ostream_created)
+#define bcast_istream_count (bcast_header->istream_count)
+
+#endif /* CAMIO_BCAST_H_ */
@@ -8,10 +8,59 @@
 #ifndef CAMIO_BRING_H_
 #define CAMIO_BRING_H_
 
+#include <stdint.h>
+
+#include "camio_wait.h"
+#include "camio_doorbell.h"
+
 #define CAMIO_BRING_SLOT_COUNT_DEFAULT (1024)
 #define CAMIO_BRING_SLOT_SIZE_DEFAULT (4 * 1024)  //4K
-#define CAMIO_BRING_SLOT_AVAIL  (priv->slot_size - 2*sizeof(uint64_t))
-#define CAMIO_BRING_MEM_SIZE    (priv->slot_size * priv->slot_count + 2*sizeof(uint64_t))
+
+#define CAMIO_BRING_MAGIC   (0x434D494F42524E47ULL) //"CMIOBRNG"
+#define CAMIO_BRING_VERSION (4)
+
+#define CAMIO_BRING_CACHE_LINE (64)
+
+//Layout. Everything that is written often lives on its own cache line, and each line has exactly one writer:
+// - head is only written by the ostream, tail is only written by the istream. Each side keeps a cached copy of the
+//   other's index and only goes back to the shared one when the cached copy says it has to wait.
+// - The istream hands slots back in batches by moving tail every CAMIO_BRING_FREE_BATCH slots, or when it runs dry.
+// - Each slot starts with a cache line sized descriptor, so the reader picks up the length with the first line of data
+//   and never writes to the slot at all.
+// - An istream that sleeps rather than spins has a wait line of its own (see camio_wait.h). It is only touched when
+//   the istream is about to sleep.
+// - The doorbell reference is written by the istream before it connects, and its bit is cleared again when it closes.
+typedef struct {
+    uint64_t magic;                         //Identifies this as a bring file
+    uint64_t version;                       //Layout version of the bring
+    uint64_t slot_size;                     //Size of each slot in bytes, including the descriptor
+    uint64_t slot_count;                    //Number of slots in the bring
+    volatile uint64_t ostream_created;      //Set by the ostream once the header and slots are initialised
+    volatile uint64_t istream_connected;    //Set by the istream once it has mapped the bring
+    volatile uint64_t istream_wait;         //How the istream waits for data, anything but CAMIO_WAIT_SPIN means the ostream has to wake it
+    uint8_t pad0[CAMIO_BRING_CACHE_LINE - 7 * sizeof(uint64_t)];
+
+    volatile uint64_t head;                 //Number of slots published by the ostream
+    uint8_t pad1[CAMIO_BRING_CACHE_LINE - sizeof(uint64_t)];
+
+    volatile uint64_t tail;                 //Number of slots handed back by the istream
+    uint8_t pad2[CAMIO_BRING_CACHE_LINE - sizeof(uint64_t)];
+
+    camio_wait_t wait;                      //Where the istream sleeps
+    camio_doorbell_ref_t doorbell;          //Which doorbell (if any) to ring when there is new data
+} camio_bring_header_t;
+
+typedef struct {
+    uint64_t len;                           //Number of bytes of data in the slot
+    uint64_t seq;                           //Value of head that published this slot, for sanity checking
+    uint8_t pad[CAMIO_BRING_CACHE_LINE - 2 * sizeof(uint64_t)];
+} camio_bring_slot_t;
+
+#define CAMIO_BRING_HEADER_SIZE (4 * 1024)  //Keep the slots page aligned
+#define CAMIO_BRING_SLOT_SIZE_MIN (2 * CAMIO_BRING_CACHE_LINE)
+#define CAMIO_BRING_SLOT_AVAIL  (priv->slot_size - sizeof(camio_bring_slot_t))
+#define CAMIO_BRING_MEM_SIZE    (CAMIO_BRING_HEADER_SIZE + priv->slot_size * priv->slot_count)
+#define CAMIO_BRING_FREE_BATCH  (priv->slot_count >= 8 ? priv->slot_count / 8 : 1)
 
 
 #define CHECK_LEN_OK(len) \
@@ -20,7 +69,13 @@
     }
 
 
-#define bring_ostream_created (*(volatile uint64_t*)(priv->bring + priv->slot_count * priv->slot_size + sizeof(uint64_t)) )
-#define bring_istream_connected (*(volatile uint64_t*)(priv->bring + priv->slot_count * priv->slot_size ))
+#define bring_header ((volatile camio_bring_header_t*)(priv->bring - CAMIO_BRING_HEADER_SIZE))
+#define bring_slot(i) ((volatile camio_bring_slot_t*)(priv->bring + ((i) % priv->slot_count) * priv->slot_size))
+#define bring_slot_data(i) ((uint8_t*)bring_slot(i) + sizeof(camio_bring_slot_t))
+#define bring_ostream_created (bring_header->ostream_created)
+#define bring_istream_connected (bring_header->istream_connected)
+#define bring_istream_wait (bring_header->istream_wait)
+#define bring_wait (&bring_header->wait)
+#define bring_doorbell (&bring_header->doorbell)
 
 #endif /* CAMIO_BRING_H_ */
@@ -0,0 +1,210 @@
+/*
+ * Copyright  (C) Matthew P. Grosvenor, 2012, All Rights Reserved
+ *
+ * Camio shared memory doorbell setup, tear down and registry
+ *
+ */
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "camio_doorbell.h"
+#include "camio_util.h"
+#include "../errors/camio_errors.h"
+
+
+static volatile camio_doorbell_t* create(int fd, const char* filename){
+    //Resize the file
+    if(lseek(fd, sizeof(camio_doorbell_t) -1, SEEK_SET) < 0){
+        eprintf_exit( "Could not resize file for doorbell \"%s\". Error=%s\n", filename, strerror(errno));
+    }
+
+    if(write(fd, "", 1) < 0){
+        eprintf_exit( "Could not resize file for doorbell \"%s\". Error=%s\n", filename, strerror(errno));
+    }
+
+    volatile camio_doorbell_t* bell = mmap( NULL, sizeof(camio_doorbell_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if(unlikely(bell == MAP_FAILED)){
+        eprintf_exit("Could not memory map doorbell file \"%s\". Error=%s\n", filename, strerror(errno));
+    }
+
+    //The file starts out zeroed, so every bit is already free and clear
+    bell->magic    = CAMIO_DOORBELL_MAGIC;
+    bell->version  = CAMIO_DOORBELL_VERSION;
+    bell->attached = 1; //That's us
+
+    __sync_synchronize(); //Everything above must be visible before anyone is told about it
+    bell->created = 1;
+
+    return bell;
+}
+
+
+//Map a doorbell that someone else created, returns NULL if it is being torn down and we should start again
+static volatile camio_doorbell_t* join(int fd, const char* filename){
+    struct stat bell_stat;
+    while( fstat(fd, &bell_stat) == 0 && bell_stat.st_size < (off_t)sizeof(camio_doorbell_t) ){ usleep(1000); }
+
+    volatile camio_doorbell_t* bell = mmap( NULL, sizeof(camio_doorbell_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if(unlikely(bell == MAP_FAILED)){
+        eprintf_exit( "Could not memory map doorbell file \"%s\". Error=%s\n", filename, strerror(errno));
+    }
+
+    while(!bell->created){
+        asm("PAUSE");
+    }
+
+    if(unlikely(bell->magic != CAMIO_DOORBELL_MAGIC || bell->version != CAMIO_DOORBELL_VERSION)){
+        eprintf_exit( "File \"%s\" is not a version %lu doorbell\n", filename, (uint64_t)CAMIO_DOORBELL_VERSION);
+    }
+
+    //Only join while someone else is still attached. Once the count hits zero, the file is on its way out.
+    uint64_t attached = bell->attached;
+    while(attached){
+        if(__sync_bool_compare_and_swap(&bell->attached, attached, attached + 1)){
+            return bell;
+        }
+        attached = bell->attached;
+    }
+
+    munmap((void*)bell, sizeof(camio_doorbell_t));
+    return NULL;
+}
+
+
+volatile camio_doorbell_t* camio_doorbell_attach(const char* filename){
+    volatile camio_doorbell_t* bell = NULL;
+
+    if(strlen(filename) >= CAMIO_DOORBELL_NAME_MAX){
+        eprintf_exit("Doorbell file name \"%s\" is too long, the limit is %u\n", filename, CAMIO_DOORBELL_NAME_MAX - 1);
+    }
+
+    while(!bell){
+        //Try to be the one that creates it
+        int fd = open(filename, O_RDWR | O_CREAT | O_EXCL, (mode_t)(0666));
+        if(fd >= 0){
+            bell = create(fd, filename);
+            close(fd);
+            break;
+        }
+
+        if(unlikely(errno != EEXIST)){
+            eprintf_exit("Could not open file \"%s\". Error=%s\n", filename, strerror(errno));
+        }
+
+        //Someone beat us to it, join in
+        fd = open(filename, O_RDWR);
+        if(fd < 0){
+            if(errno != ENOENT){
+                eprintf_exit("Could not open file \"%s\". Error=%s\n", filename, strerror(errno));
+            }
+            continue; //It went away under our feet, try again
+        }
+
+        bell = join(fd, filename);
+        close(fd); //The mapping keeps the file alive
+        if(!bell){
+            usleep(1000); //Give the last user a moment to remove the file
+        }
+    }
+
+    return bell;
+}
+
+
+void camio_doorbell_detach(volatile camio_doorbell_t* bell, const char* filename){
+    const int last = __sync_sub_and_fetch(&bell->attached, 1) == 0;
+    munmap((void*)bell, sizeof(camio_doorbell_t));
+
+    //Delete the file so the next user starts from scratch
+    if(last && unlink(filename) < 0){
+        wprintf("Could not remove doorbell file \"%s\". Error = \"%s\"", filename, strerror(errno));
+    }
+}
+
+
+uint64_t camio_doorbell_claim(volatile camio_doorbell_t* bell, const char* filename){
+    uint64_t word = 0;
+    for(; word < CAMIO_DOORBELL_WORDS; word++){
+        uint64_t claimed = bell->claimed[word];
+        while(~claimed){
+            const uint64_t bit = __builtin_ctzll(~claimed);
+            if(__sync_bool_compare_and_swap(&bell->claimed[word], claimed, claimed | (1ULL << bit))){
+                return word * 64 + bit;
+            }
+            claimed = bell->claimed[word];
+        }
+    }
+
+    eprintf_exit("Doorbell \"%s\" is full, it has room for %u istreams\n", filename, CAMIO_DOORBELL_BITS);
+    return 0;
+}
+
+
+void camio_doorbell_release(volatile camio_doorbell_t* bell, uint64_t bit){
+    __sync_fetch_and_and(&bell->claimed[bit / 64], ~(1ULL << (bit % 64)));
+}
+
+
+/* ****************************************************
+ * Registry
+ */
+
+typedef struct camio_doorbell_entry {
+    struct camio_selectable* stream;
+    char* filename;
+    uint64_t bit;
+    struct camio_doorbell_entry* next;
+} camio_doorbell_entry_t;
+
+static camio_doorbell_entry_t* registry = NULL;
+
+
+void camio_doorbell_register(struct camio_selectable* stream, const char* filename, uint64_t bit){
+    camio_doorbell_entry_t* entry = malloc(sizeof(camio_doorbell_entry_t));
+    if(!entry){
+        eprintf_exit("No memory available for doorbell registry\n");
+    }
+
+    entry->filename = strdup(filename);
+    if(!entry->filename){
+        eprintf_exit("No memory available for doorbell registry\n");
+    }
+
+    entry->stream = stream;
+    entry->bit    = bit;
+    entry->next   = registry;
+    registry      = entry;
+}
+
+
+void camio_doorbell_unregister(struct camio_selectable* stream){
+    camio_doorbell_entry_t** entry = &registry;
+    for(; *entry; entry = &(*entry)->next){
+        if((*entry)->stream == stream){
+            camio_doorbell_entry_t* dead = *entry;
+            *entry = dead->next;
+            free(dead->filename);
+            free(dead);
+            return;
+        }
+    }
+}
+
+
+const char* camio_doorbell_lookup(struct camio_selectable* stream, uint64_t* bit_out){
+    camio_doorbell_entry_t* entry = registry;
+    for(; entry; entry = entry->next){
+        if(entry->stream == stream){
+            *bit_out = entry->bit;
+            return entry->filename;
+        }
+    }
+
+    return NULL;
+}
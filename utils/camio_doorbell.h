@@ -0,0 +1,110 @@
+/*
+ * camio_doorbell.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: mgrosvenor
+ */
+
+#ifndef CAMIO_DOORBELL_H_
+#define CAMIO_DOORBELL_H_
+
+#include <stdint.h>
+
+#define CAMIO_DOORBELL_MAGIC   (0x434D494F4442454CULL) //"CMIODBEL"
+#define CAMIO_DOORBELL_VERSION (1)
+
+#define CAMIO_DOORBELL_CACHE_LINE (64)
+#define CAMIO_DOORBELL_WORDS (64)
+#define CAMIO_DOORBELL_BITS (CAMIO_DOORBELL_WORDS * 64)    //One bit per istream, the summary word has a bit per word
+#define CAMIO_DOORBELL_NAME_MAX (120)
+
+//A readiness bitmap in a shared file, that lets one selector watch many shared memory istreams by looking at a single
+//cache line while they are idle.
+// - Each istream that wants a doorbell claims a bit in it, and tells its ostream which doorbell and bit to ring.
+// - The ostream rings after it publishes, by setting its bit and then the summary bit of the word its bit is in. Both
+//   are only written if they are clear, so a busy stream costs a read of two lines that are already in the cache.
+// - The selector reads the summary word, and only when it is non zero swaps out the flagged words and calls ready()
+//   on the streams whose bits were set.
+// - Like the mring, whoever gets there first creates the file, and the last one to detach removes it.
+typedef struct {
+    uint64_t magic;                                     //Identifies this as a doorbell file
+    uint64_t version;                                   //Layout version of the doorbell
+    volatile uint64_t created;                          //Set once the doorbell is initialised
+    volatile uint64_t attached;                         //Number of istreams, ostreams and selectors attached
+    uint8_t pad0[CAMIO_DOORBELL_CACHE_LINE - 4 * sizeof(uint64_t)];
+
+    volatile uint64_t claimed[CAMIO_DOORBELL_WORDS];    //Bits that belong to an istream
+
+    volatile uint64_t summary;                          //Bit w is set when bits[w] may be non zero
+    uint8_t pad1[CAMIO_DOORBELL_CACHE_LINE - sizeof(uint64_t)];
+
+    volatile uint64_t bits[CAMIO_DOORBELL_WORDS];       //Set by ostreams when they publish, cleared by the selector
+} camio_doorbell_t;
+
+//Lives in the ring header, so that the ostream can find the doorbell of its istream
+typedef struct {
+    volatile uint64_t bit;                              //The istream's bit, plus one. Zero means there is no doorbell
+    char name[CAMIO_DOORBELL_NAME_MAX];                 //File name of the doorbell
+} camio_doorbell_ref_t;
+
+
+//Create or attach to the doorbell in filename
+volatile camio_doorbell_t* camio_doorbell_attach(const char* filename);
+
+//Let go of a doorbell returned by camio_doorbell_attach(). Once everyone has gone, the file is removed.
+void camio_doorbell_detach(volatile camio_doorbell_t* bell, const char* filename);
+
+//Claim a free bit for an istream, and hand it back again
+uint64_t camio_doorbell_claim(volatile camio_doorbell_t* bell, const char* filename);
+void camio_doorbell_release(volatile camio_doorbell_t* bell, uint64_t bit);
+
+//Let the selector know that the istream behind stream has a doorbell. The registry is local to this process and is not
+//thread safe, insert streams from the thread that opens them.
+struct camio_selectable;
+void camio_doorbell_register(struct camio_selectable* stream, const char* filename, uint64_t bit);
+void camio_doorbell_unregister(struct camio_selectable* stream);
+const char* camio_doorbell_lookup(struct camio_selectable* stream, uint64_t* bit_out);
+
+
+/* ****************************************************
+ * Ostream side
+ */
+
+//Call after publishing. The full barrier makes sure that our data is visible before we look at the bit, otherwise the
+//selector could take the bit and then miss the data.
+static inline void camio_doorbell_ring(volatile camio_doorbell_t* bell, uint64_t bit){
+    const uint64_t word = bit / 64;
+    const uint64_t mask = 1ULL << (bit % 64);
+
+    __sync_synchronize();
+    if(!(bell->bits[word] & mask)){
+        __sync_fetch_and_or(&bell->bits[word], mask);
+        if(!(bell->summary & (1ULL << word))){
+            __sync_fetch_and_or(&bell->summary, 1ULL << word);
+        }
+    }
+}
+
+
+/* ****************************************************
+ * Selector side
+ */
+
+//Move every bit that has been rung into pending. Returns the words that had bits in them.
+static inline uint64_t camio_doorbell_take(volatile camio_doorbell_t* bell, uint64_t* pending){
+    if(!bell->summary){
+        return 0; //The idle case, one cache line
+    }
+
+    const uint64_t summary = __sync_lock_test_and_set(&bell->summary, 0);
+    uint64_t words = summary;
+    while(words){
+        const uint64_t word = __builtin_ctzll(words);
+        words &= words - 1;
+        pending[word] |= __sync_lock_test_and_set(&bell->bits[word], 0);
+    }
+
+    return summary;
+}
+
+#endif /* CAMIO_DOORBELL_H_ */
@@ -0,0 +1,33 @@
+/*
+ * camio_meta.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: mgrosvenor
+ */
+
+#ifndef CAMIO_META_H_
+#define CAMIO_META_H_
+
+#include <stdint.h>
+
+#define CAMIO_META_TS       (1 << 0)    //ts_ns is valid
+#define CAMIO_META_SEQ      (1 << 1)    //seq is valid
+#define CAMIO_META_SRC      (1 << 2)    //src_addr and src_port are valid
+#define CAMIO_META_OVERRUN  (1 << 3)    //Messages were lost between the last message and this one
+#define CAMIO_META_ERROR    (1 << 4)    //The stream flagged this message as damaged (eg. a bad FCS on a capture)
+#define CAMIO_META_TS_HW    (1 << 5)    //ts_ns was taken by the NIC, rather than by the kernel
+#define CAMIO_META_TS_MONO  (1 << 6)    //ts_ns is on a monotonic clock (eg. CLOCK_MONOTONIC), not ns since 1970
+
+//What a stream knows about a message, beyond its bytes. Each istream fills in what it has to hand for free, and says
+//which fields it filled in with flags, so readers never have to dig the same things back out of the payload.
+typedef struct {
+    uint64_t ts_ns;                     //When the message arrived. Timers give their deadline instead. The clock depends
+                                        //on the source, ns since 1970 unless CAMIO_META_TS_MONO is set
+    uint64_t seq;                       //Position of the message in the stream
+    uint32_t src_addr;                  //Who sent it, IPv4 address in network order
+    uint16_t src_port;                  //and port, in network order
+    uint16_t flags;                     //Which of the above are valid, and anything else we noticed. CAMIO_META_*
+} camio_meta_t;
+
+
+#endif /* CAMIO_META_H_ */
@@ -0,0 +1,201 @@
+/*
+ * Copyright  (C) Matthew P. Grosvenor, 2012, All Rights Reserved
+ *
+ * Camio multi-producer, multi-consumer shared memory ring setup and tear down
+ *
+ */
+#include <errno.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "camio_mring.h"
+#include "camio_util.h"
+#include "../errors/camio_errors.h"
+
+
+//Size of the whole file for a geometry. Big slot counts or sizes could wrap the sum around to something small, which
+//would then be mapped and written past the end of, so anything that doesn't fit in a file offset is refused.
+static size_t get_mem_size(const char* filename, uint64_t slot_size, uint64_t slot_count){
+    const uint64_t max_size = (uint64_t)INT64_MAX - CAMIO_MRING_HEADER_SIZE;
+    if(slot_size && slot_count > max_size / slot_size){
+        eprintf_exit( "Mring \"%s\" geometry (%lu x %lu) is too big to map\n", filename, slot_count, slot_size);
+    }
+
+    return CAMIO_MRING_HEADER_SIZE + slot_size * slot_count;
+}
+
+
+//Check a geometry we've been asked for, before anything is created with it. A bad one is refused up front so that it
+//never leaves behind an empty file that others would wait on.
+static void check_geometry(const char* filename, uint64_t slot_size, uint64_t slot_count){
+    if(slot_count < 1){
+        eprintf_exit( "Mring must have at least one slot\n");
+    }
+
+    //Slots must start on a cache line so that the descriptor and the data never share one with another slot
+    if(slot_size < CAMIO_MRING_SLOT_SIZE_MIN || slot_size % CAMIO_MRING_CACHE_LINE){
+        eprintf_exit( "Slot size (%lu) must be a multiple of %lu and at least %lu\n", slot_size, CAMIO_MRING_CACHE_LINE, CAMIO_MRING_SLOT_SIZE_MIN);
+    }
+
+    get_mem_size(filename, slot_size, slot_count);
+}
+
+
+//Lay out a freshly created (and so zero length) mring file. The geometry has been checked already.
+static volatile camio_mring_header_t* create(int fd, const char* filename, uint64_t slot_size, uint64_t slot_count){
+    const size_t mem_size = get_mem_size(filename, slot_size, slot_count);
+
+    //Resize the file
+    if(lseek(fd, mem_size -1, SEEK_SET) < 0){
+        eprintf_exit( "Could not resize file for shared region \"%s\". Error=%s\n", filename, strerror(errno));
+    }
+
+    if(write(fd, "", 1) < 0){
+        eprintf_exit( "Could not resize file for shared region \"%s\". Error=%s\n", filename, strerror(errno));
+    }
+
+    volatile uint8_t* mem = mmap( NULL, mem_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if(unlikely(mem == MAP_FAILED)){
+        eprintf_exit("Could not memory map mring file \"%s\". Error=%s\n", filename, strerror(errno));
+    }
+
+    //Every slot starts out free for the writer of its first position
+    uint64_t i = 0;
+    for(; i < slot_count; i++){
+        volatile camio_mring_slot_t* slot = (volatile camio_mring_slot_t*)(mem + CAMIO_MRING_HEADER_SIZE + i * slot_size);
+        slot->seq = i;
+        slot->len = 0;
+    }
+
+    volatile camio_mring_header_t* header = (volatile camio_mring_header_t*)mem;
+    header->magic      = CAMIO_MRING_MAGIC;
+    header->version    = CAMIO_MRING_VERSION;
+    header->slot_size  = slot_size;
+    header->slot_count = slot_count;
+    header->head       = 0;
+    header->tail       = 0;
+    header->attached   = 1; //That's us
+
+    __sync_synchronize(); //Everything above must be visible before anyone is told about it
+    header->created = 1;
+
+    return header;
+}
+
+
+//Map an mring that someone else created, returns NULL if it is being torn down and we should start again
+static volatile camio_mring_header_t* join(int fd, const char* filename, uint64_t slot_size, uint64_t slot_count){
+
+    //Wait until the file is big enough to hold the header.
+    struct stat mring_stat;
+    while( fstat(fd, &mring_stat) == 0 && mring_stat.st_size < CAMIO_MRING_HEADER_SIZE ){ usleep(1000); }
+
+    //Map just the header to begin with, the geometry tells us how much more there is
+    volatile camio_mring_header_t* header = mmap( NULL, CAMIO_MRING_HEADER_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if(unlikely(header == MAP_FAILED)){
+        eprintf_exit( "Could not memory map mring file \"%s\". Error=%s\n", filename, strerror(errno));
+    }
+
+    //Wait for the creator to do any init work it must do
+    while(!header->created){
+        asm("PAUSE");
+    }
+
+    if(unlikely(header->magic != CAMIO_MRING_MAGIC || header->version != CAMIO_MRING_VERSION)){
+        eprintf_exit( "File \"%s\" is not a version %lu mring\n", filename, (uint64_t)CAMIO_MRING_VERSION);
+    }
+
+    const uint64_t mring_slot_size  = header->slot_size;
+    const uint64_t mring_slot_count = header->slot_count;
+    munmap((void*)header, CAMIO_MRING_HEADER_SIZE);
+
+    //Don't trust the header any more than our own options
+    if(unlikely(!mring_slot_count || mring_slot_size < CAMIO_MRING_SLOT_SIZE_MIN)){
+        eprintf_exit( "Mring \"%s\" has a bad geometry (%lu x %lu)\n", filename, mring_slot_count, mring_slot_size);
+    }
+    const size_t mem_size = get_mem_size(filename, mring_slot_size, mring_slot_count);
+
+    if( (slot_size && slot_size != mring_slot_size) || (slot_count && slot_count != mring_slot_count) ){
+        wprintf("Mring geometry requested (%lu x %lu) does not match the existing one (%lu x %lu). Using the existing one.\n",
+                slot_count, slot_size, mring_slot_count, mring_slot_size);
+    }
+
+    header = mmap( NULL, mem_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if(unlikely(header == MAP_FAILED)){
+        eprintf_exit( "Could not memory map mring file \"%s\". Error=%s\n", filename, strerror(errno));
+    }
+
+    //Only join while someone else is still attached. Once the count hits zero, the file is on its way out.
+    uint64_t attached = header->attached;
+    while(attached){
+        if(__sync_bool_compare_and_swap(&header->attached, attached, attached + 1)){
+            return header;
+        }
+        attached = header->attached;
+    }
+
+    munmap((void*)header, mem_size);
+    return NULL;
+}
+
+
+volatile uint8_t* camio_mring_attach(const char* filename, uint64_t* slot_size, uint64_t* slot_count, int* fd_out){
+    volatile camio_mring_header_t* header = NULL;
+    int fd = -1;
+
+    const uint64_t create_slot_size  = *slot_size  ? *slot_size  : CAMIO_MRING_SLOT_SIZE_DEFAULT;
+    const uint64_t create_slot_count = *slot_count ? *slot_count : CAMIO_MRING_SLOT_COUNT_DEFAULT;
+    check_geometry(filename, create_slot_size, create_slot_count);
+
+    while(!header){
+        //Try to be the one that creates it
+        fd = open(filename, O_RDWR | O_CREAT | O_EXCL, (mode_t)(0666));
+        if(fd >= 0){
+            header = create(fd, filename, create_slot_size, create_slot_count);
+            break;
+        }
+
+        if(unlikely(errno != EEXIST)){
+            eprintf_exit("Could not open file \"%s\". Error=%s\n", filename, strerror(errno));
+        }
+
+        //Someone beat us to it, join in
+        fd = open(filename, O_RDWR);
+        if(fd < 0){
+            if(errno != ENOENT){
+                eprintf_exit("Could not open file \"%s\". Error=%s\n", filename, strerror(errno));
+            }
+            continue; //It went away under our feet, try again
+        }
+
+        header = join(fd, filename, *slot_size, *slot_count);
+        if(!header){
+            close(fd);
+            usleep(1000); //Give the last user a moment to remove the file
+        }
+    }
+
+    *slot_size  = header->slot_size;
+    *slot_count = header->slot_count;
+    *fd_out     = fd;
+    return (volatile uint8_t*)header + CAMIO_MRING_HEADER_SIZE;
+}
+
+
+void camio_mring_detach(volatile uint8_t* mring, const char* filename, int fd){
+    volatile camio_mring_header_t* header = (volatile camio_mring_header_t*)(mring - CAMIO_MRING_HEADER_SIZE);
+    const size_t mem_size = CAMIO_MRING_HEADER_SIZE + header->slot_size * header->slot_count;
+
+    const int last = __sync_sub_and_fetch(&header->attached, 1) == 0;
+    munmap((void*)header, mem_size);
+    close(fd);
+
+    //Delete the file so the next user starts from scratch
+    if(last && unlink(filename) < 0){
+        wprintf("Could not remove mring file \"%s\". Error = \"%s\"", filename, strerror(errno));
+    }
+}
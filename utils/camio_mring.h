@@ -0,0 +1,80 @@
+/*
+ * camio_mring.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: mgrosvenor
+ */
+
+#ifndef CAMIO_MRING_H_
+#define CAMIO_MRING_H_
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#define CAMIO_MRING_SLOT_COUNT_DEFAULT (1024)
+#define CAMIO_MRING_SLOT_SIZE_DEFAULT (4 * 1024)  //4K
+
+#define CAMIO_MRING_MAGIC   (0x434D494F4D524E47ULL) //"CMIOMRNG"
+#define CAMIO_MRING_VERSION (1)
+
+#define CAMIO_MRING_CACHE_LINE (64)
+
+//A bounded multi-producer, multi-consumer ring in a shared file (after D. Vyukov's MPMC queue).
+// - Any number of ostreams and istreams attach to the same file. Whoever gets there first creates it, everyone else
+//   adopts the geometry in the header. The last one to detach removes the file.
+// - head and tail count slot positions claimed by writers and readers. Each sits on its own cache line and is only
+//   ever moved with a compare and swap, so claims never need a lock.
+// - Each slot carries a sequence number that says what it is waiting for. A slot at position pos is free to write when
+//   seq == pos, ready to read when seq == pos + 1, and is handed back to writers by setting seq = pos + slot_count.
+//   Claims may complete out of order, a slow writer only holds up the readers of its own slots.
+typedef struct {
+    uint64_t magic;                         //Identifies this as an mring file
+    uint64_t version;                       //Layout version of the mring
+    uint64_t slot_size;                     //Size of each slot in bytes, including the descriptor
+    uint64_t slot_count;                    //Number of slots in the mring
+    volatile uint64_t created;              //Set once the header and slots are initialised
+    volatile uint64_t attached;             //Number of istreams and ostreams attached
+    uint8_t pad0[CAMIO_MRING_CACHE_LINE - 6 * sizeof(uint64_t)];
+
+    volatile uint64_t head;                 //Next slot position to be claimed by a writer
+    uint8_t pad1[CAMIO_MRING_CACHE_LINE - sizeof(uint64_t)];
+
+    volatile uint64_t tail;                 //Next slot position to be claimed by a reader
+    uint8_t pad2[CAMIO_MRING_CACHE_LINE - sizeof(uint64_t)];
+} camio_mring_header_t;
+
+typedef struct {
+    volatile uint64_t seq;                  //Slot state, see above
+    uint64_t len;                           //Number of bytes of data in the slot, or CAMIO_MRING_LEN_SKIP
+    uint8_t pad[CAMIO_MRING_CACHE_LINE - 2 * sizeof(uint64_t)];
+} camio_mring_slot_t;
+
+//A writer that goes away still has to publish the slots it claimed ahead, so that readers don't wait on them forever.
+//It marks them with this, and readers hand them straight back without passing them on.
+#define CAMIO_MRING_LEN_SKIP (1ULL << 63)
+
+#define CAMIO_MRING_HEADER_SIZE (4 * 1024)  //Keep the slots page aligned
+#define CAMIO_MRING_SLOT_SIZE_MIN (2 * CAMIO_MRING_CACHE_LINE)
+#define CAMIO_MRING_SLOT_AVAIL  (priv->slot_size - sizeof(camio_mring_slot_t))
+#define CAMIO_MRING_MEM_SIZE    (CAMIO_MRING_HEADER_SIZE + priv->slot_size * priv->slot_count)
+
+
+#define CHECK_LEN_OK(len) \
+    if(len > CAMIO_MRING_SLOT_AVAIL){ \
+        eprintf_exit("Length supplied (%lu) is greater than slot size (%lu, corruption is likely.\n", len, CAMIO_MRING_SLOT_AVAIL ); \
+    }
+
+
+#define mring_header ((volatile camio_mring_header_t*)(priv->mring - CAMIO_MRING_HEADER_SIZE))
+#define mring_slot(i) ((volatile camio_mring_slot_t*)(priv->mring + ((i) % priv->slot_count) * priv->slot_size))
+#define mring_slot_data(i) ((uint8_t*)mring_slot(i) + sizeof(camio_mring_slot_t))
+
+
+//Create or attach to the mring in filename. slot_size and slot_count are used if the file has to be created (0 means
+//use the default) and are updated with the geometry actually in use. Returns a pointer to the first slot.
+volatile uint8_t* camio_mring_attach(const char* filename, uint64_t* slot_size, uint64_t* slot_count, int* fd_out);
+
+//Let go of an mring returned by camio_mring_attach(). Once every istream and ostream has gone, the file is removed.
+void camio_mring_detach(volatile uint8_t* mring, const char* filename, int fd);
+
+#endif /* CAMIO_MRING_H_ */
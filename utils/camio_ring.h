@@ -8,10 +8,36 @@
 #ifndef CAMIO_RING_H_
 #define CAMIO_RING_H_
 
-#define CAMIO_RING_SLOT_COUNT (1024)
-#define CAMIO_RING_SLOT_SIZE (4 * 1024)  //4K
-#define CAMIO_RING_SLOT_AVAIL (CAMIO_RING_SLOT_SIZE - sizeof(uint64_t) * 2)
-#define CAMIO_RING_MEM_SIZE ( CAMIO_RING_SLOT_COUNT * CAMIO_RING_SLOT_SIZE + 2* sizeof(uint64_t))
+#include <stdint.h>
+
+#include "camio_wait.h"
+#include "camio_doorbell.h"
+
+#define CAMIO_RING_SLOT_COUNT_DEFAULT (1024)
+#define CAMIO_RING_SLOT_SIZE_DEFAULT (4 * 1024)  //4K
+#define CAMIO_RING_SLOT_SIZE_MIN (4 * sizeof(uint64_t))
+
+#define CAMIO_RING_MAGIC   (0x434D494F52494E47ULL) //"CMIORING"
+#define CAMIO_RING_VERSION (3)
+
+//The writer describes the ring geometry in a header at the front of the shared file so that readers can adopt it.
+typedef struct {
+    uint64_t magic;                         //Identifies this as a ring file
+    uint64_t version;                       //Layout version of the ring
+    uint64_t slot_size;                     //Size of each slot in bytes, including the length and sync words at the end
+    uint64_t slot_count;                    //Number of slots in the ring
+    volatile uint64_t ostream_created;      //Set by the ostream once the header and slots are initialised
+    volatile uint64_t istream_connected;    //Set by the istream once it has mapped the ring
+    volatile uint64_t istream_wait;         //How the istream waits for data, anything but CAMIO_WAIT_SPIN means the ostream has to wake it
+    uint8_t pad0[CAMIO_WAIT_CACHE_LINE - 7 * sizeof(uint64_t)];
+
+    camio_wait_t wait;                      //Where the istream sleeps
+    camio_doorbell_ref_t doorbell;          //Which doorbell (if any) to ring when there is new data
+} camio_ring_header_t;
+
+#define CAMIO_RING_HEADER_SIZE (4 * 1024)  //Keep the slots page aligned
+#define CAMIO_RING_SLOT_AVAIL (priv->slot_size - sizeof(uint64_t) * 2)
+#define CAMIO_RING_MEM_SIZE ( CAMIO_RING_HEADER_SIZE + priv->slot_count * priv->slot_size )
 
 
 #define CHECK_LEN_OK(len) \
@@ -20,7 +46,11 @@
     }
 
 
-#define ring_istream_connected (*(volatile uint64_t*)(priv->ring + CAMIO_RING_SLOT_COUNT * CAMIO_RING_SLOT_SIZE))
-#define ring_ostream_created (*(volatile uint64_t*)(priv->ring + CAMIO_RING_SLOT_COUNT * CAMIO_RING_SLOT_SIZE + sizeof(uint64_t)))
+#define ring_header ((volatile camio_ring_header_t*)(priv->ring - CAMIO_RING_HEADER_SIZE))
+#define ring_istream_connected (ring_header->istream_connected)
+#define ring_ostream_created (ring_header->ostream_created)
+#define ring_istream_wait (ring_header->istream_wait)
+#define ring_wait (&ring_header->wait)
+#define ring_doorbell (&ring_header->doorbell)
 
 #endif /* CAMIO_RING_H_ */
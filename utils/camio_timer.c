@@ -0,0 +1,177 @@
+/*
+ * Copyright  (C) Matthew P. Grosvenor, 2012, All Rights Reserved
+ *
+ * Camio hierarchical timing wheel
+ *
+ */
+
+#include <string.h>
+
+#include "camio_timer.h"
+#include "camio_util.h"
+#include "../errors/camio_errors.h"
+
+
+void camio_timer_wheel_init(camio_timer_wheel_t* wheel, uint64_t tick_ns, uint64_t now_ns){
+    if(!tick_ns){
+        eprintf_exit("Timer wheel tick must be at least 1ns\n");
+    }
+
+    bzero(wheel, sizeof(camio_timer_wheel_t));
+    wheel->tick_ns = tick_ns;
+    wheel->now     = now_ns / tick_ns;
+}
+
+
+static inline void push(camio_timer_t** head, camio_timer_t* timer){
+    timer->next  = *head;
+    timer->pprev = head;
+    if(*head){
+        (*head)->pprev = &timer->next;
+    }
+    *head = timer;
+}
+
+
+static inline void unlink_timer(camio_timer_t* timer){
+    *timer->pprev = timer->next;
+    if(timer->next){
+        timer->next->pprev = timer->pprev;
+    }
+    timer->next  = NULL;
+    timer->pprev = NULL;
+}
+
+
+//Put a timer in the slot that matches its expiry, given where the wheel is now
+static void place(camio_timer_wheel_t* wheel, camio_timer_t* timer){
+    if(timer->expiry <= wheel->now){
+        timer->level = CAMIO_TIMER_EXPIRED;
+        push(&wheel->expired, timer);
+        return;
+    }
+
+    const uint32_t level = (63 - __builtin_clzll(timer->expiry ^ wheel->now)) / CAMIO_TIMER_SLOT_BITS;
+    const uint32_t slot  = (timer->expiry >> (level * CAMIO_TIMER_SLOT_BITS)) & (CAMIO_TIMER_SLOTS - 1);
+    timer->level = level;
+    timer->slot  = slot;
+    push(&wheel->slots[level][slot], timer);
+    wheel->occupied[level] |= 1ULL << slot;
+    wheel->pending++;
+}
+
+
+void camio_timer_cancel(camio_timer_wheel_t* wheel, camio_timer_t* timer){
+    if(!camio_timer_is_set(timer)){
+        return;
+    }
+
+    const uint32_t level = timer->level;
+    const uint32_t slot  = timer->slot;
+    unlink_timer(timer);
+
+    if(level != CAMIO_TIMER_EXPIRED){
+        wheel->pending--;
+        if(!wheel->slots[level][slot]){
+            wheel->occupied[level] &= ~(1ULL << slot);
+        }
+    }
+}
+
+
+void camio_timer_add(camio_timer_wheel_t* wheel, camio_timer_t* timer, uint64_t expiry_ns, size_t index){
+    camio_timer_cancel(wheel, timer);
+    timer->expiry = expiry_ns / wheel->tick_ns + (expiry_ns % wheel->tick_ns != 0); //Round up, so we never go off early
+    timer->index  = index;
+    place(wheel, timer);
+}
+
+
+//The first tick at which something in the wheel has to happen
+static inline uint64_t next_event(camio_timer_wheel_t* wheel){
+    uint64_t next = ~0ULL;
+
+    uint32_t level = 0;
+    for(; level < CAMIO_TIMER_LEVELS; level++){
+        if(!wheel->occupied[level]){
+            continue;
+        }
+
+        //Everything in this level shares the bits above it with now
+        const uint32_t shift = (level + 1) * CAMIO_TIMER_SLOT_BITS;
+        const uint64_t base  = shift >= 64 ? 0 : (wheel->now >> shift) << shift;
+        const uint64_t slot  = __builtin_ctzll(wheel->occupied[level]);
+        next = MIN(next, base | (slot << (level * CAMIO_TIMER_SLOT_BITS)));
+    }
+
+    return next;
+}
+
+
+//Empty out a slot, putting each timer back in the wheel relative to now
+static void cascade(camio_timer_wheel_t* wheel, uint32_t level, uint32_t slot){
+    camio_timer_t* timer = wheel->slots[level][slot];
+    wheel->slots[level][slot] = NULL;
+    wheel->occupied[level] &= ~(1ULL << slot);
+
+    while(timer){
+        camio_timer_t* next = timer->next;
+        wheel->pending--;
+        timer->next  = NULL;
+        timer->pprev = NULL;
+        place(wheel, timer);
+        timer = next;
+    }
+}
+
+
+void camio_timer_advance(camio_timer_wheel_t* wheel, uint64_t now_ns){
+    const uint64_t target = now_ns / wheel->tick_ns;
+
+    while(wheel->now < target){
+        const uint64_t next = wheel->pending ? next_event(wheel) : ~0ULL;
+        if(next > target){
+            wheel->now = target; //Nothing happens between here and there
+            return;
+        }
+
+        wheel->now = next;
+
+        //The slot we've arrived at on each level comes down, from the top so that nothing is missed
+        int level = CAMIO_TIMER_LEVELS - 1;
+        for(; level >= 0; level--){
+            const uint32_t shift = level * CAMIO_TIMER_SLOT_BITS;
+            if(level && (wheel->now & ((1ULL << shift) - 1))){
+                continue; //Not at the start of a slot on this level
+            }
+
+            const uint32_t slot = (wheel->now >> shift) & (CAMIO_TIMER_SLOTS - 1);
+            if(wheel->occupied[level] & (1ULL << slot)){
+                cascade(wheel, level, slot);
+            }
+        }
+    }
+}
+
+
+camio_timer_t* camio_timer_pop_expired(camio_timer_wheel_t* wheel){
+    camio_timer_t* timer = wheel->expired;
+    if(timer){
+        unlink_timer(timer);
+    }
+    return timer;
+}
+
+
+uint64_t camio_timer_next_ns(camio_timer_wheel_t* wheel){
+    if(wheel->expired){
+        return 0;
+    }
+
+    if(!wheel->pending){
+        return ~0ULL;
+    }
+
+    const uint64_t next = next_event(wheel);
+    return next > ~0ULL / wheel->tick_ns ? ~0ULL : next * wheel->tick_ns;
+}
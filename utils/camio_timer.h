@@ -0,0 +1,74 @@
+/*
+ * camio_timer.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: mgrosvenor
+ */
+
+#ifndef CAMIO_TIMER_H_
+#define CAMIO_TIMER_H_
+
+#include <stdint.h>
+#include <time.h>
+
+#define CAMIO_TIMER_SLOT_BITS (6)
+#define CAMIO_TIMER_SLOTS (1 << CAMIO_TIMER_SLOT_BITS)                                  //One bit per slot in a uint64_t
+#define CAMIO_TIMER_LEVELS ((64 + CAMIO_TIMER_SLOT_BITS - 1) / CAMIO_TIMER_SLOT_BITS)   //Enough levels to cover every tick
+#define CAMIO_TIMER_EXPIRED (CAMIO_TIMER_LEVELS)                                        //Level of timers that have gone off
+#define CAMIO_TIMER_TICK_NS_DEFAULT (1000)
+
+//A hierarchical timing wheel. Adding and cancelling a timer is O(1), whatever the number of timers.
+// - Level L has a slot for each value of bits [6L, 6L + 6) of the expiry tick. A timer goes in the lowest level whose
+//   slot tells it apart from now, ie. the level of the highest bit in which its expiry and now differ.
+// - As time moves on, the slot at level L that now has reached is emptied into the levels below it, until timers get
+//   to level 0, where they go off.
+// - Each level has a bitmap of its occupied slots, so moving time on jumps straight to the next slot that has
+//   anything in it, rather than ticking through the empty ones.
+// - Timers are embedded in the caller's own structures, so the wheel never allocates.
+struct camio_timer;
+typedef struct camio_timer camio_timer_t;
+struct camio_timer {
+    camio_timer_t* next;
+    camio_timer_t** pprev;                              //Points at whatever points at us, NULL if the timer isn't set
+    uint64_t expiry;                                    //In ticks
+    size_t index;                                       //Handed back when the timer goes off
+    uint32_t level;
+    uint32_t slot;
+};
+
+typedef struct {
+    uint64_t tick_ns;                                   //Resolution of the wheel
+    uint64_t now;                                       //In ticks
+    uint64_t pending;                                   //Timers in the wheel, not counting those that have gone off
+    uint64_t occupied[CAMIO_TIMER_LEVELS];              //Bit s is set when slots[L][s] is non empty
+    camio_timer_t* slots[CAMIO_TIMER_LEVELS][CAMIO_TIMER_SLOTS];
+    camio_timer_t* expired;                             //Timers that have gone off, and not yet been collected
+} camio_timer_wheel_t;
+
+
+static inline uint64_t camio_timer_now_ns(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000 * 1000 * 1000ULL + ts.tv_nsec;
+}
+
+static inline int camio_timer_is_set(const camio_timer_t* timer){
+    return timer->pprev != NULL;
+}
+
+
+void camio_timer_wheel_init(camio_timer_wheel_t* wheel, uint64_t tick_ns, uint64_t now_ns);
+
+//Set a timer to go off at expiry_ns (CLOCK_MONOTONIC), handing back index. A timer that is already set is moved.
+void camio_timer_add(camio_timer_wheel_t* wheel, camio_timer_t* timer, uint64_t expiry_ns, size_t index);
+void camio_timer_cancel(camio_timer_wheel_t* wheel, camio_timer_t* timer);
+
+//Move time on to now_ns, and collect the timers that have gone off one at a time. Returns NULL when there are no more.
+void camio_timer_advance(camio_timer_wheel_t* wheel, uint64_t now_ns);
+camio_timer_t* camio_timer_pop_expired(camio_timer_wheel_t* wheel);
+
+//When the wheel next needs to be looked at. Never later than the first timer, but it may be earlier when timers still
+//have to move down a level. Returns 0 if there are timers to collect, and ~0 if there is nothing in the wheel.
+uint64_t camio_timer_next_ns(camio_timer_wheel_t* wheel);
+
+#endif /* CAMIO_TIMER_H_ */
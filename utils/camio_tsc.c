@@ -0,0 +1,106 @@
+/*
+ * Copyright  (C) Matthew P. Grosvenor, 2012, All Rights Reserved
+ *
+ * Camio TSC calibration
+ *
+ */
+
+#include <time.h>
+#include <cpuid.h>
+
+#include "camio_tsc.h"
+#include "camio_util.h"
+#include "../errors/camio_errors.h"
+
+#define CAMIO_TSC_ACCURACY_NS (1000)  //Conversions should be better than this, or the TSC isn't worth using
+#define CAMIO_TSC_CHECK_NS (2 * 1000 * 1000)
+#define CAMIO_TSC_SAMPLES (5)
+
+
+static inline uint64_t clock_ns(clockid_t clock_id){
+    struct timespec ts;
+    clock_gettime(clock_id, &ts);
+    return ts.tv_sec * 1000 * 1000 * 1000ULL + ts.tv_nsec;
+}
+
+
+//Take a TSC reading and a clock reading as close together as we can. The TSC is read either side of the clock, and the
+//pair with the least in between is kept. Returns the uncertainty in TSC ticks.
+static uint64_t sample(clockid_t clock_id, uint64_t* tsc_out, uint64_t* ns_out){
+    uint64_t best = ~0ULL;
+
+    int i = 0;
+    for(; i < CAMIO_TSC_SAMPLES; i++){
+        const uint64_t before = camio_tsc_read();
+        const uint64_t ns     = clock_ns(clock_id);
+        const uint64_t after  = camio_tsc_read();
+        if(after - before < best){
+            best     = after - before;
+            *tsc_out = before + (after - before) / 2;
+            *ns_out  = ns;
+        }
+    }
+
+    return best;
+}
+
+
+static void set_rate(camio_tsc_t* tsc, uint64_t tsc_delta, uint64_t ns_delta){
+    if(unlikely(!tsc_delta || !ns_delta)){
+        eprintf_exit("Could not measure the TSC rate, it did not move (%lu ticks in %luns)\n", tsc_delta, ns_delta);
+    }
+
+    tsc->tsc_per_ns = (uint64_t)(((unsigned __int128)tsc_delta << 32) / ns_delta);
+    tsc->ns_per_tsc = (uint64_t)(((unsigned __int128)ns_delta << 32) / tsc_delta);
+}
+
+
+void camio_tsc_calibrate(camio_tsc_t* tsc, clockid_t clock_id){
+    tsc->clock_id = clock_id;
+
+    //Without an invariant TSC, the rate changes with the CPU frequency, and the numbers below mean nothing
+    unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+    if(!__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) || !(edx & (1 << 8))){
+        wprintf("This CPU does not report an invariant TSC, TSC based times may drift\n");
+    }
+
+    sample(clock_id, &tsc->tsc_start, &tsc->ns_start);
+
+    uint64_t tsc_end = 0;
+    uint64_t ns_end  = 0;
+    do{
+        sample(clock_id, &tsc_end, &ns_end);
+    } while(ns_end - tsc->ns_start < CAMIO_TSC_CALIBRATE_NS);
+
+    set_rate(tsc, tsc_end - tsc->tsc_start, ns_end - tsc->ns_start);
+    tsc->tsc_base   = tsc_end;
+    tsc->ns_base    = ns_end;
+    tsc->tsc_refine = camio_tsc_from_ns(tsc, ns_end + CAMIO_TSC_REFINE_NS);
+
+    //Check that we can still tell the time to within a microsecond a little while later
+    uint64_t check_tsc = 0;
+    uint64_t check_ns  = 0;
+    uint64_t uncertainty = 0;
+    do{
+        uncertainty = sample(clock_id, &check_tsc, &check_ns);
+    } while(check_ns - ns_end < CAMIO_TSC_CHECK_NS);
+
+    const uint64_t predicted   = camio_tsc_to_ns(tsc, check_tsc);
+    const uint64_t error       = predicted > check_ns ? predicted - check_ns : check_ns - predicted;
+    const uint64_t slack       = camio_tsc_to_ns(tsc, tsc->tsc_base + uncertainty) - tsc->ns_base;
+    if(error > CAMIO_TSC_ACCURACY_NS + slack){
+        wprintf("TSC calibration is only good to %luns (read uncertainty %luns), expected better than %uns\n", error, slack, CAMIO_TSC_ACCURACY_NS);
+    }
+}
+
+
+void camio_tsc_refine(camio_tsc_t* tsc){
+    uint64_t tsc_now = 0;
+    uint64_t ns_now  = 0;
+    sample(tsc->clock_id, &tsc_now, &ns_now);
+
+    set_rate(tsc, tsc_now - tsc->tsc_start, ns_now - tsc->ns_start);
+    tsc->tsc_base   = tsc_now;
+    tsc->ns_base    = ns_now;
+    tsc->tsc_refine = camio_tsc_from_ns(tsc, ns_now + CAMIO_TSC_REFINE_NS);
+}
@@ -0,0 +1,59 @@
+/*
+ * camio_tsc.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: mgrosvenor
+ */
+
+#ifndef CAMIO_TSC_H_
+#define CAMIO_TSC_H_
+
+#include <stdint.h>
+#include <time.h>
+
+#define CAMIO_TSC_CALIBRATE_NS (10 * 1000 * 1000)         //How long to measure the TSC against the clock for at startup
+#define CAMIO_TSC_REFINE_NS (1000 * 1000 * 1000)          //How often the conversion is brought back into line with the clock
+
+//Converts between TSC ticks and ns on a reference clock (eg CLOCK_MONOTONIC). The rate is measured against the clock
+//once at startup, and then refined against it now and then over a longer baseline, so that errors in the rate don't
+//build up.
+typedef struct {
+    clockid_t clock_id;                                 //The reference clock
+    uint64_t tsc_base;                                  //A TSC reading,
+    uint64_t ns_base;                                   //and the clock at the same moment
+    uint64_t tsc_per_ns;                                //Fixed point, 32 fractional bits
+    uint64_t ns_per_tsc;                                //Fixed point, 32 fractional bits
+    uint64_t tsc_start;                                 //The first reading, rates are measured from here
+    uint64_t ns_start;
+    uint64_t tsc_refine;                                //When to next call camio_tsc_refine()
+} camio_tsc_t;
+
+
+static inline uint64_t camio_tsc_read(void){
+    uint32_t lo, hi;
+    asm volatile("rdtsc" : "=a" (lo), "=d" (hi));
+    return lo | ((uint64_t)hi << 32);
+}
+
+static inline uint64_t camio_tsc_to_ns(const camio_tsc_t* tsc, uint64_t ticks){
+    if(ticks >= tsc->tsc_base){
+        return tsc->ns_base + (uint64_t)(((unsigned __int128)(ticks - tsc->tsc_base) * tsc->ns_per_tsc) >> 32);
+    }
+    return tsc->ns_base - (uint64_t)(((unsigned __int128)(tsc->tsc_base - ticks) * tsc->ns_per_tsc) >> 32);
+}
+
+static inline uint64_t camio_tsc_from_ns(const camio_tsc_t* tsc, uint64_t ns){
+    if(ns >= tsc->ns_base){
+        return tsc->tsc_base + (uint64_t)(((unsigned __int128)(ns - tsc->ns_base) * tsc->tsc_per_ns) >> 32);
+    }
+    return tsc->tsc_base - (uint64_t)(((unsigned __int128)(tsc->ns_base - ns) * tsc->tsc_per_ns) >> 32);
+}
+
+//Measure the TSC against clock_id. Warns if the TSC doesn't run at a constant rate, or if the result can't be trusted
+//to better than a microsecond.
+void camio_tsc_calibrate(camio_tsc_t* tsc, clockid_t clock_id);
+
+//Re-measure the rate over everything since calibration, and re-base on the clock. Call when tsc_refine has passed.
+void camio_tsc_refine(camio_tsc_t* tsc);
+
+#endif /* CAMIO_TSC_H_ */
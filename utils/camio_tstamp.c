@@ -0,0 +1,166 @@
+/*
+ * Copyright  (C) Matthew P. Grosvenor, 2012, All Rights Reserved
+ *
+ * Camio kernel timestamps
+ *
+ */
+
+#include <string.h>
+#include <errno.h>
+#include <sys/ioctl.h>
+#include <net/if.h>
+#include <netinet/in.h>
+#include <linux/errqueue.h>
+#include <linux/net_tstamp.h>
+#include <linux/sockios.h>
+
+#include "camio_tstamp.h"
+#include "camio_util.h"
+#include "../errors/camio_errors.h"
+
+
+int camio_tstamp_parse(const char* value){
+    if(strcmp(value,"sw") == 0){
+        return CAMIO_TSTAMP_SW;
+    }
+    if(strcmp(value,"hw") == 0){
+        return CAMIO_TSTAMP_HW;
+    }
+
+    eprintf_exit( "Unknown timestamp mode \"%s\", expected \"sw\" or \"hw\"\n", value);
+    return CAMIO_TSTAMP_NONE;
+}
+
+
+//Tell the driver to stamp everything. Needs CAP_NET_ADMIN, so a failure is only worth a warning.
+static void enable_hw(int fd, const char* iface){
+    struct hwtstamp_config config;
+    memset(&config, 0, sizeof(config));
+    config.tx_type   = HWTSTAMP_TX_ON;
+    config.rx_filter = HWTSTAMP_FILTER_ALL;
+
+    struct ifreq ifr;
+    memset(&ifr, 0, sizeof(ifr));
+    strncpy(ifr.ifr_name, iface, IFNAMSIZ - 1);
+    ifr.ifr_data = (void*)&config;
+    if(ioctl(fd, SIOCSHWTSTAMP, &ifr) < 0){
+        wprintf("Could not turn on hardware timestamps on \"%s\". Error = %s\n", iface, strerror(errno));
+    }
+}
+
+
+void camio_tstamp_enable(int fd, int mode, int tx, const char* iface){
+    int flags = 0;
+    switch(mode){
+        case CAMIO_TSTAMP_NONE:
+            return;
+        case CAMIO_TSTAMP_SW:
+            flags = SOF_TIMESTAMPING_SOFTWARE | SOF_TIMESTAMPING_RX_SOFTWARE;
+            flags |= tx ? SOF_TIMESTAMPING_TX_SOFTWARE : 0;
+            break;
+        case CAMIO_TSTAMP_HW:
+            flags = SOF_TIMESTAMPING_RAW_HARDWARE | SOF_TIMESTAMPING_RX_HARDWARE;
+            flags |= tx ? SOF_TIMESTAMPING_TX_HARDWARE : 0;
+            if(iface){
+                enable_hw(fd, iface);
+            }
+            break;
+        default:
+            eprintf_exit("Unknown timestamp mode %i\n", mode);
+    }
+
+    //Number the sends, and don't loop the data back with the transmit stamps, we only want the time
+    if(tx){
+        flags |= SOF_TIMESTAMPING_OPT_ID | SOF_TIMESTAMPING_OPT_TSONLY;
+    }
+
+    if(setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof(flags)) < 0){
+        eprintf_exit("Could not turn on timestamps. Error = %s\n", strerror(errno));
+    }
+}
+
+
+//Software stamps are in ts[0], hardware stamps in ts[2]. ts[1] is no longer used.
+static uint16_t from_timestamping(const struct scm_timestamping* stamps, uint64_t* ts_ns_out){
+    if(stamps->ts[2].tv_sec || stamps->ts[2].tv_nsec){
+        *ts_ns_out = stamps->ts[2].tv_sec * 1000 * 1000 * 1000ULL + stamps->ts[2].tv_nsec;
+        return CAMIO_META_TS | CAMIO_META_TS_HW;
+    }
+    if(stamps->ts[0].tv_sec || stamps->ts[0].tv_nsec){
+        *ts_ns_out = stamps->ts[0].tv_sec * 1000 * 1000 * 1000ULL + stamps->ts[0].tv_nsec;
+        return CAMIO_META_TS;
+    }
+    return 0;
+}
+
+
+uint16_t camio_tstamp_rx(struct msghdr* msg, uint64_t* ts_ns_out){
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(msg);
+    for(; cmsg; cmsg = CMSG_NXTHDR(msg, cmsg)){
+        if(cmsg->cmsg_level != SOL_SOCKET){
+            continue;
+        }
+
+        if(likely(cmsg->cmsg_type == SO_TIMESTAMPING)){
+            return from_timestamping((struct scm_timestamping*)CMSG_DATA(cmsg), ts_ns_out);
+        }
+
+        if(cmsg->cmsg_type == SO_TIMESTAMPNS){
+            const struct timespec* ts = (struct timespec*)CMSG_DATA(cmsg);
+            *ts_ns_out = ts->tv_sec * 1000 * 1000 * 1000ULL + ts->tv_nsec;
+            return CAMIO_META_TS;
+        }
+    }
+
+    return 0;
+}
+
+
+uint16_t camio_tstamp_tx(int fd, uint64_t* ts_ns_out, uint64_t* seq_out){
+    uint16_t result = 0;
+    char control[CAMIO_TSTAMP_CONTROL_SIZE];
+
+    while(1){
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_control    = control;
+        msg.msg_controllen = sizeof(control);
+
+        if(recvmsg(fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0){
+            if(errno == EAGAIN || errno == EWOULDBLOCK){
+                return result; //That's all of them
+            }
+            eprintf_exit("Could not read transmit timestamps. Error = %s\n", strerror(errno));
+        }
+
+        //A stamp comes with the extended error that says which send it was for
+        uint64_t ts_ns   = 0;
+        uint16_t flags   = 0;
+        int has_id       = 0;
+        uint32_t id      = 0;
+        struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+        for(; cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)){
+            if(cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SO_TIMESTAMPING){
+                flags = from_timestamping((struct scm_timestamping*)CMSG_DATA(cmsg), &ts_ns);
+                continue;
+            }
+
+            const int is_err = (cmsg->cmsg_level == SOL_IP && cmsg->cmsg_type == IP_RECVERR) ||
+                               (cmsg->cmsg_level == SOL_IPV6 && cmsg->cmsg_type == IPV6_RECVERR);
+            const struct sock_extended_err* err = (struct sock_extended_err*)CMSG_DATA(cmsg);
+            if(is_err && err->ee_origin == SO_EE_ORIGIN_TIMESTAMPING){
+                id     = err->ee_data;
+                has_id = 1;
+            }
+        }
+
+        if(flags){
+            *ts_ns_out = ts_ns;
+            result     = flags;
+            if(has_id){
+                *seq_out = id;
+                result  |= CAMIO_META_SEQ;
+            }
+        }
+    }
+}
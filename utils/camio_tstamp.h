@@ -0,0 +1,41 @@
+/*
+ * camio_tstamp.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: mgrosvenor
+ */
+
+#ifndef CAMIO_TSTAMP_H_
+#define CAMIO_TSTAMP_H_
+
+#include <stdint.h>
+#include <sys/socket.h>
+
+#include "camio_meta.h"
+
+#define CAMIO_TSTAMP_CONTROL_SIZE (256)         //Room for the control messages that carry a timestamp
+
+enum {
+    CAMIO_TSTAMP_NONE = 0,                      //Don't ask for timestamps, reads stay as cheap as they were
+    CAMIO_TSTAMP_SW,                            //The kernel stamps messages as they pass through the stack
+    CAMIO_TSTAMP_HW,                            //The NIC stamps messages on the wire
+};
+
+//Kernel timestamps with SO_TIMESTAMPING. Receive stamps come back as control messages on recvmsg. Transmit stamps are
+//looped back on the socket's error queue, tagged with the number of the send they belong to.
+
+//Parse the value of a "tstamp=" option, one of "sw" or "hw"
+int camio_tstamp_parse(const char* value);
+
+//Ask for timestamps on fd. When iface is known, hardware stamping is also switched on in the NIC, otherwise it must
+//have been switched on already (eg. with hwstamp_ctl).
+void camio_tstamp_enable(int fd, int mode, int tx, const char* iface);
+
+//Find the receive stamp in a message read with recvmsg. Returns the CAMIO_META_* flags that apply, 0 if there's no stamp
+uint16_t camio_tstamp_rx(struct msghdr* msg, uint64_t* ts_ns_out);
+
+//Collect any transmit stamps waiting on fd's error queue, keeping the latest. Never blocks. Returns the CAMIO_META_*
+//flags that apply, 0 if there weren't any.
+uint16_t camio_tstamp_tx(int fd, uint64_t* ts_ns_out, uint64_t* seq_out);
+
+#endif /* CAMIO_TSTAMP_H_ */
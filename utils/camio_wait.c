@@ -0,0 +1,120 @@
+/*
+ * Copyright  (C) Matthew P. Grosvenor, 2012, All Rights Reserved
+ *
+ * Camio blocking wake up for shared memory rings
+ *
+ */
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include "camio_wait.h"
+#include "../errors/camio_errors.h"
+
+#define CAMIO_WAIT_FD_SUFFIX ".wake"
+
+
+int camio_wait_mode(const char* mode){
+    if(strcmp(mode,"spin") == 0){
+        return CAMIO_WAIT_SPIN;
+    }
+    else if(strcmp(mode,"futex") == 0){
+        return CAMIO_WAIT_FUTEX;
+    }
+    else if(strcmp(mode,"fd") == 0){
+        return CAMIO_WAIT_FD;
+    }
+
+    eprintf_exit( "Unknown wait mode \"%s\". Valid modes are \"spin\", \"futex\" and \"fd\"\n", mode);
+    return CAMIO_WAIT_SPIN;
+}
+
+
+//The ring lives in a shared file, so this has to be a shared (not private) futex
+void camio_wait_sleep(volatile camio_wait_t* wait, uint32_t futex_val){
+    if(syscall(SYS_futex, &wait->futex, FUTEX_WAIT, futex_val, NULL, NULL, 0) < 0){
+        if(errno != EAGAIN && errno != EINTR){
+            eprintf_exit( "Futex wait failed. Error=%s\n", strerror(errno));
+        }
+    }
+}
+
+
+static char* fd_name(const char* filename){
+    char* name = malloc(strlen(filename) + strlen(CAMIO_WAIT_FD_SUFFIX) + 1);
+    if(!name){
+        eprintf_exit("No memory available for wake fd name\n");
+    }
+    strcpy(name, filename);
+    strcat(name, CAMIO_WAIT_FD_SUFFIX);
+    return name;
+}
+
+
+//Opened read/write so that the fifo never sees end of file when the writer goes away
+int camio_wait_fd_open(const char* filename){
+    char* name = fd_name(filename);
+    if(mkfifo(name, (mode_t)(0666)) < 0 && errno != EEXIST){
+        eprintf_exit("Could not make wake fifo \"%s\". Error=%s\n", name, strerror(errno));
+    }
+
+    const int fd = open(name, O_RDWR | O_NONBLOCK);
+    if(fd < 0){
+        eprintf_exit("Could not open wake fifo \"%s\". Error=%s\n", name, strerror(errno));
+    }
+
+    free(name);
+    return fd;
+}
+
+
+void camio_wait_fd_close(const char* filename, int fd){
+    char* name = fd_name(filename);
+    close(fd);
+    unlink(name);
+    free(name);
+}
+
+
+void camio_wait_fd_drain(int fd){
+    uint8_t buff[64];
+    while(read(fd, buff, sizeof(buff)) > 0){}
+}
+
+
+void camio_wait_fd_ring(int fd){
+    const uint8_t byte = 1;
+    if(write(fd, &byte, 1) < 0 && errno != EAGAIN){ //A full pipe is readable anyway
+        wprintf("Could not write to wake fd. Error=%s\n", strerror(errno));
+    }
+}
+
+
+void camio_wait_wake(volatile camio_wait_t* wait, const char* filename, int* wake_fd){
+    if(wait->sleepers){
+        __sync_fetch_and_add(&wait->futex, 1);
+        if(syscall(SYS_futex, &wait->futex, FUTEX_WAKE, INT_MAX, NULL, NULL, 0) < 0){
+            eprintf_exit( "Futex wake failed. Error=%s\n", strerror(errno));
+        }
+    }
+
+    //Only one byte per arming, so that a busy writer does not make a syscall for every write
+    if(wait->armed && __sync_bool_compare_and_swap(&wait->armed, 1, 0)){
+        if(*wake_fd < 0){
+            char* name = fd_name(filename);
+            *wake_fd = open(name, O_WRONLY | O_NONBLOCK);
+            free(name);
+            if(*wake_fd < 0){
+                return; //The reader has gone away
+            }
+        }
+        camio_wait_fd_ring(*wake_fd);
+    }
+}
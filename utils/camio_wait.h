@@ -0,0 +1,82 @@
+/*
+ * camio_wait.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: mgrosvenor
+ */
+
+#ifndef CAMIO_WAIT_H_
+#define CAMIO_WAIT_H_
+
+#include <stdint.h>
+
+#include "camio_util.h"
+
+#define CAMIO_WAIT_SPIN_DEFAULT (10 * 1000)   //Empty polls before a reader goes to sleep
+#define CAMIO_WAIT_CACHE_LINE (64)
+
+//How an istream on a shared memory ring waits for data
+enum {
+    CAMIO_WAIT_SPIN = 0,    //Spin forever, the writer never has to do anything
+    CAMIO_WAIT_FUTEX,       //Spin for a while, then sleep on the futex in the ring header
+    CAMIO_WAIT_FD,          //As above, and also make the stream's selector fd readable when there is data, so it can be polled
+};
+
+//Lives on its own cache line in the shared ring header. Readers only write to it when they are about to sleep and the
+//writer only writes to it when there is someone to wake, so in the busy case the line just sits in everyone's cache.
+typedef struct {
+    volatile uint32_t futex;                //Bumped by the writer every time it wakes sleepers
+    volatile uint32_t sleepers;             //Number of readers asleep on the futex, or about to be
+    volatile uint32_t armed;                //Set by a reader that wants a byte on its wake fd as soon as there is data
+    uint8_t pad[CAMIO_WAIT_CACHE_LINE - 3 * sizeof(uint32_t)];
+} camio_wait_t;
+
+//Parse a wait=spin|futex|fd option value
+int camio_wait_mode(const char* mode);
+
+/* ****************************************************
+ * Reader side
+ */
+
+//Say that we're about to sleep. Returns the futex value to sleep on. Check for data once more before sleeping, the
+//locked increment orders our flag before that check.
+static inline uint32_t camio_wait_prepare(volatile camio_wait_t* wait){
+    const uint32_t futex_val = wait->futex;
+    __sync_fetch_and_add(&wait->sleepers, 1);
+    return futex_val;
+}
+
+//Sleep until the writer bumps the futex past futex_val. May return early.
+void camio_wait_sleep(volatile camio_wait_t* wait, uint32_t futex_val);
+
+static inline void camio_wait_finish(volatile camio_wait_t* wait){
+    __sync_fetch_and_sub(&wait->sleepers, 1);
+}
+
+//Make (if needed) and open the wake fifo that goes with the ring in filename, returns the (non-blocking) read end
+int camio_wait_fd_open(const char* filename);
+void camio_wait_fd_close(const char* filename, int fd);
+
+//Empty the wake fd. Call this only when the ring has been found empty, then arm it and check for data once more.
+void camio_wait_fd_drain(int fd);
+
+//Make the wake fd readable
+void camio_wait_fd_ring(int fd);
+
+/* ****************************************************
+ * Writer side
+ */
+
+//Wake everyone that is waiting. wake_fd caches the write end of the wake fifo, it starts out as -1.
+void camio_wait_wake(volatile camio_wait_t* wait, const char* filename, int* wake_fd);
+
+//Call after publishing data, only if the istream has asked for it. The full barrier makes sure that our slot stores are
+//visible before we look for sleepers, which is what stops a reader from going to sleep on data it could not see yet.
+static inline void camio_wait_notify(volatile camio_wait_t* wait, const char* filename, int* wake_fd){
+    __sync_synchronize();
+    if(unlikely(wait->sleepers || wait->armed)){
+        camio_wait_wake(wait, filename, wake_fd);
+    }
+}
+
+#endif /* CAMIO_WAIT_H_ */